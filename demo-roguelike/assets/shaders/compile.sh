@@ -1,7 +1,7 @@
 #!/bin/bash
 rm -rf spirv
 mkdir -p spirv
-for ext in vert frag; do
+for ext in vert frag comp; do
 	files=*.${ext}
 	numfiles=$(echo ${files} | wc -w)
 	echo "Compiling ${numfiles} ${ext} shaders..."
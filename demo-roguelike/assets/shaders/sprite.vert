@@ -8,7 +8,7 @@ layout(location = 2) in vec2 vertexUV;
 layout(location = 0) out vec4 fragmentColor;
 layout(location = 1) out vec2 fragmentUV;
 
-#define BATCH_SIZE 292
+#define BATCH_SIZE 272
 #define VERTS_PER_SPRITE 6
 
 layout(set = 0, binding = 0) uniform USpriteBatch {
@@ -16,6 +16,8 @@ layout(set = 0, binding = 0) uniform USpriteBatch {
 	vec4 textureAreas [BATCH_SIZE];
 	vec4 colors       [BATCH_SIZE];
 	vec4 trigonometry [BATCH_SIZE / 2];
+	vec4 depths       [BATCH_SIZE / 4];
+	vec4 animation;   // frame count, frames per second, time
 } batch;
 
 void main() {
@@ -34,9 +36,13 @@ void main() {
 
 	gl_Position = vec4(
 		batch.bounds[index].xy + (rot + 0.5) * batch.bounds[index].zw,
-		0.0, 1.0
+		batch.depths[index / 4][index % 4], 1.0
 	);
 
 	fragmentColor = vec4(vertexColor, 1.0) * batch.colors[index];
-	fragmentUV = batch.textureAreas[index].xy + vertexUV * batch.textureAreas[index].zw;
+	// Animation frames are stacked vertically, each one texture area high.
+	float frame = mod(floor(batch.animation.z * batch.animation.y), batch.animation.x);
+	vec4 area = batch.textureAreas[index];
+
+	fragmentUV = area.xy + vec2(0.0, frame * area.w) + vertexUV * area.zw;
 }
@@ -3,11 +3,20 @@
 
 layout(location = 0) in vec4 fragmentColor;
 layout(location = 1) in vec2 fragmentUV;
+layout(location = 2) flat in vec2 fragmentFrame; // index, count
 
 layout(location = 0) out vec4 displayColor;
 
 layout(set = 1, binding = 0) uniform sampler2D colorMap;
 
 void main() {
-	displayColor = fragmentColor * texture(colorMap, fragmentUV);
+	vec2 uv = fragmentUV;
+
+	// Map the (possibly tiling) coordinate into the current frame
+	// of a texture holding a vertical strip of animation frames.
+	if (fragmentFrame.y > 1.0) {
+		uv.y = (fract(uv.y) + fragmentFrame.x) / fragmentFrame.y;
+	}
+
+	displayColor = fragmentColor * texture(colorMap, uv);
 }
@@ -5,23 +5,29 @@ layout(location = 0) in vec3 vertexPosition;
 layout(location = 1) in vec3 vertexColor;
 layout(location = 2) in vec2 vertexUV;
 
+// Per instance, with the matrix taking up locations 3 to 6.
+layout(location = 3) in mat4 instanceModelMatrix;
+layout(location = 7) in vec4 instanceAnimation; // frame count, frames per second
+
 layout(location = 0) out vec4 fragmentColor;
 layout(location = 1) out vec2 fragmentUV;
+layout(location = 2) flat out vec2 fragmentFrame;
 
 layout(set = 0, binding = 0) uniform UniformData {
 	mat4 cameraTransform;
+	float time;
 } globals;
 
-layout(push_constant) uniform PushConstantData {
-	mat4 modelMatrix;
-} self;
-
 void main() {
 
 	gl_Position = globals.cameraTransform 
-			* self.modelMatrix 
+			* instanceModelMatrix 
 	    		* vec4(vertexPosition, 1.0);
 	
 	fragmentColor = vec4(vertexColor, 1.0);
 	fragmentUV = vertexUV;
+	fragmentFrame = vec2(
+		mod(floor(globals.time * instanceAnimation.y), instanceAnimation.x),
+		instanceAnimation.x
+	);
 }
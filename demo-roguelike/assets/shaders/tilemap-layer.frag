@@ -0,0 +1,30 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec2 fragmentTileCoord;
+layout(location = 1) flat in vec3 fragmentTileset;
+
+layout(location = 0) out vec4 displayColor;
+
+layout(set = 1, binding = 0) uniform sampler2D tileset;
+layout(set = 2, binding = 0) uniform usampler2D tileIndices;
+
+void main() {
+	ivec2 tile = ivec2(floor(fragmentTileCoord));
+	uint value = texelFetch(tileIndices, tile, 0).r;
+
+	// Index zero marks an empty tile.
+	if (value == 0u) {
+		discard;
+	}
+
+	uint tilesPerRow = uint(fragmentTileset.z);
+	vec2 source = vec2((value - 1u) % tilesPerRow, (value - 1u) / tilesPerRow);
+
+	displayColor = texture(tileset,
+		(source + fract(fragmentTileCoord)) * fragmentTileset.xy);
+
+	if (displayColor.a == 0.0) {
+		discard;
+	}
+}
@@ -0,0 +1,30 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec3 vertexColor;
+layout(location = 2) in vec2 vertexUV;
+
+layout(location = 0) out vec2 fragmentTileCoord;
+layout(location = 1) flat out vec3 fragmentTileset;
+
+layout(push_constant) uniform PushConstantData {
+	vec4 worldToNdc; // ndc = world * xy + zw
+	vec4 bounds;     // world position, world size
+	vec4 tileset;    // tile uv size, tiles per row, depth
+	vec2 tileCount;
+} layer;
+
+void main() {
+
+	vec2 world = layer.bounds.xy + vertexPosition.xy * layer.bounds.zw;
+
+	gl_Position = vec4(
+		world * layer.worldToNdc.xy + layer.worldToNdc.zw,
+		layer.tileset.w, 1.0
+	);
+
+	// Position inside the layer, measured in tiles.
+	fragmentTileCoord = vertexPosition.xy * layer.tileCount;
+	fragmentTileset = layer.tileset.xyz;
+}
@@ -0,0 +1,25 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 1) in vec3 vertexColor;
+layout(location = 2) in vec2 vertexUV;
+
+layout(location = 0) out vec4 fragmentColor;
+layout(location = 1) out vec2 fragmentUV;
+
+layout(push_constant) uniform PushConstantData {
+	vec4 worldToNdc; // ndc = world * xy + zw
+	float depth;
+} chunk;
+
+void main() {
+
+	gl_Position = vec4(
+		vertexPosition.xy * chunk.worldToNdc.xy + chunk.worldToNdc.zw,
+		chunk.depth, 1.0
+	);
+
+	fragmentColor = vec4(vertexColor, 1.0);
+	fragmentUV = vertexUV;
+}
@@ -2,24 +2,51 @@
 
 #include <engine.h>
 
+// Reports the frame rate, along with the triangles drawn, so that the
+// levels of detail can be compared against full detail, toggled by L,
+// and the state bound per frame.
 class FramerateCounter : public GameObject3d {
  private:
   size_t m_frames = 0;
+  size_t m_triangles = 0;
+  size_t m_binds = 0;
+  size_t m_redundantBinds = 0;
   float m_elapsed = 0;
   float m_interval;
+  float m_lodPixelError = 0;
 
  public:
   inline FramerateCounter(Engine3d& e, float interval = 5.0f)
       : GameObject3d(e), m_interval(interval) {}
 
   inline void update(float dt) override {
+    auto& renderer = m_engine.renderer();
+    if (renderer.keyboard().pressed(GLFW_KEY_L)) {
+      auto lodPixelError = renderer.lodPixelError();
+      renderer.setLodPixelError(m_lodPixelError);
+      m_lodPixelError = lodPixelError;
+      std::cout << "[FramerateCounter] Levels of detail "
+                << (m_lodPixelError > 0 ? "off." : "on.") << lf;
+    }
+
     m_elapsed += dt;
     m_frames++;
+    auto const& stats = renderer.frameStats();
+    m_triangles += stats.trianglesDrawn;
+    m_binds += stats.pipelineBinds + stats.textureBinds + stats.bufferBinds;
+    m_redundantBinds += stats.redundantBindsSkipped;
     if (m_elapsed >= m_interval) {
       std::cout << "[FramerateCounter] " << std::round(m_frames / m_elapsed)
-                << " FPS." << lf;
+                << " FPS, " << 1000 * m_elapsed / m_frames << " ms, "
+                << m_triangles / m_frames << " triangles, "
+                << m_binds / m_frames << " binds and "
+                << m_redundantBinds / m_frames
+                << " redundant binds skipped per frame." << lf;
       m_elapsed = 0.0f;
       m_frames = 0;
+      m_triangles = 0;
+      m_binds = 0;
+      m_redundantBinds = 0;
     }
     GameObject3d::update(dt);
   }
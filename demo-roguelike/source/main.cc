@@ -16,6 +16,7 @@ int main() {
   }
 
   engine.add<FramerateCounter>();
+  auto& portals = engine.add<RoomVisibility>().portals();
 
   constexpr auto hubW = 10.0f;
   constexpr auto hubH = 5.0f;
@@ -23,26 +24,46 @@ int main() {
   constexpr auto corrH = Room::doorHeight + 2 * Room::wallThickness;
   constexpr auto corrL = 12.0f;
 
-  size_t roomIndex = 0;
-  engine.add<Room>(
-      roomIndex++, glm::vec3{0, 0, 0}, glm::vec3{hubW, hubH, hubW},
-      static_cast<Dir>(Dir::North | Dir::East | Dir::South | Dir::West));
+  struct RoomPlan {
+    glm::vec3 origin;
+    glm::vec3 size;
+    Dir doors;
+  };
+  auto const plans = std::vector<RoomPlan>{
+      {glm::vec3{0, 0, 0}, glm::vec3{hubW, hubH, hubW},
+       static_cast<Dir>(Dir::North | Dir::East | Dir::South | Dir::West)},
+      {glm::vec3{(hubW - corrW) / 2.0f, 0, hubW},
+       glm::vec3{corrW, corrH, corrL},
+       static_cast<Dir>(Dir::North | Dir::South)},
+      {glm::vec3{hubW, 0, (hubW - corrW) / 2.0f},
+       glm::vec3{corrL, corrH, corrW}, static_cast<Dir>(Dir::East | Dir::West)},
+      {glm::vec3{(hubW - corrW) / 2.0f, 0, -corrL},
+       glm::vec3{corrW, corrH, corrL},
+       static_cast<Dir>(Dir::North | Dir::South)},
+      {glm::vec3{-corrL, 0, (hubW - corrW) / 2.0f},
+       glm::vec3{corrL, corrH, corrW}, static_cast<Dir>(Dir::East | Dir::West)},
+  };
 
-  engine.add<Room>(roomIndex++, glm::vec3{(hubW - corrW) / 2.0f, 0, hubW},
-                   glm::vec3{corrW, corrH, corrL},
-                   static_cast<Dir>(Dir::North | Dir::South));
-
-  engine.add<Room>(roomIndex++, glm::vec3{hubW, 0, (hubW - corrW) / 2.0f},
-                   glm::vec3{corrL, corrH, corrW},
-                   static_cast<Dir>(Dir::East | Dir::West));
-
-  engine.add<Room>(roomIndex++, glm::vec3{(hubW - corrW) / 2.0f, 0, -corrL},
-                   glm::vec3{corrW, corrH, corrL},
-                   static_cast<Dir>(Dir::North | Dir::South));
+  // Rooms clip their faces against the slabs of all rooms, in world
+  // space, so those of connected rooms must be known up front.
+  auto dungeonSlabs = std::vector<SolidBox>{};
+  for (auto const& plan : plans) {
+    for (auto slab : Room::slabs(plan.size, plan.doors)) {
+      slab.box.min += plan.origin;
+      slab.box.max += plan.origin;
+      dungeonSlabs.push_back(slab);
+    }
+  }
 
-  engine.add<Room>(roomIndex++, glm::vec3{-corrL, 0, (hubW - corrW) / 2.0f},
-                   glm::vec3{corrL, corrH, corrW},
-                   static_cast<Dir>(Dir::East | Dir::West));
+  auto dungeonReport = BoxSurfaceReport{};
+  for (size_t roomIndex = 0; roomIndex < plans.size(); ++roomIndex) {
+    auto const& plan = plans[roomIndex];
+    dungeonReport += engine
+                         .add<Room>(portals, roomIndex, plan.origin, plan.size,
+                                    plan.doors, dungeonSlabs)
+                         .surfaceReport();
+  }
+  std::cout << "[Dungeon] " << dungeonReport << lf;
 
   /*engine.add<FirstPersonController>(3.0f, 6.0f, 60.0f)
       .setEye({4.5f, 2.0f, 4.5f});*/
@@ -13,7 +13,7 @@ class Player : public GameObject3d {
       : GameObject3d(e),
         m_model(e.renderer().createMesh("player"),
                 e.renderer().texture("nether_brick")) {
-    m_model.mesh().setVertices(
+    m_model.mesh().setOptimizedVertices(
         cubeVertices({0.0f, 0.75f, 0.0f}, {0.75f, 1.5f, 0.75f}));
   }
 
@@ -3,104 +3,160 @@
 #include <engine.h>
 #include <mesh_util.h>
 #include <model.h>
+#include <portal_graph.h>
 
 enum Dir { North = 1, East = 2, South = 4, West = 8 };
 
+// Finds the rooms seen by the camera at the start of each frame, so it
+// must be added before the rooms to take effect within the same frame.
+class RoomVisibility : public GameObject3d {
+ private:
+  PortalGraph m_portals;
+
+ public:
+  inline RoomVisibility(Engine3d& e) : GameObject3d(e) {}
+
+  inline void update(float dt) override {
+    auto const& camera = m_engine.renderer().camera3d();
+    m_portals.computeVisibility(camera.position(), camera.transform());
+    GameObject3d::update(dt);
+  }
+
+  inline PortalGraph& portals() noexcept { return m_portals; }
+};
+
 class Room : public GameObject3d {
  private:
   size_t m_index;
   glm::vec3 m_origin;
   glm::vec3 m_size;
   Model m_model;
+  BoxSurfaceReport m_surfaceReport;
+
+  PortalGraph& m_portals;
+  PortalGraph::CellIndex m_cell;
+
+  // Registers the doorway in a wall as a portal, spanning the outer
+  // face of the wall so that it meets the doorway of the next room.
+  void addDoorPortal(Dir door) {
+    auto const& o = m_origin;
+    auto const& s = m_size;
+    auto y0 = o.y + wallThickness;
+    auto y1 = y0 + doorHeight;
+    auto x0 = o.x + (s.x - doorWidth) / 2.0f;
+    auto z0 = o.z + (s.z - doorWidth) / 2.0f;
+
+    auto horizontal = [&](float z) {
+      return std::array<glm::vec3, 4>{glm::vec3{x0, y0, z},
+                                      glm::vec3{x0 + doorWidth, y0, z},
+                                      glm::vec3{x0 + doorWidth, y1, z},
+                                      glm::vec3{x0, y1, z}};
+    };
+    auto vertical = [&](float x) {
+      return std::array<glm::vec3, 4>{glm::vec3{x, y0, z0},
+                                      glm::vec3{x, y0, z0 + doorWidth},
+                                      glm::vec3{x, y1, z0 + doorWidth},
+                                      glm::vec3{x, y1, z0}};
+    };
+
+    switch (door) {
+      case Dir::North:
+        m_portals.addPortal(m_cell, horizontal(o.z + s.z));
+        break;
+      case Dir::East:
+        m_portals.addPortal(m_cell, vertical(o.x + s.x));
+        break;
+      case Dir::South:
+        m_portals.addPortal(m_cell, horizontal(o.z));
+        break;
+      case Dir::West:
+        m_portals.addPortal(m_cell, vertical(o.x));
+        break;
+    }
+  }
 
  public:
   static constexpr auto wallThickness = 0.1f;
   static constexpr auto doorWidth = 3.0f;
   static constexpr auto doorHeight = 3.0f;
 
-  Room(Engine3d& e, size_t index, glm::vec3 origin, glm::vec3 size, Dir doors)
-      : GameObject3d(e),
-        m_index(index),
-        m_origin(std::move(origin)),
-        m_size(std::move(size)),
-        m_model(e.renderer().createMesh("room" + std::to_string(index)),
-                e.renderer().texture("stonebrick_mossy")) {
-    auto vertices = std::vector<VPositionColorTexcoord>{};
+  // Floor, ceiling and wall slabs of a room of the given size, relative
+  // to its origin, leaving doorways in the walls facing doors.
+  static std::vector<SolidBox> slabs(glm::vec3 const& size, Dir doors) {
+    auto slabs = std::vector<SolidBox>{};
 
-    const auto addCubeAt = [&vertices](glm::vec3 const& pos,
-                                       glm::vec3 const& size,
-                                       glm::vec3 const& col = {1, 1, 1}) {
-      if (size.x > 0 && size.y > 0 && size.z > 0) {
-        for (auto const& v : cubeVertices(pos + size / 2.0f, size, col, size)) {
-          vertices.push_back(v);
-        }
+    const auto addCubeAt = [&slabs](glm::vec3 const& pos,
+                                    glm::vec3 const& extent,
+                                    glm::vec3 const& col = {1, 1, 1}) {
+      if (extent.x > 0 && extent.y > 0 && extent.z > 0) {
+        slabs.push_back({{pos, pos + extent}, col});
       }
     };
 
     // floor
-    addCubeAt({0, 0, 0}, {m_size.x, wallThickness, m_size.z}, {1, 0, 1});
+    addCubeAt({0, 0, 0}, {size.x, wallThickness, size.z}, {1, 0, 1});
 
     // ceiling
-    addCubeAt({0, m_size.y - wallThickness, 0},
-              {m_size.x, wallThickness, m_size.z}, {0, 1, 0});
+    addCubeAt({0, size.y - wallThickness, 0}, {size.x, wallThickness, size.z},
+              {0, 1, 0});
 
     // north wall
     if (doors & Dir::North) {
-      addCubeAt({0, wallThickness, m_size.z - wallThickness},
-                {(m_size.x - doorWidth) / 2.0f, doorHeight, wallThickness},
+      addCubeAt({0, wallThickness, size.z - wallThickness},
+                {(size.x - doorWidth) / 2.0f, doorHeight, wallThickness},
                 {0, 0, 1});
-      addCubeAt({m_size.x - (m_size.x - doorWidth) / 2.0f, wallThickness,
-                 m_size.z - wallThickness},
-                {(m_size.x - doorWidth) / 2.0f, doorHeight, wallThickness},
+      addCubeAt({size.x - (size.x - doorWidth) / 2.0f, wallThickness,
+                 size.z - wallThickness},
+                {(size.x - doorWidth) / 2.0f, doorHeight, wallThickness},
                 {0, 0, 1});
       addCubeAt(
-          {0, wallThickness + doorHeight, m_size.z - wallThickness},
-          {m_size.x, m_size.y - 2 * wallThickness - doorHeight, wallThickness},
+          {0, wallThickness + doorHeight, size.z - wallThickness},
+          {size.x, size.y - 2 * wallThickness - doorHeight, wallThickness},
           {0, 0, 1});
     } else {
-      addCubeAt({0, wallThickness, m_size.z - wallThickness},
-                {m_size.x, m_size.y - 2 * wallThickness, wallThickness},
+      addCubeAt({0, wallThickness, size.z - wallThickness},
+                {size.x, size.y - 2 * wallThickness, wallThickness},
                 {0, 0, 1});
     }
 
     // east wall
     if (doors & Dir::East) {
-      addCubeAt({m_size.x - wallThickness, wallThickness, wallThickness},
+      addCubeAt({size.x - wallThickness, wallThickness, wallThickness},
                 {wallThickness, doorHeight,
-                 (m_size.z - doorWidth) / 2.0f - wallThickness},
+                 (size.z - doorWidth) / 2.0f - wallThickness},
                 {1, 0, 0});
-      addCubeAt({m_size.x - wallThickness, wallThickness,
-                 m_size.z - (m_size.z - doorWidth) / 2.0f},
+      addCubeAt({size.x - wallThickness, wallThickness,
+                 size.z - (size.z - doorWidth) / 2.0f},
                 {wallThickness, doorHeight,
-                 (m_size.z - doorWidth) / 2.0f - wallThickness},
+                 (size.z - doorWidth) / 2.0f - wallThickness},
                 {1, 0, 0});
       addCubeAt(
-          {m_size.x - wallThickness, wallThickness + doorHeight, wallThickness},
-          {wallThickness, m_size.y - 2 * wallThickness - doorHeight,
-           m_size.z - 2 * wallThickness},
+          {size.x - wallThickness, wallThickness + doorHeight, wallThickness},
+          {wallThickness, size.y - 2 * wallThickness - doorHeight,
+           size.z - 2 * wallThickness},
           {1, 0, 0});
     } else {
-      addCubeAt({m_size.x - wallThickness, wallThickness, wallThickness},
-                {wallThickness, m_size.y - 2 * wallThickness,
-                 m_size.z - 2 * wallThickness},
+      addCubeAt({size.x - wallThickness, wallThickness, wallThickness},
+                {wallThickness, size.y - 2 * wallThickness,
+                 size.z - 2 * wallThickness},
                 {1, 0, 0});
     }
 
     // south wall
     if (doors & Dir::South) {
       addCubeAt({0, wallThickness, 0},
-                {(m_size.x - doorWidth) / 2.0f, doorHeight, wallThickness},
+                {(size.x - doorWidth) / 2.0f, doorHeight, wallThickness},
                 {1, 1, 0});
-      addCubeAt({m_size.x - (m_size.x - doorWidth) / 2.0f, wallThickness, 0},
-                {(m_size.x - doorWidth) / 2.0f, doorHeight, wallThickness},
+      addCubeAt({size.x - (size.x - doorWidth) / 2.0f, wallThickness, 0},
+                {(size.x - doorWidth) / 2.0f, doorHeight, wallThickness},
                 {1, 1, 0});
       addCubeAt(
           {0, wallThickness + doorHeight, 0},
-          {m_size.x, m_size.y - 2 * wallThickness - doorHeight, wallThickness},
+          {size.x, size.y - 2 * wallThickness - doorHeight, wallThickness},
           {1, 1, 0});
     } else {
       addCubeAt({0, wallThickness, 0},
-                {m_size.x, m_size.y - 2 * wallThickness, wallThickness},
+                {size.x, size.y - 2 * wallThickness, wallThickness},
                 {1, 1, 0});
     }
 
@@ -108,28 +164,64 @@ class Room : public GameObject3d {
     if (doors & Dir::West) {
       addCubeAt({0, wallThickness, wallThickness},
                 {wallThickness, doorHeight,
-                 (m_size.z - doorWidth) / 2.0f - wallThickness},
+                 (size.z - doorWidth) / 2.0f - wallThickness},
                 {0, 1, 1});
-      addCubeAt({0, wallThickness, m_size.z - (m_size.z - doorWidth) / 2.0f},
+      addCubeAt({0, wallThickness, size.z - (size.z - doorWidth) / 2.0f},
                 {wallThickness, doorHeight,
-                 (m_size.z - doorWidth) / 2.0f - wallThickness},
+                 (size.z - doorWidth) / 2.0f - wallThickness},
                 {0, 1, 1});
       addCubeAt({0, wallThickness + doorHeight, wallThickness},
-                {wallThickness, m_size.y - 2 * wallThickness - doorHeight,
-                 m_size.z - 2 * wallThickness},
+                {wallThickness, size.y - 2 * wallThickness - doorHeight,
+                 size.z - 2 * wallThickness},
                 {0, 1, 1});
     } else {
       addCubeAt({0, wallThickness, wallThickness},
-                {wallThickness, m_size.y - 2 * wallThickness,
-                 m_size.z - 2 * wallThickness},
+                {wallThickness, size.y - 2 * wallThickness,
+                 size.z - 2 * wallThickness},
                 {0, 1, 1});
     }
 
-    m_model.mesh().setVertices(vertices);
+    return slabs;
+  }
+
+  Room(Engine3d& e, PortalGraph& portals, size_t index, glm::vec3 origin,
+       glm::vec3 size, Dir doors, std::vector<SolidBox> const& dungeonSlabs)
+      : GameObject3d(e),
+        m_index(index),
+        m_origin(std::move(origin)),
+        m_size(std::move(size)),
+        m_model(e.renderer().createMesh("room" + std::to_string(index)),
+                e.renderer().texture("stonebrick_mossy")),
+        m_portals(portals),
+        m_cell(portals.addCell({m_origin, m_origin + m_size})) {
+    for (auto door : {Dir::North, Dir::East, Dir::South, Dir::West}) {
+      if (doors & door) addDoorPortal(door);
+    }
+
+    // Clipping against every slab of the dungeon removes the faces
+    // buried inside this room's walls, as well as those pressed against
+    // the walls of the rooms it connects to.
+    auto occluders = std::vector<Aabb>{};
+    for (auto const& solid : dungeonSlabs) {
+      occluders.push_back({solid.box.min - m_origin, solid.box.max - m_origin});
+    }
+    auto vertices = std::vector<VPositionColorTexcoord>{};
+    m_surfaceReport =
+        boxSurfaceVertices(slabs(m_size, doors), occluders, vertices);
+
+    auto report = m_model.mesh().setOptimizedVertices(std::move(vertices));
+    m_model.mesh().generateLods();
+    std::cout << "[Room " << m_index << "] " << m_surfaceReport << ", "
+              << report << ", "
+              << m_model.mesh().vulkanVertexBuffer().sizeInBytes
+              << " vertex buffer bytes" << lf;
     m_model.setPosition(m_origin);
   }
 
+  // Faces of the room's slabs before and after clipping.
+  GETTER(surfaceReport, m_surfaceReport)
+
   void draw(Renderer3d& r) const override {
-    r.renderModel(m_model);
+    if (m_portals.isCellVisible(m_cell)) r.renderModel(m_model);
   }
 };
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <liberupt/source/common.h>
+
+#include <chrono>
+#include <cstdio>
+#include <limits>
+
+// Benchmarks are functions registered under a name by BENCHMARK, and
+// run by erupt-bench, either all of them or those named on its command
+// line. Each prints its own measurements with printMeasurement.
+
+struct Benchmark {
+  char const* name;
+  void (*run)();
+};
+
+inline std::vector<Benchmark>& registeredBenchmarks() {
+  static auto benchmarks = std::vector<Benchmark>();
+  return benchmarks;
+}
+
+struct BenchmarkRegistration {
+  inline BenchmarkRegistration(char const* name, void (*run)()) {
+    registeredBenchmarks().push_back({name, run});
+  }
+};
+
+#define BENCHMARK(Name)                                                  \
+  static void Name();                                                    \
+  static BenchmarkRegistration Name##Registration(#Name, Name);          \
+  static void Name()
+
+// Keeps the compiler from optimizing away results that go unused.
+template <typename T>
+inline void keepResult(T const& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+// Fastest of a few runs of fn, in seconds.
+template <typename Fn>
+double measureSeconds(Fn&& fn, size_t numRuns = 5) {
+  using Clock = std::chrono::steady_clock;
+  auto best = std::numeric_limits<double>::max();
+  for (size_t run = 0; run < numRuns; ++run) {
+    auto begin = Clock::now();
+    fn();
+    auto seconds =
+        std::chrono::duration<double>(Clock::now() - begin).count();
+    best = std::min(best, seconds);
+  }
+  return best;
+}
+
+inline void printMeasurement(char const* what, double value,
+                             char const* unit) {
+  std::printf("  %-44s %14.3f %s\n", what, value, unit);
+}
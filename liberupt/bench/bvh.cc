@@ -0,0 +1,118 @@
+#include <liberupt/source/bvh.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "bench.h"
+
+// Builds trees over 100k boxes scattered through a level, on one thread
+// and across the shared worker pool, refits them after every box moved,
+// and counts frustum and ray queries per second against testing every
+// box.
+
+constexpr size_t numItems = 100000;
+constexpr size_t numQueries = 1000;
+
+static std::vector<Aabb> randomBoxes() {
+  srand(1);
+  auto boxes = std::vector<Aabb>(numItems);
+  for (auto& box : boxes) {
+    auto center = glm::vec3{frand(-500, 500), frand(-20, 20),
+                            frand(-500, 500)};
+    auto halfSize = glm::vec3{frand(0.2f, 2), frand(0.2f, 2), frand(0.2f, 2)};
+    box = {center - halfSize, center + halfSize};
+  }
+  return boxes;
+}
+
+static std::vector<FrustumPlanes> randomFrustums() {
+  auto frustums = std::vector<FrustumPlanes>(numQueries);
+  auto projection =
+      glm::perspectiveLH(glm::radians(60.0f), 16 / 9.0f, 0.1f, 200.0f);
+  for (auto& planes : frustums) {
+    auto eye = glm::vec3{frand(-500, 500), 2, frand(-500, 500)};
+    auto target = eye + glm::vec3{frand(-1, 1), frand(-0.2f, 0.2f),
+                                  frand(-1, 1)};
+    planes = extractFrustumPlanes(projection *
+                                  glm::lookAtLH(eye, target, {0, 1, 0}));
+  }
+  return frustums;
+}
+
+BENCHMARK(bvhQueries) {
+  auto boxes = randomBoxes();
+  auto frustums = randomFrustums();
+  auto bvh = Bvh();
+
+  std::printf("%zu boxes, %zu worker threads\n", numItems,
+              sharedWorkerPool().threadCount());
+
+  auto singleThread = WorkerPool(1);
+  printMeasurement(
+      "build, one thread",
+      1e3 * measureSeconds([&] { bvh.build(boxes, singleThread); }), "ms");
+  printMeasurement("build, worker pool",
+                   1e3 * measureSeconds([&] { bvh.build(boxes); }), "ms");
+  printMeasurement("  nodes", bvh.nodeCount(), "nodes");
+
+  auto moved = boxes;
+  for (auto& box : moved) {
+    auto offset = glm::vec3{frand(-1, 1), 0, frand(-1, 1)};
+    box = {box.min + offset, box.max + offset};
+  }
+  auto refit = [&] {
+    for (uint32_t i = 0; i < numItems; ++i) bvh.setItemBounds(i, moved[i]);
+    bvh.refit();
+  };
+  printMeasurement("refit after moving every box",
+                   1e3 * measureSeconds(refit), "ms");
+  bvh.build(boxes);
+
+  auto printPerSecond = [](char const* what, double seconds) {
+    printMeasurement(what, numQueries / seconds / 1e3, "k queries/s");
+  };
+
+  auto numVisible = size_t{0};
+  printPerSecond("forEachInFrustum", measureSeconds([&] {
+                   numVisible = 0;
+                   for (auto const& planes : frustums) {
+                     bvh.forEachInFrustum(planes,
+                                          [&](uint32_t) { ++numVisible; });
+                   }
+                 }));
+  printMeasurement("  boxes visited per frustum",
+                   static_cast<double>(numVisible) / numQueries, "boxes");
+
+  printPerSecond("isBoxInFrustum on every box", measureSeconds([&] {
+                   numVisible = 0;
+                   for (auto const& planes : frustums) {
+                     for (auto const& box : boxes) {
+                       numVisible += isBoxInFrustum(planes, box);
+                     }
+                   }
+                 }));
+  printMeasurement("  boxes inside per frustum",
+                   static_cast<double>(numVisible) / numQueries, "boxes");
+
+  auto rays = std::vector<std::pair<glm::vec3, glm::vec3>>(numQueries);
+  for (auto& [origin, direction] : rays) {
+    origin = {frand(-500, 500), frand(-20, 20), frand(-500, 500)};
+    direction = glm::normalize(
+        glm::vec3{frand(-1, 1), frand(-0.1f, 0.1f), frand(-1, 1)});
+  }
+
+  auto numHits = size_t{0};
+  printPerSecond("raycast", measureSeconds([&] {
+                   numHits = 0;
+                   for (auto const& [origin, direction] : rays) {
+                     numHits += bvh.raycast(origin, direction, 1000).hit;
+                   }
+                 }));
+  printMeasurement("  rays hitting a box", 100.0 * numHits / numQueries, "%");
+
+  printPerSecond("hasLineOfSight, 50 units", measureSeconds([&] {
+                   for (auto const& [origin, direction] : rays) {
+                     keepResult(bvh.hasLineOfSight(
+                         origin, origin + direction * 50.0f));
+                   }
+                 }));
+}
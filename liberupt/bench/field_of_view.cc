@@ -0,0 +1,95 @@
+#include <liberupt/source/field_of_view.h>
+
+#include "tilemaps.h"
+
+// Fields of view updated per second for a thousand monsters on a
+// 1024x1024 map with scattered walls: recomputed from scratch, one at a
+// time and batched across the shared worker pool, and incrementally
+// after a turn in which a single tile changed.
+
+constexpr size_t mapSize = 1024;
+constexpr size_t numActors = 1000;
+
+static std::vector<glm::u64vec3> randomOrigins(unsigned seed) {
+  srand(seed);
+  auto origins = std::vector<glm::u64vec3>(numActors);
+  for (auto& origin : origins) {
+    origin = {rand() % mapSize, rand() % mapSize, 0};
+  }
+  return origins;
+}
+
+BENCHMARK(fieldOfView) {
+  auto renderer = Renderer2d(benchmarkRendererSettings("fieldOfView"));
+  renderer.materialize();
+
+  auto map = Tilemap<uint16_t>({mapSize, mapSize, 1},
+                               createBenchmarkTileset(renderer), {16, 16},
+                               {16, 16});
+  scatterWalls(map, 0, 0.1f);
+  auto isOpaque = [](uint16_t tile) { return tile != 0; };
+
+  // Actors alternate between two sets of positions, so that every
+  // update has to recompute the whole view.
+  auto origins = std::array{randomOrigins(1), randomOrigins(2)};
+  auto turn = size_t{0};
+  auto moveAll = [&](std::vector<FieldOfView>& fovs) {
+    auto const& next = origins[++turn % 2];
+    for (size_t i = 0; i < numActors; ++i) fovs[i].moveTo(next[i]);
+  };
+
+  auto printActorsPerSecond = [](std::string const& what, double seconds) {
+    printMeasurement(what.c_str(), numActors / seconds / 1e3, "k actors/s");
+  };
+
+  std::printf("%zu worker threads\n", sharedWorkerPool().threadCount());
+
+  for (auto radius : {8u, 16u}) {
+    auto fovs = std::vector<FieldOfView>(numActors, FieldOfView(radius));
+    auto label = [&](char const* what) {
+      return std::string(what) + ", radius " + std::to_string(radius);
+    };
+
+    printActorsPerSecond(label("moved, one at a time"), measureSeconds([&] {
+                           moveAll(fovs);
+                           for (auto& fov : fovs) fov.update(map, isOpaque);
+                         }));
+
+    printActorsPerSecond(label("moved, updateFieldsOfView"),
+                         measureSeconds([&] {
+                           moveAll(fovs);
+                           updateFieldsOfView(map, fovs, isOpaque);
+                         }));
+
+    // Actors gather in the top left quarter, so that a door toggled in
+    // the far corner leaves every view as it is.
+    for (size_t i = 0; i < numActors; ++i) {
+      fovs[i].moveTo({origins[0][i].x / 4, origins[0][i].y / 4, 0});
+    }
+    updateFieldsOfView(map, fovs, isOpaque);
+    auto door = glm::u64vec3{mapSize - 1, mapSize - 1, 0};
+
+    auto recomputed = size_t{0};
+    printActorsPerSecond(label("standing, distant edit"), measureSeconds([&] {
+                           map.setTileAt(door, map.tileAt(door) ^ 1);
+                           updateFieldsOfView(map, fovs, isOpaque);
+                         }));
+    for (auto const& fov : fovs) recomputed += fov.numRecomputedQuadrants();
+    printMeasurement(label("  quadrants recomputed").c_str(),
+                     static_cast<double>(recomputed) / numActors,
+                     "per actor");
+
+    // An edit next to one actor only recomputes the quadrants of the
+    // actors near it.
+    auto nearby = fovs[0].origin() + glm::u64vec3{1, 0, 0};
+    printActorsPerSecond(label("standing, nearby edit"), measureSeconds([&] {
+                           map.setTileAt(nearby, map.tileAt(nearby) ^ 1);
+                           updateFieldsOfView(map, fovs, isOpaque);
+                         }));
+    recomputed = 0;
+    for (auto const& fov : fovs) recomputed += fov.numRecomputedQuadrants();
+    printMeasurement(label("  quadrants recomputed").c_str(),
+                     static_cast<double>(recomputed) / numActors,
+                     "per actor");
+  }
+}
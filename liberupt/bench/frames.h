@@ -0,0 +1,29 @@
+#pragma once
+
+#include <liberupt/source/renderer.h>
+
+#include "bench.h"
+
+// Renders frames with vsync off, queueing draws with queueDraws(frame),
+// and returns the average time per frame in milliseconds, from begin to
+// end of frame. The renderer's frame stats describe the last frame.
+template <typename AnyRenderer, typename QueueDraws>
+double measureFrameMilliseconds(AnyRenderer& renderer, size_t numFrames,
+                                QueueDraws&& queueDraws) {
+  using Clock = std::chrono::steady_clock;
+  auto total = 0.0;
+  for (size_t frame = 0; frame < numFrames; ++frame) {
+    renderer.handleWindowEvents();
+    auto begin = Clock::now();
+    crashIf(!renderer.tryBeginFrame());
+    queueDraws(frame);
+    renderer.endFrame();
+    total += std::chrono::duration<double, std::milli>(Clock::now() - begin)
+                 .count();
+  }
+  return total / numFrames;
+}
+
+inline RendererSettings benchmarkRendererSettings(char const* title) {
+  return {title, {1280, 720}, false};
+}
@@ -0,0 +1,20 @@
+#include <cstring>
+
+#include "bench.h"
+
+int main(int argc, char** argv) {
+  auto isSelected = [&](char const* name) {
+    if (argc < 2) return true;
+    for (int i = 1; i < argc; ++i) {
+      if (std::strcmp(argv[i], name) == 0) return true;
+    }
+    return false;
+  };
+
+  for (auto const& benchmark : registeredBenchmarks()) {
+    if (!isSelected(benchmark.name)) continue;
+    std::printf("%s\n", benchmark.name);
+    benchmark.run();
+  }
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include <liberupt/source/mesh_import.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include "frames.h"
+
+// Loads OBJ spheres of 4k and 131k triangles, written to the temporary
+// directory, by parsing the OBJ file and by mapping the mesh file it is
+// converted to, and times the conversion itself.
+
+// Sphere cut into rings and segments, with texture coordinates, as
+// quads split into two triangles each.
+static void writeSphereObj(std::string const& path, uint32_t numRings,
+                           uint32_t numSegments) {
+  auto out = std::ofstream(path);
+  for (uint32_t ring = 0; ring <= numRings; ++ring) {
+    for (uint32_t segment = 0; segment <= numSegments; ++segment) {
+      auto theta = 3.14159265f * ring / numRings;
+      auto phi = 2 * 3.14159265f * segment / numSegments;
+      out << "v " << std::sin(theta) * std::cos(phi) << ' '
+          << std::cos(theta) << ' ' << std::sin(theta) * std::sin(phi)
+          << lf;
+      out << "vt " << static_cast<float>(segment) / numSegments << ' '
+          << static_cast<float>(ring) / numRings << lf;
+    }
+  }
+
+  // OBJ indices count from one.
+  auto vertex = [&](uint32_t ring, uint32_t segment) {
+    auto index = std::to_string(1 + ring * (numSegments + 1) + segment);
+    return index + '/' + index;
+  };
+  for (uint32_t ring = 0; ring < numRings; ++ring) {
+    for (uint32_t segment = 0; segment < numSegments; ++segment) {
+      auto a = vertex(ring, segment);
+      auto b = vertex(ring, segment + 1);
+      auto c = vertex(ring + 1, segment + 1);
+      auto d = vertex(ring + 1, segment);
+      out << "f " << a << ' ' << b << ' ' << c << lf;
+      out << "f " << c << ' ' << d << ' ' << a << lf;
+    }
+  }
+}
+
+BENCHMARK(meshImport) {
+  auto renderer = Renderer3d(benchmarkRendererSettings("meshImport"));
+  renderer.materialize();
+  auto& mesh = renderer.createMesh("imported");
+
+  auto directory = std::filesystem::temp_directory_path();
+  auto const spheres = {std::pair{32u, 64u}, std::pair{256u, 256u}};
+  for (auto [numRings, numSegments] : spheres) {
+    auto name = std::to_string(2 * numRings * numSegments) + " triangles";
+    auto objPath = (directory / "erupt-bench-sphere.obj").string();
+    auto meshPath = objPath + ".mesh";
+    writeSphereObj(objPath, numRings, numSegments);
+
+    auto print = [&](char const* what, double value, char const* unit) {
+      printMeasurement((name + ", " + what).c_str(), value, unit);
+    };
+
+    print("parsing the OBJ file",
+          1e3 * measureSeconds([&] { keepResult(importObj(objPath)); }),
+          "ms");
+
+    auto converted = convertModel(objPath, meshPath);
+    print("converting, import", converted.importMilliseconds, "ms");
+    print("converting, weld, optimize and simplify",
+          converted.convertMilliseconds, "ms");
+
+    // Up to date now, so only mapped and uploaded.
+    auto loaded = MeshCacheReport{};
+    print("loadModel from the mesh file", 1e3 * measureSeconds([&] {
+                                            loaded = loadModel(mesh, objPath);
+                                          }),
+          "ms");
+    crashIf(loaded.wasConverted);
+    print("  of which mapping and uploading", loaded.loadMilliseconds, "ms");
+    print("OBJ file", converted.modelBytes / 1024.0, "KiB");
+    print("mesh file", loaded.meshFileBytes / 1024.0, "KiB");
+
+    std::filesystem::remove(objPath);
+    std::filesystem::remove(meshPath);
+  }
+}
@@ -0,0 +1,82 @@
+#include "frames.h"
+
+// Simplifies a sphere of 32k triangles into a chain of levels of
+// detail, and draws 2000 of them receding from the camera at full
+// detail and at increasing tolerances for the error on screen,
+// comparing the triangles drawn and the time per frame.
+
+constexpr size_t numFrames = 200;
+
+// Unindexed triangles of a unit sphere, cut into rings and segments.
+static std::vector<VPositionColorTexcoord> sphereTriangles(
+    uint32_t numRings, uint32_t numSegments) {
+  auto point = [&](uint32_t ring, uint32_t segment) {
+    auto theta = 3.14159265f * ring / numRings;
+    auto phi = 2 * 3.14159265f * (segment % numSegments) / numSegments;
+    return VPositionColorTexcoord{
+        {std::sin(theta) * std::cos(phi), std::cos(theta),
+         std::sin(theta) * std::sin(phi)},
+        {1, 1, 1},
+        {static_cast<float>(segment) / numSegments,
+         static_cast<float>(ring) / numRings}};
+  };
+
+  auto vertices = std::vector<VPositionColorTexcoord>();
+  for (uint32_t ring = 0; ring < numRings; ++ring) {
+    for (uint32_t segment = 0; segment < numSegments; ++segment) {
+      auto a = point(ring, segment);
+      auto b = point(ring, segment + 1);
+      auto c = point(ring + 1, segment + 1);
+      auto d = point(ring + 1, segment);
+      vertices.insert(vertices.end(), {a, b, c, c, d, a});
+    }
+  }
+  return vertices;
+}
+
+BENCHMARK(meshLod) {
+  auto renderer = Renderer3d(benchmarkRendererSettings("meshLod"));
+  renderer.materialize();
+
+  auto& texture = renderer.createTexture("white");
+  texture.updatePixels(1, 1, {0xffffffff});
+
+  auto& sphere = renderer.createMesh("sphere");
+  sphere.setOptimizedVertices(sphereTriangles(128, 128));
+
+  printMeasurement("generateLods", 1e3 * measureSeconds([&] {
+                                     sphere.generateLods();
+                                   }),
+                   "ms");
+  for (size_t level = 0; level < sphere.lods().size(); ++level) {
+    auto const& lod = sphere.lods()[level];
+    auto label = "level " + std::to_string(level);
+    printMeasurement(label.c_str(), lod.indexCount / 3, "triangles");
+    printMeasurement((label + ", error").c_str(), lod.error, "units");
+  }
+
+  // Rows of spheres from 4 to 400 units in front of the camera.
+  auto models = std::vector<Model>();
+  for (size_t i = 0; i < 2000; ++i) {
+    auto& model = models.emplace_back(sphere, texture);
+    model.setPosition({3.0f * (i % 40) - 60, 0, 4.0f + 8 * (i / 40)});
+  }
+  renderer.camera3d().setPosition({0, 10, 0});
+  renderer.camera3d().lookAt({0, 0, 100});
+
+  for (auto pixelError : {0.0f, 0.5f, 1.0f, 4.0f}) {
+    renderer.setLodPixelError(pixelError);
+    auto milliseconds =
+        measureFrameMilliseconds(renderer, numFrames, [&](size_t) {
+          for (auto const& model : models) renderer.renderModel(model);
+        });
+
+    auto label = pixelError == 0
+                     ? std::string("full detail")
+                     : "up to " + std::to_string(pixelError).substr(0, 3) +
+                           " pixels of error";
+    printMeasurement(label.c_str(), milliseconds, "ms/frame");
+    printMeasurement((label + ", triangles").c_str(),
+                     renderer.frameStats().trianglesDrawn, "per frame");
+  }
+}
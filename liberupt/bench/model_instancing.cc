@@ -0,0 +1,72 @@
+#include <liberupt/source/mesh_util.h>
+
+#include "frames.h"
+
+// Draws 50k cubes queued with renderModel, all of them in view, sharing
+// one mesh and texture, and spread across several textures. Models of
+// distinct meshes cannot be instanced together, so 5k cubes each with
+// their own mesh stand in for drawing one model per draw call, against
+// the same 5k cubes sharing a mesh.
+
+constexpr size_t numFrames = 200;
+
+// Cubes in a grid facing the camera, two units apart.
+static std::vector<Model> cubeGrid(size_t numCubes, size_t numColumns,
+                                   std::vector<Mesh*> const& meshes,
+                                   std::vector<Texture*> const& textures) {
+  auto models = std::vector<Model>();
+  models.reserve(numCubes);
+  auto numRows = (numCubes + numColumns - 1) / numColumns;
+  for (size_t i = 0; i < numCubes; ++i) {
+    auto& model = models.emplace_back(*meshes[i % meshes.size()],
+                                      *textures[i % textures.size()]);
+    model.setPosition({2.0f * (i % numColumns) - numColumns,
+                       2.0f * (i / numColumns) - numRows, 0});
+  }
+  return models;
+}
+
+BENCHMARK(modelInstancing) {
+  auto renderer = Renderer3d(benchmarkRendererSettings("modelInstancing"));
+  renderer.materialize();
+
+  // Far enough back for a grid of 250x200 cubes to fill the view.
+  renderer.camera3d().setPosition({0, 0, -520});
+
+  auto textures = std::vector<Texture*>();
+  for (uint32_t i = 0; i < 8; ++i) {
+    auto& texture = renderer.createTexture("texture" + std::to_string(i));
+    texture.updatePixels(1, 1, {0xff000000 | i * 0x1f1f1f});
+    textures.push_back(&texture);
+  }
+
+  auto meshes = std::vector<Mesh*>();
+  for (size_t i = 0; i < 5000; ++i) {
+    auto& mesh = renderer.createMesh("cube" + std::to_string(i));
+    mesh.setVertices(cubeVertices());
+    meshes.push_back(&mesh);
+  }
+
+  auto measure = [&](std::string const& name,
+                     std::vector<Model> const& models) {
+    auto milliseconds =
+        measureFrameMilliseconds(renderer, numFrames, [&](size_t) {
+          for (auto const& model : models) renderer.renderModel(model);
+        });
+    auto const& stats = renderer.frameStats();
+    printMeasurement(name.c_str(), milliseconds, "ms/frame");
+    printMeasurement((name + ", models drawn").c_str(), stats.modelsDrawn,
+                     "per frame");
+    printMeasurement((name + ", draw calls").c_str(), stats.drawCalls,
+                     "per frame");
+  };
+
+  auto const oneMesh = std::vector<Mesh*>{meshes[0]};
+  auto const oneTexture = std::vector<Texture*>{textures[0]};
+
+  measure("50k cubes, one mesh and texture",
+          cubeGrid(50000, 250, oneMesh, oneTexture));
+  measure("50k cubes, 8 textures", cubeGrid(50000, 250, oneMesh, textures));
+  measure("5k cubes, one mesh", cubeGrid(5000, 100, oneMesh, oneTexture));
+  measure("5k cubes, a mesh each", cubeGrid(5000, 100, meshes, oneTexture));
+}
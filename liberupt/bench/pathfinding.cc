@@ -0,0 +1,122 @@
+#include <liberupt/source/pathfinding.h>
+
+#include "tilemaps.h"
+
+// Agents routed per second on a 1024x1024 map with scattered walls:
+// short paths found with jump point search, long ones planned on the
+// cluster graph first, both one at a time and batched across the
+// shared worker pool, and many agents following one shared flow field.
+// Also times building the cluster graph, and updating it after an edit.
+
+constexpr size_t mapSize = 1024;
+constexpr size_t numAgents = 1000;
+
+// Requests whose start and goal lie between minDistance and maxDistance
+// tiles apart along each axis. Their tiles are cleared of walls.
+static std::vector<PathRequest> randomRequests(Tilemap16& map,
+                                               size_t minDistance,
+                                               size_t maxDistance) {
+  auto requests = std::vector<PathRequest>(numAgents);
+  auto randomOffset = [&] {
+    auto offset = static_cast<int64_t>(
+        minDistance + rand() % (maxDistance - minDistance + 1));
+    return rand() % 2 ? offset : -offset;
+  };
+  for (auto& request : requests) {
+    request.start = {rand() % mapSize, rand() % mapSize};
+    auto goal = glm::i64vec2(request.start) +
+                glm::i64vec2(randomOffset(), randomOffset());
+    request.goal = glm::u64vec2(glm::clamp(goal, glm::i64vec2(0, 0),
+                                           glm::i64vec2(mapSize - 1)));
+
+    map.setTileAt({request.start.x, request.start.y, 0}, 0);
+    map.setTileAt({request.goal.x, request.goal.y, 0}, 0);
+  }
+  return requests;
+}
+
+BENCHMARK(pathfinding) {
+  auto renderer = Renderer2d(benchmarkRendererSettings("pathfinding"));
+  renderer.materialize();
+
+  auto map = Tilemap16({mapSize, mapSize, 1}, createBenchmarkTileset(renderer),
+                       {16, 16}, {16, 16});
+  scatterWalls(map, 0, 0.15f);
+
+  auto shortRequests = randomRequests(map, 8, 24);
+  auto longRequests = randomRequests(map, 200, 400);
+
+  auto pathfinder =
+      Pathfinder<uint16_t>(map, 0, [](uint16_t tile) { return tile != 0; });
+
+  std::printf("%zu clusters, %zu worker threads\n", pathfinder.clusterCount(),
+              sharedWorkerPool().threadCount());
+
+  printMeasurement("building the cluster graph",
+                   1e3 * measureSeconds([&] { pathfinder.update(); }, 1),
+                   "ms");
+
+  auto edit = glm::u64vec3{mapSize / 2, mapSize / 2, 0};
+  printMeasurement("update after one edit", 1e3 * measureSeconds([&] {
+                                              map.setTileAt(
+                                                  edit, map.tileAt(edit) ^ 1);
+                                              pathfinder.update();
+                                            }),
+                   "ms");
+  printMeasurement("  clusters rebuilt",
+                   static_cast<double>(pathfinder.numRebuiltClusters()),
+                   "clusters");
+
+  auto printAgentsPerSecond = [](char const* what, double seconds) {
+    printMeasurement(what, numAgents / seconds / 1e3, "k agents/s");
+  };
+
+  auto paths = std::vector<std::vector<glm::u64vec2>>();
+  auto measureRequests = [&](char const* name,
+                             std::vector<PathRequest> const& requests) {
+    auto label = [&](char const* what) {
+      return std::string(name) + ", " + what;
+    };
+
+    printAgentsPerSecond(label("findPath").c_str(), measureSeconds([&] {
+                           for (auto const& request : requests) {
+                             keepResult(
+                                 pathfinder.findPath(request.start,
+                                                     request.goal));
+                           }
+                         }));
+
+    printAgentsPerSecond(label("findPaths").c_str(), measureSeconds([&] {
+                           pathfinder.findPaths(requests, paths);
+                         }));
+
+    auto numFound =
+        std::count_if(paths.begin(), paths.end(),
+                      [](auto const& path) { return !path.empty(); });
+    printMeasurement(label("  paths found").c_str(),
+                     100.0 * numFound / requests.size(), "%");
+  };
+
+  measureRequests("8 to 24 tiles", shortRequests);
+  measureRequests("200 to 400 tiles", longRequests);
+
+  // Agents scattered around one target, each reading its next step.
+  auto target = shortRequests[0].goal;
+  auto agents = std::vector<glm::u64vec2>(numAgents);
+  auto radius = pathfinder.flowFieldRadius();
+  for (auto& agent : agents) {
+    agent = {target.x - std::min(target.x, radius) + rand() % (2 * radius),
+             target.y - std::min(target.y, radius) + rand() % (2 * radius)};
+  }
+
+  auto followField = [&] {
+    auto const& field = pathfinder.flowField(target);
+    for (auto const& agent : agents) keepResult(field.directionAt(agent));
+  };
+
+  printAgentsPerSecond("flow field, built", measureSeconds([&] {
+                         pathfinder.clearFlowFields();
+                         followField();
+                       }));
+  printAgentsPerSecond("flow field, cached", measureSeconds(followField));
+}
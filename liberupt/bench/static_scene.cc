@@ -0,0 +1,86 @@
+#include <liberupt/source/mesh_util.h>
+
+#include "frames.h"
+
+// Draws 100k cubes of 4 meshes and 8 textures, half of them in view
+// and half behind the camera, once as a static scene culled by its
+// compute pass and drawn with an indirect draw per texture, and once
+// queued with renderModel, culled and instanced on the CPU.
+
+constexpr size_t numFrames = 200;
+
+// Cubes in two grids of 250x200, two units apart, one filling the view
+// and one behind the camera.
+static std::vector<Model> cubeGrids(std::vector<Mesh*> const& meshes,
+                                    std::vector<Texture*> const& textures) {
+  constexpr size_t numColumns = 250;
+  constexpr size_t numRows = 200;
+
+  auto models = std::vector<Model>();
+  models.reserve(2 * numColumns * numRows);
+  for (auto z : {0.0f, -1040.0f}) {
+    for (size_t i = 0; i < numColumns * numRows; ++i) {
+      auto& model = models.emplace_back(*meshes[i % meshes.size()],
+                                        *textures[i / 7 % textures.size()]);
+      model.setPosition({2.0f * (i % numColumns) - numColumns,
+                         2.0f * (i / numColumns) - numRows, z});
+    }
+  }
+  return models;
+}
+
+BENCHMARK(staticScene) {
+  auto renderer = Renderer3d(benchmarkRendererSettings("staticScene"));
+  renderer.materialize();
+
+  // Far enough back for a grid of 250x200 cubes to fill the view.
+  renderer.camera3d().setPosition({0, 0, -520});
+
+  auto textures = std::vector<Texture*>();
+  for (uint32_t i = 0; i < 8; ++i) {
+    auto& texture = renderer.createTexture("texture" + std::to_string(i));
+    texture.updatePixels(1, 1, {0xff000000 | i * 0x1f1f1f});
+    textures.push_back(&texture);
+  }
+
+  auto meshes = std::vector<Mesh*>();
+  for (size_t i = 0; i < 4; ++i) {
+    auto& mesh = renderer.createMesh("cube" + std::to_string(i));
+    mesh.setVertices(cubeVertices({0, 0, 0}, glm::vec3(0.5f + 0.25f * i)));
+    meshes.push_back(&mesh);
+  }
+
+  auto const models = cubeGrids(meshes, textures);
+  auto scene = renderer.createStaticScene();
+  auto buildScene = [&] {
+    for (auto const& model : models) scene->addModel(model);
+    scene->upload();
+  };
+  printMeasurement("build scene", 1e3 * measureSeconds(buildScene, 1), "ms");
+
+  auto print = [&](std::string const& name, double milliseconds) {
+    auto const& stats = renderer.frameStats();
+    printMeasurement(name.c_str(), milliseconds, "ms/frame");
+    printMeasurement((name + ", draw calls").c_str(), stats.drawCalls,
+                     "per frame");
+  };
+
+  print("static scene, 100k cubes",
+        measureFrameMilliseconds(renderer, numFrames, [&](size_t) {
+          renderer.renderStaticScene(*scene);
+        }));
+  auto const& stats = renderer.frameStats();
+  printMeasurement("static scene, instances tested on the device",
+                   stats.staticInstancesTestedOnDevice, "per frame");
+  printMeasurement("static scene, instances drawn on the CPU",
+                   stats.staticInstancesDrawn, "per frame");
+  printMeasurement("static scene, draw commands", stats.staticDrawCommands,
+                   "per frame");
+
+  print("renderModel, 100k cubes",
+        measureFrameMilliseconds(renderer, numFrames, [&](size_t) {
+          for (auto const& model : models) renderer.renderModel(model);
+        }));
+  printMeasurement("renderModel, models drawn", stats.modelsDrawn,
+                   "per frame");
+}
@@ -0,0 +1,83 @@
+#include <liberupt/source/tile_query.h>
+
+#include "tilemaps.h"
+
+// Rays cast per second across a 4096x4096 map with scattered walls,
+// one at a time on the calling thread and in batches spread across the
+// shared worker pool, along with line of sight checks and box sweeps.
+
+constexpr size_t mapSize = 4096;
+constexpr size_t numRays = 1 << 20;
+constexpr float tileSize = 16;
+
+static std::vector<TileRay> randomRays(float maxDistance) {
+  srand(2);
+  auto rays = std::vector<TileRay>(numRays);
+  for (auto& ray : rays) {
+    auto angle = frand(0, 2 * 3.14159265f);
+    ray.origin = {frand(0, mapSize * tileSize), frand(0, mapSize * tileSize)};
+    ray.direction = {std::cos(angle), std::sin(angle)};
+    ray.maxDistance = maxDistance;
+  }
+  return rays;
+}
+
+BENCHMARK(tileQuery) {
+  auto renderer = Renderer2d(benchmarkRendererSettings("tileQuery"));
+  renderer.materialize();
+
+  auto map = Tilemap<uint16_t>({mapSize, mapSize, 1},
+                               createBenchmarkTileset(renderer), {16, 16},
+                               {tileSize, tileSize});
+  auto isBlocking = [](uint16_t tile) { return tile != 0; };
+  auto hits = std::vector<TileRayHit>();
+
+  auto printRaysPerSecond = [](char const* what, double seconds) {
+    printMeasurement(what, numRays / seconds / 1e6, "M rays/s");
+  };
+
+  // Sparse walls let rays travel far, dense ones stop them early.
+  for (auto density : {0.01f, 0.2f}) {
+    scatterWalls(map, 0, density);
+    std::printf("walls covering %.0f%% of the map, %zu worker threads\n",
+                density * 100, sharedWorkerPool().threadCount());
+
+    for (auto maxTiles : {32.0f, 512.0f}) {
+      auto rays = randomRays(maxTiles * tileSize);
+      auto label = [&](char const* what) {
+        return std::string(what) + ", " + std::to_string(int(maxTiles)) +
+               " tiles";
+      };
+
+      printRaysPerSecond(label("raycast").c_str(), measureSeconds([&] {
+                           for (auto const& ray : rays) {
+                             keepResult(raycast(map, 0, ray, isBlocking));
+                           }
+                         }));
+
+      printRaysPerSecond(label("raycastBatch").c_str(), measureSeconds([&] {
+                           raycastBatch(map, 0, rays, hits, isBlocking);
+                         }));
+    }
+
+    // Line of sight between nearby points, as when checking which
+    // agents see one another.
+    auto rays = randomRays(24 * tileSize);
+    printRaysPerSecond("hasLineOfSight", measureSeconds([&] {
+                         for (auto const& ray : rays) {
+                           auto to = ray.origin + ray.direction * 24.0f *
+                                                      tileSize;
+                           keepResult(hasLineOfSight(map, 0, ray.origin, to,
+                                                     isBlocking));
+                         }
+                       }));
+
+    printRaysPerSecond("sweepBox, 12x12 moving 8", measureSeconds([&] {
+                         for (auto const& ray : rays) {
+                           keepResult(sweepBox(map, 0, ray.origin, {12, 12},
+                                               ray.direction * 8.0f,
+                                               isBlocking));
+                         }
+                       }));
+  }
+}
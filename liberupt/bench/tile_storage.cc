@@ -0,0 +1,154 @@
+#include <liberupt/source/tile_storage.h>
+
+#include "bench.h"
+
+// Compares the sparse chunk storage of tilemaps against a dense array
+// of all tiles, by memory held and by time per tile accessed.
+
+using Storage = TileStorage<uint16_t>;
+
+constexpr size_t mapSize = 4096;
+constexpr size_t numLayers = 4;
+constexpr size_t numRandomAccesses = 1 << 22;
+
+// Ground, scattered details, rectangular buildings and a few clusters.
+static void fillStorage(Storage& storage) {
+  srand(1);
+  storage.fill(0, 1);
+  for (size_t i = 0; i < mapSize * mapSize / 8; ++i) {
+    storage.set({rand() % mapSize, rand() % mapSize, 1},
+                static_cast<uint16_t>(1 + rand() % 256));
+  }
+  for (size_t i = 0; i < 4096; ++i) {
+    auto pos = glm::u64vec2{rand() % (mapSize - 64), rand() % (mapSize - 64)};
+    auto size = glm::u64vec2{1 + rand() % 64, 1 + rand() % 64};
+    storage.fillRect(2, pos, pos + size,
+                     static_cast<uint16_t>(1 + rand() % 256));
+  }
+  for (size_t i = 0; i < 256; ++i) {
+    auto center = glm::u64vec2{64 + rand() % (mapSize - 128),
+                               64 + rand() % (mapSize - 128)};
+    for (size_t k = 0; k < 256; ++k) {
+      storage.set({center.x + rand() % 64 - 32, center.y + rand() % 64 - 32, 3},
+                  static_cast<uint16_t>(1 + rand() % 256));
+    }
+  }
+}
+
+static size_t denseIndex(glm::u64vec3 const& pos) {
+  return pos.x + mapSize * (pos.y + mapSize * pos.z);
+}
+
+BENCHMARK(tileStorage) {
+  auto storage = Storage({mapSize, mapSize, numLayers});
+  fillStorage(storage);
+
+  auto dense = std::vector<uint16_t>(mapSize * mapSize * numLayers);
+  for (size_t z = 0; z < numLayers; ++z) {
+    for (size_t y = 0; y < mapSize; ++y) {
+      storage.readRow({0, y, z}, mapSize, &dense[denseIndex({0, y, z})]);
+    }
+  }
+
+  printMeasurement("4096x4096x4, dense",
+                   dense.size() * sizeof(uint16_t) / double(1 << 20), "MiB");
+  printMeasurement("4096x4096x4, sparse",
+                   storage.memoryUsage() / double(1 << 20), "MiB");
+  printMeasurement("4096x4096x4, sparse chunks stored",
+                   storage.chunkCount(), "chunks");
+  printMeasurement("4096x4096x4, sparse chunks holding tiles",
+                   storage.denseChunkCount(), "chunks");
+
+  // A world too large to allocate densely, with a few edited regions.
+  auto world = Storage({65536, 65536, numLayers});
+  world.fill(0, 1);
+  for (size_t i = 0; i < 64; ++i) {
+    auto pos = glm::u64vec2{rand() % 65000, rand() % 65000};
+    world.fillRect(1, pos, pos + glm::u64vec2{500, 20}, 2);
+    world.set({pos.x + 7, pos.y + 3, 2}, 3);
+  }
+  printMeasurement("65536x65536x4, dense",
+                   65536.0 * 65536 * numLayers * sizeof(uint16_t) / (1 << 20),
+                   "MiB");
+  printMeasurement("65536x65536x4, sparse",
+                   world.memoryUsage() / double(1 << 20), "MiB");
+
+  auto positions = std::vector<glm::u64vec3>(numRandomAccesses);
+  for (auto& pos : positions) {
+    pos = {rand() % mapSize, rand() % mapSize, rand() % numLayers};
+  }
+  auto perRandom = 1e9 / numRandomAccesses;
+  auto perTile = 1e9 / (mapSize * mapSize * numLayers);
+
+  auto denseRandom = measureSeconds([&] {
+    uint64_t sum = 0;
+    for (auto const& pos : positions) sum += dense[denseIndex(pos)];
+    keepResult(sum);
+  });
+  auto sparseRandom = measureSeconds([&] {
+    uint64_t sum = 0;
+    for (auto const& pos : positions) sum += storage.at(pos);
+    keepResult(sum);
+  });
+  printMeasurement("random reads, dense", denseRandom * perRandom, "ns/tile");
+  printMeasurement("random reads, sparse at", sparseRandom * perRandom,
+                   "ns/tile");
+
+  auto denseScan = measureSeconds([&] {
+    uint64_t sum = 0;
+    for (auto tile : dense) sum += tile;
+    keepResult(sum);
+  });
+  auto sparseScan = measureSeconds([&] {
+    uint64_t sum = 0;
+    for (size_t z = 0; z < numLayers; ++z) {
+      for (size_t y = 0; y < mapSize; ++y) {
+        for (size_t x = 0; x < mapSize; ++x) sum += storage.at({x, y, z});
+      }
+    }
+    keepResult(sum);
+  });
+  auto readerScan = measureSeconds([&] {
+    uint64_t sum = 0;
+    auto read = Storage::Reader(storage);
+    for (size_t z = 0; z < numLayers; ++z) {
+      for (size_t y = 0; y < mapSize; ++y) {
+        for (size_t x = 0; x < mapSize; ++x) sum += read({x, y, z});
+      }
+    }
+    keepResult(sum);
+  });
+  auto rowScan = measureSeconds([&] {
+    uint64_t sum = 0;
+    auto row = std::vector<uint16_t>(mapSize);
+    for (size_t z = 0; z < numLayers; ++z) {
+      for (size_t y = 0; y < mapSize; ++y) {
+        storage.readRow({0, y, z}, mapSize, row.data());
+        for (auto tile : row) sum += tile;
+      }
+    }
+    keepResult(sum);
+  });
+  printMeasurement("row-major scan, dense", denseScan * perTile, "ns/tile");
+  printMeasurement("row-major scan, sparse at", sparseScan * perTile,
+                   "ns/tile");
+  printMeasurement("row-major scan, sparse Reader", readerScan * perTile,
+                   "ns/tile");
+  printMeasurement("row-major scan, sparse readRow", rowScan * perTile,
+                   "ns/tile");
+
+  auto denseWrites = measureSeconds([&] {
+    for (size_t i = 0; i < positions.size(); ++i) {
+      dense[denseIndex(positions[i])] = static_cast<uint16_t>(i);
+    }
+  });
+  auto sparseWrites = measureSeconds([&] {
+    for (size_t i = 0; i < positions.size(); ++i) {
+      storage.set(positions[i], static_cast<uint16_t>(i));
+    }
+  });
+  printMeasurement("random writes, dense", denseWrites * perRandom,
+                   "ns/tile");
+  printMeasurement("random writes, sparse set", sparseWrites * perRandom,
+                   "ns/tile");
+}
@@ -0,0 +1,97 @@
+#include "tilemaps.h"
+
+// Draws a 4096x4096x4 map of 16 pixel tiles, filling a 1280x720 view,
+// as one sprite per tile, as it was drawn before chunk geometry, and
+// as cached chunk geometry, standing still, editing and scrolling.
+
+constexpr size_t mapSize = 4096;
+constexpr size_t numLayers = 4;
+constexpr float tileSize = 16;
+constexpr size_t numFrames = 200;
+
+static void fillMap(Tilemap16& map) {
+  srand(1);
+  map.fill(0, 1);
+  for (size_t i = 0; i < mapSize * mapSize / 8; ++i) {
+    map.setTileAt({rand() % mapSize, rand() % mapSize, 1},
+                  static_cast<uint16_t>(1 + rand() % 256));
+  }
+  for (size_t i = 0; i < 4096; ++i) {
+    auto pos = glm::u64vec2{rand() % (mapSize - 64), rand() % (mapSize - 64)};
+    auto size = glm::u64vec2{1 + rand() % 64, 1 + rand() % 64};
+    map.fillRect(pos, size, 2, static_cast<uint16_t>(1 + rand() % 256));
+  }
+  for (size_t i = 0; i < mapSize * mapSize / 128; ++i) {
+    map.setTileAt({rand() % mapSize, rand() % mapSize, 3},
+                  static_cast<uint16_t>(1 + rand() % 256));
+  }
+}
+
+BENCHMARK(tilemapDraw) {
+  auto renderer = Renderer2d(benchmarkRendererSettings("tilemapDraw"));
+  renderer.materialize();
+
+  auto& tileset = createBenchmarkTileset(renderer);
+
+  auto map = Tilemap16({mapSize, mapSize, numLayers}, tileset, {16, 16},
+                       {tileSize, tileSize});
+  fillMap(map);
+
+  auto viewTiles = glm::u64vec2{
+      glm::ceil(renderer.camera2d().viewportSize() / tileSize)};
+  auto uvIncrement = glm::vec2{1 / 16.0f};
+  auto perTile = measureFrameMilliseconds(renderer, numFrames, [&](size_t) {
+    for (size_t z = 0; z < numLayers; ++z) {
+      for (size_t y = 0; y < viewTiles.y; ++y) {
+        for (size_t x = 0; x < viewTiles.x; ++x) {
+          auto value = map.tileAt({x, y, z});
+          if (!value) continue;
+
+          auto sprite = Sprite(tileset);
+          sprite.setPosition(tileSize * glm::vec2{x, y});
+          sprite.setSize({tileSize, tileSize});
+          sprite.setTextureArea(
+              {uvIncrement * glm::vec2{(value - 1) % 16, (value - 1) / 16},
+               uvIncrement});
+          sprite.setDepth(1.0f - (z + 1.0f) / (numLayers + 1.0f));
+          renderer.renderSprite(sprite);
+        }
+      }
+    }
+  });
+  printMeasurement("per-tile sprites", perTile, "ms/frame");
+  printMeasurement("per-tile sprites, draw calls",
+                   renderer.frameStats().drawCalls, "per frame");
+
+  auto firstFrame = measureFrameMilliseconds(
+      renderer, 1, [&](size_t) { map.draw(renderer); });
+  printMeasurement("chunk meshes, first frame", firstFrame, "ms");
+
+  auto still = measureFrameMilliseconds(renderer, numFrames,
+                                        [&](size_t) { map.draw(renderer); });
+  printMeasurement("chunk meshes", still, "ms/frame");
+  printMeasurement("chunk meshes, draw calls",
+                   renderer.frameStats().drawCalls, "per frame");
+
+  auto editing = measureFrameMilliseconds(renderer, numFrames, [&](size_t) {
+    map.setTileAt({rand() % viewTiles.x, rand() % viewTiles.y, 1},
+                  static_cast<uint16_t>(1 + rand() % 256));
+    map.draw(renderer);
+  });
+  printMeasurement("chunk meshes, one edit per frame", editing, "ms/frame");
+
+  // Diagonally across a quarter of the map, 32 pixels per frame.
+  auto numScrollFrames = static_cast<size_t>(mapSize * tileSize / 4 / 32);
+  auto scrolling =
+      measureFrameMilliseconds(renderer, numScrollFrames, [&](size_t frame) {
+        renderer.camera2d().setPosition(glm::vec2{32.0f * frame});
+        map.draw(renderer);
+      });
+  printMeasurement("chunk meshes, scrolling", scrolling, "ms/frame");
+  printMeasurement("chunk meshes, cached after scrolling",
+                   map.cachedChunkCount(), "chunks");
+  printMeasurement("chunk meshes, chunks in map",
+                   mapSize * mapSize * numLayers / Tilemap16::chunkSize /
+                       Tilemap16::chunkSize,
+                   "chunks");
+}
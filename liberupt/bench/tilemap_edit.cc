@@ -0,0 +1,91 @@
+#include "tilemaps.h"
+
+// Times the bulk editing operations of tilemaps of each tile width,
+// against setting every tile with setTileAt, on a 2048x2048 layer.
+// The renderer only provides the tileset the maps are checked against.
+
+constexpr size_t mapSize = 2048;
+constexpr size_t regionSize = 1024;
+
+template <typename TileType>
+static void measureEdits(char const* name, Texture const& tileset) {
+  auto map = Tilemap<TileType>({mapSize, mapSize, 2}, tileset, {16, 16},
+                               {16, 16});
+  auto perTile = 1e9 / (mapSize * mapSize);
+  auto perRegionTile = 1e9 / (regionSize * regionSize);
+  auto value = TileType{0};
+  auto nextValue = [&] {
+    return value = static_cast<TileType>(1 + value % 200);
+  };
+
+  auto print = [&](char const* what, double nanoseconds) {
+    auto label = std::string(name) + ", " + what;
+    printMeasurement(label.c_str(), nanoseconds, "ns/tile");
+  };
+
+  print("setTileAt per tile", perTile * measureSeconds([&] {
+          auto tile = nextValue();
+          for (size_t y = 0; y < mapSize; ++y) {
+            for (size_t x = 0; x < mapSize; ++x) {
+              map.setTileAt({x, y, 0}, tile);
+            }
+          }
+        }));
+
+  print("fillRect", perTile * measureSeconds([&] {
+          map.fillRect({0, 0}, {mapSize, mapSize}, 0, nextValue());
+        }));
+
+  // Unaligned to chunks, so that chunks along the edges are split.
+  print("fillRect, unaligned", perRegionTile * measureSeconds([&] {
+          map.fillRect({5, 7}, {regionSize, regionSize}, 0, nextValue());
+        }));
+
+  // Varied tiles for the copies and replacements below.
+  srand(1);
+  for (size_t i = 0; i < mapSize * mapSize / 4; ++i) {
+    map.setTileAt({rand() % mapSize, rand() % mapSize, 0},
+                  static_cast<TileType>(1 + rand() % 200));
+  }
+
+  print("copyRegion", perRegionTile * measureSeconds([&] {
+          keepResult(map.copyRegion({3, 3}, {regionSize, regionSize}, 0));
+        }));
+
+  auto region = map.copyRegion({3, 3}, {regionSize, regionSize}, 0);
+  print("pasteRegion", perRegionTile * measureSeconds([&] {
+          map.pasteRegion(region, {17, 9}, 1);
+        }));
+
+  print("blit between layers", perRegionTile * measureSeconds([&] {
+          map.blit({0, 0}, 0, {regionSize, regionSize}, {100, 100}, 1);
+        }));
+
+  print("blit, overlapping", perRegionTile * measureSeconds([&] {
+          map.blit({0, 0}, 0, {regionSize, regionSize}, {10, 10}, 0);
+        }));
+
+  print("replace", perTile * measureSeconds([&] {
+          map.replace(0, 1 + rand() % 200, nextValue());
+        }));
+
+  // Flood fills all of a uniform layer, one span per row.
+  map.fill(1, 1);
+  print("floodFill", perTile * measureSeconds([&] {
+          auto from = map.tileAt({0, 0, 1});
+          map.floodFill({mapSize / 2, mapSize / 2, 1},
+                        static_cast<TileType>(from % 200 + 1));
+        }));
+}
+
+BENCHMARK(tilemapEdit) {
+  auto renderer = Renderer2d(benchmarkRendererSettings("tilemapEdit"));
+  renderer.materialize();
+
+  auto& tileset = createBenchmarkTileset(renderer);
+
+  measureEdits<uint8_t>("Tilemap8", tileset);
+  measureEdits<uint16_t>("Tilemap16", tileset);
+  measureEdits<uint32_t>("Tilemap32", tileset);
+  measureEdits<uint64_t>("Tilemap64", tileset);
+}
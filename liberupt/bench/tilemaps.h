@@ -0,0 +1,27 @@
+#pragma once
+
+#include <liberupt/source/tilemap.h>
+
+#include "frames.h"
+
+// The tileset tilemaps are checked against, of 16x16 tiles of 16
+// pixels each. Tilemaps only read its size, so its pixels are plain.
+inline Texture& createBenchmarkTileset(Renderer2d& renderer) {
+  auto& tileset = renderer.createTexture("tileset");
+  tileset.updatePixels(256, 256, std::vector<uint32_t>(256 * 256, ~0u));
+  return tileset;
+}
+
+// Sets a fraction of the tiles of a layer to walls, which queries treat
+// as blocking, and clears the rest. The same seed gives the same walls.
+template <typename TileType>
+void scatterWalls(Tilemap<TileType>& map, size_t layer, float density,
+                  unsigned seed = 1) {
+  auto const wall = TileType{1};
+  map.fillRect({0, 0}, {map.size().x, map.size().y}, layer, TileType{0});
+  srand(seed);
+  auto numWalls = static_cast<size_t>(density * map.size().x * map.size().y);
+  for (size_t i = 0; i < numWalls; ++i) {
+    map.setTileAt({rand() % map.size().x, rand() % map.size().y, layer}, wall);
+  }
+}
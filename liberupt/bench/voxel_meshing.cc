@@ -0,0 +1,58 @@
+#include "bench.h"
+#include "voxel_terrain.h"
+
+// Meshes the chunks of block worlds one at a time and across the shared
+// worker pool, and compares the triangles per chunk against drawing
+// every solid block as a cube, as concatenating cubeVertices would.
+
+static void measureMeshing(char const* name, VoxelWorld const& world,
+                           size_t numSolid) {
+  auto chunks = std::vector<glm::ivec3>();
+  world.forEachChunk([&](glm::ivec3 const& chunk, VoxelChunk const&) {
+    chunks.push_back(chunk);
+  });
+  auto numChunks = static_cast<double>(chunks.size());
+  auto blockTypes = terrainBlockTypes();
+
+  auto print = [&](char const* what, double value, char const* unit) {
+    printMeasurement((std::string(name) + ", " + what).c_str(), value, unit);
+  };
+
+  auto neighborhood = std::make_unique<VoxelNeighborhood>();
+  auto oneThread = measureSeconds([&] {
+    for (auto const& chunk : chunks) {
+      world.fillNeighborhood(chunk, *neighborhood);
+      keepResult(meshVoxelChunk(*neighborhood, blockTypes));
+    }
+  });
+  print("one thread", 1e3 * oneThread / numChunks, "ms/chunk");
+
+  auto meshes = std::vector<VoxelChunkMesh>();
+  auto report = VoxelMeshingReport{};
+  auto pool = measureSeconds([&] {
+    report = meshVoxelChunks(
+        chunks.size(),
+        [&](size_t index, VoxelNeighborhood& neighborhood) {
+          world.fillNeighborhood(chunks[index], neighborhood);
+        },
+        blockTypes, meshes);
+  });
+  print("meshVoxelChunks", 1e3 * pool / numChunks, "ms/chunk");
+
+  print("chunks", numChunks, "chunks");
+  print("cubes per block", 12 * numSolid / numChunks, "triangles/chunk");
+  print("visible faces", 2 * report.numFaces / numChunks, "triangles/chunk");
+  print("merged quads", 2 * report.numQuads / numChunks, "triangles/chunk");
+}
+
+BENCHMARK(voxelMeshing) {
+  std::printf("%zu worker threads\n", sharedWorkerPool().threadCount());
+
+  auto terrain = VoxelWorld();
+  auto numTerrainSolid = generateTerrain(terrain, {16, 3, 16});
+  measureMeshing("hills", terrain, numTerrainSolid);
+
+  auto noise = VoxelWorld();
+  auto numNoiseSolid = generateNoise(noise, {4, 4, 4});
+  measureMeshing("noise", noise, numNoiseSolid);
+}
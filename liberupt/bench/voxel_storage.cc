@@ -0,0 +1,145 @@
+#include "bench.h"
+#include "voxel_terrain.h"
+
+// Compares palette-compressed voxel worlds against a dense array of
+// all their blocks, by memory per block and by time per block read,
+// written, scanned and copied into neighborhoods for meshing.
+
+constexpr size_t numRandomAccesses = 1 << 22;
+
+template <typename Generate>
+static void measureStorage(char const* name, glm::ivec3 const& numChunks,
+                           Generate&& generate) {
+  auto world = VoxelWorld();
+  generate(world, numChunks);
+
+  auto size = numChunks * voxelChunkSize;
+  auto numBlocks = static_cast<size_t>(size.x) * size.y * size.z;
+  auto denseIndex = [&](glm::ivec3 const& pos) {
+    return static_cast<size_t>(pos.x) +
+           size.x * (static_cast<size_t>(pos.y) +
+                     size.y * static_cast<size_t>(pos.z));
+  };
+  auto dense = std::vector<BlockId>(numBlocks);
+  for (int z = 0; z < size.z; ++z) {
+    for (int y = 0; y < size.y; ++y) {
+      for (int x = 0; x < size.x; ++x) {
+        dense[denseIndex({x, y, z})] = world.at({x, y, z});
+      }
+    }
+  }
+
+  auto print = [&](char const* what, double value, char const* unit) {
+    printMeasurement((std::string(name) + ", " + what).c_str(), value, unit);
+  };
+
+  auto report = world.report();
+  print("dense", 8.0 * sizeof(BlockId), "bits/block");
+  print("palettes", 8.0 * report.bytes / numBlocks, "bits/block");
+  print("uniform chunks", report.numUniformChunks, "chunks");
+  print("paletted chunks", report.numPalettedChunks, "chunks");
+  print("direct chunks", report.numDirectChunks, "chunks");
+
+  srand(2);
+  auto positions = std::vector<glm::ivec3>(numRandomAccesses);
+  for (auto& pos : positions) {
+    pos = {rand() % size.x, rand() % size.y, rand() % size.z};
+  }
+  auto perRandomAccess = 1e9 / numRandomAccesses;
+  auto perBlock = 1e9 / numBlocks;
+
+  print("random reads, dense", perRandomAccess * measureSeconds([&] {
+          auto sum = size_t{0};
+          for (auto const& pos : positions) sum += dense[denseIndex(pos)];
+          keepResult(sum);
+        }),
+        "ns/block");
+  print("random reads, at", perRandomAccess * measureSeconds([&] {
+          auto sum = size_t{0};
+          for (auto const& pos : positions) sum += world.at(pos);
+          keepResult(sum);
+        }),
+        "ns/block");
+
+  print("scan, dense", perBlock * measureSeconds([&] {
+          auto sum = size_t{0};
+          for (auto block : dense) sum += block;
+          keepResult(sum);
+        }),
+        "ns/block");
+  print("scan, Reader", perBlock * measureSeconds([&] {
+          auto read = VoxelWorld::Reader(world);
+          auto sum = size_t{0};
+          for (int z = 0; z < size.z; ++z) {
+            for (int y = 0; y < size.y; ++y) {
+              for (int x = 0; x < size.x; ++x) sum += read({x, y, z});
+            }
+          }
+          keepResult(sum);
+        }),
+        "ns/block");
+
+  // Neighborhoods of every chunk, as meshing and lighting read them.
+  auto neighborhood = std::make_unique<VoxelNeighborhood>();
+  auto numChunkBlocks = static_cast<double>(numChunks.x) * numChunks.y *
+                        numChunks.z * VoxelChunk::volume;
+  print("neighborhoods, dense", 1e9 / numChunkBlocks * measureSeconds([&] {
+          for (int cz = 0; cz < numChunks.z; ++cz) {
+            for (int cy = 0; cy < numChunks.y; ++cy) {
+              for (int cx = 0; cx < numChunks.x; ++cx) {
+                auto corner = glm::ivec3{cx, cy, cz} * voxelChunkSize;
+                for (int z = -1; z <= voxelChunkSize; ++z) {
+                  for (int y = -1; y <= voxelChunkSize; ++y) {
+                    for (int x = -1; x <= voxelChunkSize; ++x) {
+                      auto pos = glm::clamp(corner + glm::ivec3{x, y, z},
+                                            glm::ivec3(0), size - 1);
+                      neighborhood->set(x, y, z, dense[denseIndex(pos)]);
+                    }
+                  }
+                }
+              }
+            }
+          }
+          keepResult(*neighborhood);
+        }),
+        "ns/block");
+  print("neighborhoods, fillNeighborhood",
+        1e9 / numChunkBlocks * measureSeconds([&] {
+          for (int cz = 0; cz < numChunks.z; ++cz) {
+            for (int cy = 0; cy < numChunks.y; ++cy) {
+              for (int cx = 0; cx < numChunks.x; ++cx) {
+                world.fillNeighborhood({cx, cy, cz}, *neighborhood);
+              }
+            }
+          }
+          keepResult(*neighborhood);
+        }),
+        "ns/block");
+
+  print("random writes, dense", perRandomAccess * measureSeconds([&] {
+          auto block = BlockId{0};
+          for (auto const& pos : positions) {
+            dense[denseIndex(pos)] = block;
+            block = static_cast<BlockId>((block + 1) % numTerrainBlocks);
+          }
+        }),
+        "ns/block");
+  print("random writes, set", perRandomAccess * measureSeconds([&] {
+          auto block = BlockId{0};
+          for (auto const& pos : positions) {
+            world.set(pos, block);
+            block = static_cast<BlockId>((block + 1) % numTerrainBlocks);
+          }
+          world.takeDirtyChunks();
+        }),
+        "ns/block");
+
+  world.compact();
+  print("palettes after writes and compact",
+        8.0 * world.report().bytes / numBlocks, "bits/block");
+}
+
+BENCHMARK(voxelStorage) {
+  measureStorage("hills", {16, 3, 16}, generateTerrain);
+  measureStorage("noise", {4, 4, 4}, generateNoise);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <liberupt/source/voxel_world.h>
+
+// Block worlds shared by the voxel benchmarks: rolling hills of stone,
+// dirt and grass, with ore scattered through the stone, and noise of
+// solid blocks, which is the worst case for both palettes and meshing.
+
+enum TerrainBlock : BlockId {
+  stoneBlock = 1,
+  dirtBlock,
+  grassBlock,
+  oreBlock,
+  numTerrainBlocks
+};
+
+// One texture per block, except for grass, whose sides show dirt.
+inline std::vector<VoxelBlockType> terrainBlockTypes() {
+  auto types = std::vector<VoxelBlockType>(numTerrainBlocks);
+  for (BlockId block = stoneBlock; block < numTerrainBlocks; ++block) {
+    types[block].faceTextures.fill(block);
+  }
+  types[grassBlock].faceTextures.fill(dirtBlock);
+  types[grassBlock].faceTextures[static_cast<size_t>(VoxelFace::Up)] =
+      grassBlock;
+  return types;
+}
+
+inline int terrainHeight(int x, int z) {
+  return static_cast<int>(48 + 16 * std::sin(x / 37.0f) * std::cos(z / 29.0f) +
+                          6 * std::sin((x + z) / 13.0f));
+}
+
+// Fills numChunks chunks from the origin, returning the number of
+// blocks that are not air. Chunks of air are not stored.
+template <typename BlockAt>
+size_t generateBlocks(VoxelWorld& world, glm::ivec3 const& numChunks,
+                      BlockAt&& blockAt) {
+  constexpr int n = voxelChunkSize;
+  auto blocks = std::vector<BlockId>(VoxelChunk::volume);
+  auto numSolid = size_t{0};
+  for (int cz = 0; cz < numChunks.z; ++cz) {
+    for (int cy = 0; cy < numChunks.y; ++cy) {
+      for (int cx = 0; cx < numChunks.x; ++cx) {
+        for (int z = 0; z < n; ++z) {
+          for (int y = 0; y < n; ++y) {
+            for (int x = 0; x < n; ++x) {
+              auto block = blockAt(cx * n + x, cy * n + y, cz * n + z);
+              blocks[VoxelChunk::index(x, y, z)] = block;
+              numSolid += block != airBlock;
+            }
+          }
+        }
+        world.setChunk({cx, cy, cz}, blocks.data());
+      }
+    }
+  }
+  world.compact();
+  world.takeDirtyChunks();
+  return numSolid;
+}
+
+inline size_t generateTerrain(VoxelWorld& world, glm::ivec3 const& numChunks) {
+  srand(1);
+  return generateBlocks(world, numChunks, [](int x, int y, int z) {
+    auto height = terrainHeight(x, z);
+    if (y > height) return airBlock;
+    if (y == height) return BlockId{grassBlock};
+    if (y > height - 4) return BlockId{dirtBlock};
+    return BlockId(rand() % 100 == 0 ? oreBlock : stoneBlock);
+  });
+}
+
+inline size_t generateNoise(VoxelWorld& world, glm::ivec3 const& numChunks) {
+  srand(1);
+  return generateBlocks(world, numChunks, [](int, int, int) {
+    return BlockId(rand() % 2 ? airBlock : 1 + rand() % (numTerrainBlocks - 1));
+  });
+}
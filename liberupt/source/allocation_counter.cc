@@ -0,0 +1,42 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "frame_arena.h"
+
+namespace {
+std::atomic<size_t> allocationCount{0};
+}
+
+size_t heapAllocationCount() noexcept {
+  return allocationCount.load(std::memory_order_relaxed);
+}
+
+#ifdef ERUPT_COUNT_ALLOCATIONS
+
+// Replacements for the global allocation functions, counting every
+// allocation made by the process. The array and nothrow forms
+// forward to these by default, so they need not be replaced.
+
+void* operator new(size_t bytes) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (auto ptr = std::malloc(bytes ? bytes : 1)) return ptr;
+  throw std::bad_alloc();
+}
+
+void* operator new(size_t bytes, std::align_val_t alignment) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  auto align = static_cast<size_t>(alignment);
+  if (auto ptr = std::aligned_alloc(align, (bytes + align - 1) & ~(align - 1)))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+#endif
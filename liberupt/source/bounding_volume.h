@@ -0,0 +1,109 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <limits>
+
+#include "common.h"
+
+// Axis-aligned bounding box. Boxes with min > max along any axis are
+// empty, which is the state of a default constructed box.
+struct Aabb {
+  glm::vec3 min{std::numeric_limits<float>::max()};
+  glm::vec3 max{std::numeric_limits<float>::lowest()};
+
+  inline bool isEmpty() const noexcept {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+  }
+
+  inline void extend(glm::vec3 const& point) noexcept {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  inline void extend(Aabb const& other) noexcept {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+  }
+
+  inline glm::vec3 center() const noexcept { return (min + max) * 0.5f; }
+  inline glm::vec3 extent() const noexcept { return max - min; }
+
+  inline float surfaceArea() const noexcept {
+    if (isEmpty()) return 0;
+    auto e = extent();
+    return 2 * (e.x * e.y + e.y * e.z + e.z * e.x);
+  }
+};
+
+// Bounds of a box after an affine transform, computed per axis from the
+// extremes of each matrix column (Arvo's method) rather than from the
+// eight corners.
+inline Aabb transformBox(glm::mat4 const& transform, Aabb const& box) noexcept {
+  if (box.isEmpty()) return box;
+
+  auto result = Aabb{glm::vec3(transform[3]), glm::vec3(transform[3])};
+  for (int col = 0; col < 3; ++col) {
+    auto a = glm::vec3(transform[col]) * box.min[col];
+    auto b = glm::vec3(transform[col]) * box.max[col];
+    result.min += glm::min(a, b);
+    result.max += glm::max(a, b);
+  }
+  return result;
+}
+
+struct BoundingSphere {
+  glm::vec3 center{0, 0, 0};
+  float radius = 0;
+};
+
+// Bounds of a sphere after an affine transform, growing the radius by
+// the largest scale along any axis so that it stays conservative.
+inline BoundingSphere transformSphere(glm::mat4 const& transform,
+                                      BoundingSphere const& sphere) noexcept {
+  auto scale = std::max({glm::length(glm::vec3(transform[0])),
+                         glm::length(glm::vec3(transform[1])),
+                         glm::length(glm::vec3(transform[2]))});
+  return {glm::vec3(transform * glm::vec4(sphere.center, 1)),
+          sphere.radius * scale};
+}
+
+// Planes of a view frustum as (normal, distance), with normals pointing
+// inwards, so that points inside satisfy dot(normal, p) + distance >= 0.
+using FrustumPlanes = std::array<glm::vec4, 6>;
+
+// Extracts the frustum planes of a view projection matrix that maps
+// depth into [0, 1].
+inline FrustumPlanes extractFrustumPlanes(glm::mat4 const& m) noexcept {
+  auto row = [&](int i) {
+    return glm::vec4{m[0][i], m[1][i], m[2][i], m[3][i]};
+  };
+
+  // Left, right, bottom, top, near and far.
+  auto planes = FrustumPlanes{row(3) + row(0), row(3) - row(0),
+                              row(3) + row(1), row(3) - row(1),
+                              row(2), row(3) - row(2)};
+  for (auto& plane : planes) plane /= glm::length(glm::vec3(plane));
+  return planes;
+}
+
+// Tests the corner of the box furthest along each plane's normal.
+inline bool isBoxInFrustum(FrustumPlanes const& planes,
+                           Aabb const& box) noexcept {
+  for (auto const& plane : planes) {
+    auto normal = glm::vec3(plane);
+    auto corner = glm::mix(box.min, box.max,
+                           glm::greaterThanEqual(normal, glm::vec3(0)));
+    if (glm::dot(normal, corner) + plane.w < 0) return false;
+  }
+  return true;
+}
+
+inline bool isSphereInFrustum(FrustumPlanes const& planes,
+                              BoundingSphere const& sphere) noexcept {
+  for (auto const& plane : planes) {
+    if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius) {
+      return false;
+    }
+  }
+  return true;
+}
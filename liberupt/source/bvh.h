@@ -0,0 +1,440 @@
+#pragma once
+
+#include <numeric>
+
+#include "bounding_volume.h"
+#include "worker_pool.h"
+
+struct BvhNode {
+  Aabb bounds;
+
+  // Leaves hold count items starting at first, inner nodes have count
+  // zero and their children at first and first + 1.
+  uint32_t first;
+  uint32_t count;
+};
+
+struct BvhRayHit {
+  bool hit = false;
+  uint32_t item = 0;
+  float distance = 0;
+};
+
+// Bounding volume hierarchy over a static set of items, each given by
+// its bounding box, e.g. the world bounds of the models of a level.
+// Items are referred to by their index in the list the tree was built
+// from.
+//
+// Trees are built top down, splitting nodes where the surface area
+// heuristic estimates the cheapest traversal, using binned centroids.
+// Moving items only requires updating their bounds and refitting, at
+// the price of a tree that gets looser as items move further away.
+class Bvh {
+ public:
+  static constexpr size_t maxDepth = 64;
+  static constexpr uint32_t maxLeafItems = 8;
+
+ private:
+  static constexpr size_t numBins = 16;
+
+  // Below this depth nodes are split at the median rather than by the
+  // surface area heuristic, which bounds the depth of the tree.
+  static constexpr size_t sahDepthLimit = 32;
+
+  // Subtrees with fewer items are not worth building on another thread.
+  static constexpr size_t minParallelItems = 1024;
+
+  struct BuildTask {
+    uint32_t node;
+    uint32_t begin;
+    uint32_t end;
+    uint32_t depth;
+  };
+
+  std::vector<BvhNode> m_nodes;
+  std::vector<uint32_t> m_items;
+  std::vector<Aabb> m_itemBounds;
+  std::vector<glm::vec3> m_centroids;
+
+  // Splits the items in [begin, end) into two children, or returns the
+  // end when the node is cheaper to keep as a leaf. Also computes the
+  // bounds of the node.
+  uint32_t split(uint32_t begin, uint32_t end, uint32_t depth, Aabb& bounds) {
+    struct Bin {
+      Aabb bounds;
+      uint32_t count = 0;
+    };
+
+    bounds = {};
+    auto centroidBounds = Aabb{};
+    for (auto i = begin; i < end; ++i) {
+      bounds.extend(m_itemBounds[m_items[i]]);
+      centroidBounds.extend(m_centroids[m_items[i]]);
+    }
+
+    auto count = end - begin;
+    if (count <= 2) return end;
+
+    auto medianSplit = [&] {
+      auto axis = 0;
+      auto extent = centroidBounds.extent();
+      if (extent.y > extent[axis]) axis = 1;
+      if (extent.z > extent[axis]) axis = 2;
+
+      auto mid = begin + count / 2;
+      std::nth_element(m_items.begin() + begin, m_items.begin() + mid,
+                       m_items.begin() + end, [&](auto lhs, auto rhs) {
+                         return m_centroids[lhs][axis] <
+                                m_centroids[rhs][axis];
+                       });
+      return mid;
+    };
+
+    if (depth >= sahDepthLimit) return medianSplit();
+
+    auto bestCost = std::numeric_limits<float>::max();
+    auto bestAxis = -1;
+    auto bestBin = size_t{0};
+
+    for (int axis = 0; axis < 3; ++axis) {
+      auto lo = centroidBounds.min[axis];
+      auto extent = centroidBounds.max[axis] - lo;
+      if (extent <= 0) continue;
+
+      auto binOf = [&](uint32_t item) {
+        auto bin = static_cast<size_t>((m_centroids[item][axis] - lo) *
+                                       (numBins / extent));
+        return std::min(bin, numBins - 1);
+      };
+
+      auto bins = std::array<Bin, numBins>{};
+      for (auto i = begin; i < end; ++i) {
+        auto& bin = bins[binOf(m_items[i])];
+        bin.bounds.extend(m_itemBounds[m_items[i]]);
+        ++bin.count;
+      }
+
+      // Sweep from the right to find the cost of every right side, then
+      // from the left to combine them with the left sides.
+      auto rightCosts = std::array<float, numBins>{};
+      auto right = Aabb{};
+      auto rightCount = uint32_t{0};
+      for (auto i = numBins - 1; i > 0; --i) {
+        right.extend(bins[i].bounds);
+        rightCount += bins[i].count;
+        rightCosts[i - 1] = rightCount * right.surfaceArea();
+      }
+
+      auto left = Aabb{};
+      auto leftCount = uint32_t{0};
+      for (size_t i = 0; i + 1 < numBins; ++i) {
+        left.extend(bins[i].bounds);
+        leftCount += bins[i].count;
+        if (leftCount == 0 || leftCount == count) continue;
+
+        auto cost = leftCount * left.surfaceArea() + rightCosts[i];
+        if (cost < bestCost) {
+          bestCost = cost;
+          bestAxis = axis;
+          bestBin = i;
+        }
+      }
+    }
+
+    if (bestAxis < 0) return count > maxLeafItems ? medianSplit() : end;
+
+    auto leafCost = count * bounds.surfaceArea();
+    if (bestCost >= leafCost && count <= maxLeafItems) return end;
+
+    auto lo = centroidBounds.min[bestAxis];
+    auto scale = numBins / (centroidBounds.max[bestAxis] - lo);
+    auto it = std::partition(
+        m_items.begin() + begin, m_items.begin() + end, [&](uint32_t item) {
+          auto bin = static_cast<size_t>((m_centroids[item][bestAxis] - lo) *
+                                         scale);
+          return std::min(bin, numBins - 1) <= bestBin;
+        });
+    return static_cast<uint32_t>(it - m_items.begin());
+  }
+
+  // Builds the subtree of a node whose slot already exists in nodes.
+  // With deferBelow set, smaller subtrees are left to the caller and
+  // collected in deferred instead.
+  void buildSubtree(std::vector<BvhNode>& nodes, BuildTask const& root,
+                    size_t deferBelow, std::vector<BuildTask>* pDeferred) {
+    auto pending = std::vector<BuildTask>{root};
+    while (!pending.empty()) {
+      auto task = pending.back();
+      pending.pop_back();
+
+      if (pDeferred && task.end - task.begin < deferBelow) {
+        pDeferred->push_back(task);
+        continue;
+      }
+
+      auto bounds = Aabb{};
+      auto mid = split(task.begin, task.end, task.depth, bounds);
+      nodes[task.node].bounds = bounds;
+
+      if (mid == task.end) {
+        nodes[task.node].first = task.begin;
+        nodes[task.node].count = task.end - task.begin;
+        continue;
+      }
+
+      auto left = static_cast<uint32_t>(nodes.size());
+      nodes.resize(nodes.size() + 2);
+      nodes[task.node].first = left;
+      nodes[task.node].count = 0;
+
+      pending.push_back({left + 1, mid, task.end, task.depth + 1});
+      pending.push_back({left, task.begin, mid, task.depth + 1});
+    }
+  }
+
+  // Visits every item of a subtree, without testing bounds.
+  template <typename Fn>
+  void forEachItemBelow(uint32_t node, Fn& fn) const {
+    auto stack = std::array<uint32_t, maxDepth + 1>{};
+    auto size = size_t{0};
+    stack[size++] = node;
+
+    while (size > 0) {
+      auto const& n = m_nodes[stack[--size]];
+      if (n.count > 0) {
+        for (auto i = n.first; i < n.first + n.count; ++i) fn(m_items[i]);
+      } else {
+        stack[size++] = n.first;
+        stack[size++] = n.first + 1;
+      }
+    }
+  }
+
+  // Distance along a ray to where it enters a box, or infinity if it
+  // misses the box within maxDistance.
+  static inline float rayBoxDistance(glm::vec3 const& origin,
+                                     glm::vec3 const& invDirection,
+                                     float maxDistance,
+                                     Aabb const& box) noexcept {
+    auto t0 = (box.min - origin) * invDirection;
+    auto t1 = (box.max - origin) * invDirection;
+    auto tMin = glm::min(t0, t1);
+    auto tMax = glm::max(t0, t1);
+
+    auto enter = std::max({tMin.x, tMin.y, tMin.z, 0.0f});
+    auto exit = std::min({tMax.x, tMax.y, tMax.z, maxDistance});
+    return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+  }
+
+ public:
+  // Builds the tree, spreading the subtrees across the worker pool once
+  // the top levels have been split.
+  void build(std::vector<Aabb> itemBounds,
+             WorkerPool& pool = sharedWorkerPool()) {
+    crashIf(itemBounds.size() > std::numeric_limits<uint32_t>::max());
+
+    m_itemBounds = std::move(itemBounds);
+    auto numItems = static_cast<uint32_t>(m_itemBounds.size());
+
+    m_items.resize(numItems);
+    std::iota(m_items.begin(), m_items.end(), 0);
+
+    m_centroids.resize(numItems);
+    pool.parallelFor(numItems, 4096, [&](size_t begin, size_t end) {
+      for (auto i = begin; i < end; ++i) {
+        m_centroids[i] = m_itemBounds[i].center();
+      }
+    });
+
+    m_nodes.clear();
+    if (numItems == 0) return;
+
+    auto deferBelow =
+        std::max(minParallelItems, numItems / (4 * pool.threadCount()));
+    auto deferred = std::vector<BuildTask>{};
+    m_nodes.resize(1);
+    buildSubtree(m_nodes, {0, 0, numItems, 0}, deferBelow, &deferred);
+
+    // Subtrees are built into separate node lists, rooted at index zero,
+    // as they work on disjoint ranges of items.
+    auto subtrees = std::vector<std::vector<BvhNode>>(deferred.size());
+    pool.parallelFor(deferred.size(), 1, [&](size_t begin, size_t end) {
+      for (auto i = begin; i < end; ++i) {
+        auto task = deferred[i];
+        task.node = 0;
+        subtrees[i].resize(1);
+        buildSubtree(subtrees[i], task, 0, nullptr);
+      }
+    });
+
+    // Append the subtrees, replacing their placeholder nodes with their
+    // roots. Every node but the root moves to base + index - 1.
+    for (size_t i = 0; i < subtrees.size(); ++i) {
+      auto const& subtree = subtrees[i];
+      auto base = static_cast<uint32_t>(m_nodes.size());
+      auto relocate = [&](BvhNode node) {
+        if (node.count == 0) node.first = base + node.first - 1;
+        return node;
+      };
+
+      m_nodes[deferred[i].node] = relocate(subtree[0]);
+      for (size_t j = 1; j < subtree.size(); ++j) {
+        m_nodes.push_back(relocate(subtree[j]));
+      }
+    }
+  }
+
+  // Changes the bounds of an item, taking effect on the next refit.
+  inline void setItemBounds(uint32_t item, Aabb const& bounds) {
+    m_itemBounds[item] = bounds;
+  }
+
+  // Recomputes the bounds of every node bottom up, keeping the tree's
+  // structure. Children are always stored after their parents.
+  void refit() {
+    for (auto i = m_nodes.size(); i-- > 0;) {
+      auto& node = m_nodes[i];
+      node.bounds = {};
+      if (node.count > 0) {
+        for (auto j = node.first; j < node.first + node.count; ++j) {
+          node.bounds.extend(m_itemBounds[m_items[j]]);
+        }
+      } else {
+        node.bounds.extend(m_nodes[node.first].bounds);
+        node.bounds.extend(m_nodes[node.first + 1].bounds);
+      }
+    }
+  }
+
+  // Calls fn(item) for every item whose bounds may intersect the
+  // frustum. Nodes entirely inside the frustum are not tested further.
+  template <typename Fn>
+  void forEachInFrustum(FrustumPlanes const& planes, Fn&& fn) const {
+    if (m_nodes.empty()) return;
+
+    auto stack = std::array<uint32_t, maxDepth + 1>{};
+    auto size = size_t{0};
+    stack[size++] = 0;
+
+    while (size > 0) {
+      auto index = stack[--size];
+      auto const& node = m_nodes[index];
+
+      auto isInside = true;
+      auto isOutside = false;
+      for (auto const& plane : planes) {
+        auto normal = glm::vec3(plane);
+        auto isPositive = glm::greaterThanEqual(normal, glm::vec3(0));
+        auto far = glm::mix(node.bounds.min, node.bounds.max, isPositive);
+        auto near = glm::mix(node.bounds.max, node.bounds.min, isPositive);
+
+        if (glm::dot(normal, far) + plane.w < 0) {
+          isOutside = true;
+          break;
+        }
+        if (glm::dot(normal, near) + plane.w < 0) isInside = false;
+      }
+
+      if (isOutside) continue;
+      if (isInside) {
+        forEachItemBelow(index, fn);
+      } else if (node.count > 0) {
+        for (auto i = node.first; i < node.first + node.count; ++i) {
+          fn(m_items[i]);
+        }
+      } else {
+        stack[size++] = node.first;
+        stack[size++] = node.first + 1;
+      }
+    }
+  }
+
+  // Finds the closest item hit by a ray, with hitTest(item) returning
+  // the distance to the item's actual geometry, or infinity on a miss.
+  // Children are visited closest first, skipping those further away
+  // than the closest hit found so far.
+  template <typename HitTest>
+  BvhRayHit raycast(glm::vec3 const& origin, glm::vec3 const& direction,
+                    float maxDistance, HitTest&& hitTest) const {
+    auto result = BvhRayHit{};
+    if (m_nodes.empty()) return result;
+
+    auto invDirection = 1.0f / direction;
+    auto closest = maxDistance;
+
+    auto stack = std::array<uint32_t, maxDepth + 1>{};
+    auto size = size_t{0};
+    if (rayBoxDistance(origin, invDirection, closest, m_nodes[0].bounds) <
+        std::numeric_limits<float>::infinity()) {
+      stack[size++] = 0;
+    }
+
+    while (size > 0) {
+      auto const& node = m_nodes[stack[--size]];
+      if (rayBoxDistance(origin, invDirection, closest, node.bounds) ==
+          std::numeric_limits<float>::infinity()) {
+        continue;
+      }
+
+      if (node.count > 0) {
+        for (auto i = node.first; i < node.first + node.count; ++i) {
+          auto item = m_items[i];
+          // Misses are reported as infinity, which must not count as
+          // hits when the maximum distance is infinite. Ties keep the
+          // item found first, but hits at maxDistance still count.
+          auto distance = hitTest(item);
+          if (!(distance < std::numeric_limits<float>::infinity())) continue;
+          if (distance < closest || (distance == closest && !result.hit)) {
+            closest = distance;
+            result = {true, item, distance};
+          }
+        }
+        continue;
+      }
+
+      auto near = node.first;
+      auto far = node.first + 1;
+      auto nearDistance =
+          rayBoxDistance(origin, invDirection, closest, m_nodes[near].bounds);
+      auto farDistance =
+          rayBoxDistance(origin, invDirection, closest, m_nodes[far].bounds);
+      if (farDistance < nearDistance) {
+        std::swap(near, far);
+        std::swap(nearDistance, farDistance);
+      }
+
+      if (farDistance < std::numeric_limits<float>::infinity()) {
+        stack[size++] = far;
+      }
+      if (nearDistance < std::numeric_limits<float>::infinity()) {
+        stack[size++] = near;
+      }
+    }
+    return result;
+  }
+
+  // Finds the closest item whose bounding box is hit by the ray, which
+  // suits picking.
+  inline BvhRayHit raycast(glm::vec3 const& origin, glm::vec3 const& direction,
+                           float maxDistance) const {
+    auto invDirection = 1.0f / direction;
+    return raycast(origin, direction, maxDistance, [&](uint32_t item) {
+      return rayBoxDistance(origin, invDirection, maxDistance,
+                            m_itemBounds[item]);
+    });
+  }
+
+  // Whether no item's bounding box lies between two points.
+  inline bool hasLineOfSight(glm::vec3 const& from,
+                             glm::vec3 const& to) const {
+    auto distance = glm::length(to - from);
+    if (distance == 0) return true;
+    return !raycast(from, (to - from) / distance, distance).hit;
+  }
+
+  inline size_t itemCount() const noexcept { return m_itemBounds.size(); }
+  inline size_t nodeCount() const noexcept { return m_nodes.size(); }
+
+  GETTER(nodes, m_nodes)
+  GETTER(itemBounds, m_itemBounds)
+};
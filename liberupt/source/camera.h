@@ -1,5 +1,6 @@
 #pragma once
 
+#include "bounding_volume.h"
 #include "common.h"
 
 #ifndef GLM_ENABLE_EXPERIMENTAL
@@ -51,6 +52,14 @@ class Camera2d {
                               -size.y / m_viewportHalfSize.y};
   }
 
+  // Packs the affine mapping performed by worldToNdcPoint,
+  // as ndc = world * xy + zw, for use inside shaders.
+  inline glm::vec4 worldToNdcTransform() const noexcept {
+    auto scale = m_zoom / m_viewportHalfSize;
+    return {scale.x, -scale.y, -m_position.x * scale.x - m_zoom,
+            m_position.y * scale.y + m_zoom};
+  }
+
   GETTER(position, m_position)
   GETTER(viewportSize, m_viewportSize)
   GETTER(zoom, m_zoom)
@@ -94,4 +103,8 @@ class Camera3d {
     return m_projection *
            glm::lookAtLH(m_position, m_position + m_direction, {0, 1, 0});
   }
+
+  inline FrustumPlanes frustumPlanes() const noexcept {
+    return extractFrustumPlanes(transform());
+  }
 };
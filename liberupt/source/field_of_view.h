@@ -0,0 +1,242 @@
+#pragma once
+
+#include "tilemap.h"
+#include "worker_pool.h"
+
+// Field of view of a single viewer on one tilemap layer, computed with
+// symmetric shadowcasting: a floor tile is visible from the origin
+// exactly when the origin is visible from it. Tiles outside the map
+// block sight. Visibility is kept as a bitset over the square of tiles
+// within the radius around the origin.
+//
+// The view is made up of four quadrants, each of which is only
+// recomputed once the viewer has moved, or a tile in or near the
+// quadrant was edited (see Tilemap::regionRevision).
+class FieldOfView {
+ private:
+  static constexpr size_t numQuadrants = 4;
+
+  // Exact rational slope, with a positive denominator.
+  struct Slope {
+    int64_t num;
+    int64_t den;
+  };
+
+  struct Row {
+    int64_t depth;
+    Slope start;
+    Slope end;
+  };
+
+  glm::u64vec3 m_origin;
+  int64_t m_radius;
+  int64_t m_side;
+
+  std::array<std::vector<uint64_t>, numQuadrants> m_quadrantBits;
+  std::array<uint64_t, numQuadrants> m_quadrantRevisions;
+  std::vector<uint64_t> m_bits;
+  bool m_isComputed;
+  size_t m_numRecomputedQuadrants;
+
+  static inline int64_t floorDiv(int64_t a, int64_t b) noexcept {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+  }
+
+  static inline int64_t ceilDiv(int64_t a, int64_t b) noexcept {
+    return -floorDiv(-a, b);
+  }
+
+  // Offset from the origin of the tile at the given depth and column
+  // of a quadrant, ordered north, east, south, west.
+  static inline glm::i64vec2 quadrantOffset(size_t quadrant, int64_t depth,
+                                            int64_t col) noexcept {
+    switch (quadrant) {
+      case 0:
+        return {col, -depth};
+      case 1:
+        return {depth, col};
+      case 2:
+        return {col, depth};
+      default:
+        return {-depth, col};
+    }
+  }
+
+  inline size_t bitIndex(glm::i64vec2 const& offset) const noexcept {
+    return static_cast<size_t>(offset.x + m_radius +
+                               (offset.y + m_radius) * m_side);
+  }
+
+  // Tiles covered by a quadrant, as [min, max) clamped to the map.
+  inline std::pair<glm::u64vec2, glm::u64vec2> quadrantRect(
+      size_t quadrant, glm::u64vec3 const& mapSize) const noexcept {
+    auto origin = glm::i64vec2(m_origin.x, m_origin.y);
+    auto min = origin - m_radius;
+    auto max = origin + m_radius + int64_t{1};
+
+    switch (quadrant) {
+      case 0:
+        max.y = origin.y + 1;
+        break;
+      case 1:
+        min.x = origin.x;
+        break;
+      case 2:
+        min.y = origin.y;
+        break;
+      default:
+        max.x = origin.x + 1;
+        break;
+    }
+
+    auto clampTo = glm::i64vec2(mapSize.x, mapSize.y);
+    min = glm::clamp(min, glm::i64vec2{0, 0}, clampTo);
+    max = glm::clamp(max, glm::i64vec2{0, 0}, clampTo);
+    return {glm::u64vec2(min), glm::u64vec2(max)};
+  }
+
+  template <typename TileType, typename IsOpaque>
+  void scanQuadrant(Tilemap<TileType> const& tilemap, size_t quadrant,
+                    IsOpaque& isOpaque) {
+    auto& bits = m_quadrantBits[quadrant];
+    std::fill(bits.begin(), bits.end(), 0);
+
+    auto mapSize = glm::i64vec2(tilemap.size().x, tilemap.size().y);
+    auto origin = glm::i64vec2(m_origin.x, m_origin.y);
+    auto readTile = typename Tilemap<TileType>::Storage::Reader(tilemap.tiles());
+
+    auto reveal = [&](glm::i64vec2 const& offset) {
+      auto index = bitIndex(offset);
+      bits[index / 64] |= uint64_t{1} << index % 64;
+    };
+
+    reveal({0, 0});
+
+    // Rows are scanned depth first, as in the recursive formulation,
+    // with an explicit stack in place of the call stack.
+    auto rows = std::vector<Row>{{1, {-1, 1}, {1, 1}}};
+    while (!rows.empty()) {
+      auto row = rows.back();
+      rows.pop_back();
+      if (row.depth > m_radius) continue;
+
+      // Columns whose centers lie inside the row's slopes, ties rounded
+      // outwards at the start and inwards at the end.
+      auto minCol = floorDiv(2 * row.depth * row.start.num + row.start.den,
+                             2 * row.start.den);
+      auto maxCol = ceilDiv(2 * row.depth * row.end.num - row.end.den,
+                            2 * row.end.den);
+
+      enum { None, Floor, Wall } previous = None;
+
+      for (auto col = minCol; col <= maxCol; ++col) {
+        auto offset = quadrantOffset(quadrant, row.depth, col);
+        auto tile = origin + offset;
+        auto inMap = tile.x >= 0 && tile.y >= 0 && tile.x < mapSize.x &&
+                     tile.y < mapSize.y;
+        auto isWall = !inMap || isOpaque(readTile(
+                                    {static_cast<uint64_t>(tile.x),
+                                     static_cast<uint64_t>(tile.y),
+                                     m_origin.z}));
+
+        auto isSymmetric = col * row.start.den >= row.depth * row.start.num &&
+                           col * row.end.den <= row.depth * row.end.num;
+        auto inRadius =
+            offset.x * offset.x + offset.y * offset.y <= m_radius * m_radius;
+
+        if (inMap && inRadius && (isWall || isSymmetric)) reveal(offset);
+
+        auto tileSlope = Slope{2 * col - 1, 2 * row.depth};
+        if (previous == Wall && !isWall) row.start = tileSlope;
+        if (previous == Floor && isWall) {
+          rows.push_back({row.depth + 1, row.start, tileSlope});
+        }
+        previous = isWall ? Wall : Floor;
+      }
+
+      if (previous == Floor) rows.push_back({row.depth + 1, row.start, row.end});
+    }
+  }
+
+ public:
+  inline FieldOfView(uint32_t radius)
+      : m_origin{0, 0, 0},
+        m_radius{radius},
+        m_side{2 * m_radius + 1},
+        m_quadrantRevisions{},
+        m_bits((m_side * m_side + 63) / 64),
+        m_isComputed{false},
+        m_numRecomputedQuadrants{0} {
+    for (auto& bits : m_quadrantBits) bits.resize(m_bits.size());
+  }
+
+  // Moves the viewer to a tile, with z selecting the layer.
+  inline void moveTo(glm::u64vec3 const& origin) noexcept {
+    if (origin != m_origin) {
+      m_origin = origin;
+      m_isComputed = false;
+    }
+  }
+
+  // Recomputes the quadrants affected by movement or tile edits since
+  // the last update. Returns whether the visibility may have changed.
+  template <typename TileType, typename IsOpaque>
+  bool update(Tilemap<TileType> const& tilemap, IsOpaque&& isOpaque) {
+    auto const& mapSize = tilemap.size();
+    crashIf(m_origin.x >= mapSize.x || m_origin.y >= mapSize.y ||
+            m_origin.z >= mapSize.z);
+
+    m_numRecomputedQuadrants = 0;
+    for (size_t quadrant = 0; quadrant < numQuadrants; ++quadrant) {
+      auto [min, max] = quadrantRect(quadrant, mapSize);
+      if (m_isComputed && tilemap.regionRevision(min, max, m_origin.z) <=
+                              m_quadrantRevisions[quadrant]) {
+        continue;
+      }
+
+      scanQuadrant(tilemap, quadrant, isOpaque);
+      m_quadrantRevisions[quadrant] = tilemap.revision();
+      ++m_numRecomputedQuadrants;
+    }
+    m_isComputed = true;
+
+    if (m_numRecomputedQuadrants == 0) return false;
+
+    for (size_t i = 0; i < m_bits.size(); ++i) {
+      m_bits[i] = m_quadrantBits[0][i] | m_quadrantBits[1][i] |
+                  m_quadrantBits[2][i] | m_quadrantBits[3][i];
+    }
+    return true;
+  }
+
+  inline bool isVisible(glm::u64vec2 const& tile) const noexcept {
+    auto offset = glm::i64vec2(tile) - glm::i64vec2(m_origin.x, m_origin.y);
+    if (std::abs(offset.x) > m_radius || std::abs(offset.y) > m_radius) {
+      return false;
+    }
+    auto index = bitIndex(offset);
+    return m_bits[index / 64] >> index % 64 & 1;
+  }
+
+  // Visibility of the (2 * radius + 1)^2 tiles centered on the origin,
+  // row by row, with the top left tile in the lowest bit of word zero.
+  GETTER(bits, m_bits)
+  GETTER(origin, m_origin)
+  GETTER(radius, m_radius)
+
+  // Quadrants recomputed by the last update, out of four.
+  GETTER(numRecomputedQuadrants, m_numRecomputedQuadrants)
+};
+
+// Updates many fields of view at once, spreading them across the
+// worker pool. The tilemap must not be modified meanwhile.
+template <typename TileType, typename IsOpaque>
+void updateFieldsOfView(Tilemap<TileType> const& tilemap,
+                        std::vector<FieldOfView>& fovs, IsOpaque&& isOpaque,
+                        WorkerPool& pool = sharedWorkerPool()) {
+  pool.parallelFor(fovs.size(), 4, [&](size_t begin, size_t end) {
+    for (auto i = begin; i < end; ++i) {
+      fovs[i].update(tilemap, isOpaque);
+    }
+  });
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <unordered_map>
+
+#include "common.h"
+
+// Number of global heap allocations performed by the process so far.
+// Only counts when the library is built with ERUPT_COUNT_ALLOCATIONS,
+// which replaces the global operator new (see allocation_counter.cc).
+// Otherwise, this always returns zero.
+size_t heapAllocationCount() noexcept;
+
+// Linear allocator for scratch data that lives no longer than one frame.
+// Allocating is a pointer bump and deallocating is a no-op; all memory
+// is reclaimed at once by reset(). Chunks are retained across resets,
+// so once the arena has grown to fit a typical frame, subsequent frames
+// do not touch the heap at all.
+class FrameArena {
+ private:
+  static constexpr size_t minChunkSize = 64 * 1024;
+
+  struct Chunk {
+    std::unique_ptr<std::byte[]> memory;
+    size_t size;
+  };
+
+  std::vector<Chunk> m_chunks;
+  size_t m_chunkIndex = 0;
+  size_t m_chunkOffset = 0;
+  size_t m_bytesUsed = 0;
+  size_t m_chunkAllocations = 0;
+
+  inline void appendChunk(size_t minBytes) {
+    auto size = std::max(
+        minBytes, m_chunks.empty() ? minChunkSize : 2 * m_chunks.back().size);
+    m_chunks.push_back({std::make_unique<std::byte[]>(size), size});
+    ++m_chunkAllocations;
+  }
+
+ public:
+  inline FrameArena(size_t initialBytes = minChunkSize) {
+    appendChunk(initialBytes);
+  }
+
+  FrameArena(FrameArena const&) = delete;
+  FrameArena& operator=(FrameArena const&) = delete;
+
+  inline void* allocate(size_t bytes, size_t alignment) {
+    while (true) {
+      auto& chunk = m_chunks[m_chunkIndex];
+      auto base = reinterpret_cast<uintptr_t>(chunk.memory.get());
+      auto aligned = (base + m_chunkOffset + alignment - 1) & ~(alignment - 1);
+      auto end = aligned - base + bytes;
+
+      if (end <= chunk.size) {
+        m_bytesUsed += end - m_chunkOffset;
+        m_chunkOffset = end;
+        return reinterpret_cast<void*>(aligned);
+      }
+
+      // Continue in the next retained chunk, or grow the arena.
+      if (m_chunkIndex + 1 == m_chunks.size()) {
+        appendChunk(bytes + alignment);
+      }
+      ++m_chunkIndex;
+      m_chunkOffset = 0;
+    }
+  }
+
+  // Releases all allocations at once. Objects placed inside the arena
+  // are not destroyed, so containers bound to it must be gone by now.
+  inline void reset() {
+    // If the last frame spilled into additional chunks, merge them into
+    // one chunk large enough to hold everything the next time around.
+    if (m_chunkIndex > 0) {
+      size_t total = 0;
+      for (auto const& chunk : m_chunks) total += chunk.size;
+      m_chunks.clear();
+      appendChunk(total);
+    }
+
+    m_chunkIndex = 0;
+    m_chunkOffset = 0;
+    m_bytesUsed = 0;
+  }
+
+  inline size_t capacity() const noexcept {
+    size_t total = 0;
+    for (auto const& chunk : m_chunks) total += chunk.size;
+    return total;
+  }
+
+  GETTER(bytesUsed, m_bytesUsed)
+  GETTER(chunkAllocations, m_chunkAllocations)
+};
+
+// Standard allocator handing out memory from a frame arena.
+// A default-constructed allocator is unbound and must be replaced
+// (by assigning a container bound to an arena) before it allocates.
+template <typename T>
+class ArenaAllocator {
+ private:
+  FrameArena* m_pArena;
+
+ public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  inline ArenaAllocator() noexcept : m_pArena(nullptr) {}
+  inline ArenaAllocator(FrameArena& arena) noexcept : m_pArena(&arena) {}
+
+  template <typename U>
+  inline ArenaAllocator(ArenaAllocator<U> const& other) noexcept
+      : m_pArena(other.arena()) {}
+
+  inline T* allocate(size_t count) {
+    crashIf(!m_pArena);
+    return static_cast<T*>(m_pArena->allocate(count * sizeof(T), alignof(T)));
+  }
+
+  inline void deallocate(T*, size_t) noexcept {}
+
+  inline FrameArena* arena() const noexcept { return m_pArena; }
+
+  template <typename U>
+  inline bool operator==(ArenaAllocator<U> const& other) const noexcept {
+    return m_pArena == other.arena();
+  }
+
+  template <typename U>
+  inline bool operator!=(ArenaAllocator<U> const& other) const noexcept {
+    return m_pArena != other.arena();
+  }
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+using ArenaHashMap =
+    std::unordered_map<Key, Value, Hash, std::equal_to<Key>,
+                       ArenaAllocator<std::pair<Key const, Value>>>;
+
+// Vector keeping its first N elements in inline storage. Once it
+// outgrows those, further storage is requested from its arena, which
+// makes it suitable for short, bounded lists built inside hot paths.
+// Restricted to trivially copyable elements, e.g. Vulkan handles.
+template <typename T, size_t N>
+class SmallVector {
+  static_assert(std::is_trivially_copyable_v<T>);
+
+ private:
+  alignas(T) std::byte m_inline[N * sizeof(T)];
+  T* m_pData;
+  size_t m_size;
+  size_t m_capacity;
+  FrameArena* m_pArena;
+
+  inline void grow(size_t minCapacity) {
+    crashIf(!m_pArena);
+    auto capacity = std::max(minCapacity, 2 * m_capacity);
+    auto pData = static_cast<T*>(
+        m_pArena->allocate(capacity * sizeof(T), alignof(T)));
+    std::memcpy(pData, m_pData, m_size * sizeof(T));
+    m_pData = pData;
+    m_capacity = capacity;
+  }
+
+ public:
+  using value_type = T;
+
+  inline SmallVector(FrameArena* pArena = nullptr) noexcept
+      : m_pData(reinterpret_cast<T*>(m_inline)),
+        m_size(0),
+        m_capacity(N),
+        m_pArena(pArena) {}
+
+  inline SmallVector(std::initializer_list<T> elems,
+                     FrameArena* pArena = nullptr)
+      : SmallVector(pArena) {
+    for (auto const& elem : elems) push_back(elem);
+  }
+
+  SmallVector(SmallVector const&) = delete;
+  SmallVector& operator=(SmallVector const&) = delete;
+
+  inline void push_back(T const& elem) {
+    if (m_size == m_capacity) grow(m_size + 1);
+    m_pData[m_size++] = elem;
+  }
+
+  inline void resize(size_t size, T const& value = {}) {
+    if (size > m_capacity) grow(size);
+    for (auto i = m_size; i < size; ++i) m_pData[i] = value;
+    m_size = size;
+  }
+
+  inline void clear() noexcept { m_size = 0; }
+
+  inline T& operator[](size_t i) noexcept { return m_pData[i]; }
+  inline T const& operator[](size_t i) const noexcept { return m_pData[i]; }
+  inline T& back() noexcept { return m_pData[m_size - 1]; }
+
+  inline T* data() noexcept { return m_pData; }
+  inline T const* data() const noexcept { return m_pData; }
+  inline T* begin() noexcept { return m_pData; }
+  inline T* end() noexcept { return m_pData + m_size; }
+  inline T const* begin() const noexcept { return m_pData; }
+  inline T const* end() const noexcept { return m_pData + m_size; }
+
+  inline size_t size() const noexcept { return m_size; }
+  inline bool empty() const noexcept { return m_size == 0; }
+};
@@ -1,7 +1,12 @@
 #pragma once
 
 #include <bitset>
+#include <optional>
 
+#include "bounding_volume.h"
+#include "mesh_file.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
 #include "vulkan_context.h"
 
 class Mesh {
@@ -12,51 +17,199 @@ class Mesh {
 
   std::vector<VPositionColorTexcoord> m_vertices;
   std::vector<index_type> m_indices;
+  std::vector<MeshLod> m_lods;
 
   VulkanBufferInfo m_vbufInfo;
   VulkanBufferInfo m_ibufInfo;
+  VkIndexType m_indexType;
+
+  bool m_allowPacking;
+  VertexLayout m_vertexLayout;
+  glm::mat4 m_positionDequantization;
+
+  Aabb m_boundingBox;
+  BoundingSphere m_boundingSphere;
+
+  uint16_t m_sortId;
 
  private:
-  inline void destroyVertexBuffer() {
-    if (m_vbufInfo.buffer) {
-      m_vulkanContext.flush();
-      m_vulkanContext.destroyBuffer(m_vbufInfo);
+  // Centers the sphere on the box, and fits its radius to the vertex
+  // furthest away, which is tighter than the box's half diagonal.
+  inline void computeBounds() {
+    m_boundingBox = {};
+    for (auto const& vertex : m_vertices) {
+      m_boundingBox.extend(vertex.position);
+    }
+
+    m_boundingSphere = {};
+    if (m_boundingBox.isEmpty()) return;
+
+    auto center = m_boundingBox.center();
+    auto radiusSquared = 0.0f;
+    for (auto const& vertex : m_vertices) {
+      auto offset = vertex.position - center;
+      radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    m_boundingSphere = {center, std::sqrt(radiusSquared)};
+  }
+
+  // Buffers are rewritten in place while large enough, so frequently
+  // rebuilt meshes, e.g. tilemap chunks, keep theirs. Either way, the
+  // upload joins the current frame's, if any, without waiting.
+  inline void writeVertexBuffer(void const* data, size_t bytes) {
+    m_vulkanContext.replaceBufferData(
+        m_vbufInfo, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, data, bytes);
+  }
+
+  inline void writeIndexBuffer(void const* data, size_t bytes) {
+    m_vulkanContext.replaceBufferData(
+        m_ibufInfo, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, data, bytes);
+  }
+
+  // Uploads the vertices in the packed layout if allowed and close
+  // enough, given their bounds are up to date, or else as they are.
+  inline void uploadVertices() {
+    auto packed = m_allowPacking ? packVertices(m_vertices, m_boundingBox)
+                                 : std::nullopt;
+    if (packed) {
+      m_vertexLayout = VertexLayout::Packed;
+      m_positionDequantization = packed->positionDequantization;
+      writeVertexBuffer(packed->vertices.data(),
+                        packed->vertices.size() *
+                            sizeof(VPackedPositionColorTexcoord));
+    } else {
+      m_vertexLayout = VertexLayout::Float;
+      m_positionDequantization = glm::mat4{1};
+      writeVertexBuffer(m_vertices.data(),
+                        m_vertices.size() * sizeof(VPositionColorTexcoord));
     }
   }
 
-  inline void destroyIndexBuffer() {
-    if (m_ibufInfo.buffer) {
-      m_vulkanContext.flush();
-      m_vulkanContext.destroyBuffer(m_ibufInfo);
+  // Indices are uploaded as 16 bits when they all fit, halving the
+  // index buffer.
+  inline void uploadIndices() {
+    auto maxIndex = std::max_element(m_indices.begin(), m_indices.end());
+    if (maxIndex == m_indices.end() ||
+        *maxIndex <= std::numeric_limits<uint16_t>::max()) {
+      m_indexType = VK_INDEX_TYPE_UINT16;
+      auto narrow = std::vector<uint16_t>(m_indices.begin(), m_indices.end());
+      writeIndexBuffer(narrow.data(), narrow.size() * sizeof(uint16_t));
+    } else {
+      m_indexType = VK_INDEX_TYPE_UINT32;
+      writeIndexBuffer(m_indices.data(), m_indices.size() * sizeof(index_type));
     }
   }
 
  public:
-  inline Mesh(VulkanContext& vulkanContext)
+  // With packing allowed, vertices are uploaded in the packed layout
+  // whenever it represents them closely enough, so only meshes drawn by
+  // pipelines accepting both layouts may allow it.
+  inline Mesh(VulkanContext& vulkanContext, bool allowPacking = false)
       : m_vulkanContext{vulkanContext},
         m_vertices{},
         m_indices{},
         m_vbufInfo{},
-        m_ibufInfo{} {}
+        m_ibufInfo{},
+        m_indexType{VK_INDEX_TYPE_UINT32},
+        m_allowPacking{allowPacking},
+        m_vertexLayout{VertexLayout::Float},
+        m_positionDequantization{1},
+        m_sortId{vulkanContext.allocateSortId()} {}
 
+  // Buffers are retired rather than destroyed, so meshes may go away
+  // while frames drawing them are still in flight.
   inline ~Mesh() {
-    destroyVertexBuffer();
-    destroyIndexBuffer();
+    m_vulkanContext.retireBuffer(m_vbufInfo);
+    m_vulkanContext.retireBuffer(m_ibufInfo);
   }
 
+  // Copies of the vertices and of the indices of every level of detail,
+  // one after another. Empty for meshes loaded from files without them.
   GETTER(vertices, m_vertices)
   GETTER(indices, m_indices)
 
+  // Ranges of the index buffer holding each level of detail, from full
+  // to least detail. Empty for meshes without indices.
+  GETTER(lods, m_lods)
+
+  // Bounds of the vertex positions, updated by setVertices and
+  // loadFile.
+  GETTER(boundingBox, m_boundingBox)
+  GETTER(boundingSphere, m_boundingSphere)
+
   inline void setVertices(std::vector<VPositionColorTexcoord> vertices) {
-    destroyVertexBuffer();
     m_vertices = std::move(vertices);
-    m_vbufInfo = m_vulkanContext.createVertexBuffer(m_vertices);
+    computeBounds();
+    uploadVertices();
+  }
+
+  // Replaces the vertices, indices and levels of detail with those of a
+  // mesh file, uploaded straight from the file's mapping. Packed vertices
+  // are only unpacked first if packing is not allowed. Copies of the
+  // vertices and indices are only kept when asked for, e.g. to generate
+  // levels of detail or to add the mesh to a StaticScene, and those of
+  // packed vertices lack the precision lost packing them.
+  inline void loadFile(MeshFile const& file, bool keepCopies = false) {
+    auto const& header = file.header();
+    m_boundingBox = file.boundingBox();
+    m_boundingSphere = file.boundingSphere();
+
+    auto mustUnpack =
+        file.vertexLayout() == VertexLayout::Packed && !m_allowPacking;
+    m_vertices = keepCopies || mustUnpack
+                     ? file.vertices()
+                     : std::vector<VPositionColorTexcoord>{};
+    if (mustUnpack) {
+      m_vertexLayout = VertexLayout::Float;
+      m_positionDequantization = glm::mat4{1};
+      writeVertexBuffer(m_vertices.data(),
+                        m_vertices.size() * sizeof(VPositionColorTexcoord));
+    } else {
+      m_vertexLayout = file.vertexLayout();
+      m_positionDequantization = file.positionDequantization();
+      writeVertexBuffer(file.vertexData(),
+                        size_t{header.vertexCount} * header.vertexBytes);
+    }
+
+    m_lods.assign(file.lods().begin(), file.lods().end());
+    m_indexType = header.indexBytes == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16
+                                                        : VK_INDEX_TYPE_UINT32;
+    writeIndexBuffer(file.indexData(),
+                     size_t{header.indexCount} * header.indexBytes);
+
+    if (!keepCopies) m_vertices = {};
+    m_indices = keepCopies ? file.indices() : std::vector<index_type>{};
   }
 
+  // Replaces the indices, leaving a single level of detail.
   inline void setIndices(std::vector<index_type> indices) {
-    destroyIndexBuffer();
     m_indices = std::move(indices);
-    m_ibufInfo = m_vulkanContext.createIndexBuffer(m_indices);
+    m_lods = {{0, static_cast<uint32_t>(m_indices.size()), 0.0f}};
+    uploadIndices();
+  }
+
+  // Appends simplified versions of the full detail indices to the index
+  // buffer, each with about half the triangles of the one before. The
+  // error of every level, which bounds how far it deviates from the full
+  // detail surface, stays within maxError, though fewer levels may fit.
+  // Needs the copies of the vertices and indices.
+  inline void generateLods(size_t maxLevels = 4, float maxError = 1.0f) {
+    crashIf(m_lods.empty() || m_indices.size() < m_lods.front().indexCount);
+    m_indices.resize(m_lods.front().indexCount);
+    m_lods = buildLodChain(m_vertices, m_indices, maxLevels, 0.5f, maxError);
+    uploadIndices();
+  }
+
+  // Welds identical vertices of a triangle list into an index buffer,
+  // and orders both for the vertex cache and vertex fetch.
+  inline MeshOptimizationReport setOptimizedVertices(
+      std::vector<VPositionColorTexcoord> vertices) {
+    crashIf(vertices.size() % 3 != 0);
+    auto indices = std::vector<index_type>{};
+    auto report = optimizeMesh(vertices, indices);
+    setVertices(std::move(vertices));
+    setIndices(std::move(indices));
+    return report;
   }
 
   // The constness of these are questionable, since we are returning
@@ -66,4 +219,14 @@ class Mesh {
 
   GETTER(vulkanVertexBuffer, m_vbufInfo)
   GETTER(vulkanIndexBuffer, m_ibufInfo)
+  GETTER(indexType, m_indexType)
+  GETTER(vertexLayout, m_vertexLayout)
+
+  // Maps positions as stored in the vertex buffer back to the mesh's
+  // space, to be applied before the model matrix. Identity unless the
+  // vertices are packed.
+  GETTER(positionDequantization, m_positionDequantization)
+
+  // Tells meshes apart when sorting draws.
+  GETTER(sortId, m_sortId)
 };
\ No newline at end of file
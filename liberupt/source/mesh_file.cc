@@ -0,0 +1,173 @@
+#include "mesh_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fstream>
+
+MeshFile::MeshFile(std::string const& path)
+    : m_pData(nullptr), m_bytes(0), m_pHeader(nullptr) {
+  auto fd = open(path.c_str(), O_RDONLY);
+  crashIf(fd < 0);
+
+  struct stat info;
+  crashIf(fstat(fd, &info) != 0);
+  m_bytes = static_cast<size_t>(info.st_size);
+  crashIf(m_bytes < sizeof(MeshFileHeader));
+
+  // The mapping stays valid after the descriptor has been closed.
+  auto pMapped = mmap(nullptr, m_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  crashIf(pMapped == MAP_FAILED);
+
+  // Every array is read once, front to back, while uploading.
+  madvise(pMapped, m_bytes, MADV_SEQUENTIAL);
+  m_pData = static_cast<std::byte const*>(pMapped);
+
+  m_pHeader = reinterpret_cast<MeshFileHeader const*>(m_pData);
+  auto const& header = *m_pHeader;
+  crashIf(header.magic != MeshFileHeader::magicValue ||
+          header.version != MeshFileHeader::currentVersion);
+  crashIf(header.indexBytes != sizeof(uint16_t) &&
+          header.indexBytes != sizeof(uint32_t));
+  crashIf(header.vertexBytes != (header.vertexLayout == VertexLayout::Packed
+                                     ? sizeof(VPackedPositionColorTexcoord)
+                                     : sizeof(VPositionColorTexcoord)));
+
+  auto isValidArray = [&](uint64_t offset, uint64_t count, uint64_t size) {
+    return offset % MeshFileHeader::arrayAlignment == 0 && offset <= m_bytes &&
+           count <= (m_bytes - offset) / size;
+  };
+  crashIf(!isValidArray(header.lodsOffset, header.lodCount, sizeof(MeshLod)));
+  crashIf(!isValidArray(header.verticesOffset, header.vertexCount,
+                        header.vertexBytes));
+  crashIf(!isValidArray(header.indicesOffset, header.indexCount,
+                        header.indexBytes));
+
+  for (auto const& lod : lods()) {
+    crashIf(lod.firstIndex > header.indexCount ||
+            lod.indexCount > header.indexCount - lod.firstIndex);
+  }
+}
+
+MeshFile::~MeshFile() { munmap(const_cast<std::byte*>(m_pData), m_bytes); }
+
+bool MeshFile::isCurrent(std::string const& path) {
+  auto file = std::ifstream(path, std::ios::binary);
+  auto header = MeshFileHeader{};
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  return file && header.magic == MeshFileHeader::magicValue &&
+         header.version == MeshFileHeader::currentVersion;
+}
+
+std::vector<VPositionColorTexcoord> MeshFile::vertices() const {
+  auto count = m_pHeader->vertexCount;
+  if (m_pHeader->vertexLayout == VertexLayout::Packed) {
+    return unpackVertices(
+        {reinterpret_cast<VPackedPositionColorTexcoord const*>(vertexData()),
+         count},
+        positionDequantization());
+  }
+  auto vertices = std::vector<VPositionColorTexcoord>(count);
+  std::memcpy(vertices.data(), vertexData(),
+              count * sizeof(VPositionColorTexcoord));
+  return vertices;
+}
+
+std::vector<uint32_t> MeshFile::indices() const {
+  auto count = m_pHeader->indexCount;
+  auto indices = std::vector<uint32_t>(count);
+  if (m_pHeader->indexBytes == sizeof(uint32_t)) {
+    std::memcpy(indices.data(), indexData(), count * sizeof(uint32_t));
+  } else {
+    auto const* pNarrow = reinterpret_cast<uint16_t const*>(indexData());
+    std::copy(pNarrow, pNarrow + count, indices.begin());
+  }
+  for (auto index : indices) crashIf(index >= m_pHeader->vertexCount);
+  return indices;
+}
+
+void saveMeshFile(std::string const& path,
+                  std::vector<VPositionColorTexcoord> const& vertices,
+                  std::vector<uint32_t> const& indices,
+                  std::vector<MeshLod> const& lods, Aabb const& boundingBox,
+                  BoundingSphere const& boundingSphere) {
+  crashIf(vertices.size() > std::numeric_limits<uint32_t>::max() ||
+          indices.size() > std::numeric_limits<uint32_t>::max());
+
+  auto maxIndex = std::max_element(indices.begin(), indices.end());
+  auto isNarrow = maxIndex == indices.end() ||
+                  *maxIndex <= std::numeric_limits<uint16_t>::max();
+  auto indexBytes = isNarrow ? sizeof(uint16_t) : sizeof(uint32_t);
+
+  auto packed = packVertices(vertices, boundingBox);
+  auto vertexLayout = packed ? VertexLayout::Packed : VertexLayout::Float;
+  auto vertexBytes = packed ? sizeof(VPackedPositionColorTexcoord)
+                            : sizeof(VPositionColorTexcoord);
+  auto positionScale = glm::vec3{1, 1, 1};
+  auto positionOffset = glm::vec3{0, 0, 0};
+  if (packed) {
+    auto const& dequantization = packed->positionDequantization;
+    for (int axis = 0; axis < 3; ++axis) {
+      positionScale[axis] = dequantization[axis][axis];
+    }
+    positionOffset = glm::vec3(dequantization[3]);
+  }
+
+  auto align = [](uint64_t offset) {
+    constexpr auto alignment = MeshFileHeader::arrayAlignment;
+    return (offset + alignment - 1) / alignment * alignment;
+  };
+  auto lodsOffset = align(sizeof(MeshFileHeader));
+  auto verticesOffset = align(lodsOffset + lods.size() * sizeof(MeshLod));
+  auto indicesOffset = align(verticesOffset + vertices.size() * vertexBytes);
+
+  auto const& box = boundingBox;
+  auto const& sphere = boundingSphere;
+  auto header = MeshFileHeader{MeshFileHeader::magicValue,
+                               MeshFileHeader::currentVersion,
+                               static_cast<uint32_t>(vertices.size()),
+                               static_cast<uint32_t>(vertexBytes),
+                               vertexLayout,
+                               static_cast<uint32_t>(indices.size()),
+                               static_cast<uint32_t>(indexBytes),
+                               static_cast<uint32_t>(lods.size()),
+                               {box.min.x, box.min.y, box.min.z},
+                               {box.max.x, box.max.y, box.max.z},
+                               {sphere.center.x, sphere.center.y,
+                                sphere.center.z},
+                               sphere.radius,
+                               {positionScale.x, positionScale.y,
+                                positionScale.z},
+                               {positionOffset.x, positionOffset.y,
+                                positionOffset.z},
+                               lodsOffset,
+                               verticesOffset,
+                               indicesOffset};
+
+  auto file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+  crashIf(!file);
+
+  auto write = [&](uint64_t offset, void const* data, size_t bytes) {
+    static constexpr char padding[MeshFileHeader::arrayAlignment] = {};
+    file.write(padding, offset - static_cast<uint64_t>(file.tellp()));
+    file.write(static_cast<char const*>(data), bytes);
+  };
+  write(0, &header, sizeof(header));
+  write(lodsOffset, lods.data(), lods.size() * sizeof(MeshLod));
+  if (packed) {
+    write(verticesOffset, packed->vertices.data(),
+          packed->vertices.size() * vertexBytes);
+  } else {
+    write(verticesOffset, vertices.data(), vertices.size() * vertexBytes);
+  }
+  if (isNarrow) {
+    auto narrow = std::vector<uint16_t>(indices.begin(), indices.end());
+    write(indicesOffset, narrow.data(), narrow.size() * sizeof(uint16_t));
+  } else {
+    write(indicesOffset, indices.data(), indices.size() * sizeof(uint32_t));
+  }
+  crashIf(!file);
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <span>
+
+#include "bounding_volume.h"
+#include "mesh_packing.h"
+#include "mesh_simplifier.h"
+
+// Mesh files hold meshes ready for upload: welded, optimized for the
+// vertex cache and vertex fetch, with their levels of detail and bounds
+// precomputed. They are laid out as follows, in native byte order, with
+// every array starting at a multiple of arrayAlignment bytes:
+//
+//   MeshFileHeader
+//   MeshLod lods[lodCount]
+//   VPackedPositionColorTexcoord or VPositionColorTexcoord
+//       vertices[vertexCount]
+//   uint16_t or uint32_t indices[indexCount]   (of every level of detail)
+//
+// Vertices are packed whenever they lose little enough precision, and
+// indices take 16 bits whenever they all fit, as uploaded by Mesh.
+struct MeshFileHeader {
+  static constexpr uint32_t magicValue = 0x534d5245;  // "ERMS"
+  static constexpr uint32_t currentVersion = 2;
+  static constexpr uint64_t arrayAlignment = 16;
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vertexCount;
+  uint32_t vertexBytes;
+  VertexLayout vertexLayout;
+  uint32_t indexCount;
+  uint32_t indexBytes;
+  uint32_t lodCount;
+  float boxMin[3];
+  float boxMax[3];
+  float sphereCenter[3];
+  float sphereRadius;
+
+  // Of packed vertices, see Mesh::positionDequantization.
+  float positionScale[3];
+  float positionOffset[3];
+
+  uint64_t lodsOffset;
+  uint64_t verticesOffset;
+  uint64_t indicesOffset;
+};
+
+static_assert(std::is_trivially_copyable_v<MeshLod> &&
+              sizeof(MeshLod) == 3 * sizeof(uint32_t));
+static_assert(std::is_trivially_copyable_v<VPositionColorTexcoord> &&
+              sizeof(VPositionColorTexcoord) == 8 * sizeof(float));
+static_assert(std::is_trivially_copyable_v<VPackedPositionColorTexcoord>);
+
+// Read-only view of a mesh file, which is memory-mapped rather than
+// read, so its arrays can be uploaded straight from the mapping.
+class MeshFile {
+ private:
+  std::byte const* m_pData;
+  size_t m_bytes;
+
+  MeshFileHeader const* m_pHeader;
+
+ public:
+  MeshFile(std::string const& path);
+  ~MeshFile();
+
+  MeshFile(MeshFile const&) = delete;
+  MeshFile& operator=(MeshFile const&) = delete;
+
+  // Whether a file exists at the path and has the current version.
+  static bool isCurrent(std::string const& path);
+
+  inline MeshFileHeader const& header() const noexcept { return *m_pHeader; }
+
+  inline size_t bytes() const noexcept { return m_bytes; }
+
+  inline std::span<MeshLod const> lods() const noexcept {
+    return {reinterpret_cast<MeshLod const*>(m_pData + m_pHeader->lodsOffset),
+            m_pHeader->lodCount};
+  }
+
+  inline VertexLayout vertexLayout() const noexcept {
+    return m_pHeader->vertexLayout;
+  }
+
+  // Vertices as stored, header().vertexBytes each, in vertexLayout().
+  inline std::byte const* vertexData() const noexcept {
+    return m_pData + m_pHeader->verticesOffset;
+  }
+
+  // Identity unless the vertices are packed.
+  inline glm::mat4 positionDequantization() const noexcept {
+    auto const& header = *m_pHeader;
+    if (header.vertexLayout != VertexLayout::Packed) return glm::mat4{1};
+    return boxDequantization(
+        {header.positionOffset[0], header.positionOffset[1],
+         header.positionOffset[2]},
+        {header.positionScale[0], header.positionScale[1],
+         header.positionScale[2]});
+  }
+
+  // Copies of the vertices, unpacked if need be.
+  std::vector<VPositionColorTexcoord> vertices() const;
+
+  // Indices as stored, header().indexBytes each.
+  inline std::byte const* indexData() const noexcept {
+    return m_pData + m_pHeader->indicesOffset;
+  }
+
+  std::vector<uint32_t> indices() const;
+
+  inline Aabb boundingBox() const noexcept {
+    auto const& header = *m_pHeader;
+    return {{header.boxMin[0], header.boxMin[1], header.boxMin[2]},
+            {header.boxMax[0], header.boxMax[1], header.boxMax[2]}};
+  }
+
+  inline BoundingSphere boundingSphere() const noexcept {
+    auto const& header = *m_pHeader;
+    return {{header.sphereCenter[0], header.sphereCenter[1],
+             header.sphereCenter[2]},
+            header.sphereRadius};
+  }
+};
+
+// Writes an indexed mesh along with its levels of detail, as ranges of
+// the indices, and its bounds. Vertices are packed against the bounding
+// box if packVertices allows.
+void saveMeshFile(std::string const& path,
+                  std::vector<VPositionColorTexcoord> const& vertices,
+                  std::vector<uint32_t> const& indices,
+                  std::vector<MeshLod> const& lods, Aabb const& boundingBox,
+                  BoundingSphere const& boundingSphere);
@@ -0,0 +1,834 @@
+#include "mesh_import.h"
+
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <numeric>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+std::string readFile(std::string const& path) {
+  auto file = std::ifstream(path, std::ios::binary | std::ios::ate);
+  crashIf(!file);
+
+  auto bytes = static_cast<size_t>(file.tellg());
+  auto data = std::string(bytes, '\0');
+  file.seekg(0);
+  file.read(data.data(), static_cast<std::streamsize>(bytes));
+  crashIf(!file);
+  return data;
+}
+
+std::string_view extensionOf(std::string_view path) {
+  auto dot = path.find_last_of('.');
+  auto slash = path.find_last_of("/\\");
+  if (dot == path.npos || (slash != path.npos && dot < slash)) return {};
+  return path.substr(dot);
+}
+
+// Splits a line of text into tokens separated by spaces.
+struct LineReader {
+  char const* p;
+  char const* end;
+
+  inline std::string_view token() noexcept {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) ++p;
+    auto begin = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\r') ++p;
+    return {begin, static_cast<size_t>(p - begin)};
+  }
+
+  // Reads the next token as a number, unless the line has ended.
+  inline bool number(float& value) {
+    auto text = token();
+    if (text.empty()) return false;
+
+    // Copied, as strtof needs the number to end within the string.
+    char buffer[64];
+    crashIf(text.size() >= sizeof(buffer));
+    text.copy(buffer, text.size());
+    buffer[text.size()] = '\0';
+
+    char* pEnd;
+    value = std::strtof(buffer, &pEnd);
+    crashIf(pEnd != buffer + text.size());
+    return true;
+  }
+};
+
+// Indices into one of the lists of an OBJ file count from one, or back
+// from the end of the list when negative.
+size_t objIndex(std::string_view text, size_t listSize) {
+  auto index = int64_t{0};
+  auto [pEnd, error] =
+      std::from_chars(text.data(), text.data() + text.size(), index);
+  crashIf(error != std::errc{} || pEnd != text.data() + text.size());
+
+  auto resolved = index < 0 ? static_cast<int64_t>(listSize) + index
+                            : index - 1;
+  crashIf(index == 0 || resolved < 0 ||
+          resolved >= static_cast<int64_t>(listSize));
+  return static_cast<size_t>(resolved);
+}
+
+// Just enough JSON for glTF. Objects keep their members in order, and
+// are searched linearly, as glTF objects are small.
+struct Json {
+  enum class Type { Null, Boolean, Number, String, Array, Object };
+
+  Type type = Type::Null;
+  bool boolean = false;
+  double number = 0;
+  std::string string;
+
+  // Elements of arrays, and values of objects, named by keys.
+  std::vector<Json> values;
+  std::vector<std::string> keys;
+
+  inline Json const* find(std::string_view key) const noexcept {
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (keys[i] == key) return &values[i];
+    }
+    return nullptr;
+  }
+
+  inline Json const& operator[](std::string_view key) const {
+    auto pValue = find(key);
+    crashIf(!pValue);
+    return *pValue;
+  }
+
+  inline Json const& operator[](size_t index) const {
+    crashIf(type != Type::Array || index >= values.size());
+    return values[index];
+  }
+
+  inline double numberOr(std::string_view key, double fallback) const {
+    auto pValue = find(key);
+    if (!pValue) return fallback;
+    crashIf(pValue->type != Type::Number);
+    return pValue->number;
+  }
+
+  // Non-negative integers, as used for indices and sizes.
+  inline size_t index() const {
+    crashIf(type != Type::Number || number < 0 || number != std::floor(number));
+    return static_cast<size_t>(number);
+  }
+};
+
+class JsonParser {
+ private:
+  // Deeper nesting is rejected instead of overflowing the stack.
+  static constexpr int maxDepth = 128;
+
+  char const* m_p;
+  char const* m_end;
+
+  inline void skipWhitespace() noexcept {
+    while (m_p < m_end &&
+           (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r')) {
+      ++m_p;
+    }
+  }
+
+  inline bool consume(char c) noexcept {
+    skipWhitespace();
+    if (m_p == m_end || *m_p != c) return false;
+    ++m_p;
+    return true;
+  }
+
+  inline void expect(char c) { crashIf(!consume(c)); }
+
+  inline bool consumeWord(std::string_view word) noexcept {
+    if (static_cast<size_t>(m_end - m_p) < word.size() ||
+        std::string_view(m_p, word.size()) != word) {
+      return false;
+    }
+    m_p += word.size();
+    return true;
+  }
+
+  void appendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+      out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+      out += static_cast<char>(0xc0 | codePoint >> 6);
+      out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else if (codePoint < 0x10000) {
+      out += static_cast<char>(0xe0 | codePoint >> 12);
+      out += static_cast<char>(0x80 | (codePoint >> 6 & 0x3f));
+      out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    } else {
+      out += static_cast<char>(0xf0 | codePoint >> 18);
+      out += static_cast<char>(0x80 | (codePoint >> 12 & 0x3f));
+      out += static_cast<char>(0x80 | (codePoint >> 6 & 0x3f));
+      out += static_cast<char>(0x80 | (codePoint & 0x3f));
+    }
+  }
+
+  uint32_t parseHex4() {
+    crashIf(m_end - m_p < 4);
+    auto value = uint32_t{0};
+    auto [pEnd, error] = std::from_chars(m_p, m_p + 4, value, 16);
+    crashIf(error != std::errc{} || pEnd != m_p + 4);
+    m_p += 4;
+    return value;
+  }
+
+  std::string parseString() {
+    expect('"');
+    auto out = std::string{};
+    while (true) {
+      crashIf(m_p == m_end);
+      auto c = *m_p++;
+      if (c == '"') return out;
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+
+      crashIf(m_p == m_end);
+      switch (c = *m_p++) {
+        case '"':
+        case '\\':
+        case '/':
+          out += c;
+          break;
+        case 'b':
+          out += '\b';
+          break;
+        case 'f':
+          out += '\f';
+          break;
+        case 'n':
+          out += '\n';
+          break;
+        case 'r':
+          out += '\r';
+          break;
+        case 't':
+          out += '\t';
+          break;
+        case 'u': {
+          auto codePoint = parseHex4();
+          if (codePoint >= 0xd800 && codePoint < 0xdc00 && consumeWord("\\u")) {
+            auto low = parseHex4();
+            crashIf(low < 0xdc00 || low >= 0xe000);
+            codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+          }
+          appendUtf8(out, codePoint);
+          break;
+        }
+        default:
+          crashIf(true);
+      }
+    }
+  }
+
+  Json parseValue(int depth) {
+    crashIf(depth > maxDepth);
+    skipWhitespace();
+    crashIf(m_p == m_end);
+
+    auto value = Json{};
+    if (*m_p == '{') {
+      ++m_p;
+      value.type = Json::Type::Object;
+      if (consume('}')) return value;
+      do {
+        skipWhitespace();
+        value.keys.push_back(parseString());
+        expect(':');
+        value.values.push_back(parseValue(depth + 1));
+      } while (consume(','));
+      expect('}');
+    } else if (*m_p == '[') {
+      ++m_p;
+      value.type = Json::Type::Array;
+      if (consume(']')) return value;
+      do {
+        value.values.push_back(parseValue(depth + 1));
+      } while (consume(','));
+      expect(']');
+    } else if (*m_p == '"') {
+      value.type = Json::Type::String;
+      value.string = parseString();
+    } else if (consumeWord("true")) {
+      value.type = Json::Type::Boolean;
+      value.boolean = true;
+    } else if (consumeWord("false")) {
+      value.type = Json::Type::Boolean;
+    } else if (consumeWord("null")) {
+      value.type = Json::Type::Null;
+    } else {
+      // Copied, as strtod needs the number to end within the string.
+      auto length = size_t{0};
+      while (m_p + length < m_end &&
+             std::string_view("+-.0123456789eE").find(m_p[length]) !=
+                 std::string_view::npos) {
+        ++length;
+      }
+      auto text = std::string(m_p, length);
+      char* pEnd;
+      value.type = Json::Type::Number;
+      value.number = std::strtod(text.c_str(), &pEnd);
+      crashIf(length == 0 || pEnd != text.c_str() + length);
+      m_p += length;
+    }
+    return value;
+  }
+
+ public:
+  inline JsonParser(std::string_view text)
+      : m_p(text.data()), m_end(text.data() + text.size()) {}
+
+  inline Json parse() {
+    auto value = parseValue(0);
+    skipWhitespace();
+    crashIf(m_p != m_end);
+    return value;
+  }
+};
+
+std::string decodeBase64(std::string_view text) {
+  auto sextet = [](char c) -> int {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+' || c == '-') return 62;
+    if (c == '/' || c == '_') return 63;
+    return -1;
+  };
+
+  auto out = std::string{};
+  out.reserve(text.size() / 4 * 3);
+  auto bits = uint32_t{0};
+  auto numBits = 0;
+  for (auto c : text) {
+    if (c == '=') break;
+    auto value = sextet(c);
+    crashIf(value < 0);
+    bits = bits << 6 | static_cast<uint32_t>(value);
+    numBits += 6;
+    if (numBits >= 8) {
+      numBits -= 8;
+      out += static_cast<char>(bits >> numBits & 0xff);
+    }
+  }
+  return out;
+}
+
+struct GltfFile {
+  Json json;
+  std::vector<std::string> buffers;
+};
+
+GltfFile readGltf(std::string const& path) {
+  constexpr uint32_t glbMagic = 0x46546c67;  // "glTF"
+  constexpr uint32_t jsonChunk = 0x4e4f534a;
+  constexpr uint32_t binaryChunk = 0x004e4942;
+
+  auto data = readFile(path);
+  auto gltf = GltfFile{};
+  auto binary = std::optional<std::string>{};
+
+  auto readU32 = [&](size_t offset) {
+    crashIf(offset + sizeof(uint32_t) > data.size());
+    uint32_t value;
+    std::memcpy(&value, data.data() + offset, sizeof(uint32_t));
+    return value;
+  };
+
+  if (data.size() >= 12 && readU32(0) == glbMagic) {
+    crashIf(readU32(4) != 2);
+    auto length = std::min<size_t>(readU32(8), data.size());
+    auto jsonText = std::string_view{};
+    for (size_t offset = 12; offset + 8 <= length;) {
+      auto chunkBytes = size_t{readU32(offset)};
+      auto chunkType = readU32(offset + 4);
+      offset += 8;
+      crashIf(chunkBytes > length - offset);
+      if (chunkType == jsonChunk && jsonText.empty()) {
+        jsonText = std::string_view(data).substr(offset, chunkBytes);
+      } else if (chunkType == binaryChunk && !binary) {
+        binary = data.substr(offset, chunkBytes);
+      }
+      offset += (chunkBytes + 3) / 4 * 4;
+    }
+    gltf.json = JsonParser(jsonText).parse();
+  } else {
+    gltf.json = JsonParser(data).parse();
+  }
+
+  crashIf(gltf.json.type != Json::Type::Object);
+  auto const& asset = gltf.json["asset"];
+  crashIf(asset["version"].string.substr(0, 2) != "2.");
+
+  auto directory = std::filesystem::path(path).parent_path();
+  if (auto pBuffers = gltf.json.find("buffers")) {
+    for (auto const& buffer : pBuffers->values) {
+      auto pUri = buffer.find("uri");
+      if (!pUri) {
+        // Only the first buffer may refer to the binary chunk.
+        crashIf(!binary || !gltf.buffers.empty());
+        gltf.buffers.push_back(std::move(*binary));
+        binary.reset();
+      } else if (pUri->string.starts_with("data:")) {
+        auto comma = pUri->string.find(',');
+        crashIf(comma == std::string::npos ||
+                pUri->string.substr(0, comma).find(";base64") ==
+                    std::string::npos);
+        gltf.buffers.push_back(
+            decodeBase64(std::string_view(pUri->string).substr(comma + 1)));
+      } else {
+        gltf.buffers.push_back(readFile((directory / pUri->string).string()));
+      }
+      crashIf(gltf.buffers.back().size() < buffer["byteLength"].index());
+    }
+  }
+  return gltf;
+}
+
+struct GltfAccessor {
+  size_t count;
+  size_t numComponents;
+
+  // Every component of every element, converted to float.
+  std::vector<float> values;
+};
+
+GltfAccessor readAccessor(GltfFile const& gltf, Json const& accessorIndex) {
+  auto const& accessor = gltf.json["accessors"][accessorIndex.index()];
+  crashIf(accessor.find("sparse"));
+
+  auto const& type = accessor["type"].string;
+  auto numComponents = type == "SCALAR" ? size_t{1}
+                       : type == "VEC2" ? size_t{2}
+                       : type == "VEC3" ? size_t{3}
+                       : type == "VEC4" ? size_t{4}
+                                        : size_t{0};
+  crashIf(numComponents == 0);
+
+  auto componentType = accessor["componentType"].index();
+  auto componentBytes = size_t{0};
+  switch (componentType) {
+    case 5120:  // BYTE
+    case 5121:  // UNSIGNED_BYTE
+      componentBytes = 1;
+      break;
+    case 5122:  // SHORT
+    case 5123:  // UNSIGNED_SHORT
+      componentBytes = 2;
+      break;
+    case 5125:  // UNSIGNED_INT
+    case 5126:  // FLOAT
+      componentBytes = 4;
+      break;
+    default:
+      crashIf(true);
+  }
+
+  auto pNormalized = accessor.find("normalized");
+  auto isNormalized = pNormalized && pNormalized->boolean;
+  auto count = accessor["count"].index();
+  auto result = GltfAccessor{count, numComponents,
+                             std::vector<float>(count * numComponents, 0)};
+
+  // Accessors without a buffer view are all zeros.
+  auto pViewIndex = accessor.find("bufferView");
+  if (!pViewIndex || count == 0) return result;
+
+  auto const& view = gltf.json["bufferViews"][pViewIndex->index()];
+  auto const& buffer = gltf.buffers.at(view["buffer"].index());
+  auto viewOffset = static_cast<size_t>(view.numberOr("byteOffset", 0));
+  auto viewBytes = view["byteLength"].index();
+  crashIf(viewOffset > buffer.size() || viewBytes > buffer.size() - viewOffset);
+
+  auto elementBytes = componentBytes * numComponents;
+  auto stride = static_cast<size_t>(view.numberOr("byteStride", 0));
+  if (stride == 0) stride = elementBytes;
+  auto offset = static_cast<size_t>(accessor.numberOr("byteOffset", 0));
+  crashIf(offset > viewBytes ||
+          (count - 1) * stride + elementBytes > viewBytes - offset);
+
+  auto const* pData = buffer.data() + viewOffset + offset;
+  auto read = [&](auto type, char const* pComponent) {
+    decltype(type) value;
+    std::memcpy(&value, pComponent, sizeof(value));
+    return value;
+  };
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t c = 0; c < numComponents; ++c) {
+      auto const* pComponent = pData + i * stride + c * componentBytes;
+      auto& value = result.values[i * numComponents + c];
+      switch (componentType) {
+        case 5120: {
+          auto raw = read(int8_t{}, pComponent);
+          value = isNormalized ? std::max(raw / 127.0f, -1.0f) : raw;
+          break;
+        }
+        case 5121: {
+          auto raw = read(uint8_t{}, pComponent);
+          value = isNormalized ? raw / 255.0f : raw;
+          break;
+        }
+        case 5122: {
+          auto raw = read(int16_t{}, pComponent);
+          value = isNormalized ? std::max(raw / 32767.0f, -1.0f) : raw;
+          break;
+        }
+        case 5123: {
+          auto raw = read(uint16_t{}, pComponent);
+          value = isNormalized ? raw / 65535.0f : raw;
+          break;
+        }
+        case 5125:
+          value = static_cast<float>(read(uint32_t{}, pComponent));
+          break;
+        case 5126:
+          value = read(float{}, pComponent);
+          break;
+      }
+    }
+  }
+  return result;
+}
+
+// Indices are read exactly, not through floats.
+std::vector<uint32_t> readIndices(GltfFile const& gltf,
+                                  Json const& accessorIndex) {
+  auto const& accessor = gltf.json["accessors"][accessorIndex.index()];
+  crashIf(accessor.find("sparse") || accessor["type"].string != "SCALAR");
+
+  auto componentType = accessor["componentType"].index();
+  auto componentBytes = componentType == 5121   ? 1
+                        : componentType == 5123 ? 2
+                        : componentType == 5125 ? 4
+                                                : 0;
+  crashIf(componentBytes == 0);
+
+  auto count = accessor["count"].index();
+  auto indices = std::vector<uint32_t>(count, 0);
+  auto pViewIndex = accessor.find("bufferView");
+  if (!pViewIndex || count == 0) return indices;
+
+  auto const& view = gltf.json["bufferViews"][pViewIndex->index()];
+  auto const& buffer = gltf.buffers.at(view["buffer"].index());
+  auto viewOffset = static_cast<size_t>(view.numberOr("byteOffset", 0));
+  auto viewBytes = view["byteLength"].index();
+  crashIf(viewOffset > buffer.size() || viewBytes > buffer.size() - viewOffset);
+
+  auto stride = static_cast<size_t>(view.numberOr("byteStride", 0));
+  if (stride == 0) stride = componentBytes;
+  auto offset = static_cast<size_t>(accessor.numberOr("byteOffset", 0));
+  crashIf(offset > viewBytes ||
+          (count - 1) * stride + componentBytes > viewBytes - offset);
+
+  auto const* pData = buffer.data() + viewOffset + offset;
+  for (size_t i = 0; i < count; ++i) {
+    std::memcpy(&indices[i], pData + i * stride, componentBytes);
+  }
+  return indices;
+}
+
+glm::mat4 nodeMatrix(Json const& node) {
+  if (auto pMatrix = node.find("matrix")) {
+    float values[16];
+    for (size_t i = 0; i < 16; ++i) {
+      values[i] = static_cast<float>((*pMatrix)[i].number);
+    }
+    return glm::make_mat4(values);
+  }
+
+  auto vector = [&](std::string_view key, glm::vec4 fallback) {
+    auto pValue = node.find(key);
+    if (!pValue) return fallback;
+    for (size_t i = 0; i < pValue->values.size() && i < 4; ++i) {
+      fallback[static_cast<int>(i)] = static_cast<float>((*pValue)[i].number);
+    }
+    return fallback;
+  };
+  auto translation = vector("translation", {0, 0, 0, 0});
+  auto rotation = vector("rotation", {0, 0, 0, 1});
+  auto scale = vector("scale", {1, 1, 1, 0});
+
+  return glm::translate(glm::mat4{1}, glm::vec3(translation)) *
+         glm::mat4_cast(glm::quat(rotation.w, rotation.x, rotation.y,
+                                  rotation.z)) *
+         glm::scale(glm::mat4{1}, glm::vec3(scale));
+}
+
+void appendPrimitive(GltfFile const& gltf, Json const& primitive,
+                     glm::mat4 const& transform,
+                     std::vector<VPositionColorTexcoord>& out) {
+  // Only triangle lists, the default mode.
+  constexpr size_t triangles = 4;
+  if (static_cast<size_t>(primitive.numberOr("mode", triangles)) !=
+      triangles) {
+    return;
+  }
+
+  auto const& attributes = primitive["attributes"];
+  auto positions = readAccessor(gltf, attributes["POSITION"]);
+  crashIf(positions.numComponents != 3);
+
+  auto texcoords = std::optional<GltfAccessor>{};
+  if (auto pTexcoords = attributes.find("TEXCOORD_0")) {
+    texcoords = readAccessor(gltf, *pTexcoords);
+    crashIf(texcoords->numComponents != 2 ||
+            texcoords->count != positions.count);
+  }
+  auto colors = std::optional<GltfAccessor>{};
+  if (auto pColors = attributes.find("COLOR_0")) {
+    colors = readAccessor(gltf, *pColors);
+    crashIf(colors->numComponents < 3 || colors->count != positions.count);
+  }
+
+  auto indices = std::vector<uint32_t>{};
+  if (auto pIndices = primitive.find("indices")) {
+    indices = readIndices(gltf, *pIndices);
+  } else {
+    indices.resize(positions.count);
+    std::iota(indices.begin(), indices.end(), 0);
+  }
+  crashIf(indices.size() % 3 != 0);
+
+  // Mirroring transforms turn triangles inside out, unless their
+  // winding is reversed along.
+  auto isMirrored = glm::determinant(glm::mat3(transform)) < 0;
+
+  auto vertex = [&](uint32_t index) {
+    crashIf(index >= positions.count);
+    auto const* p = &positions.values[index * 3];
+    auto result = VPositionColorTexcoord{
+        glm::vec3(transform * glm::vec4(p[0], p[1], p[2], 1)),
+        {1, 1, 1},
+        {0, 0}};
+    if (colors) {
+      auto const* c = &colors->values[index * colors->numComponents];
+      result.m_color = {c[0], c[1], c[2]};
+    }
+    if (texcoords) {
+      auto const* t = &texcoords->values[index * 2];
+      result.texcoord = {t[0], t[1]};
+    }
+    return result;
+  };
+
+  out.reserve(out.size() + indices.size());
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    out.push_back(vertex(indices[i]));
+    out.push_back(vertex(indices[i + (isMirrored ? 2 : 1)]));
+    out.push_back(vertex(indices[i + (isMirrored ? 1 : 2)]));
+  }
+}
+
+}  // namespace
+
+std::vector<VPositionColorTexcoord> importObj(std::string const& path) {
+  auto text = readFile(path);
+
+  auto positions = std::vector<glm::vec3>{};
+  auto colors = std::vector<glm::vec3>{};
+  auto texcoords = std::vector<glm::vec2>{};
+  auto face = std::vector<VPositionColorTexcoord>{};
+  auto triangles = std::vector<VPositionColorTexcoord>{};
+
+  auto const* p = text.data();
+  auto const* end = p + text.size();
+  while (p < end) {
+    auto const* lineEnd =
+        static_cast<char const*>(std::memchr(p, '\n', end - p));
+    if (!lineEnd) lineEnd = end;
+    auto line = LineReader{p, lineEnd};
+    p = lineEnd + 1;
+
+    auto keyword = line.token();
+    if (keyword == "v") {
+      // Either x y z [w], or x y z r g b.
+      float values[7];
+      auto count = 0;
+      while (count < 7 && line.number(values[count])) ++count;
+      crashIf(count < 3);
+      positions.push_back({values[0], values[1], values[2]});
+      colors.push_back(count >= 6 ? glm::vec3{values[3], values[4], values[5]}
+                                  : glm::vec3{1, 1, 1});
+    } else if (keyword == "vt") {
+      auto u = 0.0f, v = 0.0f;
+      crashIf(!line.number(u));
+      line.number(v);
+      texcoords.push_back({u, 1 - v});
+    } else if (keyword == "f") {
+      // Corners are given as v, v/vt, v//vn or v/vt/vn.
+      face.clear();
+      for (auto corner = line.token(); !corner.empty();
+           corner = line.token()) {
+        auto slash = corner.find('/');
+        auto position = objIndex(corner.substr(0, slash), positions.size());
+        auto vertex = VPositionColorTexcoord{positions[position],
+                                             colors[position], {0, 0}};
+        if (slash != corner.npos) {
+          auto texcoord = corner.substr(slash + 1);
+          texcoord = texcoord.substr(0, texcoord.find('/'));
+          if (!texcoord.empty()) {
+            vertex.texcoord = texcoords[objIndex(texcoord, texcoords.size())];
+          }
+        }
+        face.push_back(vertex);
+      }
+      crashIf(face.size() < 3);
+
+      // Polygons are assumed convex, and split into a fan.
+      for (size_t i = 2; i < face.size(); ++i) {
+        triangles.push_back(face[0]);
+        triangles.push_back(face[i - 1]);
+        triangles.push_back(face[i]);
+      }
+    }
+  }
+  return triangles;
+}
+
+std::vector<VPositionColorTexcoord> importGltf(std::string const& path) {
+  auto gltf = readGltf(path);
+  auto const& json = gltf.json;
+  auto triangles = std::vector<VPositionColorTexcoord>{};
+
+  auto appendMesh = [&](size_t meshIndex, glm::mat4 const& transform) {
+    auto const& mesh = json["meshes"][meshIndex];
+    for (auto const& primitive : mesh["primitives"].values) {
+      appendPrimitive(gltf, primitive, transform, triangles);
+    }
+  };
+
+  auto pScenes = json.find("scenes");
+  if (!pScenes || pScenes->values.empty()) {
+    // Files without scenes are libraries of meshes, merged as they are.
+    if (auto pMeshes = json.find("meshes")) {
+      for (size_t i = 0; i < pMeshes->values.size(); ++i) {
+        appendMesh(i, glm::mat4{1});
+      }
+    }
+    return triangles;
+  }
+
+  auto sceneIndex = static_cast<size_t>(json.numberOr("scene", 0));
+  auto const& scene = (*pScenes)[sceneIndex];
+  auto const* pNodes = json.find("nodes");
+  auto pending = std::vector<std::pair<size_t, glm::mat4>>{};
+  if (auto pRoots = scene.find("nodes")) {
+    for (auto it = pRoots->values.rbegin(); it != pRoots->values.rend(); ++it) {
+      pending.push_back({it->index(), glm::mat4{1}});
+    }
+  }
+
+  // Nodes are visited depth first, in file order. They form trees, so
+  // no node is visited twice unless the file is malformed, which the
+  // bound on visits catches.
+  auto numVisited = size_t{0};
+  while (!pending.empty()) {
+    auto [nodeIndex, parentMatrix] = pending.back();
+    pending.pop_back();
+    crashIf(!pNodes || ++numVisited > pNodes->values.size());
+
+    auto const& node = (*pNodes)[nodeIndex];
+    auto matrix = parentMatrix * nodeMatrix(node);
+    if (auto pMesh = node.find("mesh")) appendMesh(pMesh->index(), matrix);
+    if (auto pChildren = node.find("children")) {
+      auto const& children = pChildren->values;
+      for (auto it = children.rbegin(); it != children.rend(); ++it) {
+        pending.push_back({it->index(), matrix});
+      }
+    }
+  }
+  return triangles;
+}
+
+std::vector<VPositionColorTexcoord> importModel(std::string const& path) {
+  auto extension = std::string(extensionOf(path));
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (extension == ".obj") return importObj(path);
+  if (extension == ".gltf" || extension == ".glb") return importGltf(path);
+  crashIf(true);
+  return {};
+}
+
+MeshCacheReport convertModel(std::string const& modelPath,
+                             std::string const& meshPath, size_t maxLods,
+                             float maxRelativeError) {
+  auto report = MeshCacheReport{};
+  report.wasConverted = true;
+  report.modelBytes = std::filesystem::file_size(modelPath);
+
+  auto start = Clock::now();
+  auto vertices = importModel(modelPath);
+  report.importMilliseconds = millisecondsSince(start);
+  crashIf(vertices.empty());
+
+  start = Clock::now();
+  auto indices = std::vector<uint32_t>{};
+  optimizeMesh(vertices, indices);
+
+  auto box = Aabb{};
+  for (auto const& vertex : vertices) box.extend(vertex.position);
+  auto radiusSquared = 0.0f;
+  for (auto const& vertex : vertices) {
+    auto offset = vertex.position - box.center();
+    radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+  }
+  auto sphere = BoundingSphere{box.center(), std::sqrt(radiusSquared)};
+
+  auto lods = buildLodChain(vertices, indices, maxLods, 0.5f,
+                            maxRelativeError * sphere.radius);
+  saveMeshFile(meshPath, vertices, indices, lods, box, sphere);
+  report.convertMilliseconds = millisecondsSince(start);
+
+  report.meshFileBytes = std::filesystem::file_size(meshPath);
+  report.numVertices = vertices.size();
+  report.numTriangles = lods.front().indexCount / 3;
+  report.numLods = lods.size();
+  return report;
+}
+
+MeshCacheReport loadModel(Mesh& mesh, std::string const& modelPath,
+                          bool keepCopies) {
+  namespace fs = std::filesystem;
+
+  auto meshPath = modelPath + ".mesh";
+  auto report = MeshCacheReport{};
+
+  // Without the model file, as when only mesh files are shipped, any
+  // current mesh file will do.
+  auto error = std::error_code{};
+  auto modelTime = fs::last_write_time(modelPath, error);
+  auto isOutdated = !MeshFile::isCurrent(meshPath) ||
+                    (!error && fs::last_write_time(meshPath) < modelTime);
+  if (isOutdated) report = convertModel(modelPath, meshPath);
+
+  auto start = Clock::now();
+  auto file = MeshFile(meshPath);
+  mesh.loadFile(file, keepCopies);
+  report.loadMilliseconds = millisecondsSince(start);
+
+  auto const& header = file.header();
+  report.meshFileBytes = file.bytes();
+  report.numVertices = header.vertexCount;
+  report.numTriangles =
+      header.lodCount > 0 ? file.lods().front().indexCount / 3 : 0;
+  report.numLods = header.lodCount;
+  return report;
+}
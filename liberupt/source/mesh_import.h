@@ -0,0 +1,73 @@
+#pragma once
+
+#include "mesh.h"
+
+// Importers return triangle lists without indices, with every polygon
+// triangulated, ready for optimizeMesh. Vertices of files without
+// vertex colors are white.
+
+// Wavefront OBJ, including vertex colors given after positions. Texture
+// coordinates are flipped vertically, as OBJ places their origin at the
+// bottom left.
+std::vector<VPositionColorTexcoord> importObj(std::string const& path);
+
+// glTF 2.0, either as .gltf, with buffers in separate files or embedded
+// as data URIs, or as .glb. The triangle primitives of every node in the
+// default scene are merged, placed by their node transforms.
+std::vector<VPositionColorTexcoord> importGltf(std::string const& path);
+
+// Picks the importer by the file extension.
+std::vector<VPositionColorTexcoord> importModel(std::string const& path);
+
+struct MeshCacheReport {
+  // Whether the mesh file was missing or out of date, and got written.
+  bool wasConverted = false;
+
+  // Time spent reading the model file, then welding, optimizing and
+  // simplifying it, or zero when the mesh file was up to date.
+  double importMilliseconds = 0;
+  double convertMilliseconds = 0;
+
+  // Time spent mapping the mesh file and uploading it, or zero when it
+  // was only converted.
+  double loadMilliseconds = 0;
+
+  size_t modelBytes = 0;
+  size_t meshFileBytes = 0;
+  size_t numVertices = 0;
+  size_t numTriangles = 0;
+  size_t numLods = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& out,
+                                MeshCacheReport const& report) {
+  if (report.wasConverted) {
+    out << report.modelBytes << " byte model imported in "
+        << report.importMilliseconds << " ms, converted in "
+        << report.convertMilliseconds << " ms, ";
+  }
+  out << report.meshFileBytes << " byte mesh file";
+  if (report.loadMilliseconds > 0) {
+    out << " loaded in " << report.loadMilliseconds << " ms";
+  }
+  return out << ", " << report.numVertices << " vertices, "
+             << report.numTriangles << " triangles, " << report.numLods
+             << " levels of detail";
+}
+
+// Imports a model file and writes it as a mesh file, optimized, with
+// up to maxLods levels of detail. Every level's error, which bounds how
+// far it deviates from the full detail surface, stays within
+// maxRelativeError times the bounding radius of the mesh. Vertices are
+// stored packed when packVertices allows, ready to be uploaded as they
+// are.
+MeshCacheReport convertModel(std::string const& modelPath,
+                             std::string const& meshPath, size_t maxLods = 4,
+                             float maxRelativeError = 0.05f);
+
+// Loads a model file into a mesh through a mesh file next to it, named
+// after it with ".mesh" appended, which is converted first if missing,
+// older than the model file, or of an older version. See Mesh::loadFile
+// for keepCopies.
+MeshCacheReport loadModel(Mesh& mesh, std::string const& modelPath,
+                          bool keepCopies = false);
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+
+#include "shader_interface.h"
+
+// Mesh preparation for the GPU: identical vertices are welded into an
+// index buffer, triangles are reordered for the post-transform vertex
+// cache with Tipsify (Sander, Nehab and Barczak, 2007), and vertices
+// are reordered by first use so that fetching them walks memory
+// mostly forwards.
+
+// Post-transform cache size assumed when ordering triangles. Actual
+// hardware behaves roughly like a FIFO of this size, or larger.
+constexpr size_t vertexCacheSize = 16;
+
+struct MeshOptimizationReport {
+  size_t numVerticesBefore = 0;
+  size_t numVerticesAfter = 0;
+  size_t numTriangles = 0;
+
+  // Average cache miss ratio, i.e. vertices transformed per triangle,
+  // of the welded mesh before and after reordering its triangles.
+  // Unindexed meshes transform three vertices per triangle.
+  float acmrBefore = 0;
+  float acmrAfter = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& out,
+                                MeshOptimizationReport const& report) {
+  return out << report.numVerticesBefore << " -> " << report.numVerticesAfter
+             << " vertices, " << report.numTriangles << " triangles, ACMR "
+             << report.acmrBefore << " -> " << report.acmrAfter;
+}
+
+// Merges bitwise identical vertices, returning the indices into the
+// unique vertices left behind, which keep their first occurrence order.
+template <typename Vertex>
+std::vector<uint32_t> weldVertices(std::vector<Vertex>& vertices) {
+  static_assert(std::is_trivially_copyable_v<Vertex>,
+                "vertices are compared bytewise, and must not have padding");
+  crashIf(vertices.size() > std::numeric_limits<uint32_t>::max());
+
+  struct Hash {
+    size_t operator()(Vertex const& vertex) const noexcept {
+      return std::hash<std::string_view>{}(std::string_view(
+          reinterpret_cast<char const*>(&vertex), sizeof(Vertex)));
+    }
+  };
+  struct Equal {
+    bool operator()(Vertex const& lhs, Vertex const& rhs) const noexcept {
+      return std::memcmp(&lhs, &rhs, sizeof(Vertex)) == 0;
+    }
+  };
+
+  auto indexOf = std::unordered_map<Vertex, uint32_t, Hash, Equal>{};
+  indexOf.reserve(vertices.size());
+
+  auto indices = std::vector<uint32_t>(vertices.size());
+  auto numUnique = size_t{0};
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    auto [it, isNew] =
+        indexOf.try_emplace(vertices[i], static_cast<uint32_t>(numUnique));
+    if (isNew) vertices[numUnique++] = vertices[i];
+    indices[i] = it->second;
+  }
+
+  vertices.resize(numUnique);
+  return indices;
+}
+
+// Average cache miss ratio of drawing the triangles in order through a
+// FIFO vertex cache.
+inline float computeAcmr(std::vector<uint32_t> const& indices,
+                         size_t vertexCount,
+                         size_t cacheSize = vertexCacheSize) {
+  if (indices.size() < 3) return 0;
+
+  // A vertex is cached while fewer than cacheSize misses have happened
+  // since its own miss.
+  auto missedAt = std::vector<size_t>(vertexCount, 0);
+  auto numMisses = size_t{0};
+  for (auto index : indices) {
+    if (missedAt[index] == 0 || numMisses - missedAt[index] >= cacheSize) {
+      missedAt[index] = ++numMisses;
+    }
+  }
+  return static_cast<float>(numMisses) / (indices.size() / 3);
+}
+
+// Reorders triangles so that consecutive triangles share vertices while
+// they are still cached. Runs in time linear in the size of the mesh.
+// The indices must form whole triangles.
+inline void optimizeVertexCache(std::vector<uint32_t>& indices,
+                                size_t vertexCount,
+                                size_t cacheSize = vertexCacheSize) {
+  crashIf(indices.size() % 3 != 0);
+  auto numTriangles = indices.size() / 3;
+  if (numTriangles == 0) return;
+
+  // Triangles using each vertex, as offsets into one flat list.
+  auto adjacencyOffsets = std::vector<uint32_t>(vertexCount + 1, 0);
+  for (auto index : indices) ++adjacencyOffsets[index + 1];
+  for (size_t v = 0; v < vertexCount; ++v) {
+    adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+  }
+  auto adjacency = std::vector<uint32_t>(indices.size());
+  auto fill = std::vector<uint32_t>(adjacencyOffsets.begin(),
+                                    adjacencyOffsets.end() - 1);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+
+  auto liveTriangles = std::vector<uint32_t>(vertexCount);
+  for (size_t v = 0; v < vertexCount; ++v) {
+    liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+  }
+
+  auto cachedAt = std::vector<size_t>(vertexCount, 0);
+  auto isEmitted = std::vector<uint8_t>(numTriangles, 0);
+  auto deadEnds = std::vector<uint32_t>{};
+  auto candidates = std::vector<uint32_t>{};
+  auto result = std::vector<uint32_t>{};
+  result.reserve(indices.size());
+
+  auto time = cacheSize + 1;
+  auto cursor = size_t{0};
+
+  // Picks the next vertex to fan around: the candidate that stays in
+  // the cache while emitting its remaining triangles and entered the
+  // cache earliest, or failing that a recently used vertex with
+  // triangles left, or failing that the next such vertex in order.
+  auto nextVertex = [&]() -> std::optional<uint32_t> {
+    auto best = std::optional<uint32_t>{};
+    auto bestPriority = size_t{0};
+    for (auto v : candidates) {
+      if (liveTriangles[v] == 0) continue;
+      auto age = time - cachedAt[v];
+      auto priority = age + 2 * liveTriangles[v] <= cacheSize ? age : 0;
+      if (!best || priority > bestPriority) {
+        best = v;
+        bestPriority = priority;
+      }
+    }
+    if (best) return best;
+
+    while (!deadEnds.empty()) {
+      auto v = deadEnds.back();
+      deadEnds.pop_back();
+      if (liveTriangles[v] > 0) return v;
+    }
+    for (; cursor < vertexCount; ++cursor) {
+      if (liveTriangles[cursor] > 0) return static_cast<uint32_t>(cursor);
+    }
+    return std::nullopt;
+  };
+
+  for (auto fan = nextVertex(); fan; fan = nextVertex()) {
+    candidates.clear();
+    for (auto i = adjacencyOffsets[*fan]; i < adjacencyOffsets[*fan + 1];
+         ++i) {
+      auto triangle = adjacency[i];
+      if (isEmitted[triangle]) continue;
+      isEmitted[triangle] = 1;
+
+      for (size_t corner = 0; corner < 3; ++corner) {
+        auto v = indices[3 * triangle + corner];
+        result.push_back(v);
+        deadEnds.push_back(v);
+        candidates.push_back(v);
+        --liveTriangles[v];
+        if (time - cachedAt[v] > cacheSize) cachedAt[v] = time++;
+      }
+    }
+  }
+
+  indices = std::move(result);
+}
+
+// Reorders vertices by their first use in the index buffer, dropping
+// unused ones, and rewrites the indices to match.
+template <typename Vertex>
+void optimizeVertexFetch(std::vector<Vertex>& vertices,
+                         std::vector<uint32_t>& indices) {
+  constexpr auto unassigned = std::numeric_limits<uint32_t>::max();
+
+  auto remap = std::vector<uint32_t>(vertices.size(), unassigned);
+  auto reordered = std::vector<Vertex>{};
+  reordered.reserve(vertices.size());
+
+  for (auto& index : indices) {
+    if (remap[index] == unassigned) {
+      remap[index] = static_cast<uint32_t>(reordered.size());
+      reordered.push_back(vertices[index]);
+    }
+    index = remap[index];
+  }
+
+  vertices = std::move(reordered);
+}
+
+// Runs every pass on a triangle list given without indices.
+template <typename Vertex>
+MeshOptimizationReport optimizeMesh(std::vector<Vertex>& vertices,
+                                    std::vector<uint32_t>& indices) {
+  crashIf(vertices.size() % 3 != 0);
+  auto report = MeshOptimizationReport{};
+  report.numVerticesBefore = vertices.size();
+  report.numTriangles = vertices.size() / 3;
+
+  indices = weldVertices(vertices);
+  report.acmrBefore = computeAcmr(indices, vertices.size());
+
+  optimizeVertexCache(indices, vertices.size());
+  optimizeVertexFetch(vertices, indices);
+  report.acmrAfter = computeAcmr(indices, vertices.size());
+  report.numVerticesAfter = vertices.size();
+  return report;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <optional>
+#include <span>
+
+#include "bounding_volume.h"
+#include "shader_interface.h"
+
+// Vertex buffer layouts, see VPositionColorTexcoord and
+// VPackedPositionColorTexcoord.
+enum class VertexLayout : uint32_t { Float, Packed };
+
+// Texture coordinates may move at most this far when stored as halves,
+// a texel of a 512 pixel wide texture.
+constexpr float maxTexcoordError = 1.0f / 512;
+
+// Vertices in the packed layout, along with the matrix mapping their
+// positions back to the mesh's space.
+struct PackedVertices {
+  std::vector<VPackedPositionColorTexcoord> vertices;
+  glm::mat4 positionDequantization;
+};
+
+// Maps positions quantized against a box back into it.
+inline glm::mat4 boxDequantization(glm::vec3 const& center,
+                                   glm::vec3 const& halfExtent) {
+  auto dequantization = glm::mat4{1};
+  for (int axis = 0; axis < 3; ++axis) {
+    dequantization[axis][axis] = halfExtent[axis];
+  }
+  dequantization[3] = glm::vec4(center, 1);
+  return dequantization;
+}
+
+// Packs vertices, with positions relative to their bounding box, or
+// returns nothing when colors or texture coordinates would lose too
+// much precision.
+inline std::optional<PackedVertices> packVertices(
+    std::span<VPositionColorTexcoord const> vertices,
+    Aabb const& boundingBox) {
+  if (boundingBox.isEmpty()) return std::nullopt;
+
+  auto center = boundingBox.center();
+  auto halfExtent = boundingBox.extent() * 0.5f;
+  auto invHalfExtent = glm::vec3{0, 0, 0};
+  for (int axis = 0; axis < 3; ++axis) {
+    if (halfExtent[axis] > 0) invHalfExtent[axis] = 1 / halfExtent[axis];
+  }
+
+  auto packed = PackedVertices{{}, boxDequantization(center, halfExtent)};
+  packed.vertices.reserve(vertices.size());
+  for (auto const& vertex : vertices) {
+    if (glm::any(glm::lessThan(vertex.m_color, glm::vec3(0))) ||
+        glm::any(glm::greaterThan(vertex.m_color, glm::vec3(1)))) {
+      return std::nullopt;
+    }
+
+    auto texcoord = glm::packHalf2x16(vertex.texcoord);
+    auto texcoordError =
+        glm::abs(glm::unpackHalf2x16(texcoord) - vertex.texcoord);
+    if (!(std::max(texcoordError.x, texcoordError.y) <= maxTexcoordError)) {
+      return std::nullopt;
+    }
+
+    auto position = glm::round(
+        glm::clamp((vertex.position - center) * invHalfExtent, -1.0f, 1.0f) *
+        32767.0f);
+    auto color = glm::round(vertex.m_color * 255.0f);
+
+    packed.vertices.push_back({{static_cast<int16_t>(position.x),
+                                static_cast<int16_t>(position.y),
+                                static_cast<int16_t>(position.z), 0},
+                               {static_cast<uint8_t>(color.r),
+                                static_cast<uint8_t>(color.g),
+                                static_cast<uint8_t>(color.b), 255},
+                               {static_cast<uint16_t>(texcoord & 0xffff),
+                                static_cast<uint16_t>(texcoord >> 16)}});
+  }
+  return packed;
+}
+
+// Inverse of packVertices, up to the precision lost packing them.
+inline std::vector<VPositionColorTexcoord> unpackVertices(
+    std::span<VPackedPositionColorTexcoord const> packed,
+    glm::mat4 const& positionDequantization) {
+  auto vertices = std::vector<VPositionColorTexcoord>{};
+  vertices.reserve(packed.size());
+  for (auto const& vertex : packed) {
+    auto const& p = vertex.position;
+    auto const& c = vertex.color;
+    auto const& t = vertex.texcoord;
+    auto quantized = glm::vec4{p.x, p.y, p.z, 32767.0f} / 32767.0f;
+    vertices.push_back(
+        {glm::vec3(positionDequantization * quantized),
+         glm::vec3{c.r, c.g, c.b} / 255.0f,
+         glm::unpackHalf2x16(uint32_t{t.x} | uint32_t{t.y} << 16)});
+  }
+  return vertices;
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+#include "mesh_optimizer.h"
+
+// Mesh simplification by edge collapses ordered by quadric error
+// metrics (Garland and Heckbert, 1997). Vertices are only ever moved
+// onto a neighboring vertex, so simplified meshes keep the original
+// vertex buffer and differ in their indices alone.
+//
+// Vertices on open borders, on non-manifold edges, and on attribute
+// seams, where several vertices share a position, never move, which
+// keeps silhouettes, holes and texture seams in place.
+
+// Sum of squared distances to a set of planes, as a symmetric 4x4
+// matrix applied to (x, y, z, 1).
+struct Quadric {
+  double xx = 0, xy = 0, xz = 0, xw = 0;
+  double yy = 0, yz = 0, yw = 0;
+  double zz = 0, zw = 0;
+  double ww = 0;
+
+  static inline Quadric fromPlane(glm::vec3 const& normal,
+                                  float distance) noexcept {
+    double a = normal.x, b = normal.y, c = normal.z, d = distance;
+    return {a * a, a * b, a * c, a * d, b * b, b * c,
+            b * d, c * c, c * d, d * d};
+  }
+
+  inline Quadric& operator+=(Quadric const& other) noexcept {
+    xx += other.xx, xy += other.xy, xz += other.xz, xw += other.xw;
+    yy += other.yy, yz += other.yz, yw += other.yw;
+    zz += other.zz, zw += other.zw;
+    ww += other.ww;
+    return *this;
+  }
+
+  inline double evaluate(glm::vec3 const& p) const noexcept {
+    double x = p.x, y = p.y, z = p.z;
+    return xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x +
+           yy * y * y + 2 * yz * y * z + 2 * yw * y + zz * z * z +
+           2 * zw * z + ww;
+  }
+};
+
+// Removes triangles until at most targetTriangles remain, or until the
+// next collapse would move the surface further than maxError. Returns
+// the largest error of the collapses made, in the units of positions.
+template <typename Vertex>
+float simplifyMesh(std::vector<Vertex> const& vertices,
+                   std::vector<uint32_t>& indices, size_t targetTriangles,
+                   float maxError) {
+  struct PositionHash {
+    size_t operator()(glm::vec3 const& p) const noexcept {
+      return std::hash<std::string_view>{}(
+          std::string_view(reinterpret_cast<char const*>(&p), sizeof(p)));
+    }
+  };
+  struct Collapse {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+  };
+
+  auto numVertices = vertices.size();
+
+  // Vertices sharing a position are represented by the first of them.
+  auto canonical = std::vector<uint32_t>(numVertices);
+  auto isLocked = std::vector<uint8_t>(numVertices, 0);
+  {
+    auto firstAt = std::unordered_map<glm::vec3, uint32_t, PositionHash>{};
+    for (uint32_t v = 0; v < numVertices; ++v) {
+      auto [it, isNew] = firstAt.try_emplace(vertices[v].position, v);
+      canonical[v] = it->second;
+      if (!isNew) isLocked[v] = isLocked[it->second] = 1;
+    }
+  }
+
+  // Edges used by anything but exactly two triangles lock their ends.
+  {
+    auto edgeKey = [&](uint32_t a, uint32_t b) {
+      a = canonical[a], b = canonical[b];
+      return a < b ? uint64_t{a} << 32 | b : uint64_t{b} << 32 | a;
+    };
+    auto edgeUses = std::unordered_map<uint64_t, uint32_t>{};
+    edgeUses.reserve(indices.size());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      for (size_t corner = 0; corner < 3; ++corner) {
+        ++edgeUses[edgeKey(indices[i + corner],
+                           indices[i + (corner + 1) % 3])];
+      }
+    }
+    for (auto [key, uses] : edgeUses) {
+      if (uses != 2) {
+        isLocked[key >> 32] = 1;
+        isLocked[key & 0xffffffff] = 1;
+      }
+    }
+  }
+
+  auto quadrics = std::vector<Quadric>(numVertices);
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    auto const& p0 = vertices[indices[i]].position;
+    auto const& p1 = vertices[indices[i + 1]].position;
+    auto const& p2 = vertices[indices[i + 2]].position;
+    auto normal = glm::cross(p1 - p0, p2 - p0);
+    auto length = glm::length(normal);
+    if (length == 0) continue;
+
+    normal /= length;
+    auto plane = Quadric::fromPlane(normal, -glm::dot(normal, p0));
+    for (size_t corner = 0; corner < 3; ++corner) {
+      quadrics[canonical[indices[i + corner]]] += plane;
+    }
+  }
+
+  auto remap = std::vector<uint32_t>(numVertices);
+  auto isTouched = std::vector<uint8_t>(numVertices);
+  auto adjacencyOffsets = std::vector<uint32_t>(numVertices + 1);
+  auto adjacency = std::vector<uint32_t>{};
+  auto collapses = std::vector<Collapse>{};
+  auto maxCost = static_cast<double>(maxError) * maxError;
+  auto largestCost = 0.0;
+
+  // Each pass collapses as many independent edges as it can, cheapest
+  // first, with no vertex involved in more than one collapse.
+  while (indices.size() / 3 > targetTriangles) {
+    std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+    for (auto index : indices) ++adjacencyOffsets[index + 1];
+    for (size_t v = 0; v < numVertices; ++v) {
+      adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    }
+    adjacency.resize(indices.size());
+    auto fill = std::vector<uint32_t>(adjacencyOffsets.begin(),
+                                      adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i) {
+      adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    collapses.clear();
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      for (size_t corner = 0; corner < 3; ++corner) {
+        auto from = indices[i + corner];
+        auto to = indices[i + (corner + 1) % 3];
+        if (isLocked[from]) continue;
+
+        auto quadric = quadrics[from];
+        quadric += quadrics[canonical[to]];
+        auto cost = std::max(quadric.evaluate(vertices[to].position), 0.0);
+        if (cost <= maxCost) collapses.push_back({cost, from, to});
+      }
+    }
+    std::sort(collapses.begin(), collapses.end(),
+              [](auto const& lhs, auto const& rhs) {
+                return lhs.cost < rhs.cost;
+              });
+
+    std::iota(remap.begin(), remap.end(), 0);
+    std::fill(isTouched.begin(), isTouched.end(), 0);
+    auto numTriangles = indices.size() / 3;
+    auto numCollapsed = size_t{0};
+
+    for (auto const& [cost, from, to] : collapses) {
+      if (numTriangles <= targetTriangles) break;
+      if (isTouched[from] || isTouched[canonical[to]]) continue;
+
+      // Reject collapses that flip or flatten a remaining triangle.
+      auto const& target = vertices[to].position;
+      auto numRemoved = size_t{0};
+      auto isValid = true;
+      for (auto j = adjacencyOffsets[from]; j < adjacencyOffsets[from + 1];
+           ++j) {
+        auto const* triangle = &indices[3 * adjacency[j]];
+        auto usesTarget = false;
+        auto corners = std::array<glm::vec3, 3>{};
+        auto moved = std::array<glm::vec3, 3>{};
+        for (size_t corner = 0; corner < 3; ++corner) {
+          auto v = triangle[corner];
+          usesTarget |= canonical[v] == canonical[to];
+          corners[corner] = vertices[v].position;
+          moved[corner] = v == from ? target : corners[corner];
+        }
+        if (usesTarget) {
+          ++numRemoved;
+          continue;
+        }
+
+        auto before = glm::cross(corners[1] - corners[0],
+                                 corners[2] - corners[0]);
+        auto after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+        if (glm::dot(before, after) <= 0) {
+          isValid = false;
+          break;
+        }
+      }
+      if (!isValid) continue;
+
+      remap[from] = to;
+      quadrics[canonical[to]] += quadrics[from];
+      largestCost = std::max(largestCost, cost);
+      numTriangles -= numRemoved;
+      ++numCollapsed;
+
+      // Neighbors wait for the next pass, with updated adjacency.
+      for (auto j = adjacencyOffsets[from]; j < adjacencyOffsets[from + 1];
+           ++j) {
+        for (size_t corner = 0; corner < 3; ++corner) {
+          auto v = indices[3 * adjacency[j] + corner];
+          isTouched[v] = isTouched[canonical[v]] = 1;
+        }
+      }
+    }
+
+    if (numCollapsed == 0) break;
+
+    auto kept = size_t{0};
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      auto a = remap[indices[i]];
+      auto b = remap[indices[i + 1]];
+      auto c = remap[indices[i + 2]];
+      if (canonical[a] == canonical[b] || canonical[b] == canonical[c] ||
+          canonical[c] == canonical[a]) {
+        continue;
+      }
+      indices[kept++] = a;
+      indices[kept++] = b;
+      indices[kept++] = c;
+    }
+    indices.resize(kept);
+  }
+
+  return static_cast<float>(std::sqrt(largestCost));
+}
+
+// Detail level of a mesh, as a range of its index buffer.
+struct MeshLod {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+
+  // Upper bound on how far the level's surface deviates from the full
+  // detail mesh, in the units of positions.
+  float error;
+};
+
+// Appends successively coarser versions of the mesh in indices to it,
+// each with about reduction times the triangles of the one before,
+// until maxLevels levels exist or simplification stalls. The first
+// level is the mesh as given. Errors add up across levels, so each is
+// simplified within what remains of maxError after the one before, and
+// the chain ends once none remains.
+template <typename Vertex>
+std::vector<MeshLod> buildLodChain(std::vector<Vertex> const& vertices,
+                                   std::vector<uint32_t>& indices,
+                                   size_t maxLevels = 4,
+                                   float reduction = 0.5f,
+                                   float maxError = 1.0f) {
+  crashIf(reduction <= 0 || reduction >= 1);
+
+  auto lods = std::vector<MeshLod>{
+      {0, static_cast<uint32_t>(indices.size()), 0.0f}};
+
+  auto level = indices;
+  while (lods.size() < maxLevels) {
+    auto const& previous = lods.back();
+    auto budget = maxError - previous.error;
+    if (budget <= 0) break;
+
+    auto target = static_cast<size_t>(previous.indexCount / 3 * reduction);
+    auto error = simplifyMesh(vertices, level, target, budget);
+
+    // Stop once a level saves less than a tenth of the triangles.
+    if (level.size() * 10 > previous.indexCount * 9) break;
+
+    optimizeVertexCache(level, vertices.size());
+    lods.push_back({static_cast<uint32_t>(indices.size()),
+                    static_cast<uint32_t>(level.size()),
+                    previous.error + error});
+    indices.insert(indices.end(), level.begin(), level.end());
+  }
+  return lods;
+}
@@ -60,3 +60,168 @@ inline auto cubeVertices(glm::vec3 const& center = {0, 0, 0},
 
   return vertices;
 }
+
+// Axis-aligned box of solid geometry, such as a slab of a wall.
+struct SolidBox {
+  Aabb box;
+  glm::vec3 color{1, 1, 1};
+};
+
+struct BoxSurfaceReport {
+  size_t numBoxes = 0;
+  size_t numTrianglesBefore = 0;
+  size_t numTrianglesAfter = 0;
+
+  // Area of the faces of every box, and of the parts left visible,
+  // which bounds the fragments rasterized with all of them in view.
+  float areaBefore = 0;
+  float areaAfter = 0;
+
+  inline BoxSurfaceReport& operator+=(BoxSurfaceReport const& other) {
+    numBoxes += other.numBoxes;
+    numTrianglesBefore += other.numTrianglesBefore;
+    numTrianglesAfter += other.numTrianglesAfter;
+    areaBefore += other.areaBefore;
+    areaAfter += other.areaAfter;
+    return *this;
+  }
+};
+
+inline std::ostream& operator<<(std::ostream& out,
+                                BoxSurfaceReport const& report) {
+  auto hidden = report.areaBefore > 0
+                    ? 100 * (1 - report.areaAfter / report.areaBefore)
+                    : 0.0f;
+  return out << report.numBoxes << " boxes, " << report.numTrianglesBefore
+             << " -> " << report.numTrianglesAfter << " triangles, "
+             << report.areaBefore << " -> " << report.areaAfter
+             << " square units of faces, " << hidden << "% hidden";
+}
+
+// Appends the triangles of the faces of boxes, as cubeVertices would
+// with uvScale equal to the size of each box, leaving out the parts of
+// faces lying inside an occluder, or pressed against one. Faces are cut
+// into rectangles around the parts left out, with texture coordinates
+// kept in place. Occluders may include the boxes themselves, since no
+// box hides its own faces.
+inline BoxSurfaceReport boxSurfaceVertices(
+    std::vector<SolidBox> const& boxes, std::vector<Aabb> const& occluders,
+    std::vector<VPositionColorTexcoord>& vertices) {
+  // Planes closer than this are coplanar, and parts of faces narrower
+  // than it are dropped.
+  constexpr float tolerance = 1e-3f;
+
+  // Faces in the order of cubeVertices, with the axes along which their
+  // texture coordinates grow, measured from the box's min or max.
+  struct Face {
+    int axis;
+    bool isPositive;
+    int sAxis;
+    bool isSFromMax;
+    int tAxis;
+    bool isTFromMax;
+  };
+  static constexpr std::array<Face, 6> faces = {{
+      {2, false, 0, false, 1, true},   // south
+      {1, false, 0, false, 2, false},  // down
+      {0, false, 2, true, 1, true},    // west
+      {0, true, 2, false, 1, true},    // east
+      {2, true, 0, true, 1, true},     // north
+      {1, true, 0, false, 2, true},    // up
+  }};
+
+  // Rectangle in texture coordinates, [s0, s1] x [t0, t1].
+  struct Rect {
+    float s0, s1, t0, t1;
+  };
+
+  auto report = BoxSurfaceReport{};
+  report.numBoxes = boxes.size();
+
+  auto rects = std::vector<Rect>{};
+  auto remaining = std::vector<Rect>{};
+  for (auto const& [box, color] : boxes) {
+    for (auto const& face : faces) {
+      auto const& lo = box.min;
+      auto const& hi = box.max;
+      auto plane = face.isPositive ? hi[face.axis] : lo[face.axis];
+
+      // Texture coordinate of a world coordinate, and back.
+      auto toS = [&](float x) {
+        return face.isSFromMax ? hi[face.sAxis] - x : x - lo[face.sAxis];
+      };
+      auto toT = [&](float x) {
+        return face.isTFromMax ? hi[face.tAxis] - x : x - lo[face.tAxis];
+      };
+      auto position = [&](float s, float t) {
+        auto p = glm::vec3{};
+        p[face.axis] = plane;
+        p[face.sAxis] = face.isSFromMax ? hi[face.sAxis] - s
+                                        : lo[face.sAxis] + s;
+        p[face.tAxis] = face.isTFromMax ? hi[face.tAxis] - t
+                                        : lo[face.tAxis] + t;
+        return p;
+      };
+
+      auto size = hi - lo;
+      report.areaBefore += size[face.sAxis] * size[face.tAxis];
+      report.numTrianglesBefore += 2;
+
+      rects.assign({{0, size[face.sAxis], 0, size[face.tAxis]}});
+      for (auto const& occluder : occluders) {
+        // The occluder must fill the space right in front of the face.
+        auto front = plane + (face.isPositive ? tolerance : -tolerance);
+        if (!(occluder.min[face.axis] < front &&
+              front < occluder.max[face.axis])) {
+          continue;
+        }
+
+        auto sA = toS(occluder.min[face.sAxis]);
+        auto sB = toS(occluder.max[face.sAxis]);
+        auto tA = toT(occluder.min[face.tAxis]);
+        auto tB = toT(occluder.max[face.tAxis]);
+        auto hole = Rect{std::min(sA, sB), std::max(sA, sB), std::min(tA, tB),
+                         std::max(tA, tB)};
+
+        remaining.clear();
+        for (auto const& rect : rects) {
+          auto s0 = std::max(rect.s0, hole.s0);
+          auto s1 = std::min(rect.s1, hole.s1);
+          auto t0 = std::max(rect.t0, hole.t0);
+          auto t1 = std::min(rect.t1, hole.t1);
+          if (s1 - s0 <= tolerance || t1 - t0 <= tolerance) {
+            remaining.push_back(rect);
+            continue;
+          }
+
+          // Full width strips before and after the hole, then the parts
+          // beside it.
+          auto pieces = std::array<Rect, 4>{
+              {{rect.s0, rect.s1, rect.t0, t0},
+               {rect.s0, rect.s1, t1, rect.t1},
+               {rect.s0, s0, t0, t1},
+               {s1, rect.s1, t0, t1}}};
+          for (auto const& piece : pieces) {
+            if (piece.s1 - piece.s0 > tolerance &&
+                piece.t1 - piece.t0 > tolerance) {
+              remaining.push_back(piece);
+            }
+          }
+        }
+        std::swap(rects, remaining);
+      }
+
+      for (auto const& [s0, s1, t0, t1] : rects) {
+        vertices.push_back({position(s0, t0), color, {s0, t0}});
+        vertices.push_back({position(s1, t0), color, {s1, t0}});
+        vertices.push_back({position(s1, t1), color, {s1, t1}});
+        vertices.push_back({position(s1, t1), color, {s1, t1}});
+        vertices.push_back({position(s0, t1), color, {s0, t1}});
+        vertices.push_back({position(s0, t0), color, {s0, t0}});
+        report.areaAfter += (s1 - s0) * (t1 - t0);
+        report.numTrianglesAfter += 2;
+      }
+    }
+  }
+  return report;
+}
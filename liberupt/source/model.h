@@ -1,7 +1,18 @@
 #pragma once
 
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/euler_angles.hpp>
+#include <glm/gtx/transform.hpp>
+#undef GLM_ENABLE_EXPERIMENTAL
+#else
+#include <glm/gtx/euler_angles.hpp>
+#include <glm/gtx/transform.hpp>
+#endif
+
 #include "mesh.h"
 #include "texture.h"
+#include "transform_hierarchy.h"
 
 class Model {
  private:
@@ -11,6 +22,13 @@ class Model {
   glm::vec3 m_scale = {1, 1, 1};
   glm::vec3 m_euler = {0, 0, 0};
 
+  // Where the transform lives once attached, instead of the above.
+  TransformHierarchy* m_pTransforms = nullptr;
+  TransformHierarchy::Handle m_transformHandle = TransformHierarchy::none;
+
+  // Level of detail drawn last, which the next selection leans towards.
+  mutable size_t m_lodLevel = 0;
+
  public:
   inline Model(Mesh& mesh, Texture& texture)
       : m_pMesh(&mesh), m_pTexture(&texture) {}
@@ -21,13 +39,64 @@ class Model {
 
   GETTER(mesh, *m_pMesh)
   GETTER(texture, *m_pTexture)
-  GETTER(position, m_position)
-  GETTER(scale, m_scale)
-  GETTER(euler, m_euler)
+  inline glm::vec3 const& position() const {
+    return m_pTransforms ? m_pTransforms->position(m_transformHandle)
+                         : m_position;
+  }
+  inline glm::vec3 const& scale() const {
+    return m_pTransforms ? m_pTransforms->scale(m_transformHandle) : m_scale;
+  }
+  inline glm::vec3 const& euler() const {
+    return m_pTransforms ? m_pTransforms->euler(m_transformHandle) : m_euler;
+  }
+
+  inline void setPosition(glm::vec3 const& position) {
+    if (m_pTransforms) m_pTransforms->setPosition(m_transformHandle, position);
+    else m_position = position;
+  }
+  inline void setScale(glm::vec3 const& scale) {
+    if (m_pTransforms) m_pTransforms->setScale(m_transformHandle, scale);
+    else m_scale = scale;
+  }
+  inline void setEuler(glm::vec3 const& euler) {
+    if (m_pTransforms) m_pTransforms->setEuler(m_transformHandle, euler);
+    else m_euler = euler;
+  }
+
+  // Moves the model's transform into a hierarchy, where it can be
+  // parented and its matrix is computed by TransformHierarchy::update
+  // rather than on every call to transform. The handle takes the
+  // model's current position, scale and angles.
+  inline void attachTransform(TransformHierarchy& transforms,
+                              TransformHierarchy::Handle handle) {
+    crashIf(m_pTransforms);
+    transforms.setPosition(handle, m_position);
+    transforms.setScale(handle, m_scale);
+    transforms.setEuler(handle, m_euler);
+    m_pTransforms = &transforms;
+    m_transformHandle = handle;
+  }
+
+  inline bool hasTransformHandle() const noexcept { return m_pTransforms; }
+  GETTER(transformHandle, m_transformHandle)
+
+  GETTER(lodLevel, m_lodLevel)
+
+  // Updated by the renderer as it draws the model.
+  inline void setLodLevel(size_t level) const noexcept { m_lodLevel = level; }
+
+  // World matrix. For attached models, as of the hierarchy's last
+  // update.
+  inline glm::mat4 transform() const {
+    if (m_pTransforms) return m_pTransforms->worldMatrix(m_transformHandle);
+    return glm::translate(m_position) * glm::scale(m_scale) *
+           glm::eulerAngleYXZ(m_euler.y, m_euler.x, m_euler.z);
+  }
 
-  SETTER(setPosition, m_position)
-  SETTER(setScale, m_scale)
-  SETTER(setEuler, m_euler)
+  // Bounds of the transformed mesh, in world coordinates.
+  inline Aabb worldBounds() const {
+    return transformBox(transform(), m_pMesh->boundingBox());
+  }
 
   inline virtual ~Model() = default;
 };
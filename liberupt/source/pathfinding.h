@@ -0,0 +1,868 @@
+#pragma once
+
+#include <limits>
+#include <optional>
+#include <queue>
+
+#include "tilemap.h"
+#include "worker_pool.h"
+
+// Grid pathfinding over one layer of a tilemap. Movement is 8-connected,
+// with diagonal steps only allowed when both orthogonally adjacent
+// tiles are walkable, so paths never cut corners. Straight steps cost 1
+// and diagonal steps sqrt(2).
+//
+// Paths are returned as waypoints, starting with the start tile and
+// ending with the goal tile, where each waypoint is reached from the
+// previous one along a straight or diagonal line (see expandPath).
+
+constexpr float diagonalStepCost = 1.41421356f;
+
+// Neighbor offsets, counterclockwise starting east. Odd directions are
+// diagonal.
+constexpr int8_t gridNeighborDx[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+constexpr int8_t gridNeighborDy[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+inline float octileDistance(glm::i64vec2 const& a,
+                            glm::i64vec2 const& b) noexcept {
+  auto dx = static_cast<float>(std::abs(a.x - b.x));
+  auto dy = static_cast<float>(std::abs(a.y - b.y));
+  return std::max(dx, dy) + (diagonalStepCost - 1) * std::min(dx, dy);
+}
+
+inline uint64_t gridTileKey(glm::i64vec2 const& tile) noexcept {
+  return static_cast<uint64_t>(tile.x) | static_cast<uint64_t>(tile.y) << 32;
+}
+
+inline glm::i64vec2 gridTileFromKey(uint64_t key) noexcept {
+  return {static_cast<int64_t>(key & 0xffffffff),
+          static_cast<int64_t>(key >> 32)};
+}
+
+// Lists every tile along a path of waypoints.
+inline std::vector<glm::u64vec2> expandPath(
+    std::vector<glm::u64vec2> const& waypoints) {
+  auto tiles = std::vector<glm::u64vec2>{};
+  if (waypoints.empty()) return tiles;
+
+  tiles.push_back(waypoints.front());
+  for (size_t i = 1; i < waypoints.size(); ++i) {
+    auto pos = glm::i64vec2(waypoints[i - 1]);
+    auto end = glm::i64vec2(waypoints[i]);
+    auto step = glm::i64vec2((end.x > pos.x) - (end.x < pos.x),
+                             (end.y > pos.y) - (end.y < pos.y));
+    while (pos != end) {
+      pos += step;
+      tiles.push_back(glm::u64vec2(pos));
+    }
+  }
+  return tiles;
+}
+
+// Walkability of the tiles in [min, max), one byte per tile, row by row.
+template <typename IsWalkable>
+void gridWalkableMask(glm::i64vec2 const& min, glm::i64vec2 const& max,
+                      IsWalkable& isWalkable, std::vector<uint8_t>& mask) {
+  mask.resize((max.x - min.x) * (max.y - min.y));
+  auto i = size_t{0};
+  for (auto y = min.y; y < max.y; ++y) {
+    for (auto x = min.x; x < max.x; ++x) mask[i++] = isWalkable(x, y);
+  }
+}
+
+// Dijkstra distances from source to every tile in [min, max), moving
+// only within the rectangle. Unreachable tiles are left infinite.
+inline void gridDistances(glm::i64vec2 const& min, glm::i64vec2 const& max,
+                          std::vector<uint8_t> const& mask,
+                          glm::i64vec2 const& source,
+                          std::vector<float>& distances) {
+  using Entry = std::pair<float, size_t>;
+
+  auto width = max.x - min.x;
+  auto height = max.y - min.y;
+  distances.assign(width * height, std::numeric_limits<float>::infinity());
+
+  auto isOpen = [&](int64_t x, int64_t y) {
+    return x >= 0 && y >= 0 && x < width && y < height && mask[y * width + x];
+  };
+
+  auto local = source - min;
+  if (!isOpen(local.x, local.y)) return;
+
+  auto queue =
+      std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>{};
+  distances[local.y * width + local.x] = 0;
+  queue.push({0.0f, local.y * width + local.x});
+
+  while (!queue.empty()) {
+    auto [distance, index] = queue.top();
+    queue.pop();
+    if (distance > distances[index]) continue;
+
+    auto x = static_cast<int64_t>(index % width);
+    auto y = static_cast<int64_t>(index / width);
+
+    for (size_t dir = 0; dir < 8; ++dir) {
+      auto dx = gridNeighborDx[dir];
+      auto dy = gridNeighborDy[dir];
+      if (!isOpen(x + dx, y + dy)) continue;
+      if (dir % 2 && !(isOpen(x + dx, y) && isOpen(x, y + dy))) continue;
+
+      auto next = (y + dy) * width + x + dx;
+      auto nextDistance = distance + (dir % 2 ? diagonalStepCost : 1.0f);
+      if (nextDistance < distances[next]) {
+        distances[next] = nextDistance;
+        queue.push({nextDistance, static_cast<size_t>(next)});
+      }
+    }
+  }
+}
+
+// Jump point search, which finds the same shortest paths as A* but
+// skips over the runs of tiles that symmetric paths share, only adding
+// the jump points where paths can branch to the open list.
+// isWalkable(x, y) must return false for tiles outside the map.
+template <typename IsWalkable>
+class JumpPointSearch {
+ private:
+  struct Node {
+    float cost;
+    uint64_t parent;
+    bool closed;
+  };
+
+  using Entry = std::pair<float, uint64_t>;
+
+  IsWalkable& m_isWalkable;
+  glm::i64vec2 m_goal;
+
+  inline bool isOpen(int64_t x, int64_t y) { return m_isWalkable(x, y); }
+
+  // First jump point reached stepping from pos in dir, which is either
+  // the goal or a tile with neighbors that must be looked at.
+  std::optional<glm::i64vec2> jump(glm::i64vec2 pos, glm::i64vec2 const& dir) {
+    while (true) {
+      auto x = pos.x;
+      auto y = pos.y;
+      if (!isOpen(x, y)) return std::nullopt;
+      if (pos == m_goal) return pos;
+
+      if (dir.x != 0 && dir.y != 0) {
+        if (jump({x + dir.x, y}, {dir.x, 0}) ||
+            jump({x, y + dir.y}, {0, dir.y})) {
+          return pos;
+        }
+      } else if (dir.x != 0) {
+        if ((isOpen(x, y - 1) && !isOpen(x - dir.x, y - 1)) ||
+            (isOpen(x, y + 1) && !isOpen(x - dir.x, y + 1))) {
+          return pos;
+        }
+      } else {
+        if ((isOpen(x - 1, y) && !isOpen(x - 1, y - dir.y)) ||
+            (isOpen(x + 1, y) && !isOpen(x + 1, y - dir.y))) {
+          return pos;
+        }
+      }
+
+      if (!isOpen(x + dir.x, y) || !isOpen(x, y + dir.y)) return std::nullopt;
+      pos += dir;
+    }
+  }
+
+  // Directions worth searching from pos when arriving along dir, or all
+  // of them at the start.
+  template <typename Fn>
+  void forEachSuccessorDirection(glm::i64vec2 const& pos,
+                                 glm::i64vec2 const& dir, Fn&& fn) {
+    auto x = pos.x;
+    auto y = pos.y;
+
+    if (dir == glm::i64vec2{0, 0}) {
+      for (size_t i = 0; i < 8; ++i) {
+        auto dx = gridNeighborDx[i];
+        auto dy = gridNeighborDy[i];
+        if (i % 2 && !(isOpen(x + dx, y) && isOpen(x, y + dy))) continue;
+        fn(glm::i64vec2(dx, dy));
+      }
+    } else if (dir.x != 0 && dir.y != 0) {
+      auto isVerticalOpen = isOpen(x, y + dir.y);
+      auto isHorizontalOpen = isOpen(x + dir.x, y);
+      if (isVerticalOpen) fn(glm::i64vec2(0, dir.y));
+      if (isHorizontalOpen) fn(glm::i64vec2(dir.x, 0));
+      if (isVerticalOpen && isHorizontalOpen) fn(dir);
+    } else if (dir.x != 0) {
+      auto isNextOpen = isOpen(x + dir.x, y);
+      auto isBelowOpen = isOpen(x, y + 1);
+      auto isAboveOpen = isOpen(x, y - 1);
+      if (isNextOpen) {
+        fn(dir);
+        if (isBelowOpen) fn(glm::i64vec2(dir.x, 1));
+        if (isAboveOpen) fn(glm::i64vec2(dir.x, -1));
+      }
+      if (isBelowOpen) fn(glm::i64vec2(0, 1));
+      if (isAboveOpen) fn(glm::i64vec2(0, -1));
+    } else {
+      auto isNextOpen = isOpen(x, y + dir.y);
+      auto isRightOpen = isOpen(x + 1, y);
+      auto isLeftOpen = isOpen(x - 1, y);
+      if (isNextOpen) {
+        fn(dir);
+        if (isRightOpen) fn(glm::i64vec2(1, dir.y));
+        if (isLeftOpen) fn(glm::i64vec2(-1, dir.y));
+      }
+      if (isRightOpen) fn(glm::i64vec2(1, 0));
+      if (isLeftOpen) fn(glm::i64vec2(-1, 0));
+    }
+  }
+
+ public:
+  inline JumpPointSearch(IsWalkable& isWalkable) : m_isWalkable{isWalkable} {}
+
+  // Returns no waypoints when the goal cannot be reached.
+  std::vector<glm::u64vec2> findPath(glm::u64vec2 const& start,
+                                     glm::u64vec2 const& goal) {
+    m_goal = glm::i64vec2(goal);
+    auto startPos = glm::i64vec2(start);
+    if (!isOpen(startPos.x, startPos.y) || !isOpen(m_goal.x, m_goal.y)) {
+      return {};
+    }
+
+    auto nodes = std::unordered_map<uint64_t, Node>{};
+    auto queue =
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>{};
+
+    auto startKey = gridTileKey(startPos);
+    nodes[startKey] = {0, startKey, false};
+    queue.push({octileDistance(startPos, m_goal), startKey});
+
+    while (!queue.empty()) {
+      auto key = queue.top().second;
+      queue.pop();
+
+      auto& node = nodes[key];
+      if (node.closed) continue;
+      node.closed = true;
+
+      auto pos = gridTileFromKey(key);
+      if (pos == m_goal) {
+        auto path = std::vector<glm::u64vec2>{};
+        for (auto k = key; k != startKey; k = nodes[k].parent) {
+          path.push_back(glm::u64vec2(gridTileFromKey(k)));
+        }
+        path.push_back(start);
+        std::reverse(path.begin(), path.end());
+        return path;
+      }
+
+      auto parent = gridTileFromKey(node.parent);
+      auto dir = glm::i64vec2((pos.x > parent.x) - (pos.x < parent.x),
+                              (pos.y > parent.y) - (pos.y < parent.y));
+
+      forEachSuccessorDirection(pos, dir, [&](glm::i64vec2 const& next) {
+        auto jumpPoint = jump(pos + next, next);
+        if (!jumpPoint) return;
+
+        auto cost = node.cost + octileDistance(pos, *jumpPoint);
+        auto [it, inserted] = nodes.try_emplace(
+            gridTileKey(*jumpPoint),
+            Node{std::numeric_limits<float>::infinity(), 0, false});
+        if (it->second.closed || cost >= it->second.cost) return;
+
+        it->second.cost = cost;
+        it->second.parent = key;
+        queue.push({cost + octileDistance(*jumpPoint, m_goal), it->first});
+      });
+    }
+    return {};
+  }
+};
+
+// Shortest distances to a target over a window of the map, with the
+// step to take from each tile to get closer. Shared by every agent
+// heading for the same target.
+class FlowField {
+ public:
+  static constexpr uint8_t noDirection = 0xff;
+
+ private:
+  glm::u64vec2 m_target;
+  glm::u64vec2 m_min;
+  glm::u64vec2 m_max;
+  uint64_t m_revision;
+
+  std::vector<float> m_distances;
+  std::vector<uint8_t> m_directions;
+
+  inline size_t indexOf(glm::u64vec2 const& tile) const noexcept {
+    return (tile.y - m_min.y) * (m_max.x - m_min.x) + tile.x - m_min.x;
+  }
+
+ public:
+  inline FlowField(glm::u64vec2 const& target, glm::u64vec2 const& min,
+                   glm::u64vec2 const& max) noexcept
+      : m_target{target}, m_min{min}, m_max{max}, m_revision{0} {}
+
+  // Runs Dijkstra outwards from the target, moving only inside the
+  // window, and records the revision of the tilemap it was built from.
+  template <typename IsWalkable>
+  void build(IsWalkable& isWalkable, uint64_t revision) {
+    auto min = glm::i64vec2(m_min);
+    auto max = glm::i64vec2(m_max);
+    auto width = max.x - min.x;
+
+    auto mask = std::vector<uint8_t>{};
+    gridWalkableMask(min, max, isWalkable, mask);
+    gridDistances(min, max, mask, glm::i64vec2(m_target), m_distances);
+    m_revision = revision;
+
+    auto isOpen = [&](int64_t x, int64_t y) {
+      return x >= 0 && y >= 0 && x < width && y < max.y - min.y &&
+             mask[y * width + x];
+    };
+
+    // Point every tile at its closest neighbor.
+    m_directions.assign(m_distances.size(), noDirection);
+    for (size_t i = 0; i < m_distances.size(); ++i) {
+      auto best = m_distances[i];
+      if (best == std::numeric_limits<float>::infinity()) continue;
+
+      auto x = static_cast<int64_t>(i % width);
+      auto y = static_cast<int64_t>(i / width);
+      for (uint8_t dir = 0; dir < 8; ++dir) {
+        auto dx = gridNeighborDx[dir];
+        auto dy = gridNeighborDy[dir];
+        if (!isOpen(x + dx, y + dy)) continue;
+        if (dir % 2 && !(isOpen(x + dx, y) && isOpen(x, y + dy))) continue;
+
+        auto distance = m_distances[(y + dy) * width + x + dx];
+        if (distance < best) {
+          best = distance;
+          m_directions[i] = dir;
+        }
+      }
+    }
+  }
+
+  inline bool contains(glm::u64vec2 const& tile) const noexcept {
+    return tile.x >= m_min.x && tile.y >= m_min.y && tile.x < m_max.x &&
+           tile.y < m_max.y;
+  }
+
+  // Path length to the target, infinite when out of reach.
+  inline float distanceAt(glm::u64vec2 const& tile) const noexcept {
+    if (!contains(tile)) return std::numeric_limits<float>::infinity();
+    return m_distances[indexOf(tile)];
+  }
+
+  // Step towards the target, zero at the target and out of reach.
+  inline glm::ivec2 directionAt(glm::u64vec2 const& tile) const noexcept {
+    if (!contains(tile)) return {0, 0};
+    auto dir = m_directions[indexOf(tile)];
+    if (dir == noDirection) return {0, 0};
+    return {gridNeighborDx[dir], gridNeighborDy[dir]};
+  }
+
+  GETTER(target, m_target)
+  GETTER(min, m_min)
+  GETTER(max, m_max)
+  GETTER(revision, m_revision)
+};
+
+struct PathRequest {
+  glm::u64vec2 start;
+  glm::u64vec2 goal;
+};
+
+// Pathfinding for the agents of one tilemap layer. Short paths are found
+// with jump point search. Long paths are first planned on an abstract
+// graph of the map's clusters (HPA*), where clusters line up with the
+// tilemap's chunks, and then refined with jump point search between
+// consecutive abstract nodes. Many agents heading for the same target
+// share a cached flow field.
+//
+// Caches are invalidated by tile edits, using the tilemap's revisions:
+// update must be called after the tilemap was modified and before
+// paths are looked for, while flow fields are checked on every request.
+template <typename TileType>
+class Pathfinder {
+ public:
+  using IsBlocked = std::function<bool(TileType const&)>;
+  static constexpr uint64_t clusterSize = Tilemap<TileType>::chunkSize;
+
+  // Entrances at least this long get a transition at both ends rather
+  // than a single one in the middle.
+  static constexpr uint64_t longEntranceLength = 6;
+
+ private:
+  // Pair of facing tiles on each side of a cluster border.
+  struct Transition {
+    glm::u64vec2 a;
+    glm::u64vec2 b;
+  };
+
+  struct ClusterNode {
+    glm::u64vec2 tile;
+    std::vector<glm::u64vec2> partners;
+  };
+
+  struct Cluster {
+    std::vector<ClusterNode> nodes;
+
+    // Path lengths between every pair of nodes inside the cluster.
+    std::vector<float> costs;
+    uint64_t revision;
+  };
+
+  struct CachedFlowField {
+    std::unique_ptr<FlowField> pField;
+    uint64_t lastUse;
+  };
+
+  Tilemap<TileType> const& m_tilemap;
+  size_t m_layer;
+  IsBlocked m_isBlocked;
+
+  glm::u64vec2 m_numClusters;
+  std::vector<Cluster> m_clusters;
+
+  // Transitions between each cluster and its eastern and southern
+  // neighbors.
+  std::vector<std::vector<Transition>> m_eastTransitions;
+  std::vector<std::vector<Transition>> m_southTransitions;
+
+  bool m_isGraphBuilt;
+  uint64_t m_graphRevision;
+  size_t m_numRebuiltClusters;
+
+  std::unordered_map<uint64_t, CachedFlowField> m_flowFields;
+  size_t m_maxFlowFields;
+  uint64_t m_flowFieldRadius;
+  uint64_t m_flowFieldUses;
+
+  // Walkability test over the layer, for use by a single thread.
+  inline auto walkableTest() const {
+    return [this, readTile = typename Tilemap<TileType>::Storage::Reader(
+                      m_tilemap.tiles())](int64_t x, int64_t y) mutable {
+      auto const& size = m_tilemap.size();
+      if (x < 0 || y < 0 || static_cast<uint64_t>(x) >= size.x ||
+          static_cast<uint64_t>(y) >= size.y) {
+        return false;
+      }
+      return !m_isBlocked(readTile({static_cast<uint64_t>(x),
+                                    static_cast<uint64_t>(y), m_layer}));
+    };
+  }
+
+  inline size_t clusterIndex(glm::u64vec2 const& tile) const noexcept {
+    return tile.y / clusterSize * m_numClusters.x + tile.x / clusterSize;
+  }
+
+  inline std::pair<glm::i64vec2, glm::i64vec2> clusterRect(
+      size_t index) const noexcept {
+    auto cx = index % m_numClusters.x;
+    auto cy = index / m_numClusters.x;
+    auto min = glm::u64vec2(cx * clusterSize, cy * clusterSize);
+    auto max = glm::min(min + clusterSize,
+                        glm::u64vec2(m_tilemap.size().x, m_tilemap.size().y));
+    return {glm::i64vec2(min), glm::i64vec2(max)};
+  }
+
+  // Finds the transitions along a border, given the first pair of
+  // facing tiles and the step along it.
+  template <typename IsWalkable>
+  void buildTransitions(glm::i64vec2 a, glm::i64vec2 b,
+                        glm::i64vec2 const& step, int64_t length,
+                        IsWalkable& isWalkable,
+                        std::vector<Transition>& transitions) {
+    transitions.clear();
+
+    auto addTransition = [&](int64_t offset) {
+      transitions.push_back({glm::u64vec2(a + step * offset),
+                             glm::u64vec2(b + step * offset)});
+    };
+
+    auto runStart = int64_t{-1};
+    for (int64_t i = 0; i <= length; ++i) {
+      auto pa = a + step * i;
+      auto pb = b + step * i;
+      auto isOpen = i < length && isWalkable(pa.x, pa.y) &&
+                    isWalkable(pb.x, pb.y);
+
+      if (isOpen && runStart < 0) runStart = i;
+      if (!isOpen && runStart >= 0) {
+        auto runLength = i - runStart;
+        if (runLength < static_cast<int64_t>(longEntranceLength)) {
+          addTransition(runStart + runLength / 2);
+        } else {
+          addTransition(runStart);
+          addTransition(i - 1);
+        }
+        runStart = -1;
+      }
+    }
+  }
+
+  inline void addClusterNode(Cluster& cluster, glm::u64vec2 const& tile,
+                             glm::u64vec2 const& partner) {
+    for (auto& node : cluster.nodes) {
+      if (node.tile == tile) {
+        node.partners.push_back(partner);
+        return;
+      }
+    }
+    cluster.nodes.push_back({tile, {partner}});
+  }
+
+  template <typename IsWalkable>
+  void buildCluster(size_t index, IsWalkable& isWalkable) {
+    auto& cluster = m_clusters[index];
+    auto cx = index % m_numClusters.x;
+    auto cy = index / m_numClusters.x;
+
+    cluster.nodes.clear();
+    for (auto const& t : m_eastTransitions[index]) {
+      addClusterNode(cluster, t.a, t.b);
+    }
+    for (auto const& t : m_southTransitions[index]) {
+      addClusterNode(cluster, t.a, t.b);
+    }
+    if (cx > 0) {
+      for (auto const& t : m_eastTransitions[index - 1]) {
+        addClusterNode(cluster, t.b, t.a);
+      }
+    }
+    if (cy > 0) {
+      for (auto const& t : m_southTransitions[index - m_numClusters.x]) {
+        addClusterNode(cluster, t.b, t.a);
+      }
+    }
+
+    auto [min, max] = clusterRect(index);
+    auto width = max.x - min.x;
+    auto mask = std::vector<uint8_t>{};
+    auto distances = std::vector<float>{};
+    gridWalkableMask(min, max, isWalkable, mask);
+
+    auto numNodes = cluster.nodes.size();
+    cluster.costs.resize(numNodes * numNodes);
+    for (size_t i = 0; i < numNodes; ++i) {
+      gridDistances(min, max, mask, glm::i64vec2(cluster.nodes[i].tile),
+                    distances);
+      for (size_t j = 0; j < numNodes; ++j) {
+        auto local = glm::i64vec2(cluster.nodes[j].tile) - min;
+        cluster.costs[i * numNodes + j] = distances[local.y * width + local.x];
+      }
+    }
+    cluster.revision = m_tilemap.revision();
+  }
+
+  // Plans a path through the abstract graph, returning the start, the
+  // cluster nodes passed through and the goal.
+  template <typename IsWalkable>
+  std::vector<glm::u64vec2> findAbstractPath(glm::u64vec2 const& start,
+                                             glm::u64vec2 const& goal,
+                                             IsWalkable& isWalkable) const {
+    using Entry = std::pair<float, uint64_t>;
+
+    struct Node {
+      float cost;
+      uint64_t parent;
+      bool closed;
+    };
+
+    auto startCluster = clusterIndex(start);
+    auto goalCluster = clusterIndex(goal);
+
+    // Distances from the start and goal within their own clusters.
+    auto distancesWithin = [&](size_t index, glm::u64vec2 const& source,
+                               std::vector<float>& distances) {
+      auto [min, max] = clusterRect(index);
+      auto mask = std::vector<uint8_t>{};
+      gridWalkableMask(min, max, isWalkable, mask);
+      gridDistances(min, max, mask, glm::i64vec2(source), distances);
+      return std::pair{min, max.x - min.x};
+    };
+
+    auto startDistances = std::vector<float>{};
+    auto goalDistances = std::vector<float>{};
+    auto [startMin, startWidth] =
+        distancesWithin(startCluster, start, startDistances);
+    auto [goalMin, goalWidth] =
+        distancesWithin(goalCluster, goal, goalDistances);
+
+    auto localDistance = [](std::vector<float> const& distances,
+                            glm::i64vec2 const& min, int64_t width,
+                            glm::u64vec2 const& tile) {
+      auto local = glm::i64vec2(tile) - min;
+      return distances[local.y * width + local.x];
+    };
+
+    auto startKey = gridTileKey(glm::i64vec2(start));
+    auto goalKey = gridTileKey(glm::i64vec2(goal));
+    auto goalPos = glm::i64vec2(goal);
+
+    auto nodes = std::unordered_map<uint64_t, Node>{};
+    auto queue =
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>{};
+
+    auto relax = [&](glm::u64vec2 const& tile, uint64_t parent, float cost) {
+      if (cost == std::numeric_limits<float>::infinity()) return;
+      auto pos = glm::i64vec2(tile);
+      auto [it, inserted] = nodes.try_emplace(
+          gridTileKey(pos),
+          Node{std::numeric_limits<float>::infinity(), 0, false});
+      if (it->second.closed || cost >= it->second.cost) return;
+
+      it->second.cost = cost;
+      it->second.parent = parent;
+      queue.push({cost + octileDistance(pos, goalPos), it->first});
+    };
+
+    nodes[startKey] = {0, startKey, false};
+    queue.push({octileDistance(glm::i64vec2(start), goalPos), startKey});
+
+    while (!queue.empty()) {
+      auto key = queue.top().second;
+      queue.pop();
+
+      auto& node = nodes[key];
+      if (node.closed) continue;
+      node.closed = true;
+
+      auto tile = glm::u64vec2(gridTileFromKey(key));
+      if (key == goalKey) {
+        auto path = std::vector<glm::u64vec2>{};
+        for (auto k = key; k != startKey; k = nodes[k].parent) {
+          path.push_back(glm::u64vec2(gridTileFromKey(k)));
+        }
+        path.push_back(start);
+        std::reverse(path.begin(), path.end());
+        return path;
+      }
+
+      auto cost = node.cost;
+      if (key == startKey) {
+        for (auto const& next : m_clusters[startCluster].nodes) {
+          relax(next.tile, key,
+                cost + localDistance(startDistances, startMin, startWidth,
+                                     next.tile));
+        }
+      }
+
+      auto index = clusterIndex(tile);
+      auto const& cluster = m_clusters[index];
+      auto numNodes = cluster.nodes.size();
+      for (size_t i = 0; i < numNodes; ++i) {
+        if (cluster.nodes[i].tile != tile) continue;
+
+        for (size_t j = 0; j < numNodes; ++j) {
+          relax(cluster.nodes[j].tile, key,
+                cost + cluster.costs[i * numNodes + j]);
+        }
+        for (auto const& partner : cluster.nodes[i].partners) {
+          relax(partner, key, cost + 1);
+        }
+        if (index == goalCluster) {
+          relax(goal, key,
+                cost + localDistance(goalDistances, goalMin, goalWidth, tile));
+        }
+        break;
+      }
+    }
+    return {};
+  }
+
+ public:
+  inline Pathfinder(Tilemap<TileType> const& tilemap, size_t layer,
+                    IsBlocked isBlocked)
+      : m_tilemap{tilemap},
+        m_layer{layer},
+        m_isBlocked{std::move(isBlocked)},
+        m_isGraphBuilt{false},
+        m_graphRevision{0},
+        m_numRebuiltClusters{0},
+        m_maxFlowFields{16},
+        m_flowFieldRadius{64},
+        m_flowFieldUses{0} {
+    auto const& size = m_tilemap.size();
+    crashIf(layer >= size.z);
+    crashIf(size.x > std::numeric_limits<uint32_t>::max() ||
+            size.y > std::numeric_limits<uint32_t>::max());
+
+    m_numClusters = {(size.x + clusterSize - 1) / clusterSize,
+                     (size.y + clusterSize - 1) / clusterSize};
+    auto numClusters = m_numClusters.x * m_numClusters.y;
+    m_clusters.resize(numClusters);
+    m_eastTransitions.resize(numClusters);
+    m_southTransitions.resize(numClusters);
+  }
+
+  // Rebuilds the parts of the abstract graph affected by tile edits
+  // since the last update, building all of it the first time.
+  void update() {
+    m_numRebuiltClusters = 0;
+    if (m_isGraphBuilt && m_tilemap.revision() == m_graphRevision) return;
+
+    auto isWalkable = walkableTest();
+    auto numClusters = m_clusters.size();
+
+    auto isDirty = std::vector<uint8_t>(numClusters);
+    for (size_t i = 0; i < numClusters; ++i) {
+      auto [min, max] = clusterRect(i);
+      isDirty[i] = !m_isGraphBuilt ||
+                   m_tilemap.regionRevision(glm::u64vec2(min),
+                                            glm::u64vec2(max), m_layer) >
+                       m_clusters[i].revision;
+    }
+
+    // Borders are shared by two clusters, and node sets by the clusters
+    // of each border.
+    auto isAffected = std::vector<uint8_t>(numClusters);
+    for (size_t i = 0; i < numClusters; ++i) {
+      if (!isDirty[i]) continue;
+
+      auto cx = i % m_numClusters.x;
+      auto cy = i / m_numClusters.x;
+      auto [min, max] = clusterRect(i);
+
+      if (cx + 1 < m_numClusters.x) {
+        buildTransitions({max.x - 1, min.y}, {max.x, min.y}, {0, 1},
+                         max.y - min.y, isWalkable, m_eastTransitions[i]);
+        isAffected[i + 1] = true;
+      }
+      if (cy + 1 < m_numClusters.y) {
+        buildTransitions({min.x, max.y - 1}, {min.x, max.y}, {1, 0},
+                         max.x - min.x, isWalkable, m_southTransitions[i]);
+        isAffected[i + m_numClusters.x] = true;
+      }
+      if (cx > 0) {
+        buildTransitions({min.x - 1, min.y}, {min.x, min.y}, {0, 1},
+                         max.y - min.y, isWalkable, m_eastTransitions[i - 1]);
+        isAffected[i - 1] = true;
+      }
+      if (cy > 0) {
+        buildTransitions({min.x, min.y - 1}, {min.x, min.y}, {1, 0},
+                         max.x - min.x, isWalkable,
+                         m_southTransitions[i - m_numClusters.x]);
+        isAffected[i - m_numClusters.x] = true;
+      }
+      isAffected[i] = true;
+    }
+
+    for (size_t i = 0; i < numClusters; ++i) {
+      if (!isAffected[i]) continue;
+      buildCluster(i, isWalkable);
+      ++m_numRebuiltClusters;
+    }
+
+    m_isGraphBuilt = true;
+    m_graphRevision = m_tilemap.revision();
+  }
+
+  // Returns no waypoints when the goal cannot be reached. Safe to call
+  // from several threads at once, as long as neither the tilemap nor
+  // the pathfinder is modified meanwhile.
+  std::vector<glm::u64vec2> findPath(glm::u64vec2 const& start,
+                                     glm::u64vec2 const& goal) const {
+    auto isWalkable = walkableTest();
+    auto search = JumpPointSearch<decltype(isWalkable)>(isWalkable);
+
+    auto startCluster = glm::i64vec2(start / clusterSize);
+    auto goalCluster = glm::i64vec2(goal / clusterSize);
+    auto clusterDistance = glm::abs(goalCluster - startCluster);
+    if (!m_isGraphBuilt ||
+        std::max(clusterDistance.x, clusterDistance.y) <= 1) {
+      return search.findPath(start, goal);
+    }
+
+    if (!isWalkable(start.x, start.y) || !isWalkable(goal.x, goal.y)) {
+      return {};
+    }
+
+    auto abstractPath = findAbstractPath(start, goal, isWalkable);
+    if (abstractPath.empty()) return {};
+
+    auto path = std::vector<glm::u64vec2>{start};
+    for (size_t i = 1; i < abstractPath.size(); ++i) {
+      auto segment = search.findPath(abstractPath[i - 1], abstractPath[i]);
+      if (segment.empty()) return {};
+      path.insert(path.end(), segment.begin() + 1, segment.end());
+    }
+    return path;
+  }
+
+  // Finds many paths at once, spreading them across the worker pool.
+  // paths is resized to match requests.
+  void findPaths(std::vector<PathRequest> const& requests,
+                 std::vector<std::vector<glm::u64vec2>>& paths,
+                 WorkerPool& pool = sharedWorkerPool()) const {
+    paths.resize(requests.size());
+    pool.parallelFor(requests.size(), 4, [&](size_t begin, size_t end) {
+      for (auto i = begin; i < end; ++i) {
+        paths[i] = findPath(requests[i].start, requests[i].goal);
+      }
+    });
+  }
+
+  // Flow field towards target, covering the tiles within the flow field
+  // radius. Fields are rebuilt once tiles in their window were edited,
+  // and the least recently used ones are dropped beyond the cache size,
+  // which invalidates references to them.
+  FlowField const& flowField(glm::u64vec2 const& target) {
+    auto const& size = m_tilemap.size();
+    crashIf(target.x >= size.x || target.y >= size.y);
+
+    auto key = gridTileKey(glm::i64vec2(target));
+    auto it = m_flowFields.find(key);
+    if (it != m_flowFields.end()) {
+      auto const& field = *it->second.pField;
+      if (m_tilemap.regionRevision(field.min(), field.max(), m_layer) >
+          field.revision()) {
+        m_flowFields.erase(it);
+        it = m_flowFields.end();
+      }
+    }
+
+    if (it == m_flowFields.end()) {
+      if (m_flowFields.size() >= m_maxFlowFields) {
+        auto oldest = std::min_element(
+            m_flowFields.begin(), m_flowFields.end(),
+            [](auto const& a, auto const& b) {
+              return a.second.lastUse < b.second.lastUse;
+            });
+        m_flowFields.erase(oldest);
+      }
+
+      auto min = glm::u64vec2(target.x - std::min(target.x, m_flowFieldRadius),
+                              target.y - std::min(target.y, m_flowFieldRadius));
+      auto max = glm::u64vec2(std::min(target.x + m_flowFieldRadius + 1, size.x),
+                              std::min(target.y + m_flowFieldRadius + 1, size.y));
+
+      auto pField = std::make_unique<FlowField>(target, min, max);
+      auto isWalkable = walkableTest();
+      pField->build(isWalkable, m_tilemap.revision());
+      it = m_flowFields.emplace(key, CachedFlowField{std::move(pField), 0})
+               .first;
+    }
+
+    it->second.lastUse = ++m_flowFieldUses;
+    return *it->second.pField;
+  }
+
+  inline void clearFlowFields() noexcept { m_flowFields.clear(); }
+
+  inline size_t clusterCount() const noexcept { return m_clusters.size(); }
+  inline size_t flowFieldCount() const noexcept { return m_flowFields.size(); }
+
+  GETTER(layer, m_layer)
+
+  // Clusters rebuilt by the last update.
+  GETTER(numRebuiltClusters, m_numRebuiltClusters)
+
+  // Flow fields extend this many tiles around their target.
+  GETTER(flowFieldRadius, m_flowFieldRadius)
+  SETTER(setFlowFieldRadius, m_flowFieldRadius)
+
+  GETTER(maxFlowFields, m_maxFlowFields)
+  SETTER(setMaxFlowFields, m_maxFlowFields)
+};
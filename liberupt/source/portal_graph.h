@@ -0,0 +1,199 @@
+#pragma once
+
+#include <optional>
+
+#include "bounding_volume.h"
+
+// Visibility between cells of a level, such as rooms, that can only see
+// into each other through portals, such as doorways. Starting from the
+// cell holding the camera, cells are walked through their portals while
+// the screen rectangle that remains visible shrinks to the portals
+// passed, so only cells actually seen through a chain of portals end up
+// visible.
+class PortalGraph {
+ public:
+  using CellIndex = size_t;
+
+  // Screen rectangle in NDC, as (min x, min y, max x, max y).
+  using ScreenRect = glm::vec4;
+
+ private:
+  struct Portal {
+    std::array<glm::vec3, 4> corners;
+    glm::vec3 center;
+    CellIndex cell;
+
+    // Portal of the neighboring cell facing this one, if any.
+    std::optional<size_t> linked;
+  };
+
+  struct Cell {
+    Aabb bounds;
+    std::vector<size_t> portals;
+  };
+
+  struct Visit {
+    CellIndex cell;
+    ScreenRect window;
+  };
+
+  // Portals whose centers are closer than this are taken to be the two
+  // sides of the same opening.
+  static constexpr float linkDistance = 0.01f;
+
+  std::vector<Cell> m_cells;
+  std::vector<Portal> m_portals;
+
+  std::vector<uint8_t> m_isVisible;
+  std::vector<ScreenRect> m_seenWindows;
+  size_t m_numVisibleCells;
+  size_t m_numPortalsTraversed;
+
+  static inline bool isEmpty(ScreenRect const& rect) noexcept {
+    return rect.x >= rect.z || rect.y >= rect.w;
+  }
+
+  static inline bool contains(ScreenRect const& outer,
+                              ScreenRect const& inner) noexcept {
+    return inner.x >= outer.x && inner.y >= outer.y && inner.z <= outer.z &&
+           inner.w <= outer.w;
+  }
+
+  static inline ScreenRect intersect(ScreenRect const& a,
+                                     ScreenRect const& b) noexcept {
+    return {std::max(a.x, b.x), std::max(a.y, b.y), std::min(a.z, b.z),
+            std::min(a.w, b.w)};
+  }
+
+  // Screen bounds of a portal, clipped to the window it is seen through.
+  // Portals crossing the camera plane are kept conservatively, as the
+  // whole window.
+  static inline ScreenRect projectPortal(Portal const& portal,
+                                         glm::mat4 const& viewProjection,
+                                         ScreenRect const& window) noexcept {
+    constexpr auto minW = 1e-5f;
+
+    auto rect = ScreenRect{std::numeric_limits<float>::max(),
+                           std::numeric_limits<float>::max(),
+                           std::numeric_limits<float>::lowest(),
+                           std::numeric_limits<float>::lowest()};
+    auto numBehind = 0;
+
+    for (auto const& corner : portal.corners) {
+      auto clip = viewProjection * glm::vec4(corner, 1);
+      if (clip.w <= minW) {
+        ++numBehind;
+        continue;
+      }
+      auto ndc = glm::vec2(clip) / clip.w;
+      rect = {std::min(rect.x, ndc.x), std::min(rect.y, ndc.y),
+              std::max(rect.z, ndc.x), std::max(rect.w, ndc.y)};
+    }
+
+    if (numBehind == 4) return {0, 0, 0, 0};
+    if (numBehind > 0) return window;
+    return intersect(rect, window);
+  }
+
+ public:
+  inline PortalGraph() : m_numVisibleCells{0}, m_numPortalsTraversed{0} {}
+
+  inline CellIndex addCell(Aabb const& bounds) {
+    m_cells.push_back({bounds, {}});
+    return m_cells.size() - 1;
+  }
+
+  // Adds an opening in a cell's boundary, given by the corners of a
+  // planar quad. It is linked to the portal of another cell covering
+  // the same opening, in whatever order the two are added.
+  inline void addPortal(CellIndex cell,
+                        std::array<glm::vec3, 4> const& corners) {
+    crashIf(cell >= m_cells.size());
+
+    auto center = (corners[0] + corners[1] + corners[2] + corners[3]) / 4.0f;
+    auto index = m_portals.size();
+    m_portals.push_back({corners, center, cell, std::nullopt});
+    m_cells[cell].portals.push_back(index);
+
+    for (size_t i = 0; i < index; ++i) {
+      auto& other = m_portals[i];
+      if (!other.linked && other.cell != cell &&
+          glm::length(other.center - center) < linkDistance) {
+        other.linked = index;
+        m_portals[index].linked = i;
+        break;
+      }
+    }
+  }
+
+  inline std::optional<CellIndex> cellAt(
+      glm::vec3 const& point) const noexcept {
+    for (CellIndex i = 0; i < m_cells.size(); ++i) {
+      auto const& bounds = m_cells[i].bounds;
+      if (glm::all(glm::greaterThanEqual(point, bounds.min)) &&
+          glm::all(glm::lessThanEqual(point, bounds.max))) {
+        return i;
+      }
+    }
+    return std::nullopt;
+  }
+
+  // Finds the cells visible from a camera. When the camera is outside
+  // of every cell, all cells are considered visible.
+  void computeVisibility(glm::vec3 const& cameraPosition,
+                         glm::mat4 const& viewProjection) {
+    m_isVisible.assign(m_cells.size(), 0);
+    m_seenWindows.assign(m_cells.size(), {0, 0, 0, 0});
+    m_numPortalsTraversed = 0;
+
+    auto startCell = cellAt(cameraPosition);
+    if (!startCell) {
+      m_isVisible.assign(m_cells.size(), 1);
+      m_numVisibleCells = m_cells.size();
+      return;
+    }
+
+    // Cells reached again are only walked once more when seen through a
+    // part of the screen they were not seen through before.
+    auto pending = std::vector<Visit>{{*startCell, {-1, -1, 1, 1}}};
+    while (!pending.empty()) {
+      auto [cell, window] = pending.back();
+      pending.pop_back();
+
+      auto& seen = m_seenWindows[cell];
+      if (m_isVisible[cell] && contains(seen, window)) continue;
+
+      seen = m_isVisible[cell]
+                 ? ScreenRect{std::min(seen.x, window.x),
+                              std::min(seen.y, window.y),
+                              std::max(seen.z, window.z),
+                              std::max(seen.w, window.w)}
+                 : window;
+      m_isVisible[cell] = 1;
+
+      for (auto index : m_cells[cell].portals) {
+        auto const& portal = m_portals[index];
+        if (!portal.linked) continue;
+
+        auto clipped = projectPortal(portal, viewProjection, window);
+        if (isEmpty(clipped)) continue;
+
+        ++m_numPortalsTraversed;
+        pending.push_back({m_portals[*portal.linked].cell, clipped});
+      }
+    }
+
+    m_numVisibleCells = static_cast<size_t>(
+        std::count(m_isVisible.begin(), m_isVisible.end(), 1));
+  }
+
+  // As of the last computeVisibility, or true before the first one.
+  inline bool isCellVisible(CellIndex cell) const noexcept {
+    return cell >= m_isVisible.size() || m_isVisible[cell];
+  }
+
+  inline size_t cellCount() const noexcept { return m_cells.size(); }
+
+  GETTER(numVisibleCells, m_numVisibleCells)
+  GETTER(numPortalsTraversed, m_numPortalsTraversed)
+};
@@ -2,20 +2,372 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include <bit>
 #include <glm/gtx/euler_angles.hpp>
 #include <string>
 
-inline void renderMesh(VulkanContext& ctx, Mesh const& mesh) {
-  ctx.draw(mesh.vulkanVertexBuffer().buffer, mesh.vulkanIndexBuffer().buffer,
-           static_cast<uint32_t>(mesh.vertices().size()));
+// Number of triangles drawn for each instance of a mesh.
+inline size_t meshTriangleCount(Mesh const& mesh, size_t lod = 0) {
+  if (mesh.lods().empty()) return mesh.vertices().size() / 3;
+  return mesh.lods()[lod].indexCount / 3;
+}
+
+inline void renderMesh(VulkanContext& ctx, Mesh const& mesh,
+                       uint32_t instanceCount = 1, size_t lod = 0) {
+  auto ibuf = mesh.vulkanIndexBuffer().buffer;
+  if (!ibuf) {
+    ctx.draw(mesh.vulkanVertexBuffer().buffer, ibuf,
+             static_cast<uint32_t>(mesh.vertices().size()), instanceCount);
+    return;
+  }
+
+  auto const& range = mesh.lods()[lod];
+  ctx.draw(mesh.vulkanVertexBuffer().buffer, ibuf, range.indexCount,
+           instanceCount, mesh.indexType(), range.firstIndex);
+}
+
+// Sort key of a draw, along with the draw it belongs to.
+struct DrawKey {
+  uint64_t key;
+  uint32_t index;
+};
+
+// Sorts keys with a least significant digit radix sort, a byte at a
+// time, skipping bytes that all keys share, e.g. the pipeline bits when
+// every draw uses the same pipeline. Stable, using scratch as large as
+// keys for the passes.
+inline void radixSortDrawKeys(DrawKey* keys, DrawKey* scratch, size_t count) {
+  if (count < 2) return;
+
+  auto counts = std::array<std::array<uint32_t, 256>, 8>{};
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t byte = 0; byte < 8; ++byte) {
+      ++counts[byte][keys[i].key >> 8 * byte & 0xff];
+    }
+  }
+
+  auto* pSource = keys;
+  auto* pTarget = scratch;
+  for (size_t byte = 0; byte < 8; ++byte) {
+    auto& offsets = counts[byte];
+    if (offsets[pSource[0].key >> 8 * byte & 0xff] == count) continue;
+
+    auto offset = uint32_t{0};
+    for (auto& bucket : offsets) {
+      offset += std::exchange(bucket, offset);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      pTarget[offsets[pSource[i].key >> 8 * byte & 0xff]++] = pSource[i];
+    }
+    std::swap(pSource, pTarget);
+  }
+  if (pSource != keys) std::copy_n(pSource, count, keys);
 }
 
 void Renderer3d::renderModel(Model const& model) {
-  bindTextureSlot(0, model.texture());
-  setPushConstants(PCInstanceTransform{
-      glm::translate(model.position()) * glm::scale(model.scale()) *
-      glm::eulerAngleYXZ(model.euler().y, model.euler().x, model.euler().z)});
-  renderMesh(m_vulkanContext, model.mesh());
+  auto const& animation = model.texture().animation();
+  if (model.hasTransformHandle()) {
+    m_models.push_back({&model.mesh(),
+                        &model.texture(),
+                        {{}, {animation.frameCount, animation.framesPerSecond,
+                              0, 0}},
+                        {},
+                        0,
+                        &model});
+    return;
+  }
+
+  auto modelMatrix = model.transform();
+  auto bounds = transformSphere(modelMatrix, model.mesh().boundingSphere());
+
+  m_models.push_back(
+      {&model.mesh(),
+       &model.texture(),
+       {modelMatrix * model.mesh().positionDequantization(),
+        {animation.frameCount, animation.framesPerSecond, 0, 0}},
+       bounds,
+       static_cast<uint32_t>(selectLod(model, bounds)),
+       nullptr});
+}
+
+void Renderer3d::resolvePendingModels() {
+  m_transforms.update();
+  for (auto& draw : m_models) {
+    if (!draw.pPendingModel) continue;
+
+    auto const& model = *draw.pPendingModel;
+    auto const& modelMatrix = model.transform();
+    draw.instance.modelMatrix =
+        modelMatrix * model.mesh().positionDequantization();
+    draw.bounds = transformSphere(modelMatrix, model.mesh().boundingSphere());
+    draw.lod = static_cast<uint32_t>(selectLod(model, draw.bounds));
+    draw.pPendingModel = nullptr;
+  }
+}
+
+size_t Renderer3d::selectLod(Model const& model,
+                             BoundingSphere const& bounds) const {
+  auto const& mesh = model.mesh();
+  auto const& lods = mesh.lods();
+  if (lods.size() <= 1 || m_lodPixelError <= 0) return 0;
+
+  // Pixels covered by a unit of length at the point of the bounding
+  // sphere closest to the camera.
+  auto distance = std::max(
+      glm::length(bounds.center - m_camera3d.position()) - bounds.radius,
+      minLodDistance);
+  auto halfFov = glm::radians(m_camera3d.fovDegrees()) / 2;
+  auto pixelsPerUnit =
+      m_settings.resolution.y / (2 * distance * std::tan(halfFov));
+
+  // Level errors are in mesh units, scaled like the bounding sphere.
+  auto meshRadius = mesh.boundingSphere().radius;
+  auto scale = meshRadius > 0 ? bounds.radius / meshRadius : 1.0f;
+
+  // The coarsest level whose error stays below the threshold, where
+  // levels coarser than the one drawn last must stay further below it.
+  auto current = std::min(model.lodLevel(), lods.size() - 1);
+  auto level = size_t{0};
+  for (auto i = lods.size() - 1; i > 0; --i) {
+    auto threshold = m_lodPixelError;
+    if (i > current) threshold *= 1 - lodHysteresis;
+    if (lods[i].error * scale * pixelsPerUnit <= threshold) {
+      level = i;
+      break;
+    }
+  }
+
+  model.setLodLevel(level);
+  return level;
+}
+
+void Renderer3d::renderStaticModels(Bvh const& bvh,
+                                    std::vector<Model const*> const& models) {
+  crashIf(models.size() != bvh.itemCount());
+  bvh.forEachInFrustum(m_frustumPlanes,
+                       [&](uint32_t item) { renderModel(*models[item]); });
+}
+
+void Renderer3d::renderStaticScene(StaticScene const& scene) {
+  crashIf(!scene.isUploaded());
+  if (scene.instances().empty()) return;
+  if (!scene.isCulledOnDevice()) {
+    renderStaticSceneOnHost(scene);
+    return;
+  }
+
+  auto commands = scene.vulkanCommandBuffer().buffer;
+  if (std::find(m_culledStaticScenes.begin(), m_culledStaticScenes.end(),
+                commands) == m_culledStaticScenes.end()) {
+    m_culledStaticScenes.push_back(commands);
+
+    // Resets the instance counts of the commands, then lets every
+    // instance in view claim a slot in its command's instance range.
+    auto cull = PCCullStaticScene{};
+    std::copy(m_frustumPlanes.begin(), m_frustumPlanes.end(),
+              cull.frustumPlanes);
+    auto buffers = {scene.vulkanInstanceBuffer().buffer, commands,
+                    scene.vulkanVisibleBuffer().buffer};
+    auto groups = [](size_t count) {
+      return static_cast<uint32_t>(
+          (count + PCCullStaticScene::groupSize - 1) /
+          PCCullStaticScene::groupSize);
+    };
+
+    cull.count = scene.commandCount();
+    cull.isReset = 1;
+    m_vulkanContext.dispatch(m_cullStaticScenePipeline, buffers, &cull,
+                             groups(cull.count));
+
+    cull.count = static_cast<uint32_t>(scene.instances().size());
+    cull.isReset = 0;
+    m_vulkanContext.dispatch(m_cullStaticScenePipeline, buffers, &cull,
+                             groups(cull.count));
+    m_numStaticInstancesTestedOnDevice += scene.instances().size();
+  }
+
+  bindPipeline(VulkanContext::primaryPipeline);
+  m_vulkanContext.bindInstanceBuffer(scene.vulkanVisibleBuffer().buffer);
+  for (auto const& draw : scene.textureDraws()) {
+    bindTextureSlot(0, *draw.pTexture);
+    m_vulkanContext.drawIndexedIndirect(
+        scene.vulkanVertexBuffer().buffer, scene.vulkanIndexBuffer().buffer,
+        VK_INDEX_TYPE_UINT32, commands,
+        draw.firstCommand * sizeof(VkDrawIndexedIndirectCommand),
+        draw.commandCount);
+  }
+  m_numStaticDrawCommands += scene.commandCount();
+}
+
+void Renderer3d::renderStaticSceneOnHost(StaticScene const& scene) {
+  auto& arena = m_vulkanContext.frameArena();
+  auto commands = ArenaVector<VkDrawIndexedIndirectCommand>(arena);
+  auto instances = ArenaVector<VInstanceTransform>(arena);
+  auto pTexture = static_cast<Texture const*>(nullptr);
+  auto mesh = std::optional<StaticScene::MeshIndex>{};
+
+  bindPipeline(VulkanContext::primaryPipeline);
+
+  auto flush = [&] {
+    if (commands.empty()) return;
+    bindTextureSlot(0, *pTexture);
+    m_vulkanContext.setInstanceData(
+        instances.data(),
+        static_cast<uint32_t>(instances.size() * sizeof(VInstanceTransform)));
+    m_vulkanContext.drawIndexedIndirect(
+        scene.vulkanVertexBuffer().buffer, scene.vulkanIndexBuffer().buffer,
+        VK_INDEX_TYPE_UINT32, commands.data(),
+        static_cast<uint32_t>(commands.size()));
+
+    m_numStaticDrawCommands += commands.size();
+    for (auto const& command : commands) {
+      m_numTrianglesDrawn +=
+          size_t{command.instanceCount} * command.indexCount / 3;
+    }
+    commands.clear();
+    instances.clear();
+    mesh.reset();
+  };
+
+  // Instances come sorted by texture and mesh, so the visible instances
+  // of each mesh are contiguous, and one command draws them all.
+  for (auto const& instance : scene.instances()) {
+    if (!isSphereInFrustum(m_frustumPlanes, instance.bounds)) {
+      ++m_numStaticInstancesCulled;
+      continue;
+    }
+
+    if (instance.pTexture != pTexture ||
+        instances.size() == maxInstancesPerDraw) {
+      flush();
+      pTexture = instance.pTexture;
+    }
+
+    if (mesh != instance.mesh) {
+      auto const& range = scene.meshes()[instance.mesh];
+      commands.push_back({range.indexCount, 0, range.firstIndex,
+                          range.vertexOffset,
+                          static_cast<uint32_t>(instances.size())});
+      mesh = instance.mesh;
+    }
+
+    ++commands.back().instanceCount;
+    instances.push_back(instance.transform);
+    ++m_numStaticInstancesDrawn;
+  }
+  flush();
+}
+
+void Renderer3d::cullModels() {
+  constexpr size_t batchSize = 256;
+
+  auto numQueued = m_models.size();
+  auto numVisible = size_t{0};
+
+  // Spheres are tested a batch at a time, laid out as separate arrays
+  // per component so the plane tests compile to vector instructions.
+  alignas(32) float centerX[batchSize];
+  alignas(32) float centerY[batchSize];
+  alignas(32) float centerZ[batchSize];
+  alignas(32) float negRadius[batchSize];
+  alignas(32) uint8_t isVisible[batchSize];
+
+  for (size_t begin = 0; begin < numQueued; begin += batchSize) {
+    auto count = std::min(batchSize, numQueued - begin);
+    for (size_t i = 0; i < count; ++i) {
+      auto const& sphere = m_models[begin + i].bounds;
+      centerX[i] = sphere.center.x;
+      centerY[i] = sphere.center.y;
+      centerZ[i] = sphere.center.z;
+      negRadius[i] = -sphere.radius;
+      isVisible[i] = 1;
+    }
+
+    for (auto const& plane : m_frustumPlanes) {
+      for (size_t i = 0; i < count; ++i) {
+        auto distance = plane.x * centerX[i] + plane.y * centerY[i] +
+                        plane.z * centerZ[i] + plane.w;
+        isVisible[i] &= distance >= negRadius[i];
+      }
+    }
+
+    // Compact the visible models towards the front of the queue.
+    for (size_t i = 0; i < count; ++i) {
+      if (isVisible[i]) m_models[numVisible++] = m_models[begin + i];
+    }
+  }
+
+  m_models.resize(numVisible);
+  m_frameStats.modelsDrawn = numVisible;
+  m_frameStats.modelsCulled = numQueued - numVisible;
+}
+
+void Renderer3d::renderModels() {
+  resolvePendingModels();
+  cullModels();
+
+  // Keys hold, from the most significant bits, the pipeline (4 bits),
+  // texture (16), mesh (16) and level of detail (4), followed by the
+  // distance along the view direction (24), whose float bits, being
+  // positive, order like the distance itself. Draws sharing state end
+  // up next to each other, nearest first, so the depth test rejects
+  // more of the fragments hidden behind them.
+  auto pipelineOf = [&](ModelDraw const& draw) {
+    return draw.pMesh->vertexLayout() == VertexLayout::Packed
+               ? m_packedModelPipeline
+               : VulkanContext::primaryPipeline;
+  };
+  auto keys = ArenaVector<DrawKey>(m_vulkanContext.frameArena());
+  auto scratch = ArenaVector<DrawKey>(m_vulkanContext.frameArena());
+  keys.reserve(m_models.size());
+  scratch.resize(m_models.size());
+  for (size_t i = 0; i < m_models.size(); ++i) {
+    auto const& draw = m_models[i];
+    auto depth = std::max(
+        glm::dot(draw.bounds.center - m_viewPosition, m_viewDirection), 0.0f);
+    auto key = static_cast<uint64_t>(pipelineOf(draw) & 0xf) << 60 |
+               static_cast<uint64_t>(draw.pTexture->sortId()) << 44 |
+               static_cast<uint64_t>(draw.pMesh->sortId()) << 28 |
+               static_cast<uint64_t>(std::min(draw.lod, 15u)) << 24 |
+               std::bit_cast<uint32_t>(depth) >> 7;
+    keys.push_back({key, static_cast<uint32_t>(i)});
+  }
+  radixSortDrawKeys(keys.data(), scratch.data(), keys.size());
+
+  // Gather the instances of each run of models sharing a mesh, level of
+  // detail and texture, and draw them at once. Runs are told apart by
+  // the draws themselves, as distinct meshes or textures may share ids.
+  auto instances = ArenaVector<VInstanceTransform>(m_vulkanContext.frameArena());
+  for (size_t begin = 0; begin < keys.size();) {
+    auto const& first = m_models[keys[begin].index];
+    auto end = begin;
+    while (end < keys.size() && end - begin < maxInstancesPerDraw &&
+           m_models[keys[end].index].pMesh == first.pMesh &&
+           m_models[keys[end].index].lod == first.lod &&
+           m_models[keys[end].index].pTexture == first.pTexture) {
+      ++end;
+    }
+
+    instances.clear();
+    for (auto i = begin; i < end; ++i) {
+      instances.push_back(m_models[keys[i].index].instance);
+    }
+
+    // Binding state that is bound already records nothing.
+    bindPipeline(pipelineOf(first));
+    bindTextureSlot(0, *first.pTexture);
+    m_vulkanContext.setInstanceData(
+        instances.data(),
+        static_cast<uint32_t>(instances.size() * sizeof(VInstanceTransform)));
+    renderMesh(m_vulkanContext, *first.pMesh,
+               static_cast<uint32_t>(end - begin), first.lod);
+    m_numTrianglesDrawn +=
+        (end - begin) * meshTriangleCount(*first.pMesh, first.lod);
+    begin = end;
+  }
+
+  // Drop this frame's models while the arena still holds them.
+  resetModels();
 }
 
 void Renderer::materialize(VulkanPipelineSettings const& pipelineSettings) {
@@ -32,29 +384,92 @@ void Renderer::materialize(VulkanPipelineSettings const& pipelineSettings) {
   glfwShowWindow(m_pWindow);
 }
 
+void Renderer2d::renderSpriteBatch(USpriteBatch& batch, size_t numSprites,
+                                   Texture const& texture) {
+  auto const& animation = texture.animation();
+  batch.animation = {animation.frameCount, animation.framesPerSecond, time(),
+                     0};
+
+  setUniforms(batch);
+  m_vulkanContext.draw(m_spriteBatchMesh.vulkanVertexBuffer().buffer,
+                       VK_NULL_HANDLE, static_cast<uint32_t>(6 * numSprites));
+}
+
+void Renderer2d::renderTilemaps() {
+  if (m_tilemapChunks.empty() && m_tilemapLayers.empty()) return;
+
+  auto worldToNdc = m_camera2d.worldToNdcTransform();
+
+  bindPipeline(m_tilemapPipeline);
+  for (auto const& chunk : m_tilemapChunks) {
+    bindTextureSlot(0, *chunk.pTileset);
+    setPushConstants(PCTilemapChunk{worldToNdc, chunk.depth});
+    renderMesh(m_vulkanContext, *chunk.pMesh);
+  }
+
+  // Layers are drawn as a single quad each, reusing the first
+  // quad of the sprite batch mesh.
+  bindPipeline(m_tilemapLayerPipeline);
+  for (auto const& layer : m_tilemapLayers) {
+    bindTextureSlot(0, *layer.pTileset);
+    bindTextureSlot(1, *layer.pTileIndices);
+    setPushConstants(layer.layer);
+    m_vulkanContext.draw(m_spriteBatchMesh.vulkanVertexBuffer().buffer,
+                         VK_NULL_HANDLE, 6);
+  }
+
+  bindPipeline(VulkanContext::primaryPipeline);
+}
+
 void Renderer2d::renderSpriteBatches() {
-  for (auto const& layer : m_layerSpriteBatches) {
-    for (auto const& [pTexture, mapEntry] : layer) {
-      auto const& [numSprites, batches] = mapEntry;
-
-      // Clear sprite batch data behind last entry in last batch.
-      auto emptyBytes =
-          (USpriteBatch::size - 1) - (numSprites % USpriteBatch::size);
-      auto where =
-          const_cast<char*>(reinterpret_cast<char const*>(&batches.back()) +
-                            sizeof(USpriteBatch) - emptyBytes);
-      memset(where, 0, emptyBytes);
-
-      bindTextureSlot(0, *pTexture);
-      for (auto const& batch : batches) {
-        setUniforms(batch);
-        renderMesh(m_vulkanContext, m_spriteBatchMesh);
+  constexpr auto batchSize = static_cast<size_t>(USpriteBatch::size);
+
+  // Opaque sprites are resolved by the depth test, so all sprites
+  // sharing a texture are drawn together regardless of their depth.
+  for (auto& [pTexture, mapEntry] : m_opaqueSpriteBatches) {
+    auto& [numSprites, batches] = mapEntry;
+
+    bindTextureSlot(0, *pTexture);
+    for (size_t i = 0; i < batches.size(); ++i) {
+      renderSpriteBatch(batches[i],
+                        std::min(batchSize, numSprites - i * batchSize),
+                        *pTexture);
+    }
+  }
+
+  // Translucent sprites must be blended back to front, which only
+  // allows batching runs of consecutive sprites sharing a texture.
+  if (!m_translucentSprites.empty()) {
+    std::sort(m_translucentSprites.begin(), m_translucentSprites.end(),
+              [](auto const& lhs, auto const& rhs) {
+                if (lhs.instance.depth != rhs.instance.depth) {
+                  return lhs.instance.depth > rhs.instance.depth;
+                }
+                return lhs.order < rhs.order;
+              });
+
+    auto scratch = SpriteBatchList(1, m_vulkanContext.frameArena());
+    auto& batch = scratch.front();
+    auto pBatchTexture = m_translucentSprites.front().pTexture;
+    size_t k = 0;
+
+    bindTextureSlot(0, *pBatchTexture);
+    for (auto const& sprite : m_translucentSprites) {
+      if (k == batchSize || sprite.pTexture != pBatchTexture) {
+        renderSpriteBatch(batch, k, *pBatchTexture);
+        k = 0;
+      }
+      if (sprite.pTexture != pBatchTexture) {
+        pBatchTexture = sprite.pTexture;
+        bindTextureSlot(0, *pBatchTexture);
       }
+      writeSpriteBatchSlot(batch, k++, sprite.instance);
     }
+    renderSpriteBatch(batch, k, *pBatchTexture);
   }
 
-  // Reset before next frame.
-  m_layerSpriteBatches = {};
+  // Drop this frame's batches while the arena still holds them.
+  resetSpriteBatches();
 }
 
 void Renderer::createWindow() {
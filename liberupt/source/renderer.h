@@ -8,9 +8,9 @@
 #undef GLM_ENABLE_EXPERIMENTAL
 #endif
 
-#include <map>
 #include <unordered_map>
 
+#include "bvh.h"
 #include "camera.h"
 #include "keyboard.h"
 #include "mesh.h"
@@ -18,6 +18,7 @@
 #include "mouse.h"
 #include "shader_interface.h"
 #include "sprite.h"
+#include "static_scene.h"
 
 struct RendererSettings {
   std::string windowTitle;
@@ -25,6 +26,46 @@ struct RendererSettings {
   bool enableVsync;
 };
 
+// Counters describing the most recently completed frame.
+struct RendererFrameStats {
+  // Heap allocations made between tryBeginFrame and endFrame.
+  // Requires a build with ERUPT_COUNT_ALLOCATIONS, else always zero.
+  size_t heapAllocations;
+
+  // Scratch memory handed out by the frame arena.
+  size_t arenaBytesUsed;
+
+  // Draw commands recorded into the frame's command buffer.
+  size_t drawCalls;
+
+  // Pipelines, textures and mesh buffers bound while recording the
+  // frame, and binds skipped since the state was bound already.
+  size_t pipelineBinds;
+  size_t textureBinds;
+  size_t bufferBinds;
+  size_t redundantBindsSkipped;
+
+  // Models queued with Renderer3d::renderModel that were drawn, and
+  // that were skipped for lying outside the view frustum.
+  size_t modelsDrawn;
+  size_t modelsCulled;
+
+  // Instances of static scenes culled on the CPU that were drawn, and
+  // culled, and instances tested by the compute pass, whose outcome
+  // stays on the device.
+  size_t staticInstancesDrawn;
+  size_t staticInstancesCulled;
+  size_t staticInstancesTestedOnDevice;
+
+  // Indirect draw commands of static scenes. Those of scenes culled on
+  // the device include commands all of whose instances were culled.
+  size_t staticDrawCommands;
+
+  // Triangles drawn by Renderer3d, for models at their selected level
+  // of detail and static scenes culled on the CPU at full detail.
+  size_t trianglesDrawn;
+};
+
 class Renderer {
  private:
   Keyboard m_keyboard;
@@ -38,6 +79,10 @@ class Renderer {
   RendererSettings m_settings;
   float m_aspectRatio;
 
+  RendererFrameStats m_frameStats;
+  size_t m_frameBeginAllocationCount;
+  float m_time;
+
   GLFWwindow* m_pWindow;
   VulkanContext m_vulkanContext;
 
@@ -50,6 +95,9 @@ class Renderer {
   inline Renderer(RendererSettings settings)
       : m_settings(std::move(settings)),
         m_aspectRatio(settings.resolution.x / (float)settings.resolution.y),
+        m_frameStats{},
+        m_frameBeginAllocationCount(0),
+        m_time(0),
         m_pWindow(nullptr),
         m_vulkanContext() {}
 
@@ -74,10 +122,39 @@ class Renderer {
     return texture;
   }
 
+  // Loads a vertical strip of square animation frames.
+  inline Texture& createAnimatedTexture(std::string const& name,
+                                        std::string const& imagePath,
+                                        float framesPerSecond) {
+    auto& texture = createTexture(name, imagePath);
+    texture.setAnimation(texture.height() / texture.width(), framesPerSecond);
+    return texture;
+  }
+
   inline Texture& texture(std::string const& name) {
     return *m_textures.at(name);
   }
 
+  // Adds a pipeline sharing the layout of the one the renderer was
+  // materialized with. The returned handle is passed to bindPipeline.
+  inline VulkanPipelineHandle createPipeline(
+      VulkanPipelineSettings const& settings) {
+    return m_vulkanContext.addPipeline(settings);
+  }
+
+  inline void bindPipeline(VulkanPipelineHandle pipeline) {
+    m_vulkanContext.bindPipeline(pipeline);
+  }
+
+  // Meshes owned by the caller rather than by name, e.g. cached geometry.
+  inline std::unique_ptr<Mesh> createUnnamedMesh() {
+    return std::make_unique<Mesh>(m_vulkanContext);
+  }
+
+  inline std::unique_ptr<Texture> createUnnamedTexture() {
+    return std::make_unique<Texture>(m_vulkanContext);
+  }
+
   inline void bindTextureSlot(uint8_t slot, Texture const& txr) {
     m_vulkanContext.bindTextureSlot(slot, txr.vulkanTexture());
   }
@@ -110,6 +187,8 @@ class Renderer {
       return false;
     }
 
+    m_frameBeginAllocationCount = heapAllocationCount();
+    m_time = static_cast<float>(glfwGetTime());
     m_vulkanContext.onFrameBegin();
     onFrameBegin();
     return true;
@@ -117,35 +196,108 @@ class Renderer {
 
   inline void endFrame() {
     onFrameEnd();
+    m_frameStats.arenaBytesUsed = m_vulkanContext.frameArena().bytesUsed();
+    m_frameStats.drawCalls = m_vulkanContext.drawCallCount();
+    m_frameStats.pipelineBinds = m_vulkanContext.pipelineBindCount();
+    m_frameStats.textureBinds = m_vulkanContext.textureBindCount();
+    m_frameStats.bufferBinds = m_vulkanContext.bufferBindCount();
+    m_frameStats.redundantBindsSkipped = m_vulkanContext.redundantBindCount();
     m_vulkanContext.onFrameEnd();
+    m_frameStats.heapAllocations =
+        heapAllocationCount() - m_frameBeginAllocationCount;
   }
 
   inline Mouse& mouse() noexcept { return m_mouse; }
 
   GETTER(keyboard, m_keyboard)
   GETTER(settings, m_settings)
+  GETTER(frameStats, m_frameStats)
+
+  // Seconds since the renderer was materialized, as of frame begin.
+  GETTER(time, m_time)
 };
 
 class Renderer2d : public Renderer {
  private:
+  // Data of a single sprite, as stored in one slot of a USpriteBatch.
+  struct SpriteInstance {
+    glm::vec4 bounds;
+    glm::vec4 textureArea;
+    glm::vec4 color;
+    glm::vec2 trigonometry;
+    float depth;
+  };
+
+  struct TranslucentSprite {
+    SpriteInstance instance;
+    Texture const* pTexture;
+    uint32_t order;
+  };
+
+  struct TilemapChunkDraw {
+    Mesh const* pMesh;
+    Texture const* pTileset;
+    float depth;
+  };
+
+  struct TilemapLayerDraw {
+    Texture const* pTileIndices;
+    Texture const* pTileset;
+    PCTilemapLayer layer;
+  };
+
+  using SpriteBatchList = ArenaVector<USpriteBatch>;
+  using SpriteBatchMap =
+      ArenaHashMap<Texture const*, std::pair<size_t, SpriteBatchList>>;
+
   Camera2d m_camera2d;
   Mesh m_spriteBatchMesh;
 
-  std::array<
-      std::map<Texture const*, std::pair<size_t, std::vector<USpriteBatch>>>,
-      Sprite::numLayers>
-      m_layerSpriteBatches;
+  // Live inside the frame arena and are rebound after every frame.
+  SpriteBatchMap m_opaqueSpriteBatches;
+  ArenaVector<TranslucentSprite> m_translucentSprites;
+  ArenaVector<TilemapChunkDraw> m_tilemapChunks;
+  ArenaVector<TilemapLayerDraw> m_tilemapLayers;
+
+  VulkanPipelineHandle m_tilemapPipeline;
+  VulkanPipelineHandle m_tilemapLayerPipeline;
 
+  void renderTilemaps();
   void renderSpriteBatches();
+  void renderSpriteBatch(USpriteBatch& batch, size_t numSprites,
+                         Texture const& texture);
+
+  inline void resetSpriteBatches() {
+    auto& arena = m_vulkanContext.frameArena();
+    m_opaqueSpriteBatches = SpriteBatchMap(arena);
+    m_translucentSprites = ArenaVector<TranslucentSprite>(arena);
+    m_tilemapChunks = ArenaVector<TilemapChunkDraw>(arena);
+    m_tilemapLayers = ArenaVector<TilemapLayerDraw>(arena);
+  }
+
+  static inline void writeSpriteBatchSlot(USpriteBatch& batch, size_t k,
+                                          SpriteInstance const& sprite) {
+    batch.bounds[k] = sprite.bounds;
+    batch.textureAreas[k] = sprite.textureArea;
+    batch.colors[k] = sprite.color;
+    batch.trigonometry[k / 2][2 * (k % 2) + 0] = sprite.trigonometry.x;
+    batch.trigonometry[k / 2][2 * (k % 2) + 1] = sprite.trigonometry.y;
+    batch.depths[k / 4][k % 4] = sprite.depth;
+  }
 
   void onFrameBegin() override {}
-  void onFrameEnd() override { renderSpriteBatches(); }
+  void onFrameEnd() override {
+    renderTilemaps();
+    renderSpriteBatches();
+  }
 
  public:
   inline Renderer2d(RendererSettings settings)
       : Renderer(std::move(settings)),
         m_camera2d({m_settings.resolution.x, m_settings.resolution.y}),
-        m_spriteBatchMesh(m_vulkanContext) {
+        m_spriteBatchMesh(m_vulkanContext),
+        m_tilemapPipeline(VulkanContext::primaryPipeline),
+        m_tilemapLayerPipeline(VulkanContext::primaryPipeline) {
     const VPositionColorTexcoord unitQuadVertices[6] = {
         {{0, 0, 0}, {1, 1, 1}, {0, 0}}, {{1, 0, 0}, {1, 1, 1}, {1, 0}},
         {{1, 1, 0}, {1, 1, 1}, {1, 1}}, {{1, 1, 0}, {1, 1, 1}, {1, 1}},
@@ -159,40 +311,77 @@ class Renderer2d : public Renderer {
     }
 
     m_spriteBatchMesh.setVertices(std::move(spriteBatchVertices));
+    resetSpriteBatches();
   }
 
   inline void renderSprite(Sprite const& sprite) {
     if (m_camera2d.isWorldRectVisible(sprite.position(), sprite.size())) {
+      auto instance = SpriteInstance{
+          m_camera2d.worldToNdcRect(sprite.position(), sprite.size()),
+          sprite.textureArea(),
+          sprite.color(),
+          {glm::sin(glm::radians(sprite.rotation())),
+           glm::cos(glm::radians(sprite.rotation()))},
+          sprite.depth()};
+
+      if (sprite.isTranslucent()) {
+        m_translucentSprites.push_back(
+            {instance, &sprite.texture(),
+             static_cast<uint32_t>(m_translucentSprites.size())});
+        return;
+      }
+
       auto& [numSprites, batches] =
-          m_layerSpriteBatches[sprite.layer()][&sprite.texture()];
-      batches.resize(std::ceil((numSprites + 1) / (float)USpriteBatch::size));
+          m_opaqueSpriteBatches
+              .try_emplace(&sprite.texture(), 0,
+                           SpriteBatchList(m_vulkanContext.frameArena()))
+              .first->second;
 
-      auto& batch = batches.back();
       auto k = numSprites % USpriteBatch::size;
+      if (k == 0) batches.emplace_back();
 
-      batch.bounds[k] =
-          m_camera2d.worldToNdcRect(sprite.position(), sprite.size());
-      batch.textureAreas[k] = sprite.textureArea();
-      batch.colors[k] = sprite.color();
-      batch.trigonometry[k / 2][2 * (k % 2) + 0] =
-          glm::sin(glm::radians(sprite.rotation()));
-      batch.trigonometry[k / 2][2 * (k % 2) + 1] =
-          glm::cos(glm::radians(sprite.rotation()));
-
+      writeSpriteBatchSlot(batches.back(), k, instance);
       ++numSprites;
     }
   }
 
+  // Queues static tile geometry, with vertex positions given in world
+  // coordinates. The mesh must stay alive until the frame has ended.
+  inline void renderTilemapChunk(Mesh const& mesh, Texture const& tileset,
+                                 float depth) {
+    m_tilemapChunks.push_back({&mesh, &tileset, depth});
+  }
+
+  // Queues a whole tilemap layer, drawn as one quad. The tileset lookup
+  // happens per fragment, using the integer tile indices stored in
+  // tileIndices, where zero denotes an empty tile.
+  inline void renderTilemapLayer(Texture const& tileIndices,
+                                 Texture const& tileset, glm::vec4 bounds,
+                                 glm::vec4 tilesetLookup,
+                                 glm::vec2 tileCount) {
+    m_tilemapLayers.push_back(
+        {&tileIndices, &tileset,
+         {m_camera2d.worldToNdcTransform(), bounds, tilesetLookup,
+          tileCount}});
+  }
+
   inline void materialize() {
     VulkanPipelineSettings ps;
     ps.vertexInputAttribs = VPositionColorTexcoord::attributes();
     ps.vertexInputBinding = VPositionColorTexcoord::binding();
     ps.vertexShaderPath = "../assets/shaders/spirv/vert-sprite.spv";
-    ps.fragmentShaderPath = "../assets/shaders/spirv/frag-textured.spv";
+    ps.fragmentShaderPath = "../assets/shaders/spirv/frag-sprite.spv";
     ps.textureFilterMode = VK_FILTER_NEAREST;
-    ps.enableDepthTest = false;
+    ps.enableDepthTest = true;
 
     Renderer::materialize(ps);
+
+    ps.vertexShaderPath = "../assets/shaders/spirv/vert-tilemap.spv";
+    m_tilemapPipeline = createPipeline(ps);
+
+    ps.vertexShaderPath = "../assets/shaders/spirv/vert-tilemap-layer.spv";
+    ps.fragmentShaderPath = "../assets/shaders/spirv/frag-tilemap-layer.spv";
+    m_tilemapLayerPipeline = createPipeline(ps);
   }
 
   inline Camera2d& camera2d() noexcept { return m_camera2d; }
@@ -200,37 +389,186 @@ class Renderer2d : public Renderer {
 
 class Renderer3d : public Renderer {
  private:
+  struct ModelDraw {
+    Mesh const* pMesh;
+    Texture const* pTexture;
+    VInstanceTransform instance;
+    BoundingSphere bounds;
+    uint32_t lod;
+
+    // Set for models with a transform handle, whose matrix, bounds and
+    // level of detail are only filled in at frame end, once the
+    // transforms have been updated.
+    Model const* pPendingModel;
+  };
+
+  // Instances drawn by a single draw call, limited by the size of the
+  // instance buffers.
+  static constexpr size_t maxInstancesPerDraw =
+      VulkanContext::instanceBufferSize / sizeof(VInstanceTransform);
+
   Camera3d m_camera3d;
 
+  // Levels of detail coarser than the one drawn last are only picked
+  // once their error is this fraction below the threshold, so models
+  // near the switching distance do not flicker between levels.
+  static constexpr float lodHysteresis = 0.25f;
+
+  // Models closer than this are treated as being this far away.
+  static constexpr float minLodDistance = 1e-3f;
+
+  // Largest error on screen, in pixels, tolerated when picking a level
+  // of detail. Zero draws every model at full detail.
+  float m_lodPixelError;
+
+  // Draws meshes whose vertices are packed, see VertexLayout.
+  VulkanPipelineHandle m_packedModelPipeline;
+
+  // Culls static scenes, see cull-static-scene.comp.
+  VulkanComputePipelineHandle m_cullStaticScenePipeline;
+
+  // Command buffers of the static scenes culled this frame. Culling
+  // depends on nothing but the frustum, so a scene drawn again reuses
+  // the outcome rather than resetting commands earlier draws read.
+  std::vector<VkBuffer> m_culledStaticScenes;
+
+  // Taken at frame begin, along with the camera transform uniform.
+  FrustumPlanes m_frustumPlanes;
+  glm::vec3 m_viewPosition;
+  glm::vec3 m_viewDirection;
+
   std::unordered_map<std::string, std::unique_ptr<Mesh>> m_meshes;
 
+  // Lives inside the frame arena and is rebound after every frame.
+  ArenaVector<ModelDraw> m_models;
+
+  // Updated at the end of every frame, before models are drawn.
+  TransformHierarchy m_transforms;
+
+  // Accumulated by renderStaticScene during the frame.
+  size_t m_numStaticInstancesDrawn;
+  size_t m_numStaticInstancesCulled;
+  size_t m_numStaticInstancesTestedOnDevice;
+  size_t m_numStaticDrawCommands;
+  size_t m_numTrianglesDrawn;
+
+  void resolvePendingModels();
+  void cullModels();
+  void renderModels();
+
+  // Culls a static scene and compacts the draw commands of its visible
+  // instances on the calling thread, for devices lacking indirect first
+  // instance.
+  void renderStaticSceneOnHost(StaticScene const& scene);
+
+  // Picks the level of detail of a model by its size on screen.
+  size_t selectLod(Model const& model, BoundingSphere const& bounds) const;
+
+  inline void resetModels() {
+    m_models = ArenaVector<ModelDraw>(m_vulkanContext.frameArena());
+  }
+
   void onFrameBegin() override {
-    setUniforms(UCameraTransform{m_camera3d.transform()});
+    setUniforms(UCameraTransform{m_camera3d.transform(), time()});
+    m_frustumPlanes = m_camera3d.frustumPlanes();
+    m_viewPosition = m_camera3d.position();
+    m_viewDirection = m_camera3d.direction();
+    m_numStaticInstancesDrawn = 0;
+    m_numStaticInstancesCulled = 0;
+    m_numStaticInstancesTestedOnDevice = 0;
+    m_numStaticDrawCommands = 0;
+    m_numTrianglesDrawn = 0;
+    m_culledStaticScenes.clear();
+  }
+  void onFrameEnd() override {
+    renderModels();
+    m_frameStats.staticInstancesDrawn = m_numStaticInstancesDrawn;
+    m_frameStats.staticInstancesCulled = m_numStaticInstancesCulled;
+    m_frameStats.staticInstancesTestedOnDevice =
+        m_numStaticInstancesTestedOnDevice;
+    m_frameStats.staticDrawCommands = m_numStaticDrawCommands;
+    m_frameStats.trianglesDrawn = m_numTrianglesDrawn;
   }
-  void onFrameEnd() override {}
 
  public:
   inline Renderer3d(RendererSettings settings)
-      : Renderer(std::move(settings)), m_camera3d(m_aspectRatio, 45.0f) {}
+      : Renderer(std::move(settings)),
+        m_camera3d(m_aspectRatio, 45.0f),
+        m_lodPixelError{1.0f},
+        m_packedModelPipeline(VulkanContext::primaryPipeline),
+        m_cullStaticScenePipeline{0},
+        m_viewPosition{0, 0, 0},
+        m_viewDirection{0, 0, 1},
+        m_numStaticInstancesDrawn{0},
+        m_numStaticInstancesCulled{0},
+        m_numStaticInstancesTestedOnDevice{0},
+        m_numStaticDrawCommands{0},
+        m_numTrianglesDrawn{0} {
+    resetModels();
+  }
 
   inline void materialize() {
     VulkanPipelineSettings ps;
     ps.vertexInputAttribs = VPositionColorTexcoord::attributes();
     ps.vertexInputBinding = VPositionColorTexcoord::binding();
+    ps.instanceInputBinding = VInstanceTransform::binding();
+    for (auto const& attrib : VInstanceTransform::attributes()) {
+      ps.vertexInputAttribs.push_back(attrib);
+    }
     ps.vertexShaderPath = "../assets/shaders/spirv/vert-textured.spv";
     ps.fragmentShaderPath = "../assets/shaders/spirv/frag-textured.spv";
     ps.textureFilterMode = VK_FILTER_LINEAR;
     ps.enableDepthTest = true;
 
     Renderer::materialize(ps);
+
+    ps.vertexInputAttribs = VPackedPositionColorTexcoord::attributes();
+    ps.vertexInputBinding = VPackedPositionColorTexcoord::binding();
+    for (auto const& attrib : VInstanceTransform::attributes()) {
+      ps.vertexInputAttribs.push_back(attrib);
+    }
+    m_packedModelPipeline = createPipeline(ps);
+
+    m_cullStaticScenePipeline = m_vulkanContext.addComputePipeline(
+        {"../assets/shaders/spirv/comp-cull-static-scene.spv", 3,
+         sizeof(PCCullStaticScene)});
   }
 
+  // Queues a model until the end of the frame, when all models sharing
+  // a mesh and texture are drawn together as instances of one draw.
+  // Draws are sorted by pipeline, texture, mesh and then front to back,
+  // so that the order models are queued in does not cause state changes.
+  // Both must stay alive until the frame has ended, as must the model
+  // itself if it has a transform handle, which is read then.
   void renderModel(Model const& model);
 
+  // Queues the models whose bounds in the tree intersect the view
+  // frustum, given the models the tree was built from, in order.
+  void renderStaticModels(Bvh const& bvh,
+                          std::vector<Model const*> const& models);
+
+  // Draws the instances of an uploaded scene that lie inside the view
+  // frustum, right away, with one indirect draw per texture. Instances
+  // are culled and compacted into the scene's draw commands by a compute
+  // pass, which runs ahead of the frame's draws, unless the device lacks
+  // indirect first instance.
+  void renderStaticScene(StaticScene const& scene);
+
+  inline std::unique_ptr<StaticScene> createStaticScene() {
+    return std::make_unique<StaticScene>(m_vulkanContext);
+  }
+
   inline Camera3d& camera3d() noexcept { return m_camera3d; }
 
+  // Transforms that models can be attached to (see
+  // Model::attachTransform), to be parented to each other.
+  inline TransformHierarchy& transforms() noexcept { return m_transforms; }
+
+  GETTER(lodPixelError, m_lodPixelError)
+  SETTER(setLodPixelError, m_lodPixelError)
+
   inline Mesh& createMesh(std::string const& name) {
-    m_meshes[name] = std::make_unique<Mesh>(m_vulkanContext);
+    m_meshes[name] = std::make_unique<Mesh>(m_vulkanContext, true);
     return *m_meshes.at(name);
   }
 
@@ -28,6 +28,17 @@ auto describeVertexInputBinding(uint32_t binding) {
   return defaultDescribeVertexInputBinding<VPositionColorTexcoord>(binding);
 }
 
+// Binding whose attributes advance once per instance rather than once
+// per vertex.
+template <typename Instance>
+auto describeInstanceInputBinding(uint32_t binding) {
+  return VkVertexInputBindingDescription{
+      .binding = binding,
+      .stride = sizeof(Instance),
+      .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+  };
+}
+
 template <typename Attribute>
 constexpr auto vertexAttributeFormat() {
   return VK_FORMAT_UNDEFINED;
@@ -50,6 +61,36 @@ constexpr auto vertexAttributeFormat<glm::vec4>() {
   return VK_FORMAT_R32G32B32A32_SFLOAT;
 }
 
+// Attributes stored in fewer bits, which shaders still read as floats.
+// Signed normalized values map [-32767, 32767] to [-1, 1], unsigned
+// normalized values map [0, 255] to [0, 1], and halves are IEEE 754
+// binary16 floats.
+
+struct Snorm16x4 {
+  int16_t x, y, z, w;
+};
+
+struct Unorm8x4 {
+  uint8_t r, g, b, a;
+};
+
+struct Half2 {
+  uint16_t x, y;
+};
+
+template <>
+constexpr auto vertexAttributeFormat<Snorm16x4>() {
+  return VK_FORMAT_R16G16B16A16_SNORM;
+}
+template <>
+constexpr auto vertexAttributeFormat<Unorm8x4>() {
+  return VK_FORMAT_R8G8B8A8_UNORM;
+}
+template <>
+constexpr auto vertexAttributeFormat<Half2>() {
+  return VK_FORMAT_R16G16_SFLOAT;
+}
+
 template <typename Attribute>
 auto describeVertexInputAttribute(uint32_t location, uint32_t offset,
                                   uint32_t binding = 0) {
@@ -61,8 +102,9 @@ auto describeVertexInputAttribute(uint32_t location, uint32_t offset,
 }
 
 template <typename... Attributes>
-auto describeVertexInputAttributes(uint32_t binding) {
-  uint32_t location = 0;
+auto describeVertexInputAttributes(uint32_t binding,
+                                   uint32_t firstLocation = 0) {
+  uint32_t location = firstLocation;
   uint32_t offset = 0;
 
   return std::vector{
@@ -88,18 +130,108 @@ struct VPositionColorTexcoord {
   }
 };
 
+// Half the size of VPositionColorTexcoord, read by the same shaders.
+// Positions are normalized to the bounds of their mesh, which are
+// restored by the model matrix (see Mesh::positionDequantization).
+struct VPackedPositionColorTexcoord {
+  Snorm16x4 position;
+  Unorm8x4 color;
+  Half2 texcoord;
+
+  static inline auto binding() {
+    return describeVertexInputBinding<VPackedPositionColorTexcoord>(0);
+  }
+
+  static inline auto attributes() {
+    return describeVertexInputAttributes<Snorm16x4, Unorm8x4, Half2>(0);
+  }
+};
+
+static_assert(sizeof(VPackedPositionColorTexcoord) == 16);
+
 struct UCameraTransform {
   glm::mat4 cameraTransform;
+  float time;
 };
 
 struct USpriteBatch {
-  static constexpr auto size = 292;
+  static constexpr auto size = 272;
   glm::vec4 bounds[size];
   glm::vec4 textureAreas[size];
   glm::vec4 colors[size];
   glm::vec4 trigonometry[size / 2];
+  glm::vec4 depths[size / 4];
+
+  // Shared by all sprites in the batch, as they share their texture.
+  // x: frame count, y: frames per second, z: time in seconds.
+  glm::vec4 animation;
+};
+
+static_assert(sizeof(USpriteBatch) <= VulkanLimits::maxUniformBufferRange);
+
+struct PCTilemapChunk {
+  // Maps world coordinates into NDC, as ndc = world * xy + zw.
+  glm::vec4 worldToNdc;
+  float depth;
+};
+
+struct PCTilemapLayer {
+  // Maps world coordinates into NDC, as ndc = world * xy + zw.
+  glm::vec4 worldToNdc;
+
+  // World position (xy) and size (zw) of the whole layer.
+  glm::vec4 bounds;
+
+  // Tileset UV size of one tile (xy), tiles per tileset row (z)
+  // and layer depth (w).
+  glm::vec4 tileset;
+
+  // Number of tiles along each axis of the layer.
+  glm::vec2 tileCount;
 };
 
-struct PCInstanceTransform {
+struct VInstanceTransform {
   glm::mat4 modelMatrix;
+
+  // x: frame count, y: frames per second.
+  glm::vec4 animation;
+
+  static inline auto binding() {
+    return describeInstanceInputBinding<VInstanceTransform>(1);
+  }
+
+  // Follow the attributes of VPositionColorTexcoord, with the model
+  // matrix taking up one location per column.
+  static inline auto attributes() {
+    return describeVertexInputAttributes<glm::vec4, glm::vec4, glm::vec4,
+                                         glm::vec4, glm::vec4>(1, 3);
+  }
+};
+
+// Instance of a static scene as read by the compute pass culling it,
+// laid out as std430 pads it.
+struct SStaticSceneInstance {
+  VInstanceTransform transform;
+
+  // Bounding sphere in world space, center (xyz) and radius (w).
+  glm::vec4 bounds;
+
+  // Draw command whose instance range the instance is compacted into.
+  uint32_t command;
+  uint32_t padding[3];
 };
+
+static_assert(sizeof(SStaticSceneInstance) == 112);
+
+struct PCCullStaticScene {
+  // Invocations per workgroup, local_size_x in the shader.
+  static constexpr uint32_t groupSize = 64;
+
+  glm::vec4 frustumPlanes[6];
+
+  // Instances to cull, or commands whose instance counts to reset.
+  uint32_t count;
+  uint32_t isReset;
+};
+
+static_assert(sizeof(PCCullStaticScene) <= VulkanLimits::maxPushConstantsSize);
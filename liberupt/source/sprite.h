@@ -9,18 +9,32 @@ class Sprite {
   glm::vec4 m_textureArea = {0, 0, 1, 1};
   glm::vec4 m_color = {1, 1, 1, 1};
   float m_rotation = 0;
-  uint8_t m_layer = 0;
+  float m_depth = 0.5f;
+  bool m_translucent = false;
   Texture* m_pTexture;
 
  public:
-  static constexpr uint8_t numLayers = 4;
-
+  // Sprites of animated textures show one frame at a time.
   inline Sprite(Texture& texture)
-      : m_size(texture.width(), texture.height()), m_pTexture(&texture) {}
+      : m_size(texture.width(), texture.frameHeight()),
+        m_textureArea{0, 0, 1, 1.0f / texture.animation().frameCount},
+        m_pTexture(&texture) {}
+
+  // Sprites with a smaller depth are drawn in front of those with a
+  // greater one. Translucent sprites of equal depth overlap in submission
+  // order, whereas opaque ones are drawn grouped by texture, and thus
+  // overlap in no particular order. Give them distinct depths instead.
+  inline void setDepth(float depth) {
+    crashIf(depth < 0.0f || depth > 1.0f);
+    m_depth = depth;
+  }
 
-  inline void setLayer(uint8_t layer) {
-    crashIf(layer >= numLayers);
-    m_layer = layer;
+  // Opaque sprites are only alpha-tested and may be drawn in any order.
+  // Sprites that need blending with what is behind them have to be
+  // marked translucent (or given a color with alpha below one), which
+  // has them sorted back to front and drawn after all opaque sprites.
+  inline bool isTranslucent() const noexcept {
+    return m_translucent || m_color.a < 1.0f;
   }
 
   GETTER(position, m_position)
@@ -29,13 +43,14 @@ class Sprite {
   GETTER(textureArea, m_textureArea)
   GETTER(color, m_color)
   GETTER(rotation, m_rotation)
-  GETTER(layer, m_layer)
+  GETTER(depth, m_depth)
 
   SETTER(setPosition, m_position)
   SETTER(setSize, m_size)
   SETTER(setTextureArea, m_textureArea)
   SETTER(setColor, m_color)
   SETTER(setRotation, m_rotation)
+  SETTER(setTranslucent, m_translucent)
 
   inline void setTexture(Texture& texture) { m_pTexture = &texture; }
 };
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "model.h"
+
+// Geometry that does not move after loading, drawn with a handful of
+// indirect draws rather than one draw per mesh. All meshes share one
+// vertex buffer and one index buffer, and instances are kept sorted by
+// texture and mesh, so the instances of a frame that survive culling
+// compact into one draw command per run of a mesh and one indirect draw
+// per texture (see Renderer3d::renderStaticScene).
+//
+// Uploading also writes the instances, and a draw command per run, to
+// storage buffers, so that culling and compaction run in a compute pass
+// and the draws read their commands and instances straight from it.
+// Devices lacking indirect first instance get no such buffers, and are
+// culled on the CPU instead.
+class StaticScene {
+ public:
+  using MeshIndex = uint32_t;
+
+  // Location of a mesh inside the shared buffers.
+  struct MeshRange {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t vertexOffset;
+  };
+
+  struct Instance {
+    MeshIndex mesh;
+    Texture const* pTexture;
+    VInstanceTransform transform;
+    BoundingSphere bounds;
+  };
+
+  // Range of the draw commands drawing the instances of a texture.
+  struct TextureDraw {
+    Texture const* pTexture;
+    uint32_t firstCommand;
+    uint32_t commandCount;
+  };
+
+ private:
+  VulkanContext& m_vulkanContext;
+
+  std::vector<VPositionColorTexcoord> m_vertices;
+  std::vector<uint32_t> m_indices;
+  std::vector<MeshRange> m_meshes;
+  std::vector<BoundingSphere> m_meshBounds;
+  std::vector<Instance> m_instances;
+  std::unordered_map<Mesh const*, MeshIndex> m_meshIndices;
+
+  std::vector<TextureDraw> m_textureDraws;
+  uint32_t m_commandCount;
+
+  VulkanBufferInfo m_vbufInfo;
+  VulkanBufferInfo m_ibufInfo;
+
+  // Instances as read by the culling pass, see SStaticSceneInstance, a
+  // draw command per run of instances sharing a texture and mesh, and
+  // the transforms of the instances in view, compacted per command.
+  VulkanBufferInfo m_instanceBufInfo;
+  VulkanBufferInfo m_commandBufInfo;
+  VulkanBufferInfo m_visibleBufInfo;
+
+  // Buffers are retired rather than destroyed, so scenes may go away
+  // or be uploaded again while frames drawing them are in flight.
+  inline void destroyBuffers() {
+    m_vulkanContext.retireBuffer(m_vbufInfo);
+    m_vulkanContext.retireBuffer(m_ibufInfo);
+    m_vulkanContext.retireBuffer(m_instanceBufInfo);
+    m_vulkanContext.retireBuffer(m_commandBufInfo);
+    m_vulkanContext.retireBuffer(m_visibleBufInfo);
+  }
+
+  // Groups the sorted instances into runs sharing a texture and mesh,
+  // and uploads what the culling pass reads and writes.
+  inline void uploadDrawCommands() {
+    auto instances = std::vector<SStaticSceneInstance>{};
+    auto commands = std::vector<VkDrawIndexedIndirectCommand>{};
+    instances.reserve(m_instances.size());
+
+    for (uint32_t i = 0; i < m_instances.size(); ++i) {
+      auto const& instance = m_instances[i];
+      auto isNewTexture =
+          i == 0 || instance.pTexture != m_instances[i - 1].pTexture;
+      if (isNewTexture) {
+        m_textureDraws.push_back(
+            {instance.pTexture, static_cast<uint32_t>(commands.size()), 0});
+      }
+      if (isNewTexture || instance.mesh != m_instances[i - 1].mesh) {
+        auto const& range = m_meshes[instance.mesh];
+        commands.push_back({range.indexCount, 0, range.firstIndex,
+                            range.vertexOffset, i});
+        ++m_textureDraws.back().commandCount;
+      }
+
+      auto const& bounds = instance.bounds;
+      instances.push_back({instance.transform,
+                           {bounds.center, bounds.radius},
+                           static_cast<uint32_t>(commands.size() - 1),
+                           {}});
+    }
+    m_commandCount = static_cast<uint32_t>(commands.size());
+
+    if (!m_vulkanContext.supportsIndirectFirstInstance()) return;
+    m_instanceBufInfo = m_vulkanContext.createBufferWithData(
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instances.data(),
+        instances.size() * sizeof(SStaticSceneInstance));
+    m_commandBufInfo = m_vulkanContext.createBufferWithData(
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        commands.data(), commands.size() * sizeof(commands[0]));
+    m_visibleBufInfo = m_vulkanContext.createDeviceBuffer(
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        instances.size() * sizeof(VInstanceTransform));
+  }
+
+ public:
+  inline StaticScene(VulkanContext& vulkanContext)
+      : m_vulkanContext{vulkanContext},
+        m_commandCount{0},
+        m_vbufInfo{},
+        m_ibufInfo{},
+        m_instanceBufInfo{},
+        m_commandBufInfo{},
+        m_visibleBufInfo{} {}
+
+  inline ~StaticScene() { destroyBuffers(); }
+
+  StaticScene(StaticScene const&) = delete;
+  StaticScene& operator=(StaticScene const&) = delete;
+
+  // Appends a mesh given as a triangle list without indices, which is
+  // welded and optimized first (see optimizeMesh).
+  inline MeshIndex addMesh(std::vector<VPositionColorTexcoord> vertices) {
+    auto indices = std::vector<uint32_t>{};
+    optimizeMesh(vertices, indices);
+    return addMesh(vertices, indices);
+  }
+
+  inline MeshIndex addMesh(std::vector<VPositionColorTexcoord> const& vertices,
+                           std::vector<uint32_t> const& indices) {
+    crashIf(m_vertices.size() + vertices.size() >
+            static_cast<size_t>(std::numeric_limits<int32_t>::max()));
+
+    auto box = Aabb{};
+    for (auto const& vertex : vertices) box.extend(vertex.position);
+    auto radiusSquared = 0.0f;
+    for (auto const& vertex : vertices) {
+      auto offset = vertex.position - box.center();
+      radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+
+    m_meshes.push_back({static_cast<uint32_t>(m_indices.size()),
+                        static_cast<uint32_t>(indices.size()),
+                        static_cast<int32_t>(m_vertices.size())});
+    m_meshBounds.push_back({box.center(), std::sqrt(radiusSquared)});
+    m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
+    m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+    return static_cast<MeshIndex>(m_meshes.size() - 1);
+  }
+
+  inline void addInstance(MeshIndex mesh, Texture const& texture,
+                          glm::mat4 const& modelMatrix) {
+    crashIf(mesh >= m_meshes.size());
+    auto const& animation = texture.animation();
+    m_instances.push_back(
+        {mesh,
+         &texture,
+         {modelMatrix, {animation.frameCount, animation.framesPerSecond, 0, 0}},
+         transformSphere(modelMatrix, m_meshBounds[mesh])});
+  }
+
+  // Adds an instance of a model as currently placed. Its mesh is copied
+  // into the scene the first time it is seen, at full detail, so meshes
+  // loaded from files must have kept their copies.
+  inline void addModel(Model const& model) {
+    auto const& mesh = model.mesh();
+    auto it = m_meshIndices.find(&mesh);
+    if (it == m_meshIndices.end()) {
+      auto index = MeshIndex{};
+      crashIf(mesh.vertices().empty());
+      if (mesh.lods().empty()) {
+        index = addMesh(mesh.vertices());
+      } else {
+        auto const& full = mesh.lods().front();
+        auto first = mesh.indices().begin() + full.firstIndex;
+        index = addMesh(mesh.vertices(), {first, first + full.indexCount});
+      }
+      it = m_meshIndices.emplace(&mesh, index).first;
+    }
+    addInstance(it->second, model.texture(), model.transform());
+  }
+
+  // Sorts the instances and uploads the shared buffers, along with the
+  // draw commands. Must be called after the last mesh or instance was
+  // added, and before drawing.
+  inline void upload() {
+    auto less = std::less<void const*>{};
+    std::stable_sort(m_instances.begin(), m_instances.end(),
+                     [&](auto const& lhs, auto const& rhs) {
+                       if (lhs.pTexture != rhs.pTexture) {
+                         return less(lhs.pTexture, rhs.pTexture);
+                       }
+                       return lhs.mesh < rhs.mesh;
+                     });
+
+    destroyBuffers();
+    m_textureDraws.clear();
+    m_commandCount = 0;
+    if (m_indices.empty()) return;
+    m_vbufInfo = m_vulkanContext.createVertexBuffer(m_vertices);
+    m_ibufInfo = m_vulkanContext.createIndexBuffer(m_indices);
+    if (!m_instances.empty()) uploadDrawCommands();
+  }
+
+  inline bool isUploaded() const noexcept {
+    return m_ibufInfo.buffer || m_indices.empty();
+  }
+
+  // Whether the scene is culled by a compute pass, or else on the CPU.
+  inline bool isCulledOnDevice() const noexcept {
+    return m_commandBufInfo.buffer != VK_NULL_HANDLE;
+  }
+
+  GETTER(meshes, m_meshes)
+  GETTER(instances, m_instances)
+  GETTER(textureDraws, m_textureDraws)
+  GETTER(commandCount, m_commandCount)
+  GETTER(vulkanVertexBuffer, m_vbufInfo)
+  GETTER(vulkanIndexBuffer, m_ibufInfo)
+  GETTER(vulkanInstanceBuffer, m_instanceBufInfo)
+  GETTER(vulkanCommandBuffer, m_commandBufInfo)
+  GETTER(vulkanVisibleBuffer, m_visibleBufInfo)
+};
@@ -2,6 +2,14 @@
 
 #include "vulkan_context.h"
 
+// Textures may hold a vertical strip of equally sized animation frames.
+// The shaders select the current frame from the global time, so
+// animated textures cost no CPU work per sprite or model.
+struct TextureAnimation {
+  uint32_t frameCount = 1;
+  float framesPerSecond = 0;
+};
+
 class Texture {
   using pixel_type = uint32_t;
 
@@ -9,6 +17,8 @@ class Texture {
   VulkanContext& m_vulkanContext;
   std::vector<pixel_type> m_pixels;
   VulkanTextureInfo m_txrInfo;
+  TextureAnimation m_animation;
+  uint16_t m_sortId;
 
  private:
   inline void destroyTexture() {
@@ -20,13 +30,35 @@ class Texture {
 
  public:
   inline Texture(VulkanContext& vulkanContext)
-      : m_vulkanContext{vulkanContext}, m_pixels{}, m_txrInfo{} {}
+      : m_vulkanContext{vulkanContext},
+        m_pixels{},
+        m_txrInfo{},
+        m_animation{},
+        m_sortId{vulkanContext.allocateSortId()} {}
 
   inline ~Texture() { destroyTexture(); }
 
   GETTER(width, m_txrInfo.width)
   GETTER(height, m_txrInfo.height)
   GETTER(pixels, m_pixels)
+  GETTER(animation, m_animation)
+
+  // Tells textures apart when sorting draws.
+  GETTER(sortId, m_sortId)
+
+  inline bool isAnimated() const noexcept {
+    return m_animation.frameCount > 1;
+  }
+
+  // Height of a single animation frame in pixels.
+  inline uint32_t frameHeight() const noexcept {
+    return height() / m_animation.frameCount;
+  }
+
+  inline void setAnimation(uint32_t frameCount, float framesPerSecond) {
+    crashIf(frameCount == 0 || height() % frameCount != 0);
+    m_animation = {frameCount, framesPerSecond};
+  }
 
   inline void updatePixelsWithImage(std::string const& path) {
     updatePixelsWithImage(png::image<png::rgba_pixel>(path.c_str()));
@@ -55,6 +87,24 @@ class Texture {
     m_txrInfo = m_vulkanContext.createTexture(width, height, m_pixels.data());
   }
 
+  // Creates a texture of the given format from tightly packed texels,
+  // without keeping a copy of them around. Meant for textures holding
+  // raw data, such as tile indices, rather than colors.
+  inline void updateTexels(uint32_t width, uint32_t height, VkFormat format,
+                           void const* texels) {
+    destroyTexture();
+    m_pixels.clear();
+    m_txrInfo =
+        m_vulkanContext.createTexture(width, height, texels, format);
+  }
+
+  // Overwrites a sub-rectangle of a texture created by updateTexels.
+  inline void updateTexelRect(glm::uvec2 const& offset,
+                              glm::uvec2 const& extent, void const* texels) {
+    crashIf(!m_txrInfo.image || !m_pixels.empty());
+    m_vulkanContext.updateTexture(m_txrInfo, offset, extent, texels);
+  }
+
   // The constness of these are questionable, since we are returning
   // native handles to the vulkan buffers. However, the result of
   // this operation shall exclusively be used for read and draw
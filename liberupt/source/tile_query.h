@@ -0,0 +1,216 @@
+#pragma once
+
+#include <limits>
+
+#include "tilemap.h"
+#include "worker_pool.h"
+
+// Spatial queries against one layer of a tilemap, in world coordinates.
+// Whether a tile obstructs a query is decided by a caller-supplied
+// predicate taking the tile value, e.g. [](auto tile) { return tile; }.
+// All queries only read the tilemap, and may run concurrently as long
+// as it is not modified meanwhile.
+
+struct TileRay {
+  glm::vec2 origin;
+  glm::vec2 direction;  // Normalized.
+  float maxDistance;
+};
+
+struct TileRayHit {
+  bool hit = false;
+  glm::u64vec2 tile{0, 0};
+
+  // World distance along the ray to where it enters the tile.
+  float distance = 0;
+
+  // Normal of the tile face the ray entered through, which is zero
+  // for rays starting inside the blocking tile.
+  glm::ivec2 normal{0, 0};
+};
+
+struct TileSweepHit {
+  bool hit = false;
+  glm::u64vec2 tile{0, 0};
+
+  // Fraction of the motion covered before touching the tile.
+  float time = 1;
+  glm::ivec2 normal{0, 0};
+};
+
+// Walks the tiles pierced by the ray in order, using a grid DDA, and
+// returns the first blocking one within the maximum distance.
+template <typename TileType, typename IsBlocking>
+TileRayHit raycast(Tilemap<TileType> const& tilemap, size_t layer,
+                   TileRay const& ray, IsBlocking&& isBlocking) {
+  constexpr auto infinity = std::numeric_limits<float>::infinity();
+
+  auto size = glm::vec2{tilemap.size()};
+  auto origin = ray.origin / tilemap.tileSize();
+  auto dir = ray.direction / tilemap.tileSize();
+
+  // Clip the ray to the bounds of the map.
+  auto tEnter = 0.0f;
+  auto tExit = ray.maxDistance;
+  auto normal = glm::ivec2{0, 0};
+
+  for (int axis = 0; axis < 2; ++axis) {
+    if (dir[axis] == 0) {
+      if (origin[axis] < 0 || origin[axis] >= size[axis]) return {};
+      continue;
+    }
+
+    auto t0 = (0 - origin[axis]) / dir[axis];
+    auto t1 = (size[axis] - origin[axis]) / dir[axis];
+    if (t0 > t1) std::swap(t0, t1);
+
+    if (t0 > tEnter) {
+      tEnter = t0;
+      normal = {};
+      normal[axis] = dir[axis] > 0 ? -1 : 1;
+    }
+    tExit = std::min(tExit, t1);
+  }
+  if (tEnter > tExit) return {};
+
+  auto start = origin + tEnter * dir;
+  auto tile = glm::ivec2{
+      std::clamp(static_cast<int64_t>(start.x), int64_t{0},
+                 static_cast<int64_t>(tilemap.size().x) - 1),
+      std::clamp(static_cast<int64_t>(start.y), int64_t{0},
+                 static_cast<int64_t>(tilemap.size().y) - 1)};
+
+  auto step = glm::ivec2{dir.x > 0 ? 1 : -1, dir.y > 0 ? 1 : -1};
+  auto tDelta = glm::vec2{dir.x != 0 ? std::abs(1 / dir.x) : infinity,
+                          dir.y != 0 ? std::abs(1 / dir.y) : infinity};
+
+  // Ray distance at which the next tile boundary is crossed, per axis.
+  auto tNext = glm::vec2{infinity, infinity};
+  for (int axis = 0; axis < 2; ++axis) {
+    if (dir[axis] != 0) {
+      auto boundary = tile[axis] + (step[axis] > 0 ? 1 : 0);
+      tNext[axis] = (boundary - origin[axis]) / dir[axis];
+    }
+  }
+
+  auto readTile = typename Tilemap<TileType>::Storage::Reader(tilemap.tiles());
+  auto t = tEnter;
+
+  while (t <= tExit) {
+    auto pos = glm::u64vec3{static_cast<uint64_t>(tile.x),
+                            static_cast<uint64_t>(tile.y), layer};
+    if (isBlocking(readTile(pos))) {
+      return {true, {pos.x, pos.y}, t, normal};
+    }
+
+    auto axis = tNext.x < tNext.y ? 0 : 1;
+    t = tNext[axis];
+    tile[axis] += step[axis];
+    tNext[axis] += tDelta[axis];
+    normal = {};
+    normal[axis] = -step[axis];
+
+    if (tile[axis] < 0 || tile[axis] >= static_cast<int64_t>(size[axis])) {
+      break;
+    }
+  }
+  return {};
+}
+
+template <typename TileType, typename IsBlocking>
+TileRayHit castSegment(Tilemap<TileType> const& tilemap, size_t layer,
+                       glm::vec2 const& from, glm::vec2 const& to,
+                       IsBlocking&& isBlocking) {
+  auto length = glm::length(to - from);
+  if (length == 0) {
+    return raycast(tilemap, layer, {from, {1, 0}, 0}, isBlocking);
+  }
+  return raycast(tilemap, layer, {from, (to - from) / length, length},
+                 isBlocking);
+}
+
+template <typename TileType, typename IsBlocking>
+bool hasLineOfSight(Tilemap<TileType> const& tilemap, size_t layer,
+                    glm::vec2 const& from, glm::vec2 const& to,
+                    IsBlocking&& isBlocking) {
+  return !castSegment(tilemap, layer, from, to, isBlocking).hit;
+}
+
+// Moves an axis-aligned box by motion and reports the first blocking
+// tile it touches. Tiles already overlapping the box at its starting
+// position are ignored, so boxes can always move out of them.
+template <typename TileType, typename IsBlocking>
+TileSweepHit sweepBox(Tilemap<TileType> const& tilemap, size_t layer,
+                      glm::vec2 const& pos, glm::vec2 const& size,
+                      glm::vec2 const& motion, IsBlocking&& isBlocking) {
+  auto tileSize = tilemap.tileSize();
+  auto mapSize = glm::vec2{tilemap.size()};
+
+  // Tiles touched anywhere along the way.
+  auto sweptMin = glm::min(pos, pos + motion) / tileSize;
+  auto sweptMax = glm::max(pos + size, pos + size + motion) / tileSize;
+  sweptMin = glm::clamp(glm::floor(sweptMin), glm::vec2{0, 0}, mapSize);
+  sweptMax = glm::clamp(glm::ceil(sweptMax), glm::vec2{0, 0}, mapSize);
+
+  auto readTile = typename Tilemap<TileType>::Storage::Reader(tilemap.tiles());
+  auto result = TileSweepHit{};
+
+  for (auto y = static_cast<uint64_t>(sweptMin.y); y < sweptMax.y; ++y) {
+    for (auto x = static_cast<uint64_t>(sweptMin.x); x < sweptMax.x; ++x) {
+      if (!isBlocking(readTile({x, y, layer}))) continue;
+
+      auto tileMin = glm::vec2{x, y} * tileSize;
+      auto tileMax = tileMin + tileSize;
+
+      // Intersect the intervals of time during which the box overlaps
+      // the tile along each axis.
+      auto entry = -std::numeric_limits<float>::infinity();
+      auto exit = std::numeric_limits<float>::infinity();
+      auto entryAxis = 0;
+
+      for (int axis = 0; axis < 2; ++axis) {
+        if (motion[axis] == 0) {
+          if (pos[axis] + size[axis] <= tileMin[axis] ||
+              pos[axis] >= tileMax[axis]) {
+            entry = exit;
+          }
+          continue;
+        }
+
+        auto t0 = (tileMin[axis] - (pos[axis] + size[axis])) / motion[axis];
+        auto t1 = (tileMax[axis] - pos[axis]) / motion[axis];
+        if (t0 > t1) std::swap(t0, t1);
+
+        if (t0 > entry) {
+          entry = t0;
+          entryAxis = axis;
+        }
+        exit = std::min(exit, t1);
+      }
+
+      if (entry < exit && entry >= 0 && entry < result.time) {
+        result.hit = true;
+        result.tile = {x, y};
+        result.time = entry;
+        result.normal = {};
+        result.normal[entryAxis] = motion[entryAxis] > 0 ? -1 : 1;
+      }
+    }
+  }
+  return result;
+}
+
+// Casts many rays at once, spreading them across the worker pool.
+// hits is resized to match rays, with hits[i] belonging to rays[i].
+template <typename TileType, typename IsBlocking>
+void raycastBatch(Tilemap<TileType> const& tilemap, size_t layer,
+                  std::vector<TileRay> const& rays,
+                  std::vector<TileRayHit>& hits, IsBlocking&& isBlocking,
+                  WorkerPool& pool = sharedWorkerPool()) {
+  hits.resize(rays.size());
+  pool.parallelFor(rays.size(), 64, [&](size_t begin, size_t end) {
+    for (auto i = begin; i < end; ++i) {
+      hits[i] = raycast(tilemap, layer, rays[i], isBlocking);
+    }
+  });
+}
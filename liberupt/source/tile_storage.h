@@ -0,0 +1,349 @@
+#pragma once
+
+#include <cstring>
+#include <glm/glm.hpp>
+#include <optional>
+#include <unordered_map>
+
+#include "common.h"
+
+// Sparse storage for the tiles of a layered map. Each layer is split
+// into square chunks of ChunkSize tiles, which are kept in a hash map.
+// Chunks holding a single value throughout are stored as that value,
+// and chunks matching their layer's background value are not stored
+// at all. Thus, memory grows with the number of edited chunks rather
+// than with the size of the map.
+template <typename TileType, size_t ChunkSize = 32>
+class TileStorage {
+ public:
+  static constexpr size_t chunkSize = ChunkSize;
+  static constexpr size_t chunkArea = ChunkSize * ChunkSize;
+
+  // Chunk coordinates packed as 24 bits x, 24 bits y and 16 bits layer.
+  using ChunkKey = uint64_t;
+
+  static inline ChunkKey chunkKey(size_t cx, size_t cy,
+                                  size_t layer) noexcept {
+    return static_cast<ChunkKey>(cx) | static_cast<ChunkKey>(cy) << 24 |
+           static_cast<ChunkKey>(layer) << 48;
+  }
+
+  static inline ChunkKey chunkKeyAt(glm::u64vec3 const& pos) noexcept {
+    return chunkKey(pos.x / chunkSize, pos.y / chunkSize, pos.z);
+  }
+
+  static inline size_t chunkLayer(ChunkKey key) noexcept { return key >> 48; }
+
+  // Chunk x, y and layer packed into the key.
+  static inline glm::u64vec3 chunkCoords(ChunkKey key) noexcept {
+    return {key & 0xffffff, key >> 24 & 0xffffff, key >> 48};
+  }
+
+ private:
+  struct Chunk {
+    // Null while every tile of the chunk equals the uniform value.
+    std::unique_ptr<TileType[]> pTiles;
+    TileType uniform;
+  };
+
+  // Keys are already unique per chunk; spreading their bits is enough.
+  struct ChunkKeyHash {
+    inline size_t operator()(ChunkKey key) const noexcept {
+      return static_cast<size_t>((key ^ key >> 29) * 0x9e3779b97f4a7c15ull);
+    }
+  };
+
+  glm::u64vec3 m_size;
+  std::vector<TileType> m_layerBackgrounds;
+  std::unordered_map<ChunkKey, Chunk, ChunkKeyHash> m_chunks;
+
+  static inline size_t localIndex(glm::u64vec3 const& pos) noexcept {
+    return pos.x % chunkSize + (pos.y % chunkSize) * chunkSize;
+  }
+
+  static inline void fillTiles(TileType* pTiles, size_t count,
+                               TileType const& value) noexcept {
+    if constexpr (sizeof(TileType) == 1) {
+      std::memset(pTiles, static_cast<int>(value), count);
+    } else {
+      std::fill_n(pTiles, count, value);
+    }
+  }
+
+  static inline void materialize(Chunk& chunk) {
+    chunk.pTiles = std::make_unique_for_overwrite<TileType[]>(chunkArea);
+    fillTiles(chunk.pTiles.get(), chunkArea, chunk.uniform);
+  }
+
+  // Value of every tile in the chunk, unless its tiles are stored.
+  inline std::optional<TileType> uniformValue(ChunkKey key) const noexcept {
+    auto it = m_chunks.find(key);
+    if (it == m_chunks.end()) return m_layerBackgrounds[chunkLayer(key)];
+    if (it->second.pTiles) return std::nullopt;
+    return it->second.uniform;
+  }
+
+  // Tiles of the chunk, which are stored first if it was uniform.
+  inline TileType* denseTiles(ChunkKey key) {
+    auto [it, inserted] = m_chunks.try_emplace(
+        key, Chunk{nullptr, m_layerBackgrounds[chunkLayer(key)]});
+    if (!it->second.pTiles) materialize(it->second);
+    return it->second.pTiles.get();
+  }
+
+  // Invokes fn(key, lo, hi, full) for each chunk overlapping the tiles
+  // in [min, max) of a layer, where [lo, hi) is the overlap in chunk
+  // local coordinates, and full tells whether it covers every tile of
+  // the chunk which lies inside the storage.
+  template <typename Fn>
+  inline void forEachChunkInRect(size_t layer, glm::u64vec2 const& min,
+                                 glm::u64vec2 const& max, Fn&& fn) {
+    for (auto cy = min.y / chunkSize; cy <= (max.y - 1) / chunkSize; ++cy) {
+      for (auto cx = min.x / chunkSize; cx <= (max.x - 1) / chunkSize; ++cx) {
+        auto origin = glm::u64vec2{cx * chunkSize, cy * chunkSize};
+        auto lo = glm::u64vec2{std::max(min.x, origin.x) - origin.x,
+                               std::max(min.y, origin.y) - origin.y};
+        auto hi = glm::u64vec2{std::min(max.x - origin.x, chunkSize),
+                               std::min(max.y - origin.y, chunkSize)};
+        auto full = lo.x == 0 && lo.y == 0 &&
+                    hi.x == std::min(m_size.x - origin.x, chunkSize) &&
+                    hi.y == std::min(m_size.y - origin.y, chunkSize);
+        fn(chunkKey(cx, cy, layer), lo, hi, full);
+      }
+    }
+  }
+
+ public:
+  // Reads tiles while remembering the chunk last read from, which
+  // makes scans with spatial locality skip most hash lookups. Readers
+  // are invalidated by any modification of the storage, and are not
+  // meant to be shared between threads.
+  class Reader {
+   private:
+    TileStorage const& m_storage;
+    ChunkKey m_key;
+    TileType const* m_pTiles;
+    TileType m_uniform;
+
+   public:
+    inline Reader(TileStorage const& storage) noexcept
+        : m_storage{storage},
+          m_key{~ChunkKey{0}},
+          m_pTiles{nullptr},
+          m_uniform{} {}
+
+    inline TileType operator()(glm::u64vec3 const& pos) noexcept {
+      auto key = chunkKeyAt(pos);
+      if (key != m_key) {
+        m_key = key;
+        auto it = m_storage.m_chunks.find(key);
+        if (it == m_storage.m_chunks.end()) {
+          m_pTiles = nullptr;
+          m_uniform = m_storage.m_layerBackgrounds[pos.z];
+        } else {
+          m_pTiles = it->second.pTiles.get();
+          m_uniform = it->second.uniform;
+        }
+      }
+      return m_pTiles ? m_pTiles[localIndex(pos)] : m_uniform;
+    }
+  };
+
+  inline TileStorage(glm::u64vec3 size)
+      : m_size{std::move(size)}, m_layerBackgrounds(m_size.z), m_chunks{} {
+    crashIf(m_size.x >= chunkSize << 24 || m_size.y >= chunkSize << 24 ||
+            m_size.z >= 1 << 16);
+  }
+
+  inline TileType const& at(glm::u64vec3 const& pos) const noexcept {
+    auto it = m_chunks.find(chunkKeyAt(pos));
+    if (it == m_chunks.end()) return m_layerBackgrounds[pos.z];
+    auto const& chunk = it->second;
+    return chunk.pTiles ? chunk.pTiles[localIndex(pos)] : chunk.uniform;
+  }
+
+  inline void set(glm::u64vec3 const& pos, TileType value) {
+    auto key = chunkKeyAt(pos);
+    auto it = m_chunks.find(key);
+
+    if (it == m_chunks.end()) {
+      if (value == m_layerBackgrounds[pos.z]) return;
+      it = m_chunks.emplace(key, Chunk{nullptr, m_layerBackgrounds[pos.z]})
+               .first;
+    }
+
+    auto& chunk = it->second;
+    if (!chunk.pTiles) {
+      if (value == chunk.uniform) return;
+      materialize(chunk);
+    }
+    chunk.pTiles[localIndex(pos)] = std::move(value);
+  }
+
+  // Copies count consecutive tiles of a row, starting at pos.
+  inline void readRow(glm::u64vec3 pos, size_t count, TileType* out) const {
+    while (count > 0) {
+      auto run = std::min(count, chunkSize - pos.x % chunkSize);
+      auto it = m_chunks.find(chunkKeyAt(pos));
+
+      if (it == m_chunks.end()) {
+        std::fill_n(out, run, m_layerBackgrounds[pos.z]);
+      } else if (!it->second.pTiles) {
+        std::fill_n(out, run, it->second.uniform);
+      } else {
+        std::copy_n(&it->second.pTiles[localIndex(pos)], run, out);
+      }
+
+      pos.x += run;
+      out += run;
+      count -= run;
+    }
+  }
+
+  // Sets the tiles inside [min, max) of a layer. Chunks covered as a
+  // whole become uniform, without touching their individual tiles.
+  inline void fillRect(size_t layer, glm::u64vec2 const& min,
+                       glm::u64vec2 const& max, TileType const& value) {
+    forEachChunkInRect(layer, min, max, [&](ChunkKey key, auto lo, auto hi,
+                                            bool full) {
+      if (full) {
+        if (value == m_layerBackgrounds[layer]) {
+          m_chunks.erase(key);
+        } else {
+          m_chunks.insert_or_assign(key, Chunk{nullptr, value});
+        }
+        return;
+      }
+
+      if (uniformValue(key) == value) return;
+      auto pTiles = denseTiles(key);
+      for (auto y = lo.y; y < hi.y; ++y) {
+        fillTiles(&pTiles[lo.x + y * chunkSize], hi.x - lo.x, value);
+      }
+    });
+  }
+
+  // Copies the tiles inside [min, max) of a layer into out, row by row,
+  // with rows being stride tiles apart.
+  inline void readRect(size_t layer, glm::u64vec2 const& min,
+                       glm::u64vec2 const& max, TileType* out,
+                       size_t stride) const {
+    for (auto y = min.y; y < max.y; ++y) {
+      readRow({min.x, y, layer}, max.x - min.x, out + (y - min.y) * stride);
+    }
+  }
+
+  // Overwrites the tiles inside [min, max) of a layer with those of src,
+  // laid out as described for readRect.
+  inline void writeRect(size_t layer, glm::u64vec2 const& min,
+                        glm::u64vec2 const& max, TileType const* src,
+                        size_t stride) {
+    forEachChunkInRect(layer, min, max, [&](ChunkKey key, auto lo, auto hi,
+                                            bool) {
+      auto pTiles = denseTiles(key);
+      auto coords = chunkCoords(key);
+      auto srcX = coords.x * chunkSize + lo.x - min.x;
+      auto srcY = coords.y * chunkSize + lo.y - min.y;
+      for (auto y = lo.y; y < hi.y; ++y) {
+        std::copy_n(&src[srcX + (srcY + y - lo.y) * stride], hi.x - lo.x,
+                    &pTiles[lo.x + y * chunkSize]);
+      }
+    });
+  }
+
+  // Sets all tiles of a layer satisfying the predicate to value.
+  // Uniform chunks, and the background, are tested only once.
+  template <typename Predicate>
+  inline void replaceIf(size_t layer, Predicate&& pred,
+                        TileType const& value) {
+    for (auto& [key, chunk] : m_chunks) {
+      if (chunkLayer(key) != layer) continue;
+
+      if (!chunk.pTiles) {
+        if (pred(chunk.uniform)) chunk.uniform = value;
+      } else {
+        std::replace_if(chunk.pTiles.get(), chunk.pTiles.get() + chunkArea,
+                        pred, value);
+      }
+    }
+
+    if (pred(m_layerBackgrounds[layer])) m_layerBackgrounds[layer] = value;
+  }
+
+  // Sets every tile of the layer at once, dropping all of its chunks.
+  inline void fill(size_t layer, TileType value) {
+    std::erase_if(m_chunks, [layer](auto const& entry) {
+      return chunkLayer(entry.first) == layer;
+    });
+    m_layerBackgrounds[layer] = std::move(value);
+  }
+
+  // Replaces all tiles of a chunk at once, taking ownership of them.
+  inline void setChunk(ChunkKey key, std::unique_ptr<TileType[]> pTiles) {
+    m_chunks.insert_or_assign(key, Chunk{std::move(pTiles), TileType{}});
+  }
+
+  // Reverts a chunk to the background value of its layer.
+  inline void resetChunk(ChunkKey key) { m_chunks.erase(key); }
+
+  inline bool hasChunk(ChunkKey key) const noexcept {
+    return m_chunks.contains(key);
+  }
+
+  // Invokes fn(key, pTiles, uniform) for every stored chunk, where
+  // pTiles is null for chunks holding the uniform value throughout.
+  template <typename Fn>
+  inline void forEachChunk(Fn&& fn) const {
+    for (auto const& [key, chunk] : m_chunks) {
+      fn(key, static_cast<TileType const*>(chunk.pTiles.get()),
+         chunk.uniform);
+    }
+  }
+
+  inline TileType const& layerBackground(size_t layer) const noexcept {
+    return m_layerBackgrounds[layer];
+  }
+
+  // Collapses chunks whose tiles have become uniform through editing,
+  // and drops those matching the background of their layer.
+  inline void compact() {
+    for (auto it = m_chunks.begin(); it != m_chunks.end();) {
+      auto& chunk = it->second;
+      if (chunk.pTiles) {
+        auto first = chunk.pTiles[0];
+        auto last = chunk.pTiles.get() + chunkArea;
+        if (std::all_of(chunk.pTiles.get(), last,
+                        [first](auto tile) { return tile == first; })) {
+          chunk.pTiles.reset();
+          chunk.uniform = first;
+        }
+      }
+
+      if (!chunk.pTiles &&
+          chunk.uniform == m_layerBackgrounds[chunkLayer(it->first)]) {
+        it = m_chunks.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  inline size_t chunkCount() const noexcept { return m_chunks.size(); }
+
+  inline size_t denseChunkCount() const noexcept {
+    return std::count_if(m_chunks.begin(), m_chunks.end(), [](auto const& e) {
+      return e.second.pTiles != nullptr;
+    });
+  }
+
+  // Approximate number of bytes held, ignoring allocator overhead.
+  inline size_t memoryUsage() const noexcept {
+    auto nodeSize = sizeof(ChunkKey) + sizeof(Chunk) + sizeof(void*);
+    return sizeof(*this) + m_layerBackgrounds.size() * sizeof(TileType) +
+           m_chunks.bucket_count() * sizeof(void*) +
+           m_chunks.size() * nodeSize +
+           denseChunkCount() * chunkArea * sizeof(TileType);
+  }
+
+  GETTER(size, m_size)
+};
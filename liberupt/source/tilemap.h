@@ -1,13 +1,71 @@
 #pragma once
 
-#include "game_object.h"
+#include "renderer.h"
 #include "sprite.h"
+#include "tile_storage.h"
+
+enum class TilemapRenderMode {
+  // Static geometry per chunk, costs one draw per visible chunk layer.
+  ChunkMeshes,
+
+  // One integer texture of tile indices per layer, drawn as a single
+  // quad whose fragments look up the tileset. The cost is independent
+  // of the number of visible tiles, but the layer size is limited by
+  // the maximum texture size of the device.
+  IndexTextures
+};
+
+// Rectangular block of tiles, e.g. copied out of a tilemap layer.
+template <typename TileType>
+struct TileRegion {
+  glm::u64vec2 size;
+  std::vector<TileType> tiles;  // Row by row.
+};
 
 template <typename TileType>
-class Tilemap : public GameObject {
+class Tilemap {
+ public:
+  using Storage = TileStorage<TileType, 32>;
+
+  // Edge length, in tiles, of the square chunks whose tiles are stored
+  // together, and whose geometry is cached on the device and drawn
+  // with a single call per layer.
+  static constexpr size_t chunkSize = Storage::chunkSize;
+
+  // Edits spanning more chunks count as edits of the whole layer.
+  static constexpr size_t maxTrackedChunksPerEdit = 1024;
+
+  // Chunks further than this many chunks away from the visible ones
+  // lose their cached geometry, once the cache holds twice as many
+  // chunks as lie within the margin. Evicted buffers are retired until
+  // the frames drawing them are done, so evictions never wait for the
+  // device, and batching them merely spares chunks scrolled past and
+  // back from being rebuilt.
+  static constexpr size_t chunkCacheMargin = 2;
+
  private:
+  struct ChunkGeometry {
+    std::unique_ptr<Mesh> pMesh;
+    size_t numTiles = 0;
+    bool dirty = true;
+  };
+
+  // Tiles inside [dirtyMin, dirtyMax) differ from the texture contents.
+  struct LayerTexture {
+    std::unique_ptr<Texture> pTexture;
+    glm::u64vec2 dirtyMin{0, 0};
+    glm::u64vec2 dirtyMax{0, 0};
+  };
+
+  // Narrow tile types are widened, as 16 bits is the smallest
+  // integer texel format the index textures use.
+  using IndexTexel =
+      std::conditional_t<sizeof(TileType) <= 2, uint16_t, uint32_t>;
+  static constexpr VkFormat indexTexelFormat =
+      sizeof(IndexTexel) == 2 ? VK_FORMAT_R16_UINT : VK_FORMAT_R32_UINT;
+
   glm::u64vec3 m_size;
-  std::vector<TileType> m_tiles;
+  Storage m_tiles;
 
   Texture const& m_tileset;
   glm::size_t m_srcTilesPerRow;
@@ -15,50 +73,379 @@ class Tilemap : public GameObject {
   glm::vec2 m_dstTileSize;
   glm::vec2 m_uvIncrement;
 
-  Sprite m_tileSprite;
+  // Built lazily once a chunk first becomes visible, and rebuilt on
+  // the next draw after any of its tiles has been modified. Evicted
+  // once far from view, see chunkCacheMargin, or reset.
+  mutable std::unordered_map<typename Storage::ChunkKey, ChunkGeometry>
+      m_chunks;
+
+  TilemapRenderMode m_renderMode;
+  mutable std::vector<LayerTexture> m_layerTextures;
 
-  inline size_t tileIndex(glm::u64vec3 const& pos) const {
-    crashIf(pos.x > m_size.x || pos.y > m_size.y || pos.z > m_size.z);
-    return static_cast<size_t>(pos.x) + (pos.y + pos.z * m_size.y) * m_size.x;
+  // Edits are numbered, and chunks and layers remember the number of
+  // their latest edit, which lets cached query results tell whether
+  // the tiles they were derived from have changed since. Chunk entries
+  // older than their layer's are dropped, as are those of chunks being
+  // reset, which count as edits of their layer instead. Thus, entries
+  // are only kept for chunks edited since the last edit of the layer.
+  uint64_t m_revision;
+  std::unordered_map<typename Storage::ChunkKey, uint64_t> m_chunkRevisions;
+  std::vector<uint64_t> m_layerRevisions;
+
+  inline void checkBounds(glm::u64vec3 const& pos) const {
+    crashIf(pos.x >= m_size.x || pos.y >= m_size.y || pos.z >= m_size.z);
+  }
+
+  // Higher layers are drawn on top of lower ones.
+  inline float layerDepth(size_t layer) const noexcept {
+    return 1.0f - (layer + 1.0f) / (m_size.z + 1.0f);
   }
 
-  inline void setTileAt(size_t index, TileType value) {
+  inline void checkValue(TileType const& value) const {
     crashIf(value > m_srcTilesPerCol * m_srcTilesPerRow);
-    m_tiles[index] = std::move(value);
+  }
+
+  // Checks that the size tiles starting at pos lie inside the layer.
+  inline void checkRect(glm::u64vec2 const& pos, glm::u64vec2 const& size,
+                        size_t layer) const {
+    crashIf(layer >= m_size.z || pos.x > m_size.x || pos.y > m_size.y ||
+            size.x > m_size.x - pos.x || size.y > m_size.y - pos.y);
+  }
+
+  // Marks the tiles inside [min, max) of a layer as modified.
+  inline void markRegionDirty(glm::u64vec2 const& min,
+                              glm::u64vec2 const& max, size_t layer) {
+    // Huge regions are recorded as an edit of the whole layer instead.
+    auto numChunks = ((max.x - 1) / chunkSize - min.x / chunkSize + 1) *
+                     ((max.y - 1) / chunkSize - min.y / chunkSize + 1);
+    auto trackChunks = numChunks <= maxTrackedChunksPerEdit;
+
+    ++m_revision;
+    if (!trackChunks) setLayerRevision(layer);
+
+    for (auto cy = min.y / chunkSize; cy <= (max.y - 1) / chunkSize; ++cy) {
+      for (auto cx = min.x / chunkSize; cx <= (max.x - 1) / chunkSize; ++cx) {
+        auto key = Storage::chunkKey(cx, cy, layer);
+        auto it = m_chunks.find(key);
+        if (it != m_chunks.end()) it->second.dirty = true;
+        if (trackChunks) m_chunkRevisions[key] = m_revision;
+      }
+    }
+
+    auto& texture = m_layerTextures[layer];
+    if (texture.dirtyMin.x >= texture.dirtyMax.x) {
+      texture.dirtyMin = min;
+      texture.dirtyMax = max;
+    } else {
+      texture.dirtyMin = glm::min(texture.dirtyMin, min);
+      texture.dirtyMax = glm::max(texture.dirtyMax, max);
+    }
+  }
+
+  inline void markTileDirty(glm::u64vec3 const& pos) {
+    markRegionDirty({pos.x, pos.y}, {pos.x + 1, pos.y + 1}, pos.z);
+  }
+
+  inline void markChunkDirty(size_t cx, size_t cy, size_t layer) {
+    markRegionDirty({cx * chunkSize, cy * chunkSize},
+                    {std::min<size_t>(m_size.x, (cx + 1) * chunkSize),
+                     std::min<size_t>(m_size.y, (cy + 1) * chunkSize)},
+                    layer);
+  }
+
+  // Records the current edit for the whole layer, which supersedes the
+  // revisions of its chunks.
+  inline void setLayerRevision(size_t layer) noexcept {
+    m_layerRevisions[layer] = m_revision;
+    std::erase_if(m_chunkRevisions, [&](auto const& entry) {
+      return Storage::chunkLayer(entry.first) == layer;
+    });
+  }
+
+  inline void markLayerDirty(size_t layer) noexcept {
+    for (auto& [key, chunk] : m_chunks) {
+      if (Storage::chunkLayer(key) == layer) chunk.dirty = true;
+    }
+
+    ++m_revision;
+    setLayerRevision(layer);
+
+    m_layerTextures[layer].dirtyMin = {0, 0};
+    m_layerTextures[layer].dirtyMax = {m_size.x, m_size.y};
+  }
+
+  // Uploads the tiles of a layer that changed since the last draw,
+  // as a single sub-rectangle covering all of them.
+  void updateLayerTexture(Renderer2d& r, size_t layer) const {
+    auto& texture = m_layerTextures[layer];
+    if (texture.pTexture && texture.dirtyMin.x >= texture.dirtyMax.x) return;
+
+    auto offset = texture.pTexture ? texture.dirtyMin : glm::u64vec2{0, 0};
+    auto extent = texture.pTexture ? texture.dirtyMax - texture.dirtyMin
+                                   : glm::u64vec2{m_size.x, m_size.y};
+
+    auto texels = std::vector<IndexTexel>(extent.x * extent.y);
+    auto row = std::vector<TileType>(extent.x);
+    for (size_t y = 0; y < extent.y; ++y) {
+      m_tiles.readRow({offset.x, offset.y + y, layer}, extent.x, row.data());
+      std::transform(row.begin(), row.end(), &texels[y * extent.x],
+                     [](TileType value) {
+                       return static_cast<IndexTexel>(value);
+                     });
+    }
+
+    if (texture.pTexture) {
+      texture.pTexture->updateTexelRect(offset, extent, texels.data());
+    } else {
+      texture.pTexture = r.createUnnamedTexture();
+      texture.pTexture->updateTexels(static_cast<uint32_t>(m_size.x),
+                                     static_cast<uint32_t>(m_size.y),
+                                     indexTexelFormat, texels.data());
+    }
+    texture.dirtyMin = texture.dirtyMax = {0, 0};
+  }
+
+  // Drops the geometry of chunks outside [minChunk, maxChunk], grown by
+  // the margin, if the cache has outgrown its budget.
+  void evictDistantChunks(glm::u64vec2 const& minChunk,
+                          glm::u64vec2 const& maxChunk) const {
+    auto lo = minChunk - glm::min(minChunk, glm::u64vec2{chunkCacheMargin});
+    auto hi = maxChunk + glm::u64vec2{chunkCacheMargin};
+    auto budget = 2 * (hi.x - lo.x + 1) * (hi.y - lo.y + 1) * m_size.z;
+    if (m_chunks.size() <= budget) return;
+
+    for (auto it = m_chunks.begin(); it != m_chunks.end();) {
+      auto coords = Storage::chunkCoords(it->first);
+      if (coords.x < lo.x || coords.x > hi.x || coords.y < lo.y ||
+          coords.y > hi.y) {
+        it = m_chunks.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  void buildChunk(Renderer2d& r, ChunkGeometry& chunk, size_t cx, size_t cy,
+                  size_t layer) const {
+    auto vertices = std::vector<VPositionColorTexcoord>();
+    auto indices = std::vector<uint32_t>();
+
+    auto xEnd = std::min<size_t>(m_size.x, (cx + 1) * chunkSize);
+    auto yEnd = std::min<size_t>(m_size.y, (cy + 1) * chunkSize);
+    auto readTile = typename Storage::Reader(m_tiles);
+
+    for (size_t y = cy * chunkSize; y < yEnd; ++y) {
+      for (size_t x = cx * chunkSize; x < xEnd; ++x) {
+        auto value = readTile({x, y, layer});
+        if (!value) continue;
+
+        auto pos = m_dstTileSize * glm::vec2{x, y};
+        auto uv = m_uvIncrement * glm::vec2{(value - 1) % m_srcTilesPerRow,
+                                            (value - 1) / m_srcTilesPerRow};
+        auto base = static_cast<uint32_t>(vertices.size());
+
+        for (auto corner : {glm::vec2{0, 0}, glm::vec2{1, 0}, glm::vec2{1, 1},
+                            glm::vec2{0, 1}}) {
+          vertices.push_back({{pos + corner * m_dstTileSize, 0},
+                              {1, 1, 1},
+                              uv + corner * m_uvIncrement});
+        }
+        for (auto i : {0, 1, 2, 2, 3, 0}) {
+          indices.push_back(base + i);
+        }
+      }
+    }
+
+    chunk.numTiles = vertices.size() / 4;
+    chunk.dirty = false;
+
+    // Rebuilt chunks rewrite their buffers in place unless they grew.
+    // Empty chunks keep whatever buffers they had, but are never drawn.
+    if (chunk.numTiles) {
+      if (!chunk.pMesh) chunk.pMesh = r.createUnnamedMesh();
+      chunk.pMesh->setVertices(std::move(vertices));
+      chunk.pMesh->setIndices(std::move(indices));
+    }
   }
 
  public:
   inline Tilemap(glm::u64vec3 size, Texture const& tileset,
                  glm::uvec2 const& srcTileSize, glm::vec2 dstTileSize)
       : m_size{std::move(size)},
-        m_tiles(m_size.x * m_size.y * m_size.z),
+        m_tiles(m_size),
         m_tileset{tileset},
         m_srcTilesPerRow{m_tileset.width() / srcTileSize.x},
         m_srcTilesPerCol{m_tileset.height() / srcTileSize.y},
         m_dstTileSize{std::move(dstTileSize)},
         m_uvIncrement{srcTileSize.x / static_cast<float>(m_tileset.width()),
                       srcTileSize.y / static_cast<float>(m_tileset.height())},
-        m_tileSprite{tileset} {}
+        m_chunks{},
+        m_renderMode(TilemapRenderMode::ChunkMeshes),
+        m_layerTextures(m_size.z),
+        m_revision(0),
+        m_chunkRevisions{},
+        m_layerRevisions(m_size.z) {}
 
-  inline virtual ~Tilemap() {}
-
-  inline TileType const& tileAt(glm::u64vec3 const& pos) const noexcept {
-    return m_tiles[tileIndex(pos)];
+  inline TileType const& tileAt(glm::u64vec3 const& pos) const {
+    checkBounds(pos);
+    return m_tiles.at(pos);
   }
 
   inline void setTileAt(glm::u64vec3 const& pos, TileType value) {
-    setTileAt(tileIndex(pos), std::move(value));
+    checkBounds(pos);
+    checkValue(value);
+    m_tiles.set(pos, std::move(value));
+    markTileDirty(pos);
   }
 
   inline void fill(size_t layer, TileType value) {
     crashIf(layer >= m_size.z);
+    checkValue(value);
 
-    auto tilesPerLayer = m_size.x * m_size.y;
-    auto layerStart = layer * tilesPerLayer;
+    m_tiles.fill(layer, std::move(value));
+    markLayerDirty(layer);
+  }
 
-    for (auto i : range(tilesPerLayer)) {
-      setTileAt(layerStart + i, std::move(value));
+  // The bulk operations below check their arguments once, rather than
+  // per tile, and work a chunk at a time on the underlying storage.
+
+  inline void fillRect(glm::u64vec2 const& pos, glm::u64vec2 const& size,
+                       size_t layer, TileType value) {
+    checkRect(pos, size, layer);
+    checkValue(value);
+    if (size.x == 0 || size.y == 0) return;
+
+    m_tiles.fillRect(layer, pos, pos + size, value);
+    markRegionDirty(pos, pos + size, layer);
+  }
+
+  inline TileRegion<TileType> copyRegion(glm::u64vec2 const& pos,
+                                         glm::u64vec2 const& size,
+                                         size_t layer) const {
+    checkRect(pos, size, layer);
+
+    auto region = TileRegion<TileType>{size, {}};
+    region.tiles.resize(size.x * size.y);
+    if (!region.tiles.empty()) {
+      m_tiles.readRect(layer, pos, pos + size, region.tiles.data(), size.x);
     }
+    return region;
+  }
+
+  inline void pasteRegion(TileRegion<TileType> const& region,
+                          glm::u64vec2 const& pos, size_t layer) {
+    checkRect(pos, region.size, layer);
+    crashIf(region.tiles.size() != region.size.x * region.size.y);
+    if (region.tiles.empty()) return;
+    checkValue(*std::max_element(region.tiles.begin(), region.tiles.end()));
+
+    m_tiles.writeRect(layer, pos, pos + region.size, region.tiles.data(),
+                      region.size.x);
+    markRegionDirty(pos, pos + region.size, layer);
+  }
+
+  // Copies a block of tiles, possibly within the same layer, in which
+  // case source and destination may overlap.
+  inline void blit(glm::u64vec2 const& srcPos, size_t srcLayer,
+                   glm::u64vec2 const& size, glm::u64vec2 const& dstPos,
+                   size_t dstLayer) {
+    checkRect(dstPos, size, dstLayer);
+    auto region = copyRegion(srcPos, size, srcLayer);
+    if (region.tiles.empty()) return;
+
+    m_tiles.writeRect(dstLayer, dstPos, dstPos + size, region.tiles.data(),
+                      size.x);
+    markRegionDirty(dstPos, dstPos + size, dstLayer);
+  }
+
+  // Sets every tile of the layer satisfying the predicate to value.
+  template <typename Predicate>
+  inline void replaceIf(size_t layer, Predicate&& pred, TileType value) {
+    crashIf(layer >= m_size.z);
+    checkValue(value);
+
+    m_tiles.replaceIf(layer, std::forward<Predicate>(pred), value);
+    markLayerDirty(layer);
+  }
+
+  inline void replace(size_t layer, TileType from, TileType to) {
+    replaceIf(
+        layer, [from](TileType const& tile) { return tile == from; }, to);
+  }
+
+  // Replaces the 4-connected area of equal tiles around pos with value,
+  // one horizontal span at a time. Returns the number of tiles changed.
+  size_t floodFill(glm::u64vec3 const& pos, TileType value) {
+    checkBounds(pos);
+    checkValue(value);
+
+    auto target = m_tiles.at(pos);
+    if (target == value) return 0;
+
+    auto layer = pos.z;
+    auto dirtyMin = glm::u64vec2{pos.x, pos.y};
+    auto dirtyMax = dirtyMin;
+    auto seeds = std::vector<glm::u64vec2>{{pos.x, pos.y}};
+    size_t numFilled = 0;
+
+    auto matches = [&](size_t x, size_t y) {
+      return m_tiles.at({x, y, layer}) == target;
+    };
+
+    while (!seeds.empty()) {
+      auto x = seeds.back().x;
+      auto y = seeds.back().y;
+      seeds.pop_back();
+      if (!matches(x, y)) continue;
+
+      auto x0 = x, x1 = x + 1;
+      while (x0 > 0 && matches(x0 - 1, y)) --x0;
+      while (x1 < m_size.x && matches(x1, y)) ++x1;
+
+      m_tiles.fillRect(layer, {x0, y}, {x1, y + 1}, value);
+      numFilled += x1 - x0;
+      dirtyMin = glm::min(dirtyMin, glm::u64vec2{x0, y});
+      dirtyMax = glm::max(dirtyMax, glm::u64vec2{x1, y + 1});
+
+      // Seed one tile per run of matching tiles in the adjacent rows.
+      // The row above the first one wraps around, failing the check.
+      for (auto ny : {y - 1, y + 1}) {
+        if (ny >= m_size.y) continue;
+        for (auto nx = x0; nx < x1; ++nx) {
+          if (matches(nx, ny) && (nx == x0 || !matches(nx - 1, ny))) {
+            seeds.push_back({nx, ny});
+          }
+        }
+      }
+    }
+
+    markRegionDirty(dirtyMin, dirtyMax, layer);
+    return numFilled;
+  }
+
+  // Releases storage of chunks which edits have made uniform again.
+  inline void compact() { m_tiles.compact(); }
+
+  // Replaces all tiles of a chunk, laid out row by row. Tiles beyond
+  // the map edge, in chunks along the border, are ignored.
+  inline void setChunk(size_t cx, size_t cy, size_t layer,
+                       std::unique_ptr<TileType[]> pTiles) {
+    checkBounds({cx * chunkSize, cy * chunkSize, layer});
+    m_tiles.setChunk(Storage::chunkKey(cx, cy, layer), std::move(pTiles));
+    markChunkDirty(cx, cy, layer);
+  }
+
+  // Reverts all tiles of a chunk to the background value of its layer,
+  // dropping its cached geometry, e.g. once streamed out. Its revision
+  // is dropped as well, so this counts as an edit of the whole layer.
+  inline void resetChunk(size_t cx, size_t cy, size_t layer) {
+    checkBounds({cx * chunkSize, cy * chunkSize, layer});
+    auto key = Storage::chunkKey(cx, cy, layer);
+    m_tiles.resetChunk(key);
+    markChunkDirty(cx, cy, layer);
+    m_chunks.erase(key);
+    m_chunkRevisions.erase(key);
+    m_layerRevisions[layer] = m_revision;
   }
 
   inline void clear(size_t layer) { fill(layer, 0); }
@@ -69,41 +456,81 @@ class Tilemap : public GameObject {
     }
   }
 
-  inline virtual void update(float dt) override { GameObject::update(dt); }
+  // Index textures hold at most 32 bits per tile.
+  inline void setRenderMode(TilemapRenderMode mode) {
+    crashIf(mode == TilemapRenderMode::IndexTextures && sizeof(TileType) > 4);
+    m_renderMode = mode;
+  }
+
+  void draw(Renderer2d& r) const {
+    if (m_renderMode == TilemapRenderMode::IndexTextures) {
+      auto bounds = glm::vec4{0, 0, m_dstTileSize * glm::vec2{m_size}};
+      for (size_t z = 0; z < m_size.z; ++z) {
+        updateLayerTexture(r, z);
+        r.renderTilemapLayer(
+            *m_layerTextures[z].pTexture, m_tileset, bounds,
+            {m_uvIncrement, m_srcTilesPerRow, layerDepth(z)},
+            glm::vec2{m_size});
+      }
+      return;
+    }
+
+    auto cameraPos = glm::max(r.camera2d().position(), glm::vec2{0, 0});
+    auto minLoc = glm::u64vec2{cameraPos / m_dstTileSize};
+    if (minLoc.x >= m_size.x || minLoc.y >= m_size.y) return;
 
-  inline virtual void draw(Renderer& r) const override {
-    auto minLoc = glm::u64vec3{r.camera2d().position() / m_dstTileSize, 0};
     auto visibleArea =
         glm::u64vec2{glm::ceil(r.camera2d().viewportSize() / m_dstTileSize)};
-    auto maxLoc = glm::u64vec3{
-        std::min(m_size.x - 1, minLoc.x + visibleArea.x - 1),
-        std::min(m_size.y - 1, minLoc.y + visibleArea.y - 1), m_size.z - 1};
-
-    auto sprite = m_tileSprite;
-    for (size_t z = minLoc.z; z <= maxLoc.z; ++z) {
-      for (size_t y = minLoc.y; y <= maxLoc.y; ++y) {
-        for (size_t x = minLoc.x; x <= maxLoc.x; ++x) {
-          auto value = tileAt({x, y, z});
-          if (value) {
-            sprite.setSize(m_dstTileSize);
-            sprite.setPosition(m_dstTileSize * glm::vec2{x, y});
-            sprite.setTextureArea(
-                {m_uvIncrement.x * ((value - 1) % m_srcTilesPerRow),
-                 m_uvIncrement.y * ((value - 1) / m_srcTilesPerRow),
-                 m_uvIncrement});
-            sprite.setLayer(z);
-            r.renderSprite(sprite);
+    auto maxLoc =
+        glm::u64vec2{std::min(m_size.x - 1, minLoc.x + visibleArea.x - 1),
+                     std::min(m_size.y - 1, minLoc.y + visibleArea.y - 1)};
+
+    evictDistantChunks(minLoc / chunkSize, maxLoc / chunkSize);
+
+    for (size_t z = 0; z < m_size.z; ++z) {
+      for (auto cy = minLoc.y / chunkSize; cy <= maxLoc.y / chunkSize; ++cy) {
+        for (auto cx = minLoc.x / chunkSize; cx <= maxLoc.x / chunkSize;
+             ++cx) {
+          auto& chunk = m_chunks[Storage::chunkKey(cx, cy, z)];
+          if (chunk.dirty) buildChunk(r, chunk, cx, cy, z);
+          if (chunk.numTiles) {
+            r.renderTilemapChunk(*chunk.pMesh, m_tileset, layerDepth(z));
           }
         }
       }
     }
   }
 
+  // Number of the latest edit of any tile inside [min, max) of a layer,
+  // or zero if there was none. Tracked per chunk, so edits of nearby
+  // tiles in the same chunks are included as well, as are edits of the
+  // whole layer and chunk resets anywhere on it.
+  inline uint64_t regionRevision(glm::u64vec2 const& min,
+                                 glm::u64vec2 const& max,
+                                 size_t layer) const {
+    auto revision = m_layerRevisions[layer];
+    for (auto cy = min.y / chunkSize; cy <= (max.y - 1) / chunkSize; ++cy) {
+      for (auto cx = min.x / chunkSize; cx <= (max.x - 1) / chunkSize; ++cx) {
+        auto it = m_chunkRevisions.find(Storage::chunkKey(cx, cy, layer));
+        if (it != m_chunkRevisions.end()) {
+          revision = std::max(revision, it->second);
+        }
+      }
+    }
+    return revision;
+  }
+
+  // Chunk layers whose geometry is currently cached on the device.
+  inline size_t cachedChunkCount() const noexcept { return m_chunks.size(); }
+
   GETTER(size, m_size)
+  GETTER(tiles, m_tiles)
+  GETTER(revision, m_revision)
   GETTER(tileSize, m_dstTileSize)
+  GETTER(renderMode, m_renderMode)
 };
 
 using Tilemap8 = Tilemap<uint8_t>;
 using Tilemap16 = Tilemap<uint16_t>;
 using Tilemap32 = Tilemap<uint32_t>;
-using Tilemap64 = Tilemap<uint64_t>;
\ No newline at end of file
+using Tilemap64 = Tilemap<uint64_t>;
@@ -0,0 +1,68 @@
+#include "tilemap_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+TilemapFile::TilemapFile(std::string const& path)
+    : m_pData(nullptr),
+      m_bytes(0),
+      m_pHeader(nullptr),
+      m_pBackgrounds(nullptr),
+      m_pIndex(nullptr) {
+  auto fd = open(path.c_str(), O_RDONLY);
+  crashIf(fd < 0);
+
+  struct stat info;
+  crashIf(fstat(fd, &info) != 0);
+  m_bytes = static_cast<size_t>(info.st_size);
+  crashIf(m_bytes < sizeof(TilemapFileHeader));
+
+  // The mapping stays valid after the descriptor has been closed.
+  auto pMapped = mmap(nullptr, m_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  crashIf(pMapped == MAP_FAILED);
+
+  // Chunks are paged in as the camera wanders, not front to back.
+  madvise(pMapped, m_bytes, MADV_RANDOM);
+  m_pData = static_cast<std::byte const*>(pMapped);
+
+  m_pHeader = reinterpret_cast<TilemapFileHeader const*>(m_pData);
+  crashIf(m_pHeader->magic != TilemapFileHeader::magicValue ||
+          m_pHeader->version != TilemapFileHeader::currentVersion);
+
+  auto indexEnd = sizeof(TilemapFileHeader) +
+                  m_pHeader->size[2] * sizeof(uint64_t) +
+                  m_pHeader->chunkCount * sizeof(TilemapFileChunk);
+  crashIf(indexEnd > m_bytes);
+
+  m_pBackgrounds = reinterpret_cast<uint64_t const*>(
+      m_pData + sizeof(TilemapFileHeader));
+  m_pIndex = reinterpret_cast<TilemapFileChunk const*>(
+      m_pBackgrounds + m_pHeader->size[2]);
+
+  for (uint64_t i = 0; i < m_pHeader->chunkCount; ++i) {
+    crashIf(m_pIndex[i].offset + m_pIndex[i].bytes > m_bytes);
+  }
+}
+
+TilemapFile::~TilemapFile() {
+  munmap(const_cast<std::byte*>(m_pData), m_bytes);
+}
+
+TilemapFileChunk const* TilemapFile::findChunk(uint64_t key) const noexcept {
+  auto pEnd = m_pIndex + m_pHeader->chunkCount;
+  auto pChunk =
+      std::lower_bound(m_pIndex, pEnd, key, [](auto const& chunk, auto key) {
+        return chunk.key < key;
+      });
+  return pChunk != pEnd && pChunk->key == key ? pChunk : nullptr;
+}
+
+std::pair<std::byte const*, size_t> TilemapFile::chunkData(
+    uint64_t key) const noexcept {
+  auto pChunk = findChunk(key);
+  if (!pChunk) return {nullptr, 0};
+  return {m_pData + pChunk->offset, pChunk->bytes};
+}
@@ -0,0 +1,382 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include "tilemap.h"
+
+// Tilemap files are laid out as follows, in native byte order:
+//
+//   TilemapFileHeader
+//   uint64_t background[size.z]          (layer background tile values)
+//   TilemapFileChunk index[chunkCount]   (sorted by key)
+//   chunk payloads
+//
+// Each payload holds the tiles of one chunk, row by row, encoded as
+// runs of (uint16_t length, tileBytes bytes of tile value). Chunks
+// missing from the index consist of their layer's background value.
+struct TilemapFileHeader {
+  static constexpr uint32_t magicValue = 0x4d545245;  // "ERTM"
+  static constexpr uint32_t currentVersion = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t tileBytes;
+  uint32_t chunkSize;
+  uint64_t size[3];
+  uint64_t chunkCount;
+};
+
+struct TilemapFileChunk {
+  uint64_t key;
+  uint64_t offset;
+  uint64_t bytes;
+};
+
+// Read-only view of a tilemap file, which is memory-mapped rather than
+// read, so only the pages of chunks actually loaded are touched.
+class TilemapFile {
+ private:
+  std::byte const* m_pData;
+  size_t m_bytes;
+
+  TilemapFileHeader const* m_pHeader;
+  uint64_t const* m_pBackgrounds;
+  TilemapFileChunk const* m_pIndex;
+
+  TilemapFileChunk const* findChunk(uint64_t key) const noexcept;
+
+ public:
+  TilemapFile(std::string const& path);
+  ~TilemapFile();
+
+  TilemapFile(TilemapFile const&) = delete;
+  TilemapFile& operator=(TilemapFile const&) = delete;
+
+  inline TilemapFileHeader const& header() const noexcept {
+    return *m_pHeader;
+  }
+
+  inline glm::u64vec3 size() const noexcept {
+    return {m_pHeader->size[0], m_pHeader->size[1], m_pHeader->size[2]};
+  }
+
+  // Raw bits of the layer's background tile value.
+  inline uint64_t layerBackground(size_t layer) const noexcept {
+    return m_pBackgrounds[layer];
+  }
+
+  inline bool hasChunk(uint64_t key) const noexcept {
+    return findChunk(key) != nullptr;
+  }
+
+  // Encoded payload of a chunk, or an empty one if it is not stored.
+  std::pair<std::byte const*, size_t> chunkData(uint64_t key) const noexcept;
+};
+
+// Appends tiles to out as runs of equal values.
+template <typename TileType>
+void encodeTileRuns(TileType const* tiles, size_t count,
+                    std::vector<std::byte>& out) {
+  for (size_t i = 0; i < count;) {
+    auto run = uint16_t{1};
+    while (i + run < count && run < UINT16_MAX && tiles[i + run] == tiles[i]) {
+      ++run;
+    }
+
+    auto offset = out.size();
+    out.resize(offset + sizeof(uint16_t) + sizeof(TileType));
+    std::memcpy(&out[offset], &run, sizeof(uint16_t));
+    std::memcpy(&out[offset + sizeof(uint16_t)], &tiles[i], sizeof(TileType));
+    i += run;
+  }
+}
+
+// Decodes exactly count tiles, crashing on malformed input.
+template <typename TileType>
+void decodeTileRuns(std::byte const* in, size_t bytes, TileType* tiles,
+                    size_t count) {
+  auto end = in + bytes;
+  for (size_t i = 0; i < count;) {
+    crashIf(end - in < static_cast<ptrdiff_t>(sizeof(uint16_t) +
+                                              sizeof(TileType)));
+
+    uint16_t run;
+    TileType value;
+    std::memcpy(&run, in, sizeof(uint16_t));
+    std::memcpy(&value, in + sizeof(uint16_t), sizeof(TileType));
+    in += sizeof(uint16_t) + sizeof(TileType);
+
+    crashIf(run == 0 || run > count - i);
+    std::fill_n(tiles + i, run, value);
+    i += run;
+  }
+}
+
+// Writes all tiles of the storage, storing only chunks that differ
+// from their layer's background value.
+template <typename TileType, size_t ChunkSize>
+void saveTiles(TileStorage<TileType, ChunkSize> const& tiles,
+               std::string const& path) {
+  using Storage = TileStorage<TileType, ChunkSize>;
+
+  auto size = tiles.size();
+
+  auto index = std::vector<TilemapFileChunk>();
+  auto payloads = std::vector<std::byte>();
+  auto uniformTiles = std::vector<TileType>(Storage::chunkArea);
+
+  tiles.forEachChunk([&](uint64_t key, TileType const* pTiles,
+                         TileType const& uniform) {
+    if (!pTiles) {
+      std::fill(uniformTiles.begin(), uniformTiles.end(), uniform);
+      pTiles = uniformTiles.data();
+    }
+    auto offset = payloads.size();
+    encodeTileRuns(pTiles, Storage::chunkArea, payloads);
+    index.push_back({key, offset, payloads.size() - offset});
+  });
+
+  std::sort(index.begin(), index.end(),
+            [](auto const& lhs, auto const& rhs) { return lhs.key < rhs.key; });
+
+  auto header = TilemapFileHeader{TilemapFileHeader::magicValue,
+                                  TilemapFileHeader::currentVersion,
+                                  sizeof(TileType),
+                                  Storage::chunkSize,
+                                  {size.x, size.y, size.z},
+                                  index.size()};
+
+  auto backgrounds = std::vector<uint64_t>(size.z);
+  for (size_t z = 0; z < size.z; ++z) {
+    std::memcpy(&backgrounds[z], &tiles.layerBackground(z), sizeof(TileType));
+  }
+
+  // Payload offsets are stored relative to the start of the file.
+  auto payloadStart = sizeof(header) + backgrounds.size() * sizeof(uint64_t) +
+                      index.size() * sizeof(TilemapFileChunk);
+  for (auto& chunk : index) chunk.offset += payloadStart;
+
+  auto file = std::ofstream(path, std::ios::binary | std::ios::trunc);
+  crashIf(!file);
+
+  file.write(reinterpret_cast<char const*>(&header), sizeof(header));
+  file.write(reinterpret_cast<char const*>(backgrounds.data()),
+             backgrounds.size() * sizeof(uint64_t));
+  file.write(reinterpret_cast<char const*>(index.data()),
+             index.size() * sizeof(TilemapFileChunk));
+  file.write(reinterpret_cast<char const*>(payloads.data()), payloads.size());
+  crashIf(!file);
+}
+
+template <typename TileType>
+void saveTilemap(Tilemap<TileType> const& tilemap, std::string const& path) {
+  saveTiles(tilemap.tiles(), path);
+}
+
+// Streams the chunks of a tilemap file into a tilemap, as the camera
+// moves across it. Chunks around the visible area are decoded on a
+// loader thread and installed by update(), so drawing never waits for
+// the disk. Nor does it wait for the device, as the tilemap uploads
+// the geometry of installed chunks with the frame drawing them, and
+// retires that of evicted ones until no frame in flight uses it. Once
+// the decoded chunks exceed the memory budget, those least recently near
+// the camera are reverted to their background. Edits made to streamed
+// chunks are lost once they are evicted, and an eviction counts as an
+// edit of its whole layer, so results cached against region revisions
+// of that layer are recomputed.
+template <typename TileType>
+class TilemapStreamer {
+  using Storage = typename Tilemap<TileType>::Storage;
+  using ChunkKey = typename Storage::ChunkKey;
+
+ private:
+  struct LoadedChunk {
+    ChunkKey key;
+    std::unique_ptr<TileType[]> pTiles;
+  };
+
+  TilemapFile const& m_file;
+  Tilemap<TileType>& m_tilemap;
+  size_t m_memoryBudget;
+
+  // Shared with the loader thread.
+  std::mutex m_mutex;
+  std::condition_variable m_wakeLoader;
+  std::deque<ChunkKey> m_requests;
+  std::vector<LoadedChunk> m_loaded;
+  bool m_stopLoader;
+
+  // Only accessed by the thread calling update().
+  std::unordered_set<ChunkKey> m_pending;
+  std::unordered_map<ChunkKey, uint64_t> m_lastWanted;
+  uint64_t m_updateCount;
+
+  std::thread m_loader;
+
+  void runLoader() {
+    auto lock = std::unique_lock(m_mutex);
+    while (true) {
+      m_wakeLoader.wait(lock,
+                        [this] { return m_stopLoader || !m_requests.empty(); });
+      if (m_stopLoader) return;
+
+      auto key = m_requests.front();
+      m_requests.pop_front();
+
+      // Decode without holding the lock, as the pages of the chunk
+      // may first have to be read from disk.
+      lock.unlock();
+      auto [pData, bytes] = m_file.chunkData(key);
+      auto pTiles = std::make_unique_for_overwrite<TileType[]>(
+          Storage::chunkArea);
+      decodeTileRuns(pData, bytes, pTiles.get(), Storage::chunkArea);
+      lock.lock();
+
+      m_loaded.push_back({key, std::move(pTiles)});
+    }
+  }
+
+  void installLoadedChunks() {
+    auto loaded = std::vector<LoadedChunk>();
+    {
+      auto lock = std::lock_guard(m_mutex);
+      std::swap(loaded, m_loaded);
+    }
+
+    for (auto& chunk : loaded) {
+      auto coords = Storage::chunkCoords(chunk.key);
+      m_tilemap.setChunk(coords.x, coords.y, coords.z,
+                         std::move(chunk.pTiles));
+      m_pending.erase(chunk.key);
+      m_lastWanted[chunk.key] = m_updateCount;
+    }
+  }
+
+  void evictChunks() {
+    auto chunkBytes = Storage::chunkArea * sizeof(TileType);
+    if (m_lastWanted.size() * chunkBytes <= m_memoryBudget) return;
+
+    // Chunks wanted by the current update are never evicted.
+    auto candidates = std::vector<std::pair<uint64_t, ChunkKey>>();
+    for (auto const& [key, lastWanted] : m_lastWanted) {
+      if (lastWanted < m_updateCount) candidates.push_back({lastWanted, key});
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    for (auto const& [lastWanted, key] : candidates) {
+      if (m_lastWanted.size() * chunkBytes <= m_memoryBudget) break;
+      auto coords = Storage::chunkCoords(key);
+      m_tilemap.resetChunk(coords.x, coords.y, coords.z);
+      m_lastWanted.erase(key);
+    }
+  }
+
+ public:
+  inline TilemapStreamer(TilemapFile const& file, Tilemap<TileType>& tilemap,
+                         size_t memoryBudget)
+      : m_file{file},
+        m_tilemap{tilemap},
+        m_memoryBudget{memoryBudget},
+        m_stopLoader{false},
+        m_updateCount{0} {
+    auto const& header = m_file.header();
+    crashIf(header.tileBytes != sizeof(TileType) ||
+            header.chunkSize != Storage::chunkSize ||
+            m_file.size() != m_tilemap.size());
+
+    for (size_t z = 0; z < m_tilemap.size().z; ++z) {
+      auto bits = m_file.layerBackground(z);
+      auto background = TileType{};
+      std::memcpy(&background, &bits, sizeof(TileType));
+      m_tilemap.fill(z, background);
+    }
+
+    m_loader = std::thread([this] { runLoader(); });
+  }
+
+  inline ~TilemapStreamer() {
+    {
+      auto lock = std::lock_guard(m_mutex);
+      m_stopLoader = true;
+    }
+    m_wakeLoader.notify_one();
+    m_loader.join();
+  }
+
+  // Installs chunks decoded since the last call, and requests those
+  // within marginChunks of the visible area, nearest ones first.
+  void update(Camera2d const& camera, size_t marginChunks = 1) {
+    ++m_updateCount;
+    installLoadedChunks();
+
+    auto size = m_tilemap.size();
+    auto tileSize = m_tilemap.tileSize();
+    auto chunkSize = Storage::chunkSize;
+
+    auto worldToChunk = [&](glm::vec2 const& world) {
+      auto tile = glm::max(world, glm::vec2{0, 0}) / tileSize;
+      return glm::u64vec2{static_cast<size_t>(tile.x) / chunkSize,
+                          static_cast<size_t>(tile.y) / chunkSize};
+    };
+
+    auto minChunk = worldToChunk(camera.position());
+    auto maxChunk = worldToChunk(camera.position() + camera.viewportSize());
+
+    minChunk.x -= std::min<size_t>(minChunk.x, marginChunks);
+    minChunk.y -= std::min<size_t>(minChunk.y, marginChunks);
+    maxChunk.x = std::min<size_t>(maxChunk.x + marginChunks,
+                                  (size.x - 1) / chunkSize);
+    maxChunk.y = std::min<size_t>(maxChunk.y + marginChunks,
+                                  (size.y - 1) / chunkSize);
+
+    auto center = glm::vec2{minChunk + maxChunk} / 2.0f;
+    auto wanted = std::vector<std::pair<float, ChunkKey>>();
+
+    for (auto cy = minChunk.y; cy <= maxChunk.y; ++cy) {
+      for (auto cx = minChunk.x; cx <= maxChunk.x; ++cx) {
+        auto distance = glm::length(glm::vec2{cx, cy} - center);
+        for (size_t z = 0; z < size.z; ++z) {
+          auto key = Storage::chunkKey(cx, cy, z);
+          auto resident = m_lastWanted.find(key);
+          if (resident != m_lastWanted.end()) {
+            resident->second = m_updateCount;
+          } else if (m_file.hasChunk(key)) {
+            wanted.push_back({distance, key});
+          }
+        }
+      }
+    }
+    std::sort(wanted.begin(), wanted.end());
+
+    {
+      // Requests not yet picked up by the loader are replaced,
+      // so the queue never lags behind a moving camera.
+      auto lock = std::lock_guard(m_mutex);
+      for (auto key : m_requests) m_pending.erase(key);
+      m_requests.clear();
+
+      for (auto const& [distance, key] : wanted) {
+        if (m_pending.insert(key).second) m_requests.push_back(key);
+      }
+    }
+    m_wakeLoader.notify_one();
+
+    evictChunks();
+  }
+
+  inline size_t residentChunkCount() const noexcept {
+    return m_lastWanted.size();
+  }
+
+  inline size_t residentBytes() const noexcept {
+    return m_lastWanted.size() * Storage::chunkArea * sizeof(TileType);
+  }
+
+  inline size_t pendingChunkCount() const noexcept { return m_pending.size(); }
+};
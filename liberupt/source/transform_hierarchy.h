@@ -0,0 +1,307 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <limits>
+
+#include "common.h"
+
+// Local translations, scales and Euler angles of many objects, each
+// optionally parented to another, along with their world matrices.
+// Matrices are only recomputed by update, and only for transforms that
+// changed since, or whose ancestors did.
+//
+// State is kept as flat arrays ordered so that parents always precede
+// their children, which lets world matrices be composed in one forward
+// pass. Handles stay stable while the arrays get reordered.
+class TransformHierarchy {
+ public:
+  using Handle = uint32_t;
+  static constexpr Handle none = std::numeric_limits<Handle>::max();
+
+ private:
+  // Local matrices are computed this many at a time, from separate
+  // arrays per component so the loops compile to vector instructions.
+  static constexpr size_t batchSize = 64;
+
+  // Per slot.
+  std::vector<glm::vec3> m_positions;
+  std::vector<glm::vec3> m_scales;
+  std::vector<glm::vec3> m_eulers;
+  std::vector<uint32_t> m_parentSlots;
+  std::vector<glm::mat4> m_localMatrices;
+  std::vector<glm::mat4> m_worldMatrices;
+  std::vector<uint8_t> m_isLocalDirty;
+  std::vector<uint8_t> m_isWorldDirty;
+  std::vector<Handle> m_handles;
+
+  // Per handle, none for destroyed ones.
+  std::vector<uint32_t> m_slots;
+  std::vector<Handle> m_freeHandles;
+
+  // Destroyed slots and parents placed after their children are only
+  // fixed up by the next update.
+  bool m_needsReorder;
+
+  // Whether anything changed since the last update.
+  bool m_isDirty;
+
+  std::vector<Handle> m_changed;
+
+  inline uint32_t slotOf(Handle handle) const {
+    crashIf(handle >= m_slots.size() || m_slots[handle] == none);
+    return m_slots[handle];
+  }
+
+  // Drops destroyed slots, turning their children into roots, and sorts
+  // the rest depth first so that parents precede their children.
+  void reorder() {
+    auto numSlots = m_handles.size();
+    auto isLive = [&](uint32_t slot) { return m_handles[slot] != none; };
+
+    auto childOffsets = std::vector<uint32_t>(numSlots + 1, 0);
+    for (uint32_t slot = 0; slot < numSlots; ++slot) {
+      auto parent = m_parentSlots[slot];
+      if (!isLive(slot)) continue;
+      if (parent != none && !isLive(parent)) {
+        m_parentSlots[slot] = parent = none;
+        m_isWorldDirty[slot] = 1;
+      }
+      if (parent != none) ++childOffsets[parent + 1];
+    }
+    for (size_t slot = 0; slot < numSlots; ++slot) {
+      childOffsets[slot + 1] += childOffsets[slot];
+    }
+    auto children = std::vector<uint32_t>(childOffsets.back());
+    auto fill = std::vector<uint32_t>(childOffsets.begin(),
+                                      childOffsets.end() - 1);
+    for (uint32_t slot = 0; slot < numSlots; ++slot) {
+      auto parent = m_parentSlots[slot];
+      if (isLive(slot) && parent != none) children[fill[parent]++] = slot;
+    }
+
+    auto order = std::vector<uint32_t>{};
+    order.reserve(numSlots);
+    auto pending = std::vector<uint32_t>{};
+    for (uint32_t root = 0; root < numSlots; ++root) {
+      if (!isLive(root) || m_parentSlots[root] != none) continue;
+      pending.push_back(root);
+      while (!pending.empty()) {
+        auto slot = pending.back();
+        pending.pop_back();
+        order.push_back(slot);
+        for (auto i = childOffsets[slot + 1]; i-- > childOffsets[slot];) {
+          pending.push_back(children[i]);
+        }
+      }
+    }
+
+    auto newSlots = std::vector<uint32_t>(numSlots, none);
+    for (uint32_t i = 0; i < order.size(); ++i) newSlots[order[i]] = i;
+
+    auto permute = [&](auto& values) {
+      auto permuted = std::remove_reference_t<decltype(values)>{};
+      permuted.reserve(order.size());
+      for (auto slot : order) permuted.push_back(values[slot]);
+      values = std::move(permuted);
+    };
+    permute(m_positions);
+    permute(m_scales);
+    permute(m_eulers);
+    permute(m_parentSlots);
+    permute(m_localMatrices);
+    permute(m_worldMatrices);
+    permute(m_isLocalDirty);
+    permute(m_isWorldDirty);
+    permute(m_handles);
+
+    for (auto& parent : m_parentSlots) {
+      if (parent != none) parent = newSlots[parent];
+    }
+    for (uint32_t slot = 0; slot < m_handles.size(); ++slot) {
+      m_slots[m_handles[slot]] = slot;
+    }
+    m_needsReorder = false;
+  }
+
+  // Computes translate * scale * eulerAngleYXZ(y, x, z), as Model does,
+  // for every transform whose local state changed.
+  void computeLocalMatrices() {
+    alignas(32) float cy[batchSize], sy[batchSize];
+    alignas(32) float cx[batchSize], sx[batchSize];
+    alignas(32) float cz[batchSize], sz[batchSize];
+    alignas(32) float scaleX[batchSize], scaleY[batchSize], scaleZ[batchSize];
+    alignas(32) float m[9][batchSize];
+    uint32_t slots[batchSize];
+
+    auto flush = [&](size_t count) {
+      for (size_t i = 0; i < count; ++i) {
+        m[0][i] = scaleX[i] * (cy[i] * cz[i] + sy[i] * sx[i] * sz[i]);
+        m[1][i] = scaleY[i] * (sz[i] * cx[i]);
+        m[2][i] = scaleZ[i] * (-sy[i] * cz[i] + cy[i] * sx[i] * sz[i]);
+        m[3][i] = scaleX[i] * (-cy[i] * sz[i] + sy[i] * sx[i] * cz[i]);
+        m[4][i] = scaleY[i] * (cz[i] * cx[i]);
+        m[5][i] = scaleZ[i] * (sz[i] * sy[i] + cy[i] * sx[i] * cz[i]);
+        m[6][i] = scaleX[i] * (sy[i] * cx[i]);
+        m[7][i] = scaleY[i] * -sx[i];
+        m[8][i] = scaleZ[i] * (cy[i] * cx[i]);
+      }
+
+      for (size_t i = 0; i < count; ++i) {
+        auto slot = slots[i];
+        auto& local = m_localMatrices[slot];
+        for (int col = 0; col < 3; ++col) {
+          local[col] = {m[3 * col][i], m[3 * col + 1][i], m[3 * col + 2][i],
+                        0};
+        }
+        local[3] = glm::vec4(m_positions[slot], 1);
+        m_isLocalDirty[slot] = 0;
+        m_isWorldDirty[slot] = 1;
+      }
+    };
+
+    auto count = size_t{0};
+    for (uint32_t slot = 0; slot < m_handles.size(); ++slot) {
+      if (!m_isLocalDirty[slot]) continue;
+
+      auto const& euler = m_eulers[slot];
+      auto const& scale = m_scales[slot];
+      cy[count] = std::cos(euler.y), sy[count] = std::sin(euler.y);
+      cx[count] = std::cos(euler.x), sx[count] = std::sin(euler.x);
+      cz[count] = std::cos(euler.z), sz[count] = std::sin(euler.z);
+      scaleX[count] = scale.x, scaleY[count] = scale.y, scaleZ[count] = scale.z;
+      slots[count] = slot;
+
+      if (++count == batchSize) {
+        flush(count);
+        count = 0;
+      }
+    }
+    flush(count);
+  }
+
+ public:
+  inline TransformHierarchy() : m_needsReorder{false}, m_isDirty{false} {}
+
+  // Adds an identity transform, placed under a parent if given.
+  inline Handle create(Handle parent = none) {
+    auto parentSlot = parent == none ? none : slotOf(parent);
+
+    auto handle = static_cast<Handle>(m_slots.size());
+    if (!m_freeHandles.empty()) {
+      handle = m_freeHandles.back();
+      m_freeHandles.pop_back();
+    } else {
+      m_slots.push_back(none);
+    }
+
+    m_slots[handle] = static_cast<uint32_t>(m_handles.size());
+    m_positions.push_back({0, 0, 0});
+    m_scales.push_back({1, 1, 1});
+    m_eulers.push_back({0, 0, 0});
+    m_parentSlots.push_back(parentSlot);
+    m_localMatrices.emplace_back(1);
+    m_worldMatrices.emplace_back(1);
+    m_isLocalDirty.push_back(1);
+    m_isWorldDirty.push_back(1);
+    m_handles.push_back(handle);
+    m_isDirty = true;
+    return handle;
+  }
+
+  // Removes a transform. Its children keep their local transforms, but
+  // become roots.
+  inline void destroy(Handle handle) {
+    auto slot = slotOf(handle);
+    m_handles[slot] = none;
+    m_isLocalDirty[slot] = 0;
+    m_slots[handle] = none;
+    m_freeHandles.push_back(handle);
+    m_needsReorder = true;
+    m_isDirty = true;
+  }
+
+  // Places a transform under another, or at the root given none. The
+  // local transform is kept, so the world transform changes.
+  inline void setParent(Handle handle, Handle parent) {
+    auto slot = slotOf(handle);
+    auto parentSlot = parent == none ? none : slotOf(parent);
+
+    for (auto ancestor = parentSlot; ancestor != none;
+         ancestor = m_parentSlots[ancestor]) {
+      crashIf(ancestor == slot);
+    }
+
+    m_parentSlots[slot] = parentSlot;
+    m_isWorldDirty[slot] = 1;
+    if (parentSlot != none && parentSlot > slot) m_needsReorder = true;
+    m_isDirty = true;
+  }
+
+  inline Handle parent(Handle handle) const {
+    auto parentSlot = m_parentSlots[slotOf(handle)];
+    return parentSlot == none ? none : m_handles[parentSlot];
+  }
+
+  inline glm::vec3 const& position(Handle handle) const {
+    return m_positions[slotOf(handle)];
+  }
+  inline glm::vec3 const& scale(Handle handle) const {
+    return m_scales[slotOf(handle)];
+  }
+  inline glm::vec3 const& euler(Handle handle) const {
+    return m_eulers[slotOf(handle)];
+  }
+
+  inline void setPosition(Handle handle, glm::vec3 const& position) {
+    auto slot = slotOf(handle);
+    m_positions[slot] = position;
+    m_isLocalDirty[slot] = 1;
+    m_isDirty = true;
+  }
+  inline void setScale(Handle handle, glm::vec3 const& scale) {
+    auto slot = slotOf(handle);
+    m_scales[slot] = scale;
+    m_isLocalDirty[slot] = 1;
+    m_isDirty = true;
+  }
+  inline void setEuler(Handle handle, glm::vec3 const& euler) {
+    auto slot = slotOf(handle);
+    m_eulers[slot] = euler;
+    m_isLocalDirty[slot] = 1;
+    m_isDirty = true;
+  }
+
+  // As of the last update.
+  inline glm::mat4 const& worldMatrix(Handle handle) const {
+    return m_worldMatrices[slotOf(handle)];
+  }
+
+  // Recomputes the matrices of changed transforms and their
+  // descendants.
+  void update() {
+    m_changed.clear();
+    if (!m_isDirty) return;
+
+    if (m_needsReorder) reorder();
+    computeLocalMatrices();
+
+    for (uint32_t slot = 0; slot < m_handles.size(); ++slot) {
+      auto parent = m_parentSlots[slot];
+      if (parent != none && m_isWorldDirty[parent]) m_isWorldDirty[slot] = 1;
+      if (!m_isWorldDirty[slot]) continue;
+
+      m_worldMatrices[slot] =
+          parent == none ? m_localMatrices[slot]
+                         : m_worldMatrices[parent] * m_localMatrices[slot];
+      m_changed.push_back(m_handles[slot]);
+    }
+    std::fill(m_isWorldDirty.begin(), m_isWorldDirty.end(), 0);
+    m_isDirty = false;
+  }
+
+  inline size_t size() const noexcept { return m_handles.size(); }
+
+  // Transforms whose world matrices were recomputed by the last update,
+  // e.g. to refit their bounds in a Bvh.
+  GETTER(changed, m_changed)
+};
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <chrono>
+
+#include "shader_interface.h"
+#include "worker_pool.h"
+
+// Meshes of block worlds, built a chunk at a time. Faces between two
+// blocks that hide each other are dropped, and the remaining faces are
+// greedily merged into rectangles sharing a plane and a texture (see
+// Lysenko, "Meshing in a Minecraft Game", 2012). Texture coordinates of
+// merged faces span one unit per block, so textures tile across them,
+// as samplers repeat.
+
+using BlockId = uint16_t;
+
+// The block filling empty space, which has no faces.
+constexpr BlockId airBlock = 0;
+
+// Blocks along each axis of a chunk.
+constexpr int voxelChunkSize = 32;
+
+// Faces of a block, as twice the axis they face along, plus one when
+// facing the positive direction.
+enum class VoxelFace { West, East, Down, Up, South, North };
+
+// How a kind of block looks, in a table indexed by BlockId.
+struct VoxelBlockType {
+  // Textures of the faces, by VoxelFace, as indices chosen by the
+  // caller, e.g. into a list of textures.
+  std::array<uint16_t, 6> faceTextures = {};
+
+  // Opaque blocks hide the faces of any block next to them. Others,
+  // like leaves or glass, only hide faces of blocks of their own kind.
+  bool isOpaque = true;
+};
+
+// Blocks of a chunk, along with a border one block wide taken from the
+// neighboring chunks, which decides whether faces at the chunk's edges
+// are hidden. Coordinates range from -1 to voxelChunkSize.
+struct VoxelNeighborhood {
+  static constexpr int size = voxelChunkSize + 2;
+
+  std::array<BlockId, size * size * size> blocks;
+
+  static inline size_t index(int x, int y, int z) noexcept {
+    return (static_cast<size_t>(z + 1) * size + static_cast<size_t>(y + 1)) *
+               size +
+           static_cast<size_t>(x + 1);
+  }
+
+  inline BlockId at(int x, int y, int z) const noexcept {
+    return blocks[index(x, y, z)];
+  }
+
+  inline void set(int x, int y, int z, BlockId block) noexcept {
+    blocks[index(x, y, z)] = block;
+  }
+};
+
+// Quads of one texture, as indexed triangles.
+struct VoxelMeshPart {
+  uint16_t texture;
+  std::vector<VPositionColorTexcoord> vertices;
+  std::vector<uint32_t> indices;
+};
+
+// Positions are relative to the chunk's corner, in blocks.
+struct VoxelChunkMesh {
+  std::vector<VoxelMeshPart> parts;
+
+  // Visible block faces, and the quads they were merged into.
+  size_t numFaces = 0;
+  size_t numQuads = 0;
+};
+
+// Builds the mesh of the chunk in the middle of the neighborhood.
+inline VoxelChunkMesh meshVoxelChunk(
+    VoxelNeighborhood const& neighborhood,
+    std::vector<VoxelBlockType> const& blockTypes) {
+  constexpr int n = voxelChunkSize;
+
+  // Texture axes of each face, as the world axis and direction along
+  // which texture coordinates grow, matching cubeVertices.
+  struct TextureAxes {
+    int sAxis;
+    float sSign;
+    int tAxis;
+    float tSign;
+  };
+  static constexpr std::array<TextureAxes, 6> textureAxes = {{
+      {2, -1, 1, -1},  // West
+      {2, +1, 1, -1},  // East
+      {0, +1, 2, +1},  // Down
+      {0, +1, 2, -1},  // Up
+      {0, +1, 1, -1},  // South
+      {0, -1, 1, -1},  // North
+  }};
+
+  auto maxBlock = *std::max_element(neighborhood.blocks.begin(),
+                                    neighborhood.blocks.end());
+  crashIf(maxBlock >= blockTypes.size());
+
+  auto isHiddenBy = [&](BlockId block, BlockId neighbor) {
+    return neighbor != airBlock &&
+           (blockTypes[neighbor].isOpaque || neighbor == block);
+  };
+
+  auto mesh = VoxelChunkMesh{};
+  auto partOf = [&](uint16_t texture) -> VoxelMeshPart& {
+    for (auto& part : mesh.parts) {
+      if (part.texture == texture) return part;
+    }
+    return mesh.parts.emplace_back(VoxelMeshPart{texture, {}, {}});
+  };
+
+  // Texture index plus one of the visible faces of a slice, or zero.
+  auto mask = std::array<uint32_t, n * n>{};
+
+  for (int axis = 0; axis < 3; ++axis) {
+    auto u = (axis + 1) % 3;
+    auto v = (axis + 2) % 3;
+
+    for (int isPositive = 0; isPositive < 2; ++isPositive) {
+      auto face = 2 * axis + isPositive;
+      auto const& axes = textureAxes[face];
+
+      for (int slice = 0; slice < n; ++slice) {
+        auto p = std::array<int, 3>{};
+        p[axis] = slice;
+        auto q = p;
+        q[axis] = slice + (isPositive ? 1 : -1);
+
+        auto numVisible = 0;
+        for (int j = 0; j < n; ++j) {
+          p[v] = q[v] = j;
+          for (int i = 0; i < n; ++i) {
+            p[u] = q[u] = i;
+            auto block = neighborhood.at(p[0], p[1], p[2]);
+            auto isVisible =
+                block != airBlock &&
+                !isHiddenBy(block, neighborhood.at(q[0], q[1], q[2]));
+            mask[j * n + i] =
+                isVisible ? blockTypes[block].faceTextures[face] + 1u : 0;
+            numVisible += isVisible;
+          }
+        }
+        if (numVisible == 0) continue;
+        mesh.numFaces += numVisible;
+
+        for (int j = 0; j < n; ++j) {
+          for (int i = 0; i < n;) {
+            auto value = mask[j * n + i];
+            if (value == 0) {
+              ++i;
+              continue;
+            }
+
+            auto width = 1;
+            while (i + width < n && mask[j * n + i + width] == value) ++width;
+
+            auto height = 1;
+            for (; j + height < n; ++height) {
+              auto const* row = &mask[(j + height) * n + i];
+              if (!std::all_of(row, row + width,
+                               [&](auto other) { return other == value; })) {
+                break;
+              }
+            }
+            for (int row = j; row < j + height; ++row) {
+              std::fill_n(&mask[row * n + i], width, 0);
+            }
+
+            // Corners go counterclockwise around the face's normal.
+            auto corners = std::array<glm::vec3, 4>{};
+            auto spans = std::array<std::array<int, 2>, 4>{
+                {{0, 0}, {width, 0}, {width, height}, {0, height}}};
+            if (!isPositive) std::swap(spans[1], spans[3]);
+            for (size_t c = 0; c < 4; ++c) {
+              corners[c][axis] = static_cast<float>(slice + isPositive);
+              corners[c][u] = static_cast<float>(i + spans[c][0]);
+              corners[c][v] = static_cast<float>(j + spans[c][1]);
+            }
+
+            auto sMin = std::numeric_limits<float>::max();
+            auto tMin = std::numeric_limits<float>::max();
+            for (auto const& corner : corners) {
+              sMin = std::min(sMin, axes.sSign * corner[axes.sAxis]);
+              tMin = std::min(tMin, axes.tSign * corner[axes.tAxis]);
+            }
+
+            auto& part = partOf(static_cast<uint16_t>(value - 1));
+            auto first = static_cast<uint32_t>(part.vertices.size());
+            for (auto const& corner : corners) {
+              part.vertices.push_back(
+                  {corner,
+                   {1, 1, 1},
+                   {axes.sSign * corner[axes.sAxis] - sMin,
+                    axes.tSign * corner[axes.tAxis] - tMin}});
+            }
+            for (auto offset : {0u, 1u, 2u, 2u, 3u, 0u}) {
+              part.indices.push_back(first + offset);
+            }
+            ++mesh.numQuads;
+            i += width;
+          }
+        }
+      }
+    }
+  }
+
+  std::sort(mesh.parts.begin(), mesh.parts.end(),
+            [](auto const& lhs, auto const& rhs) {
+              return lhs.texture < rhs.texture;
+            });
+  return mesh;
+}
+
+struct VoxelMeshingReport {
+  size_t numChunks = 0;
+  size_t numFaces = 0;
+  size_t numQuads = 0;
+  double milliseconds = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& out,
+                                VoxelMeshingReport const& report) {
+  auto chunks = static_cast<double>(std::max<size_t>(report.numChunks, 1));
+  return out << report.numChunks << " chunks, " << report.numFaces
+             << " faces merged into " << report.numQuads << " quads, "
+             << 2 * report.numQuads / chunks << " triangles per chunk, "
+             << report.milliseconds << " ms, "
+             << report.milliseconds / chunks << " ms per chunk";
+}
+
+// Meshes count chunks on the shared worker pool, where
+// fill(index, neighborhood) copies the blocks around the chunk of the
+// given index, and may be called from several threads at once.
+template <typename Fill>
+VoxelMeshingReport meshVoxelChunks(
+    size_t count, Fill&& fill, std::vector<VoxelBlockType> const& blockTypes,
+    std::vector<VoxelChunkMesh>& meshes) {
+  auto start = std::chrono::steady_clock::now();
+
+  meshes.clear();
+  meshes.resize(count);
+  sharedWorkerPool().parallelFor(count, 1, [&](size_t begin, size_t end) {
+    // Allocated once per range of chunks rather than per chunk, since
+    // fill overwrites all of it.
+    auto pNeighborhood = std::make_unique<VoxelNeighborhood>();
+    for (auto index = begin; index < end; ++index) {
+      fill(index, *pNeighborhood);
+      meshes[index] = meshVoxelChunk(*pNeighborhood, blockTypes);
+    }
+  });
+
+  auto report = VoxelMeshingReport{};
+  report.numChunks = count;
+  for (auto const& mesh : meshes) {
+    report.numFaces += mesh.numFaces;
+    report.numQuads += mesh.numQuads;
+  }
+  report.milliseconds = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+  return report;
+}
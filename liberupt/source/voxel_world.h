@@ -0,0 +1,536 @@
+#pragma once
+
+#include <bit>
+#include <bitset>
+#include <glm/glm.hpp>
+#include <unordered_map>
+
+#include "voxel_mesher.h"
+
+// Blocks of a chunk, stored as indices into a palette of the distinct
+// blocks it holds, packed into 64 bit words with as few bits as the
+// palette needs. Chunks holding a single block throughout, like air or
+// solid stone, store only that block. Indices take 1, 2, 4 or 8 bits,
+// so that none straddles two words; chunks with more than 256 distinct
+// blocks store them directly, with 16 bits each.
+class VoxelChunk {
+ public:
+  static constexpr size_t volume =
+      static_cast<size_t>(voxelChunkSize) * voxelChunkSize * voxelChunkSize;
+
+  // Blocks are indexed with x growing fastest, then y, then z.
+  static inline size_t index(int x, int y, int z) noexcept {
+    return (static_cast<size_t>(z) * voxelChunkSize +
+            static_cast<size_t>(y)) *
+               voxelChunkSize +
+           static_cast<size_t>(x);
+  }
+
+  // Bits per block of chunks storing blocks directly.
+  static constexpr uint32_t directBits = 16;
+
+ private:
+  static constexpr uint32_t maxPaletteBits = 8;
+
+  // Bits per block, zero while uniform.
+  uint32_t m_bits;
+  BlockId m_uniform;
+
+  // Distinct blocks, and how many blocks of the chunk refer to each.
+  // Entries nothing refers to anymore get reused. Both are empty while
+  // uniform or storing blocks directly.
+  std::vector<BlockId> m_palette;
+  std::vector<uint16_t> m_counts;
+
+  std::vector<uint64_t> m_words;
+
+  static_assert(volume <= std::numeric_limits<uint16_t>::max());
+  static_assert(volume % 64 == 0);
+
+  static inline uint32_t bitsFor(size_t paletteSize) noexcept {
+    if (paletteSize <= 1) return 0;
+    auto bits = uint32_t{1};
+    while (bits < directBits && paletteSize > size_t{1} << bits) bits *= 2;
+    return bits > maxPaletteBits ? directBits : bits;
+  }
+
+  inline uint32_t readIndex(size_t i) const noexcept {
+    auto bit = i * m_bits;
+    return static_cast<uint32_t>(m_words[bit >> 6] >> (bit & 63)) &
+           ((1u << m_bits) - 1);
+  }
+
+  inline void writeIndex(size_t i, uint32_t value) noexcept {
+    auto bit = i * m_bits;
+    auto shift = bit & 63;
+    auto mask = ((uint64_t{1} << m_bits) - 1) << shift;
+    auto& word = m_words[bit >> 6];
+    word = (word & ~mask) | static_cast<uint64_t>(value) << shift;
+  }
+
+  template <uint32_t Bits>
+  inline void decodeRun(size_t first, size_t count,
+                        BlockId* out) const noexcept {
+    constexpr auto mask = (uint64_t{1} << Bits) - 1;
+    for (size_t i = 0; i < count; ++i) {
+      auto bit = (first + i) * Bits;
+      auto value =
+          static_cast<uint32_t>(m_words[bit >> 6] >> (bit & 63) & mask);
+      if constexpr (Bits == directBits) {
+        out[i] = static_cast<BlockId>(value);
+      } else {
+        out[i] = m_palette[value];
+      }
+    }
+  }
+
+  // Copies count consecutive blocks, starting at index first.
+  inline void decodeRun(size_t first, size_t count,
+                        BlockId* out) const noexcept {
+    switch (m_bits) {
+      case 0: std::fill_n(out, count, m_uniform); break;
+      case 1: decodeRun<1>(first, count, out); break;
+      case 2: decodeRun<2>(first, count, out); break;
+      case 4: decodeRun<4>(first, count, out); break;
+      case 8: decodeRun<8>(first, count, out); break;
+      default: decodeRun<directBits>(first, count, out); break;
+    }
+  }
+
+  inline void becomeUniform(BlockId block) noexcept {
+    m_bits = 0;
+    m_uniform = block;
+    m_palette = std::vector<BlockId>{};
+    m_counts = std::vector<uint16_t>{};
+    m_words = std::vector<uint64_t>{};
+  }
+
+  // Stores the palette indices again with more bits each, or the
+  // blocks themselves when switching to direct storage.
+  inline void repack(uint32_t bits) {
+    auto values = std::vector<uint32_t>(volume);
+    for (size_t i = 0; i < volume; ++i) {
+      auto entry = readIndex(i);
+      values[i] = bits == directBits ? m_palette[entry] : entry;
+    }
+
+    m_bits = bits;
+    m_words.assign(volume * bits / 64, 0);
+    for (size_t i = 0; i < volume; ++i) writeIndex(i, values[i]);
+    if (bits == directBits) {
+      m_palette = std::vector<BlockId>{};
+      m_counts = std::vector<uint16_t>{};
+    }
+  }
+
+ public:
+  inline VoxelChunk(BlockId block = airBlock) noexcept
+      : m_bits{0}, m_uniform{block}, m_palette{}, m_counts{}, m_words{} {}
+
+  // Whether every block of the chunk is the same.
+  inline bool isUniform() const noexcept { return m_bits == 0; }
+
+  // Block filling a uniform chunk.
+  GETTER(uniform, m_uniform)
+
+  // Bits stored per block, zero for uniform chunks and 16 for chunks
+  // storing blocks directly.
+  GETTER(bits, m_bits)
+
+  inline BlockId at(size_t i) const noexcept {
+    if (m_bits == 0) return m_uniform;
+    auto value = readIndex(i);
+    return m_bits == directBits ? static_cast<BlockId>(value)
+                                : m_palette[value];
+  }
+
+  inline BlockId at(int x, int y, int z) const noexcept {
+    return at(index(x, y, z));
+  }
+
+  // Takes time proportional to the size of the palette, which has at
+  // most 256 entries, except when the palette outgrows its bits, and
+  // the chunk gets repacked. Chunks storing blocks directly become
+  // uniform again only through compact.
+  inline void set(size_t i, BlockId block) {
+    if (m_bits == 0) {
+      if (block == m_uniform) return;
+      m_bits = 1;
+      m_palette = {m_uniform, block};
+      m_counts = {static_cast<uint16_t>(volume - 1), 1};
+      m_words.assign(volume / 64, 0);
+      writeIndex(i, 1);
+      return;
+    }
+
+    if (m_bits == directBits) {
+      writeIndex(i, block);
+      return;
+    }
+
+    auto old = readIndex(i);
+    if (m_palette[old] == block) return;
+    --m_counts[old];
+
+    auto entry = static_cast<uint32_t>(
+        std::find(m_palette.begin(), m_palette.end(), block) -
+        m_palette.begin());
+    if (entry == m_palette.size()) {
+      if (m_counts[old] == 0) {
+        entry = old;
+      } else {
+        entry = static_cast<uint32_t>(
+            std::find(m_counts.begin(), m_counts.end(), 0) - m_counts.begin());
+      }
+
+      if (entry < m_palette.size()) {
+        m_palette[entry] = block;
+      } else {
+        m_palette.push_back(block);
+        m_counts.push_back(0);
+        if (m_palette.size() > size_t{1} << m_bits) {
+          repack(m_bits == maxPaletteBits ? directBits : m_bits * 2);
+          if (m_bits == directBits) {
+            writeIndex(i, block);
+            return;
+          }
+        }
+      }
+    }
+
+    if (++m_counts[entry] == volume) {
+      becomeUniform(block);
+      return;
+    }
+    writeIndex(i, entry);
+  }
+
+  inline void set(int x, int y, int z, BlockId block) {
+    set(index(x, y, z), block);
+  }
+
+  inline void fill(BlockId block) noexcept { becomeUniform(block); }
+
+  // Replaces all blocks at once, with the smallest palette holding them.
+  inline void assign(BlockId const* blocks) {
+    auto first = blocks[0];
+    if (std::all_of(blocks, blocks + volume,
+                    [first](auto block) { return block == first; })) {
+      becomeUniform(first);
+      return;
+    }
+
+    auto seen = std::bitset<size_t{1} << 8 * sizeof(BlockId)>{};
+    auto palette = std::vector<BlockId>{};
+    for (size_t i = 0; i < volume; ++i) {
+      if (!seen.test(blocks[i])) {
+        seen.set(blocks[i]);
+        palette.push_back(blocks[i]);
+      }
+    }
+
+    m_bits = bitsFor(palette.size());
+    m_words.assign(volume * m_bits / 64, 0);
+    if (m_bits == directBits) {
+      m_palette = std::vector<BlockId>{};
+      m_counts = std::vector<uint16_t>{};
+      for (size_t i = 0; i < volume; ++i) writeIndex(i, blocks[i]);
+      return;
+    }
+
+    std::sort(palette.begin(), palette.end());
+    m_palette = std::move(palette);
+    m_counts.assign(m_palette.size(), 0);
+    for (size_t i = 0; i < volume; ++i) {
+      auto entry = static_cast<uint32_t>(
+          std::lower_bound(m_palette.begin(), m_palette.end(), blocks[i]) -
+          m_palette.begin());
+      ++m_counts[entry];
+      writeIndex(i, entry);
+    }
+  }
+
+  // Drops unused palette entries, packing the blocks with fewer bits
+  // where possible.
+  inline void compact() {
+    if (m_bits == 0) return;
+    auto blocks = std::vector<BlockId>(volume);
+    decodeRun(0, volume, blocks.data());
+    assign(blocks.data());
+  }
+
+  // Copies the blocks inside [lo, hi) to out, which receives the block
+  // at lo, with rows along x being strideY blocks apart, and layers
+  // along z strideZ blocks apart.
+  inline void readBox(glm::ivec3 const& lo, glm::ivec3 const& hi, BlockId* out,
+                      size_t strideY, size_t strideZ) const noexcept {
+    auto width = static_cast<size_t>(hi.x - lo.x);
+    for (int z = lo.z; z < hi.z; ++z) {
+      auto* layer = out + static_cast<size_t>(z - lo.z) * strideZ;
+      for (int y = lo.y; y < hi.y; ++y) {
+        decodeRun(index(lo.x, y, z), width,
+                  layer + static_cast<size_t>(y - lo.y) * strideY);
+      }
+    }
+  }
+
+  // Heap memory held by the chunk, besides the chunk itself.
+  inline size_t heapBytes() const noexcept {
+    return m_palette.capacity() * sizeof(BlockId) +
+           m_counts.capacity() * sizeof(uint16_t) +
+           m_words.capacity() * sizeof(uint64_t);
+  }
+};
+
+struct VoxelWorldReport {
+  size_t numChunks = 0;
+  size_t numUniformChunks = 0;
+  size_t numPalettedChunks = 0;
+  size_t numDirectChunks = 0;
+
+  // Memory held by the chunks and the map holding them.
+  size_t bytes = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& out,
+                                VoxelWorldReport const& report) {
+  auto blocks = static_cast<double>(report.numChunks * VoxelChunk::volume);
+  auto bitsPerBlock = blocks > 0 ? 8 * report.bytes / blocks : 0.0;
+  return out << report.numChunks << " chunks, " << report.numUniformChunks
+             << " uniform, " << report.numPalettedChunks << " paletted, "
+             << report.numDirectChunks << " direct, " << report.bytes
+             << " bytes, " << bitsPerBlock << " bits per block against "
+             << 8 * sizeof(BlockId) << " for a dense array";
+}
+
+// Unbounded block world, split into chunks of voxelChunkSize blocks
+// along each axis, which are kept in a hash map. Chunks not stored are
+// filled with air. Chunk coordinates range from -2^20 to 2^20 - 1.
+class VoxelWorld {
+ public:
+  // Chunk coordinates packed as 21 bits each, offset to be positive.
+  using ChunkKey = uint64_t;
+
+  static constexpr int maxChunkCoordinate = (1 << 20) - 1;
+
+  static inline ChunkKey chunkKey(glm::ivec3 const& chunk) noexcept {
+    constexpr auto offset = ChunkKey{1} << 20;
+    constexpr auto mask = (ChunkKey{1} << 21) - 1;
+    return ((static_cast<ChunkKey>(chunk.x) + offset) & mask) |
+           ((static_cast<ChunkKey>(chunk.y) + offset) & mask) << 21 |
+           ((static_cast<ChunkKey>(chunk.z) + offset) & mask) << 42;
+  }
+
+  static inline glm::ivec3 chunkCoords(ChunkKey key) noexcept {
+    constexpr auto mask = (ChunkKey{1} << 21) - 1;
+    return glm::ivec3{static_cast<int>(key & mask),
+                      static_cast<int>(key >> 21 & mask),
+                      static_cast<int>(key >> 42 & mask)} -
+           glm::ivec3(1 << 20);
+  }
+
+  // Coordinates of the chunk holding a block.
+  static inline glm::ivec3 chunkOf(glm::ivec3 const& pos) noexcept {
+    return {pos.x >> chunkShift, pos.y >> chunkShift, pos.z >> chunkShift};
+  }
+
+ private:
+  static constexpr int chunkShift = std::countr_zero(
+      static_cast<unsigned>(voxelChunkSize));
+  static constexpr int localMask = voxelChunkSize - 1;
+  static_assert(std::has_single_bit(static_cast<unsigned>(voxelChunkSize)));
+
+  // Keys are already unique per chunk; spreading their bits is enough.
+  struct ChunkKeyHash {
+    inline size_t operator()(ChunkKey key) const noexcept {
+      return static_cast<size_t>((key ^ key >> 29) * 0x9e3779b97f4a7c15ull);
+    }
+  };
+
+  std::unordered_map<ChunkKey, VoxelChunk, ChunkKeyHash> m_chunks;
+  std::unordered_map<ChunkKey, glm::ivec3, ChunkKeyHash> m_dirtyChunks;
+
+  static inline size_t localIndex(glm::ivec3 const& pos) noexcept {
+    return VoxelChunk::index(pos.x & localMask, pos.y & localMask,
+                             pos.z & localMask);
+  }
+
+  inline void markDirty(glm::ivec3 const& chunk) {
+    m_dirtyChunks.try_emplace(chunkKey(chunk), chunk);
+  }
+
+  inline VoxelChunk const* findChunk(glm::ivec3 const& chunk) const noexcept {
+    auto it = m_chunks.find(chunkKey(chunk));
+    return it == m_chunks.end() ? nullptr : &it->second;
+  }
+
+  // Stores a chunk filled with air first if there is none.
+  inline VoxelChunk& chunkAt(glm::ivec3 const& chunk) {
+    constexpr auto max = glm::ivec3(maxChunkCoordinate);
+    crashIf(glm::any(glm::greaterThan(chunk, max)) ||
+            glm::any(glm::lessThan(chunk, -max - 1)));
+    return m_chunks.try_emplace(chunkKey(chunk)).first->second;
+  }
+
+ public:
+  // Reads blocks while remembering the chunk last read from, which
+  // makes scans with spatial locality, like those of lighting, skip
+  // most hash lookups. Readers are invalidated by adding or removing
+  // chunks, and are not meant to be shared between threads.
+  class Reader {
+   private:
+    VoxelWorld const& m_world;
+    glm::ivec3 m_chunk;
+    VoxelChunk const* m_pChunk;
+    bool m_isValid;
+
+   public:
+    inline Reader(VoxelWorld const& world) noexcept
+        : m_world{world}, m_chunk{}, m_pChunk{nullptr}, m_isValid{false} {}
+
+    inline BlockId operator()(glm::ivec3 const& pos) noexcept {
+      auto chunk = chunkOf(pos);
+      if (!m_isValid || chunk != m_chunk) {
+        m_chunk = chunk;
+        m_pChunk = m_world.findChunk(chunk);
+        m_isValid = true;
+      }
+      return m_pChunk ? m_pChunk->at(localIndex(pos)) : airBlock;
+    }
+  };
+
+  inline VoxelWorld() : m_chunks{}, m_dirtyChunks{} {}
+
+  inline BlockId at(glm::ivec3 const& pos) const noexcept {
+    auto pChunk = findChunk(chunkOf(pos));
+    return pChunk ? pChunk->at(localIndex(pos)) : airBlock;
+  }
+
+  // Sets a block, marking its chunk dirty, along with the neighboring
+  // chunks whose border in a VoxelNeighborhood holds it.
+  inline void set(glm::ivec3 const& pos, BlockId block) {
+    auto chunk = chunkOf(pos);
+    if (at(pos) == block) return;
+    chunkAt(chunk).set(localIndex(pos), block);
+
+    auto range = [&](int axis) {
+      auto local = pos[axis] & localMask;
+      return glm::ivec2{local == 0 ? -1 : 0, local == localMask ? 1 : 0};
+    };
+    auto xs = range(0), ys = range(1), zs = range(2);
+    for (int dz = zs[0]; dz <= zs[1]; ++dz) {
+      for (int dy = ys[0]; dy <= ys[1]; ++dy) {
+        for (int dx = xs[0]; dx <= xs[1]; ++dx) {
+          markDirty(chunk + glm::ivec3{dx, dy, dz});
+        }
+      }
+    }
+  }
+
+  // Replaces the blocks of a chunk, laid out as in VoxelChunk, at once.
+  inline void setChunk(glm::ivec3 const& chunk, BlockId const* blocks) {
+    chunkAt(chunk).assign(blocks);
+    for (int dz = -1; dz <= 1; ++dz) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+          markDirty(chunk + glm::ivec3{dx, dy, dz});
+        }
+      }
+    }
+  }
+
+  inline bool hasChunk(glm::ivec3 const& chunk) const noexcept {
+    return findChunk(chunk) != nullptr;
+  }
+
+  // Copies the blocks of a chunk and its border into a neighborhood, to
+  // be meshed. Uniform and missing chunks are filled without decoding,
+  // so this may be called from several threads at once, as long as the
+  // world is not modified meanwhile.
+  inline void fillNeighborhood(glm::ivec3 const& chunk,
+                               VoxelNeighborhood& neighborhood) const {
+    constexpr int n = voxelChunkSize;
+    constexpr auto strideY = static_cast<size_t>(VoxelNeighborhood::size);
+    constexpr auto strideZ = strideY * strideY;
+
+    // Ranges of local coordinates taken from each neighbor along an
+    // axis, by offset plus one.
+    constexpr std::array<std::array<int, 2>, 3> ranges = {
+        {{n - 1, n}, {0, n}, {0, 1}}};
+
+    for (int dz = -1; dz <= 1; ++dz) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+          auto lo = glm::ivec3{ranges[dx + 1][0], ranges[dy + 1][0],
+                               ranges[dz + 1][0]};
+          auto hi = glm::ivec3{ranges[dx + 1][1], ranges[dy + 1][1],
+                               ranges[dz + 1][1]};
+          auto* out = &neighborhood.blocks[VoxelNeighborhood::index(
+              dx * n + lo.x, dy * n + lo.y, dz * n + lo.z)];
+
+          auto pChunk = findChunk(chunk + glm::ivec3{dx, dy, dz});
+          if (pChunk) {
+            pChunk->readBox(lo, hi, out, strideY, strideZ);
+            continue;
+          }
+          for (int z = 0; z < hi.z - lo.z; ++z) {
+            for (int y = 0; y < hi.y - lo.y; ++y) {
+              std::fill_n(out + static_cast<size_t>(z) * strideZ +
+                              static_cast<size_t>(y) * strideY,
+                          hi.x - lo.x, airBlock);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Chunks changed since last asked, whose meshes, or lighting, need to
+  // be rebuilt. Chunks filled with air may be among them.
+  inline std::vector<glm::ivec3> takeDirtyChunks() {
+    auto chunks = std::vector<glm::ivec3>{};
+    chunks.reserve(m_dirtyChunks.size());
+    for (auto const& [key, chunk] : m_dirtyChunks) chunks.push_back(chunk);
+    m_dirtyChunks.clear();
+    return chunks;
+  }
+
+  // Shrinks the palettes of chunks changed through editing, and drops
+  // chunks filled with air.
+  inline void compact() {
+    for (auto it = m_chunks.begin(); it != m_chunks.end();) {
+      it->second.compact();
+      if (it->second.isUniform() && it->second.uniform() == airBlock) {
+        it = m_chunks.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // Invokes fn(chunk, voxelChunk) for every stored chunk.
+  template <typename Fn>
+  inline void forEachChunk(Fn&& fn) const {
+    for (auto const& [key, chunk] : m_chunks) fn(chunkCoords(key), chunk);
+  }
+
+  inline VoxelWorldReport report() const {
+    auto report = VoxelWorldReport{};
+    report.numChunks = m_chunks.size();
+    // Each map node holds the key and chunk, next to a pointer and the
+    // cached hash, on top of a bucket pointer.
+    report.bytes = m_chunks.bucket_count() * sizeof(void*);
+    for (auto const& [key, chunk] : m_chunks) {
+      report.bytes += sizeof(ChunkKey) + sizeof(VoxelChunk) +
+                      2 * sizeof(void*) + chunk.heapBytes();
+      if (chunk.isUniform()) {
+        ++report.numUniformChunks;
+      } else if (chunk.bits() == VoxelChunk::directBits) {
+        ++report.numDirectChunks;
+      } else {
+        ++report.numPalettedChunks;
+      }
+    }
+    return report;
+  }
+};
@@ -16,6 +16,15 @@ constexpr auto requiredDeviceExtensions = std::array{
 constexpr auto validationLayers = std::array{
     "VK_LAYER_LUNARG_standard_validation", "VK_LAYER_LUNARG_monitor"};
 
+// Stages of draws and dispatches reading buffers written by uploads or
+// dispatches, and the kinds of reads they make.
+constexpr auto bufferReadStages = VkPipelineStageFlags{
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT};
+constexpr auto bufferReadAccess = VkAccessFlags{
+    VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT};
+
 void VulkanContext::createInstance() {
   VkApplicationInfo appInfo{};
   appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -69,10 +78,15 @@ void VulkanContext::selectPhysicalDevice() {
                           });
         });
 
+    // Dispatches are recorded among a frame's uploads, so the queue
+    // drawing frames must run compute shaders as well.
     size_t graphicsFamilyIndex;
     auto hasGraphics = contains(
         m_physicalDeviceQueueFamilies[candidate],
-        [](auto fam) { return fam.queueFlags & VK_QUEUE_GRAPHICS_BIT; },
+        [](auto fam) {
+          auto required = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+          return (fam.queueFlags & required) == required;
+        },
         &graphicsFamilyIndex);
 
     size_t presentationFamilyIndex;
@@ -170,8 +184,15 @@ void VulkanContext::createDevice() {
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
   createInfo.queueCreateInfoCount = queueCreateInfos.size();
-  VkPhysicalDeviceFeatures features{};
-  createInfo.pEnabledFeatures = &features;
+
+  // Optional features used by drawIndexedIndirect when available.
+  VkPhysicalDeviceFeatures supported;
+  vkGetPhysicalDeviceFeatures(m_physicalDevice, &supported);
+  m_enabledFeatures = {};
+  m_enabledFeatures.multiDrawIndirect = supported.multiDrawIndirect;
+  m_enabledFeatures.drawIndirectFirstInstance =
+      supported.drawIndirectFirstInstance;
+  createInfo.pEnabledFeatures = &m_enabledFeatures;
   createInfo.enabledExtensionCount = requiredDeviceExtensions.size();
   createInfo.ppEnabledExtensionNames = requiredDeviceExtensions.data();
 
@@ -272,6 +293,13 @@ void VulkanContext::createSwapchain(bool vsync) {
   crashIf(VK_SUCCESS !=
           vkAllocateCommandBuffers(m_device, &allocateInfo,
                                    m_swapchainCommandBuffers.data()));
+
+  m_swapchainUploadCommandBuffers.resize(m_swapchainImages.size());
+  crashIf(VK_SUCCESS !=
+          vkAllocateCommandBuffers(m_device, &allocateInfo,
+                                   m_swapchainUploadCommandBuffers.data()));
+
+  m_swapchainRetiredBuffers.resize(m_swapchainImages.size());
 }
 
 void VulkanContext::createDepthBuffer() {
@@ -367,6 +395,8 @@ void VulkanContext::accomodateWindow(GLFWwindow* window) {
 }
 
 void VulkanContext::onFrameBegin() {
+  m_frameArena.reset();
+
   // Find out the next swapchain image index to render to.
   crashIf(
       VK_SUCCESS !=
@@ -386,6 +416,16 @@ void VulkanContext::onFrameBegin() {
       VK_SUCCESS !=
       vkResetFences(m_device, 1, &m_swapchainFences[m_swapchainImageIndex]));
 
+  // The fence also covers all batches submitted before, so no frame in
+  // flight reads the buffers retired up to the last one on this image.
+  destroyRetiredBuffers(m_swapchainImageIndex);
+  if (!m_swapchainComputeDescriptorPools.empty()) {
+    crashIf(VK_SUCCESS !=
+            vkResetDescriptorPool(
+                m_device,
+                m_swapchainComputeDescriptorPools[m_swapchainImageIndex], 0));
+  }
+
   auto cmdbufBeginInfo = VkCommandBufferBeginInfo{};
   cmdbufBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
@@ -410,27 +450,129 @@ void VulkanContext::onFrameBegin() {
                        &passBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
   vkCmdBindPipeline(m_swapchainCommandBuffers[m_swapchainImageIndex],
-                    VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    m_pipelines[primaryPipeline]);
+  m_boundPipeline = primaryPipeline;
 
   clearUniformData();
+  clearInstanceData();
+  clearStagingData();
+  m_isRecordingFrame = true;
+  m_isRecordingUploads = false;
   m_boundTextures = {nullptr};
+  m_boundVertexBuffer = VK_NULL_HANDLE;
+  m_boundIndexBuffer = VK_NULL_HANDLE;
+  m_drawCallCount = 0;
+  m_pipelineBindCount = 0;
+  m_textureBindCount = 0;
+  m_bufferBindCount = 0;
+  m_redundantBindCount = 0;
 }
 
-void VulkanContext::draw(VkBuffer vbuf, VkBuffer ibuf, uint32_t count) {
+void VulkanContext::bindMeshBuffers(VkCommandBuffer cmdbuf, VkBuffer vbuf,
+                                    VkBuffer ibuf, VkIndexType indexType) {
   static constexpr auto offsetZero = VkDeviceSize{};
+
+  if (m_boundVertexBuffer != vbuf) {
+    vkCmdBindVertexBuffers(cmdbuf, 0, 1, &vbuf, &offsetZero);
+    m_boundVertexBuffer = vbuf;
+    ++m_bufferBindCount;
+  } else {
+    ++m_redundantBindCount;
+  }
+
+  if (!ibuf) return;
+  if (m_boundIndexBuffer != ibuf || m_boundIndexType != indexType) {
+    vkCmdBindIndexBuffer(cmdbuf, ibuf, 0, indexType);
+    m_boundIndexBuffer = ibuf;
+    m_boundIndexType = indexType;
+    ++m_bufferBindCount;
+  } else {
+    ++m_redundantBindCount;
+  }
+}
+
+void VulkanContext::draw(VkBuffer vbuf, VkBuffer ibuf, uint32_t count,
+                         uint32_t instanceCount, VkIndexType indexType,
+                         uint32_t firstIndex) {
   auto cmdbuf = m_swapchainCommandBuffers[m_swapchainImageIndex];
 
-  vkCmdBindVertexBuffers(cmdbuf, 0, 1, &vbuf, &offsetZero);
+  bindMeshBuffers(cmdbuf, vbuf, ibuf, indexType);
+  ++m_drawCallCount;
 
   // Draw indexed.
   if (ibuf) {
-    vkCmdBindIndexBuffer(cmdbuf, ibuf, 0, VK_INDEX_TYPE_UINT32);
-    vkCmdDrawIndexed(cmdbuf, count, 1, 0, 0, 0);
+    vkCmdDrawIndexed(cmdbuf, count, instanceCount, firstIndex, 0, 0);
   }
 
   // Don't draw indexed.
   else
-    vkCmdDraw(cmdbuf, count, 1, 0, 0);
+    vkCmdDraw(cmdbuf, count, instanceCount, 0, 0);
+}
+
+void VulkanContext::drawIndexedIndirect(
+    VkBuffer vbuf, VkBuffer ibuf, VkIndexType indexType,
+    VkDrawIndexedIndirectCommand const* commands, uint32_t count) {
+  static constexpr auto stride =
+      static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand));
+  if (count == 0) return;
+
+  auto cmdbuf = m_swapchainCommandBuffers[m_swapchainImageIndex];
+  bindMeshBuffers(cmdbuf, vbuf, ibuf, indexType);
+
+  // Without indirect first instance, commands are recorded one by one.
+  if (!m_enabledFeatures.drawIndirectFirstInstance) {
+    for (uint32_t i = 0; i < count; ++i) {
+      auto const& command = commands[i];
+      vkCmdDrawIndexed(cmdbuf, command.indexCount, command.instanceCount,
+                       command.firstIndex, command.vertexOffset,
+                       command.firstInstance);
+      ++m_drawCallCount;
+    }
+    return;
+  }
+
+  auto maxPerDraw = uint32_t{1};
+  if (m_enabledFeatures.multiDrawIndirect) {
+    maxPerDraw = std::min(
+        m_physicalDeviceProperties[m_physicalDevice].limits.maxDrawIndirectCount,
+        static_cast<uint32_t>(instanceBufferSize / stride));
+  }
+
+  for (uint32_t begin = 0; begin < count;) {
+    auto numCommands = std::min(count - begin, maxPerDraw);
+    auto [buffer, offset] =
+        writeInstanceBuffers(commands + begin, numCommands * stride);
+    vkCmdDrawIndexedIndirect(cmdbuf, buffer, offset, numCommands, stride);
+    ++m_drawCallCount;
+    begin += numCommands;
+  }
+}
+
+void VulkanContext::drawIndexedIndirect(VkBuffer vbuf, VkBuffer ibuf,
+                                        VkIndexType indexType,
+                                        VkBuffer commands, VkDeviceSize offset,
+                                        uint32_t count) {
+  static constexpr auto stride =
+      static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand));
+  if (count == 0) return;
+
+  auto cmdbuf = m_swapchainCommandBuffers[m_swapchainImageIndex];
+  bindMeshBuffers(cmdbuf, vbuf, ibuf, indexType);
+
+  auto maxPerDraw = uint32_t{1};
+  if (m_enabledFeatures.multiDrawIndirect) {
+    maxPerDraw =
+        m_physicalDeviceProperties[m_physicalDevice].limits.maxDrawIndirectCount;
+  }
+
+  for (uint32_t begin = 0; begin < count;) {
+    auto numCommands = std::min(count - begin, maxPerDraw);
+    vkCmdDrawIndexedIndirect(cmdbuf, commands, offset + begin * stride,
+                             numCommands, stride);
+    ++m_drawCallCount;
+    begin += numCommands;
+  }
 }
 
 void VulkanContext::onFrameEnd() {
@@ -440,13 +582,24 @@ void VulkanContext::onFrameEnd() {
   crashIf(vkEndCommandBuffer(
               m_swapchainCommandBuffers[m_swapchainImageIndex]) != VK_SUCCESS);
 
+  // Uploads, if any, are submitted first, in the same batch.
+  VkCommandBuffer cmdbufs[2];
+  uint32_t numCmdbufs = 0;
+  if (m_isRecordingUploads) {
+    auto uploads = m_swapchainUploadCommandBuffers[m_swapchainImageIndex];
+    crashIf(vkEndCommandBuffer(uploads) != VK_SUCCESS);
+    cmdbufs[numCmdbufs++] = uploads;
+    m_isRecordingUploads = false;
+  }
+  cmdbufs[numCmdbufs++] = m_swapchainCommandBuffers[m_swapchainImageIndex];
+  m_isRecordingFrame = false;
+
   auto stage =
       VkPipelineStageFlags{VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
   auto submitInfo = VkSubmitInfo{};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers =
-      &m_swapchainCommandBuffers[m_swapchainImageIndex];
+  submitInfo.commandBufferCount = numCmdbufs;
+  submitInfo.pCommandBuffers = cmdbufs;
   submitInfo.waitSemaphoreCount = 1;
   submitInfo.pWaitDstStageMask = &stage;
   submitInfo.pWaitSemaphores =
@@ -531,17 +684,130 @@ VulkanBufferInfo VulkanContext::createBuffer(VkBufferUsageFlags usage,
   return result;
 }
 
+uint32_t texelSize(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R32_UINT:
+      return 4;
+    case VK_FORMAT_R16_UINT:
+      return 2;
+    case VK_FORMAT_R8_UINT:
+      return 1;
+    default:
+      crashIf(true);
+  }
+  return 0;
+}
+
+void VulkanContext::recordCopyToImage(VkCommandBuffer cmdbuf,
+                                      VkBuffer staging,
+                                      VkDeviceSize bufferOffset, VkImage image,
+                                      VkImageLayout oldLayout,
+                                      glm::uvec2 const& offset,
+                                      glm::uvec2 const& extent) {
+  auto barrier = VkImageMemoryBarrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.image = image;
+
+  auto& srr = barrier.subresourceRange;
+  srr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  srr.levelCount = 1;
+  srr.layerCount = 1;
+
+  // Transition image layout into being writeable. An image which has
+  // been sampled before must not be written until those reads are done.
+  auto wasSampled = oldLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcAccessMask = wasSampled ? VK_ACCESS_SHADER_READ_BIT : 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+  vkCmdPipelineBarrier(cmdbuf,
+                       wasSampled ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+                                  : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &barrier);
+
+  auto region = VkBufferImageCopy{};
+  region.bufferOffset = bufferOffset;
+  region.imageOffset = {static_cast<int32_t>(offset.x),
+                        static_cast<int32_t>(offset.y), 0};
+  region.imageExtent = {extent.x, extent.y, 1};
+
+  auto& isr = region.imageSubresource;
+  isr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  isr.layerCount = 1;
+
+  vkCmdCopyBufferToImage(cmdbuf, staging, image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+  // Transition image layout into being usable by the shader.
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
+                       0, nullptr, 1, &barrier);
+}
+
+void VulkanContext::recordCopyToBuffer(VkCommandBuffer cmdbuf,
+                                       VkBuffer staging,
+                                       VkDeviceSize stagingOffset,
+                                       VkBuffer buffer, VkDeviceSize bytes) {
+  // Draws and dispatches submitted earlier may still read the old
+  // contents, which only takes an execution dependency to wait for.
+  vkCmdPipelineBarrier(cmdbuf, bufferReadStages,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 0, nullptr);
+
+  auto region = VkBufferCopy{};
+  region.srcOffset = stagingOffset;
+  region.size = bytes;
+  vkCmdCopyBuffer(cmdbuf, staging, buffer, 1, &region);
+
+  // Make the new contents visible to later draws, and to dispatches
+  // reading or overwriting them.
+  auto barrier = VkBufferMemoryBarrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = bufferReadAccess | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer;
+  barrier.size = bytes;
+
+  vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       bufferReadStages, 0, 0, nullptr, 1, &barrier, 0,
+                       nullptr);
+}
+
+void VulkanContext::copyToImage(VulkanBufferInfo const& staging, VkImage image,
+                                VkImageLayout oldLayout,
+                                glm::uvec2 const& offset,
+                                glm::uvec2 const& extent) {
+  runDeviceCommands([&](VkCommandBuffer cmdbuf) {
+    recordCopyToImage(cmdbuf, staging.buffer, 0, image, oldLayout, offset,
+                      extent);
+  });
+}
+
 VulkanTextureInfo VulkanContext::createTexture(uint32_t width, uint32_t height,
-                                               uint32_t const* pixels) {
+                                               void const* texels,
+                                               VkFormat format) {
   auto result = VulkanTextureInfo{};
   result.width = width;
   result.height = height;
+  result.format = format;
+  result.bytesPerTexel = texelSize(format);
 
-  auto bytes = VulkanTextureInfo::bytesPerPixel * width * height;
+  auto bytes = result.bytesPerTexel * width * height;
   auto staging = createHostBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
                                       VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT,
                                   bytes);
-  writeDeviceMemory(staging.memory, pixels, bytes);
+  writeDeviceMemory(staging.memory, texels, bytes);
 
   auto imageInfo = VkImageCreateInfo{};
   imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -549,7 +815,7 @@ VulkanTextureInfo VulkanContext::createTexture(uint32_t width, uint32_t height,
   imageInfo.extent.width = width;
   imageInfo.extent.height = height;
   imageInfo.extent.depth = 1;
-  imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+  imageInfo.format = format;
   imageInfo.imageType = VK_IMAGE_TYPE_2D;
   imageInfo.mipLevels = 1;
   imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -568,51 +834,16 @@ VulkanTextureInfo VulkanContext::createTexture(uint32_t width, uint32_t height,
           vkBindImageMemory(m_device, result.image, result.memory, 0));
 
   // Copy staging buffer into texture.
-  runDeviceCommands([&](VkCommandBuffer cmdbuf) {
-    auto barrier = VkImageMemoryBarrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.image = result.image;
-
-    auto& srr = barrier.subresourceRange;
-    srr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    srr.levelCount = 1;
-    srr.layerCount = 1;
-
-    // Transition image layout into being writeable.
-    barrier.srcAccessMask = 0;
-    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-
-    vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
-                         nullptr, 1, &barrier);
-
-    auto region = VkBufferImageCopy{};
-    region.imageExtent = {width, height, 1};
-
-    auto& isr = region.imageSubresource;
-    isr.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    isr.layerCount = 1;
-
-    vkCmdCopyBufferToImage(cmdbuf, staging.buffer, result.image,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-    // Transition image layout into being usable by the shader.
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr,
-                         0, nullptr, 1, &barrier);
-  });
+  copyToImage(staging, result.image, VK_IMAGE_LAYOUT_UNDEFINED, {0, 0},
+              {width, height});
 
   destroyBuffer(staging);
 
   result.view = createImageView(m_device, result.image, imageInfo.format);
 
   auto layouts =
-      repeat(m_samplerDescriptorSetLayout, VulkanTextureInfo::numSlots);
+      SmallVector<VkDescriptorSetLayout, VulkanTextureInfo::numSlots>{};
+  layouts.resize(VulkanTextureInfo::numSlots, m_samplerDescriptorSetLayout);
   auto setAllocInfo = VkDescriptorSetAllocateInfo{};
   setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
   setAllocInfo.descriptorPool = m_descriptorPool;
@@ -628,7 +859,7 @@ VulkanTextureInfo VulkanContext::createTexture(uint32_t width, uint32_t height,
   samplerInfo.imageView = result.view;
   samplerInfo.sampler = m_sampler;
 
-  for (auto slot : range(VulkanTextureInfo::numSlots)) {
+  for (uint8_t slot = 0; slot < VulkanTextureInfo::numSlots; ++slot) {
     auto write = VkWriteDescriptorSet{};
     write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     write.dstSet = result.samplerSlotDescriptorSets[slot];
@@ -643,36 +874,98 @@ VulkanTextureInfo VulkanContext::createTexture(uint32_t width, uint32_t height,
   return result;
 }
 
-VulkanBufferInfo VulkanContext::createVertexBuffer(
-    std::vector<VPositionColorTexcoord> const& vertices) {
-  auto bytes = vertices.size() * sizeof(VPositionColorTexcoord);
+void VulkanContext::updateTexture(VulkanTextureInfo const& txr,
+                                  glm::uvec2 const& offset,
+                                  glm::uvec2 const& extent,
+                                  void const* texels) {
+  crashIf(offset.x + extent.x > txr.width || offset.y + extent.y > txr.height);
+  if (extent.x == 0 || extent.y == 0) return;
+
+  auto bytes = txr.bytesPerTexel * extent.x * extent.y;
+  if (!m_isRecordingFrame) {
+    auto staging = createHostBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, bytes);
+    writeDeviceMemory(staging.memory, texels, bytes);
+    copyToImage(staging, txr.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                offset, extent);
+    destroyBuffer(staging);
+    return;
+  }
 
-  // Create CPU-accessible buffer.
-  auto host = createHostBuffer(
-      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      bytes);
+  auto [buffer, bufferOffset] = writeStagingBuffers(texels, bytes);
+  recordCopyToImage(uploadCommandBuffer(), buffer, bufferOffset, txr.image,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, offset, extent);
+}
 
-  // Write buffer data.
-  writeDeviceMemory(host.memory, vertices.data(), bytes);
+VkCommandBuffer VulkanContext::uploadCommandBuffer() {
+  auto cmdbuf = m_swapchainUploadCommandBuffers[m_swapchainImageIndex];
+  if (!m_isRecordingUploads) {
+    auto beginInfo = VkCommandBufferBeginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    crashIf(VK_SUCCESS != vkBeginCommandBuffer(cmdbuf, &beginInfo));
+    m_isRecordingUploads = true;
+  }
+  return cmdbuf;
+}
 
-  // Upload to GPU.
-  return uploadToDevice(host);
+VulkanBufferInfo VulkanContext::createBufferWithData(VkBufferUsageFlags usage,
+                                                     void const* data,
+                                                     size_t bytes) {
+  auto result =
+      createDeviceBuffer(usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, bytes);
+  updateBuffer(result, data, bytes);
+  return result;
 }
 
-VulkanBufferInfo VulkanContext::createIndexBuffer(
-    std::vector<uint32_t> const& indices) {
-  auto bytes = indices.size() * sizeof(uint32_t);
+void VulkanContext::updateBuffer(VulkanBufferInfo const& info,
+                                 void const* data, size_t bytes) {
+  crashIf(bytes > info.sizeInBytes);
+  if (bytes == 0) return;
+
+  if (!m_isRecordingFrame) {
+    auto staging = createHostBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, bytes);
+    writeDeviceMemory(staging.memory, data, bytes);
+    runDeviceCommands([&](VkCommandBuffer cmdbuf) {
+      recordCopyToBuffer(cmdbuf, staging.buffer, 0, info.buffer, bytes);
+    });
+    destroyBuffer(staging);
+    return;
+  }
 
-  // Create CPU-accessible buffer.
-  auto host = createHostBuffer(
-      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      bytes);
+  auto [buffer, offset] = writeStagingBuffers(data, bytes);
+  recordCopyToBuffer(uploadCommandBuffer(), buffer, offset, info.buffer,
+                     bytes);
+}
 
-  // Write buffer data.
-  writeDeviceMemory(host.memory, indices.data(), bytes);
+void VulkanContext::replaceBufferData(VulkanBufferInfo& info,
+                                      VkBufferUsageFlags usage,
+                                      void const* data, size_t bytes) {
+  if (info.buffer && bytes <= info.sizeInBytes) {
+    updateBuffer(info, data, bytes);
+  } else {
+    retireBuffer(info);
+    info = createBufferWithData(usage, data, bytes);
+  }
+}
 
-  // Upload to GPU.
-  return uploadToDevice(host);
+void VulkanContext::retireBuffer(VulkanBufferInfo& info) {
+  if (!info.buffer) return;
+
+  // Without a swapchain, no frame can have read it.
+  if (m_swapchainRetiredBuffers.empty()) {
+    destroyBuffer(info);
+    return;
+  }
+
+  m_swapchainRetiredBuffers[m_swapchainImageIndex].push_back(info);
+  info = {};
+}
+
+void VulkanContext::destroyRetiredBuffers(uint32_t swapchainImageIndex) {
+  for (auto& info : m_swapchainRetiredBuffers[swapchainImageIndex]) {
+    destroyBuffer(info);
+  }
+  m_swapchainRetiredBuffers[swapchainImageIndex].clear();
 }
 
 void VulkanContext::runDeviceCommands(
@@ -707,6 +1000,8 @@ void VulkanContext::runDeviceCommands(
   // Wait for completion.
   crashIf(VK_SUCCESS !=
           vkQueueWaitIdle(std::get<VkQueue>(m_queueInfo[QueueRole::Graphics])));
+
+  vkFreeCommandBuffers(m_device, m_commandPool, 1, &cmdbuf);
 }
 
 VulkanUboInfo& VulkanContext::growUniformBufferSequence() {
@@ -755,30 +1050,164 @@ VulkanUboInfo& VulkanContext::growUniformBufferSequence() {
   return ubo;
 }
 
-VulkanBufferInfo VulkanContext::uploadToDevice(
-    VulkanBufferInfo hostBufferInfo) {
-  auto usage = hostBufferInfo.usage;
-  usage &= ~VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-  usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+VulkanInstanceBufferInfo& VulkanContext::growInstanceBufferSequence() {
+  auto& seq = m_swapchainInstanceBufferSeqs[m_swapchainImageIndex];
+  auto buffer = createHostBuffer(
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+      instanceBufferSize);
+  seq.push_back({buffer, 0});
 
-  // Create GPU-local buffer.
-  auto deviceBufferInfo = createDeviceBuffer(usage, hostBufferInfo.sizeInBytes);
+  std::cout << "Grew instance buffer sequence [" << m_swapchainImageIndex
+            << "] to " << seq.size() << " buffers ("
+            << seq.size() * instanceBufferSize << " bytes)." << lf;
 
-  // Transfer data from CPU to GPU.
-  runDeviceCommands([&](VkCommandBuffer cmdbuf) {
-    auto region = VkBufferCopy{};
-    region.size = hostBufferInfo.sizeInBytes;
-    vkCmdCopyBuffer(cmdbuf, hostBufferInfo.buffer, deviceBufferInfo.buffer, 1,
-                    &region);
-  });
+  return seq.back();
+}
+
+VulkanStagingBufferInfo& VulkanContext::growStagingBufferSequence(
+    size_t minBytes) {
+  auto& seq = m_swapchainStagingBufferSeqs[m_swapchainImageIndex];
+  auto buffer = createHostBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                 std::max(minBytes, stagingBufferSize));
+  seq.push_back({buffer, 0});
+
+  std::cout << "Grew staging buffer sequence [" << m_swapchainImageIndex
+            << "] to " << seq.size() << " buffers." << lf;
+
+  return seq.back();
+}
+
+VkPipeline VulkanContext::buildPipeline(
+    VulkanPipelineSettings const& settings) {
+  auto vertexInput = VkPipelineVertexInputStateCreateInfo{};
+  vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInput.vertexAttributeDescriptionCount =
+      settings.vertexInputAttribs.size();
+  vertexInput.pVertexAttributeDescriptions = settings.vertexInputAttribs.data();
+
+  auto bindings = std::vector{settings.vertexInputBinding};
+  if (settings.instanceInputBinding) {
+    bindings.push_back(*settings.instanceInputBinding);
+  }
+  vertexInput.vertexBindingDescriptionCount =
+      static_cast<uint32_t>(bindings.size());
+  vertexInput.pVertexBindingDescriptions = bindings.data();
+
+  auto inputAssembly = VkPipelineInputAssemblyStateCreateInfo{};
+  inputAssembly.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+  // Setup pipeline stages.
+
+  auto viewport = VkViewport{};
+  viewport.x = 0.0f;
+  viewport.y = m_windowExtent.height - 1.0f;
+  viewport.width = static_cast<float>(m_windowExtent.width);
+  viewport.height = -1.0f * m_windowExtent.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+
+  auto scissor = VkRect2D{};
+  scissor.extent = m_windowExtent;
+
+  auto viewportState = VkPipelineViewportStateCreateInfo{};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.pViewports = &viewport;
+  viewportState.scissorCount = 1;
+  viewportState.pScissors = &scissor;
+
+  auto depthStencilState = VkPipelineDepthStencilStateCreateInfo{};
+  depthStencilState.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencilState.depthTestEnable = settings.enableDepthTest;
+  depthStencilState.depthWriteEnable = settings.enableDepthTest;
+  depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  depthStencilState.depthBoundsTestEnable = VK_FALSE;
+  depthStencilState.stencilTestEnable = VK_FALSE;
+
+  auto rasterState = VkPipelineRasterizationStateCreateInfo{};
+  rasterState.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterState.lineWidth = 1.0f;
+  rasterState.cullMode = debug ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+  rasterState.frontFace = VK_FRONT_FACE_CLOCKWISE;
+  rasterState.polygonMode = VK_POLYGON_MODE_FILL;
+
+  auto blendAttachmentState = VkPipelineColorBlendAttachmentState{};
+  blendAttachmentState.blendEnable = VK_TRUE;
+  blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+  blendAttachmentState.colorWriteMask = 0b1111;
+  blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+  blendAttachmentState.dstColorBlendFactor =
+      VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+  blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+
+  auto blendState = VkPipelineColorBlendStateCreateInfo{};
+  blendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  blendState.attachmentCount = 1;
+  blendState.pAttachments = &blendAttachmentState;
+
+  auto msaaState = VkPipelineMultisampleStateCreateInfo{};
+  msaaState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  msaaState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  auto stages = std::array{
+      VkPipelineShaderStageCreateInfo{
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .stage = VK_SHADER_STAGE_VERTEX_BIT,
+          .module = loadShader(settings.vertexShaderPath),
+          .pName = "main",
+      },
+      VkPipelineShaderStageCreateInfo{
+          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+          .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+          .module = loadShader(settings.fragmentShaderPath),
+          .pName = "main",
+      }};
+
+  auto pipelineInfo = VkGraphicsPipelineCreateInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.layout = m_pipelineLayout;
+  pipelineInfo.renderPass = m_renderPass;
+  pipelineInfo.subpass = 0;
+  pipelineInfo.stageCount = stages.size();
+  pipelineInfo.pStages = stages.data();
+  pipelineInfo.pVertexInputState = &vertexInput;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterState;
+  pipelineInfo.pColorBlendState = &blendState;
+  pipelineInfo.pMultisampleState = &msaaState;
+  pipelineInfo.pDepthStencilState =
+      m_hasDepthAttachment ? &depthStencilState : nullptr;
 
-  destroyBuffer(hostBufferInfo);
-  return deviceBufferInfo;
+  VkPipeline pipeline;
+  crashIf(VK_SUCCESS != vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1,
+                                                  &pipelineInfo, nullptr,
+                                                  &pipeline));
+  return pipeline;
+}
+
+VulkanPipelineHandle VulkanContext::addPipeline(
+    VulkanPipelineSettings const& settings) {
+  // Additional pipelines share the render pass, layout and sampler
+  // set up along with the primary pipeline.
+  crashIf(!m_renderPass);
+  crashIf(settings.enableDepthTest && !m_hasDepthAttachment);
+  crashIf(settings.textureFilterMode != m_textureFilterMode);
+
+  m_pipelines.push_back(buildPipeline(settings));
+  return m_pipelines.size() - 1;
 }
 
 void VulkanContext::createPipeline(VulkanPipelineSettings const& settings) {
-  m_vertexBinding = settings.vertexInputBinding;
-  m_vertexAttributes = settings.vertexInputAttribs;
+  m_hasDepthAttachment = settings.enableDepthTest;
+  m_textureFilterMode = settings.textureFilterMode;
 
   auto colorAttachment = VkAttachmentDescription{};
   colorAttachment.format = VK_FORMAT_B8G8R8A8_SRGB;
@@ -823,7 +1252,7 @@ void VulkanContext::createPipeline(VulkanPipelineSettings const& settings) {
   dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
   dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
-  auto attachments = std::vector{colorAttachment};
+  auto attachments = SmallVector<VkAttachmentDescription, 2>{colorAttachment};
   if (settings.enableDepthTest) attachments.push_back(depthAttachment);
 
   auto renderPassInfo = VkRenderPassCreateInfo{};
@@ -841,7 +1270,7 @@ void VulkanContext::createPipeline(VulkanPipelineSettings const& settings) {
   m_swapchainFramebuffers =
       mapToVector<decltype(m_swapchainImageViews), VkFramebuffer>(
           m_swapchainImageViews, [&](auto const& view) {
-            auto attachments = std::vector{view};
+            auto attachments = SmallVector<VkImageView, 2>{view};
             if (settings.enableDepthTest)
               attachments.push_back(std::get<VkImageView>(m_depthBuffer));
 
@@ -861,19 +1290,6 @@ void VulkanContext::createPipeline(VulkanPipelineSettings const& settings) {
             return framebuffer;
           });
 
-  auto vertexInput = VkPipelineVertexInputStateCreateInfo{};
-  vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-  vertexInput.vertexAttributeDescriptionCount = m_vertexAttributes.size();
-  vertexInput.pVertexAttributeDescriptions = m_vertexAttributes.data();
-  vertexInput.vertexBindingDescriptionCount = 1;
-  vertexInput.pVertexBindingDescriptions = &m_vertexBinding;
-
-  auto inputAssembly = VkPipelineInputAssemblyStateCreateInfo{};
-  inputAssembly.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-  inputAssembly.primitiveRestartEnable = VK_FALSE;
-
   // Create descriptor set layouts.
 
   auto dsLayoutCreateInfo = VkDescriptorSetLayoutCreateInfo{};
@@ -903,11 +1319,11 @@ void VulkanContext::createPipeline(VulkanPipelineSettings const& settings) {
           vkCreateDescriptorSetLayout(m_device, &dsLayoutCreateInfo, nullptr,
                                       &m_samplerDescriptorSetLayout));
 
-  auto descriptorSetLayouts = std::vector{m_uniformDescriptorSetLayout};
-  for (auto const& layout :
-       repeat(m_samplerDescriptorSetLayout, VulkanTextureInfo::numSlots)) {
-    descriptorSetLayouts.push_back(layout);
-  }
+  auto descriptorSetLayouts =
+      SmallVector<VkDescriptorSetLayout, 1 + VulkanTextureInfo::numSlots>{
+          m_uniformDescriptorSetLayout};
+  descriptorSetLayouts.resize(1 + VulkanTextureInfo::numSlots,
+                              m_samplerDescriptorSetLayout);
 
   auto pipelineLayoutInfo = VkPipelineLayoutCreateInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -924,96 +1340,7 @@ void VulkanContext::createPipeline(VulkanPipelineSettings const& settings) {
   crashIf(VK_SUCCESS != vkCreatePipelineLayout(m_device, &pipelineLayoutInfo,
                                                nullptr, &m_pipelineLayout));
 
-  // Setup pipeline stages.
-
-  auto viewport = VkViewport{};
-  viewport.x = 0.0f;
-  viewport.y = m_windowExtent.height - 1.0f;
-  viewport.width = static_cast<float>(m_windowExtent.width);
-  viewport.height = -1.0f * m_windowExtent.height;
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  auto scissor = VkRect2D{};
-  scissor.extent = m_windowExtent;
-
-  auto viewportState = VkPipelineViewportStateCreateInfo{};
-  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-  viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
-  viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
-
-  auto depthStencilState = VkPipelineDepthStencilStateCreateInfo{};
-  depthStencilState.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-  depthStencilState.depthTestEnable = VK_TRUE;
-  depthStencilState.depthWriteEnable = VK_TRUE;
-  depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS;
-  depthStencilState.depthBoundsTestEnable = VK_FALSE;
-  depthStencilState.stencilTestEnable = VK_FALSE;
-
-  auto rasterState = VkPipelineRasterizationStateCreateInfo{};
-  rasterState.sType =
-      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-  rasterState.lineWidth = 1.0f;
-  rasterState.cullMode = debug ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
-  rasterState.frontFace = VK_FRONT_FACE_CLOCKWISE;
-  rasterState.polygonMode = VK_POLYGON_MODE_FILL;
-
-  auto blendAttachmentState = VkPipelineColorBlendAttachmentState{};
-  blendAttachmentState.blendEnable = VK_TRUE;
-  blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
-  blendAttachmentState.colorWriteMask = 0b1111;
-  blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-  blendAttachmentState.dstColorBlendFactor =
-      VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-  blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
-  blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-  blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-
-  auto blendState = VkPipelineColorBlendStateCreateInfo{};
-  blendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  blendState.attachmentCount = 1;
-  blendState.pAttachments = &blendAttachmentState;
-
-  auto msaaState = VkPipelineMultisampleStateCreateInfo{};
-  msaaState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-  msaaState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-  auto stages = std::array{
-      VkPipelineShaderStageCreateInfo{
-          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-          .stage = VK_SHADER_STAGE_VERTEX_BIT,
-          .module = loadShader(settings.vertexShaderPath),
-          .pName = "main",
-      },
-      VkPipelineShaderStageCreateInfo{
-          .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-          .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-          .module = loadShader(settings.fragmentShaderPath),
-          .pName = "main",
-      }};
-
-  auto pipelineInfo = VkGraphicsPipelineCreateInfo{};
-  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-  pipelineInfo.layout = m_pipelineLayout;
-  pipelineInfo.renderPass = m_renderPass;
-  pipelineInfo.subpass = 0;
-  pipelineInfo.stageCount = stages.size();
-  pipelineInfo.pStages = stages.data();
-  pipelineInfo.pVertexInputState = &vertexInput;
-  pipelineInfo.pInputAssemblyState = &inputAssembly;
-  pipelineInfo.pViewportState = &viewportState;
-  pipelineInfo.pRasterizationState = &rasterState;
-  pipelineInfo.pColorBlendState = &blendState;
-  pipelineInfo.pMultisampleState = &msaaState;
-  pipelineInfo.pDepthStencilState =
-      settings.enableDepthTest ? &depthStencilState : nullptr;
-
-  crashIf(VK_SUCCESS != vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1,
-                                                  &pipelineInfo, nullptr,
-                                                  &m_pipeline));
+  m_pipelines.push_back(buildPipeline(settings));
 
   // Create descriptor pools.
 
@@ -1039,6 +1366,8 @@ void VulkanContext::createPipeline(VulkanPipelineSettings const& settings) {
   // Create uniform buffer sequences.
 
   m_swapchainUboSeqs.resize(m_swapchainImages.size());
+  m_swapchainInstanceBufferSeqs.resize(m_swapchainImages.size());
+  m_swapchainStagingBufferSeqs.resize(m_swapchainImages.size());
 
   // Create sampler.
 
@@ -1078,6 +1407,17 @@ void VulkanContext::createPipeline(VulkanPipelineSettings const& settings) {
   }
 }
 
+void VulkanContext::bindPipeline(VulkanPipelineHandle pipeline) {
+  if (m_boundPipeline != pipeline) {
+    vkCmdBindPipeline(m_swapchainCommandBuffers[m_swapchainImageIndex],
+                      VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelines[pipeline]);
+    m_boundPipeline = pipeline;
+    ++m_pipelineBindCount;
+  } else {
+    ++m_redundantBindCount;
+  }
+}
+
 void VulkanContext::setPushConstantData(void const* data, uint32_t bytes) {
   crashIf(bytes > VulkanLimits::maxPushConstantsSize);
   vkCmdPushConstants(m_swapchainCommandBuffers[m_swapchainImageIndex],
@@ -1093,6 +1433,9 @@ void VulkanContext::bindTextureSlot(uint8_t slot,
                             1 + slot, 1, &txr.samplerSlotDescriptorSets[slot],
                             0, nullptr);
     m_boundTextures[slot] = &txr;
+    ++m_textureBindCount;
+  } else {
+    ++m_redundantBindCount;
   }
 }
 
@@ -1130,6 +1473,211 @@ void VulkanContext::setUniformData(void const* data, uint32_t bytes) {
                           1, &pDestUbo->descriptorSet, 1, &offset);
 }
 
+std::pair<VkBuffer, VkDeviceSize> VulkanContext::writeInstanceBuffers(
+    void const* data, uint32_t bytes) {
+  crashIf(bytes > instanceBufferSize);
+
+  VulkanInstanceBufferInfo* pDestBuffer = nullptr;
+
+  // Find instance buffer with sufficient space for data.
+  for (auto& buffer : m_swapchainInstanceBufferSeqs[m_swapchainImageIndex]) {
+    if (buffer.bytesUsed + bytes <= buffer.sizeInBytes) {
+      pDestBuffer = &buffer;
+      break;
+    }
+  }
+
+  if (!pDestBuffer) pDestBuffer = &growInstanceBufferSequence();
+
+  auto offset = VkDeviceSize{pDestBuffer->bytesUsed};
+  writeDeviceMemory(pDestBuffer->memory, data, bytes, offset);
+  pDestBuffer->bytesUsed += bytes;
+  return {pDestBuffer->buffer, offset};
+}
+
+std::pair<VkBuffer, VkDeviceSize> VulkanContext::writeStagingBuffers(
+    void const* data, size_t bytes) {
+  // Buffer offsets of copies must be multiples of 4 and the texel size.
+  static constexpr size_t alignment = 16;
+
+  VulkanStagingBufferInfo* pDestBuffer = nullptr;
+
+  // Find staging buffer with sufficient space for data.
+  for (auto& buffer : m_swapchainStagingBufferSeqs[m_swapchainImageIndex]) {
+    auto offset = (buffer.bytesUsed + alignment - 1) & ~(alignment - 1);
+    if (offset + bytes <= buffer.sizeInBytes) {
+      buffer.bytesUsed = offset;
+      pDestBuffer = &buffer;
+      break;
+    }
+  }
+
+  if (!pDestBuffer) pDestBuffer = &growStagingBufferSequence(bytes);
+
+  auto offset = VkDeviceSize{pDestBuffer->bytesUsed};
+  writeDeviceMemory(pDestBuffer->memory, data, bytes, offset);
+  pDestBuffer->bytesUsed += bytes;
+  return {pDestBuffer->buffer, offset};
+}
+
+void VulkanContext::setInstanceData(void const* data, uint32_t bytes) {
+  auto [buffer, offset] = writeInstanceBuffers(data, bytes);
+  vkCmdBindVertexBuffers(m_swapchainCommandBuffers[m_swapchainImageIndex], 1,
+                         1, &buffer, &offset);
+}
+
+void VulkanContext::bindInstanceBuffer(VkBuffer buffer) {
+  auto offset = VkDeviceSize{0};
+  vkCmdBindVertexBuffers(m_swapchainCommandBuffers[m_swapchainImageIndex], 1,
+                         1, &buffer, &offset);
+}
+
+VulkanComputePipelineHandle VulkanContext::addComputePipeline(
+    VulkanComputePipelineSettings const& settings) {
+  crashIf(!m_renderPass);
+  crashIf(settings.numStorageBuffers > maxStorageBuffersPerDispatch);
+  crashIf(settings.pushConstantBytes > VulkanLimits::maxPushConstantsSize);
+
+  // Dispatches of every compute pipeline share a pool per swapchain
+  // image, reset when the image's frame begins.
+  if (m_swapchainComputeDescriptorPools.empty()) {
+    auto poolSize = VkDescriptorPoolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount =
+        maxDispatchesPerFrame * maxStorageBuffersPerDispatch;
+
+    auto poolInfo = VkDescriptorPoolCreateInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = maxDispatchesPerFrame;
+
+    m_swapchainComputeDescriptorPools.resize(m_swapchainImages.size());
+    for (auto& pool : m_swapchainComputeDescriptorPools) {
+      crashIf(VK_SUCCESS !=
+              vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &pool));
+    }
+  }
+
+  auto compute = ComputePipeline{};
+  compute.settings = settings;
+
+  auto bindings =
+      SmallVector<VkDescriptorSetLayoutBinding, maxStorageBuffersPerDispatch>{};
+  for (uint32_t i = 0; i < settings.numStorageBuffers; ++i) {
+    auto binding = VkDescriptorSetLayoutBinding{};
+    binding.binding = i;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings.push_back(binding);
+  }
+
+  auto dsLayoutCreateInfo = VkDescriptorSetLayoutCreateInfo{};
+  dsLayoutCreateInfo.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  dsLayoutCreateInfo.bindingCount = std::size(bindings);
+  dsLayoutCreateInfo.pBindings = std::data(bindings);
+  crashIf(VK_SUCCESS !=
+          vkCreateDescriptorSetLayout(m_device, &dsLayoutCreateInfo, nullptr,
+                                      &compute.descriptorSetLayout));
+
+  auto pushConstantRange = VkPushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = settings.pushConstantBytes;
+
+  auto pipelineLayoutInfo = VkPipelineLayoutCreateInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &compute.descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount =
+      settings.pushConstantBytes > 0 ? 1 : 0;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  crashIf(VK_SUCCESS != vkCreatePipelineLayout(m_device, &pipelineLayoutInfo,
+                                               nullptr, &compute.layout));
+
+  auto pipelineInfo = VkComputePipelineCreateInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = loadShader(settings.shaderPath);
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = compute.layout;
+  crashIf(VK_SUCCESS != vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1,
+                                                 &pipelineInfo, nullptr,
+                                                 &compute.pipeline));
+
+  m_computePipelines.push_back(compute);
+  return m_computePipelines.size() - 1;
+}
+
+void VulkanContext::dispatch(VulkanComputePipelineHandle pipeline,
+                             std::initializer_list<VkBuffer> buffers,
+                             void const* pushConstants, uint32_t groupCount) {
+  crashIf(!m_isRecordingFrame);
+  auto const& compute = m_computePipelines[pipeline];
+  crashIf(buffers.size() != compute.settings.numStorageBuffers);
+  if (groupCount == 0) return;
+
+  auto cmdbuf = uploadCommandBuffer();
+
+  // Draws and dispatches submitted earlier may still read the buffers
+  // about to be written, which only takes an execution dependency.
+  vkCmdPipelineBarrier(cmdbuf, bufferReadStages,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 0, nullptr);
+
+  auto allocInfo = VkDescriptorSetAllocateInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool =
+      m_swapchainComputeDescriptorPools[m_swapchainImageIndex];
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &compute.descriptorSetLayout;
+
+  VkDescriptorSet descriptorSet;
+  crashIf(VK_SUCCESS !=
+          vkAllocateDescriptorSets(m_device, &allocInfo, &descriptorSet));
+
+  auto bufferInfos =
+      SmallVector<VkDescriptorBufferInfo, maxStorageBuffersPerDispatch>{};
+  for (auto buffer : buffers) {
+    bufferInfos.push_back({buffer, 0, VK_WHOLE_SIZE});
+  }
+
+  auto write = VkWriteDescriptorSet{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = descriptorSet;
+  write.dstBinding = 0;
+  write.descriptorCount = std::size(bufferInfos);
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.pBufferInfo = std::data(bufferInfos);
+  if (write.descriptorCount > 0) {
+    vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+  }
+
+  vkCmdBindPipeline(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
+  vkCmdBindDescriptorSets(cmdbuf, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          compute.layout, 0, 1, &descriptorSet, 0, nullptr);
+  if (compute.settings.pushConstantBytes > 0) {
+    vkCmdPushConstants(cmdbuf, compute.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       compute.settings.pushConstantBytes, pushConstants);
+  }
+  vkCmdDispatch(cmdbuf, groupCount, 1, 1);
+
+  // Make the writes visible to later dispatches and copies, and to the
+  // draws of this frame reading commands, indices or attributes.
+  auto barrier = VkMemoryBarrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = bufferReadAccess | VK_ACCESS_SHADER_WRITE_BIT |
+                          VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdbuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       bufferReadStages | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                       &barrier, 0, nullptr, 0, nullptr);
+}
+
 VulkanContext::~VulkanContext() {
   for (auto& pair : m_semaphores) {
     for (auto [_, sem] : pair) {
@@ -1153,10 +1701,38 @@ VulkanContext::~VulkanContext() {
     }
   }
 
+  for (auto& seq : m_swapchainInstanceBufferSeqs) {
+    for (auto& buf : seq) {
+      destroyBuffer(buf);
+    }
+  }
+
+  for (auto& seq : m_swapchainStagingBufferSeqs) {
+    for (auto& buf : seq) {
+      destroyBuffer(buf);
+    }
+  }
+
+  for (uint32_t i = 0; i < m_swapchainRetiredBuffers.size(); ++i) {
+    destroyRetiredBuffers(i);
+  }
+
+  for (auto pool : m_swapchainComputeDescriptorPools) {
+    vkDestroyDescriptorPool(m_device, pool, nullptr);
+  }
+  for (auto const& compute : m_computePipelines) {
+    vkDestroyPipeline(m_device, compute.pipeline, nullptr);
+    vkDestroyPipelineLayout(m_device, compute.layout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, compute.descriptorSetLayout,
+                                 nullptr);
+  }
+
   vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
   vkDestroyDescriptorSetLayout(m_device, m_uniformDescriptorSetLayout, nullptr);
   vkDestroyDescriptorSetLayout(m_device, m_samplerDescriptorSetLayout, nullptr);
-  vkDestroyPipeline(m_device, m_pipeline, nullptr);
+  for (auto pipeline : m_pipelines) {
+    vkDestroyPipeline(m_device, pipeline, nullptr);
+  }
   vkDestroyRenderPass(m_device, m_renderPass, nullptr);
   vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
 
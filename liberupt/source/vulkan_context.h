@@ -12,6 +12,7 @@
 #include <png++/png.hpp>
 
 #include "common.h"
+#include "frame_arena.h"
 #include "shader_interface.h"
 
 struct VulkanBufferInfo {
@@ -31,13 +32,27 @@ struct VulkanUboInfo : public VulkanBufferInfo {
 
 using UniformBufferSequence = std::vector<VulkanUboInfo>;
 
+struct VulkanInstanceBufferInfo : public VulkanBufferInfo {
+  size_t bytesUsed;
+};
+
+using InstanceBufferSequence = std::vector<VulkanInstanceBufferInfo>;
+
+struct VulkanStagingBufferInfo : public VulkanBufferInfo {
+  size_t bytesUsed;
+};
+
+using StagingBufferSequence = std::vector<VulkanStagingBufferInfo>;
+
 struct VulkanTextureInfo {
-  static constexpr uint8_t bytesPerPixel = 4;
   static constexpr uint8_t numSlots = 4;
 
   uint32_t width;
   uint32_t height;
 
+  VkFormat format;
+  uint32_t bytesPerTexel;
+
   VkImage image;
   VkImageView view;
   VkDeviceMemory memory;
@@ -45,15 +60,34 @@ struct VulkanTextureInfo {
   std::array<VkDescriptorSet, numSlots> samplerSlotDescriptorSets;
 };
 
+// Index of a graphics pipeline created by a VulkanContext.
+using VulkanPipelineHandle = size_t;
+
 struct VulkanPipelineSettings {
   std::string vertexShaderPath;
   std::string fragmentShaderPath;
   VkVertexInputBindingDescription vertexInputBinding;
+
+  // Per-instance data, sourced from the buffer bound by setInstanceData.
+  // Its attributes are listed in vertexInputAttribs as well.
+  std::optional<VkVertexInputBindingDescription> instanceInputBinding;
   std::vector<VkVertexInputAttributeDescription> vertexInputAttribs;
   bool enableDepthTest;
   VkFilter textureFilterMode;
 };
 
+// Index of a compute pipeline created by a VulkanContext.
+using VulkanComputePipelineHandle = size_t;
+
+struct VulkanComputePipelineSettings {
+  std::string shaderPath;
+
+  // Storage buffers read and written by the shader, bound to set 0 at
+  // consecutive bindings, and the size of its push constants.
+  uint32_t numStorageBuffers;
+  uint32_t pushConstantBytes;
+};
+
 class VulkanContext {
  private:
   template <typename V>
@@ -79,6 +113,7 @@ class VulkanContext {
       m_physicalDeviceQueueFamilies;
 
   VkDevice m_device;
+  VkPhysicalDeviceFeatures m_enabledFeatures;
 
   VkExtent2D m_windowExtent;
   VkSurfaceKHR m_windowSurface;
@@ -94,22 +129,46 @@ class VulkanContext {
   std::vector<VkFramebuffer> m_swapchainFramebuffers;
   std::vector<VkCommandBuffer> m_swapchainCommandBuffers;
   std::vector<UniformBufferSequence> m_swapchainUboSeqs;
+  std::vector<InstanceBufferSequence> m_swapchainInstanceBufferSeqs;
+
+  // Transfers of a frame, recorded outside of its render pass and
+  // submitted ahead of it, along with the texels they copy from.
+  std::vector<VkCommandBuffer> m_swapchainUploadCommandBuffers;
+  std::vector<StagingBufferSequence> m_swapchainStagingBufferSeqs;
+  bool m_isRecordingFrame = false;
+  bool m_isRecordingUploads = false;
+
+  // Buffers released since a frame began, destroyed once its fence has
+  // signaled, as draws submitted up to that frame may still read them.
+  std::vector<std::vector<VulkanBufferInfo>> m_swapchainRetiredBuffers;
 
   std::vector<VkFence> m_swapchainFences;
-  uint32_t m_swapchainImageIndex;  // <- Index into resource arrays.
+  uint32_t m_swapchainImageIndex = 0;  // <- Index into resource arrays.
 
   std::tuple<VkImage, VkImageView, VkDeviceMemory> m_depthBuffer;
 
   std::vector<VkShaderModule> m_shaders;
 
-  VkVertexInputBindingDescription m_vertexBinding;
-  std::vector<VkVertexInputAttributeDescription> m_vertexAttributes;
-
   VkPipelineLayout m_pipelineLayout;
-  VkRenderPass m_renderPass;
-  VkPipeline m_pipeline;
+  VkRenderPass m_renderPass = VK_NULL_HANDLE;
+  bool m_hasDepthAttachment;
+  VkFilter m_textureFilterMode;
+  std::vector<VkPipeline> m_pipelines;
+  VulkanPipelineHandle m_boundPipeline;
   VkCommandPool m_commandPool;
 
+  struct ComputePipeline {
+    VkPipeline pipeline;
+    VkPipelineLayout layout;
+    VkDescriptorSetLayout descriptorSetLayout;
+    VulkanComputePipelineSettings settings;
+  };
+  std::vector<ComputePipeline> m_computePipelines;
+
+  // Descriptor sets binding the buffers of a frame's dispatches, all
+  // freed at once when the frame's image comes around again.
+  std::vector<VkDescriptorPool> m_swapchainComputeDescriptorPools;
+
   VkDescriptorPool m_descriptorPool;
   VkDescriptorSetLayout m_uniformDescriptorSetLayout;
   VkDescriptorSetLayout m_samplerDescriptorSetLayout;
@@ -118,14 +177,54 @@ class VulkanContext {
   std::array<VulkanTextureInfo const*, VulkanTextureInfo::numSlots>
       m_boundTextures;
 
+  // Scratch memory for the frame currently being recorded.
+  FrameArena m_frameArena;
+
+  size_t m_drawCallCount = 0;
+
+  // State bound since the current frame began, and binds skipped for
+  // repeating the state already bound.
+  size_t m_pipelineBindCount = 0;
+  size_t m_textureBindCount = 0;
+  size_t m_bufferBindCount = 0;
+  size_t m_redundantBindCount = 0;
+
+  // Mesh buffers bound by the last draw, which draws of the same mesh
+  // keep using.
+  VkBuffer m_boundVertexBuffer = VK_NULL_HANDLE;
+  VkBuffer m_boundIndexBuffer = VK_NULL_HANDLE;
+  VkIndexType m_boundIndexType = VK_INDEX_TYPE_UINT32;
+
+  uint32_t m_nextSortId = 0;
+
  private:
   void runDeviceCommands(std::function<void(VkCommandBuffer)> commands);
 
+  VkPipeline buildPipeline(VulkanPipelineSettings const& settings);
+
   VulkanBufferInfo createBuffer(VkBufferUsageFlags usage,
                                 VkMemoryPropertyFlags memProps,
                                 VkDeviceSize bytes);
 
   inline VulkanUboInfo& growUniformBufferSequence();
+  inline VulkanInstanceBufferInfo& growInstanceBufferSequence();
+  inline VulkanStagingBufferInfo& growStagingBufferSequence(size_t minBytes);
+
+  // Binds the vertex buffer, and the index buffer unless null, if not
+  // bound already.
+  void bindMeshBuffers(VkCommandBuffer cmdbuf, VkBuffer vbuf, VkBuffer ibuf,
+                       VkIndexType indexType);
+
+  // Copies data into this frame's instance buffers, returning where.
+  std::pair<VkBuffer, VkDeviceSize> writeInstanceBuffers(void const* data,
+                                                         uint32_t bytes);
+
+  // Copies data into this frame's staging buffers, returning where.
+  std::pair<VkBuffer, VkDeviceSize> writeStagingBuffers(void const* data,
+                                                        size_t bytes);
+
+  // Command buffer recording this frame's uploads, begun on first use.
+  VkCommandBuffer uploadCommandBuffer();
 
   inline VulkanBufferInfo createHostBuffer(VkBufferUsageFlags usage,
                                            VkDeviceSize bytes) {
@@ -135,12 +234,27 @@ class VulkanContext {
                         bytes);
   }
 
-  inline VulkanBufferInfo createDeviceBuffer(VkBufferUsageFlags usage,
-                                             VkDeviceSize bytes) {
-    return createBuffer(usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, bytes);
-  }
+  void destroyRetiredBuffers(uint32_t swapchainImageIndex);
+
+  // Records a copy of tightly packed texels, starting at bufferOffset
+  // inside a staging buffer, into a region of the image, leaving it
+  // ready to be sampled by fragment shaders.
+  void recordCopyToImage(VkCommandBuffer cmdbuf, VkBuffer staging,
+                         VkDeviceSize bufferOffset, VkImage image,
+                         VkImageLayout oldLayout, glm::uvec2 const& offset,
+                         glm::uvec2 const& extent);
 
-  VulkanBufferInfo uploadToDevice(VulkanBufferInfo hostBufferInfo);
+  // Records a copy from a staging buffer to the start of a buffer,
+  // ordered after the reads of draws and dispatches submitted before,
+  // and ahead of those submitted after.
+  void recordCopyToBuffer(VkCommandBuffer cmdbuf, VkBuffer staging,
+                          VkDeviceSize stagingOffset, VkBuffer buffer,
+                          VkDeviceSize bytes);
+
+  // Same as above, but submitted and waited for right away.
+  void copyToImage(VulkanBufferInfo const& staging, VkImage image,
+                   VkImageLayout oldLayout, glm::uvec2 const& offset,
+                   glm::uvec2 const& extent);
 
   VkDeviceMemory allocateDeviceMemory(VkMemoryRequirements const& memReqs,
                                       VkMemoryPropertyFlags memProps);
@@ -162,6 +276,18 @@ class VulkanContext {
     setUniformData(nullptr, 0);
   }
 
+  inline void clearInstanceData() {
+    for (auto& buffer : m_swapchainInstanceBufferSeqs[m_swapchainImageIndex]) {
+      buffer.bytesUsed = 0;
+    }
+  }
+
+  inline void clearStagingData() {
+    for (auto& buffer : m_swapchainStagingBufferSeqs[m_swapchainImageIndex]) {
+      buffer.bytesUsed = 0;
+    }
+  }
+
  public:
   ~VulkanContext();
 
@@ -174,22 +300,171 @@ class VulkanContext {
   VkShaderModule const& loadShader(std::string const& path);
   void accomodateWindow(GLFWwindow* window);
 
+  // The primary pipeline also sets up the render pass, pipeline layout
+  // and sampler shared by all pipelines added afterwards.
+  static constexpr VulkanPipelineHandle primaryPipeline = 0;
   void createPipeline(VulkanPipelineSettings const& settings);
+  VulkanPipelineHandle addPipeline(VulkanPipelineSettings const& settings);
+  void bindPipeline(VulkanPipelineHandle pipeline);
+
+  // Formats other than the default are sampled as raw data, e.g. the
+  // integer formats VK_FORMAT_R16_UINT and VK_FORMAT_R32_UINT.
+  VulkanTextureInfo createTexture(
+      uint32_t width, uint32_t height, void const* texels,
+      VkFormat format = VK_FORMAT_R8G8B8A8_SRGB);
+
+  // Overwrites a sub-rectangle of the texture. While recording a frame,
+  // the copy is recorded into the frame's uploads, which run ahead of
+  // its draws and after those of earlier frames, so no draw sees a
+  // partial update. Otherwise, it is submitted and waited for at once.
+  void updateTexture(VulkanTextureInfo const& txr, glm::uvec2 const& offset,
+                     glm::uvec2 const& extent, void const* texels);
+
+  // Creates a device local buffer with undefined contents, e.g. to be
+  // written by dispatches.
+  inline VulkanBufferInfo createDeviceBuffer(VkBufferUsageFlags usage,
+                                             VkDeviceSize bytes) {
+    return createBuffer(usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, bytes);
+  }
+
+  // Creates a device local buffer holding a copy of the data, uploaded
+  // the same way as by updateBuffer.
+  VulkanBufferInfo createBufferWithData(VkBufferUsageFlags usage,
+                                        void const* data, size_t bytes);
+
+  // Overwrites the start of a buffer made by createBufferWithData. While
+  // recording a frame, the copy is recorded into the frame's uploads,
+  // after the draws of earlier frames and ahead of its own. Otherwise,
+  // it is submitted and waited for at once.
+  void updateBuffer(VulkanBufferInfo const& info, void const* data,
+                    size_t bytes);
+
+  // Replaces the contents of a buffer made by createBufferWithData,
+  // rewriting it in place if large enough, and retiring it for a new
+  // one otherwise. Null buffers get created.
+  void replaceBufferData(VulkanBufferInfo& info, VkBufferUsageFlags usage,
+                         void const* data, size_t bytes);
+
+  // Destroys the buffer once no frame submitted so far can read it,
+  // rather than waiting for the device to idle. Null buffers are
+  // ignored.
+  void retireBuffer(VulkanBufferInfo& info);
+
+  template <typename Vertex>
+  inline VulkanBufferInfo createVertexBuffer(Vertex const* vertices,
+                                             size_t count) {
+    return createBufferWithData(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertices,
+                                count * sizeof(Vertex));
+  }
+
+  template <typename Vertex>
+  inline VulkanBufferInfo createVertexBuffer(
+      std::vector<Vertex> const& vertices) {
+    return createVertexBuffer(vertices.data(), vertices.size());
+  }
+
+  template <typename Index>
+  inline VulkanBufferInfo createIndexBuffer(Index const* indices,
+                                            size_t count) {
+    static_assert(std::is_same_v<Index, uint16_t> ||
+                  std::is_same_v<Index, uint32_t>);
+    return createBufferWithData(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices,
+                                count * sizeof(Index));
+  }
+
+  template <typename Index>
+  inline VulkanBufferInfo createIndexBuffer(
+      std::vector<Index> const& indices) {
+    return createIndexBuffer(indices.data(), indices.size());
+  }
+
+  // Size of each buffer holding instance data, which bounds the amount
+  // of instance data consumed by a single draw.
+  static constexpr size_t instanceBufferSize = 4 << 20;
 
-  VulkanTextureInfo createTexture(uint32_t width, uint32_t height,
-                                  uint32_t const* pixels);
-  VulkanBufferInfo createVertexBuffer(
-      std::vector<VPositionColorTexcoord> const& vertices);
-  VulkanBufferInfo createIndexBuffer(std::vector<uint32_t> const& indices);
+  // Size of each buffer holding the texels uploaded by updateTexture
+  // during a frame. Larger updates get a buffer of their own size.
+  static constexpr size_t stagingBufferSize = 4 << 20;
+
+  // Dispatches recorded per frame, and storage buffers bound by each.
+  static constexpr uint32_t maxDispatchesPerFrame = 256;
+  static constexpr uint32_t maxStorageBuffersPerDispatch = 8;
 
   void setUniformData(void const* data, uint32_t bytes);
+
+  // Copies instance data into this frame's instance buffers, and binds
+  // it as the source of per-instance attributes for following draws.
+  void setInstanceData(void const* data, uint32_t bytes);
+
+  // Binds a buffer, e.g. one written by dispatches, as the source of
+  // per-instance attributes for following draws.
+  void bindInstanceBuffer(VkBuffer buffer);
   void setPushConstantData(void const* data, uint32_t bytes);
   void bindTextureSlot(uint8_t slot, VulkanTextureInfo const& txr);
 
   void onFrameBegin();
-  void draw(VkBuffer vbuf, VkBuffer ibuf, uint32_t count);
+  void draw(VkBuffer vbuf, VkBuffer ibuf, uint32_t count,
+            uint32_t instanceCount = 1,
+            VkIndexType indexType = VK_INDEX_TYPE_UINT32,
+            uint32_t firstIndex = 0);
+
+  // Draws a list of indexed draw commands, with each command's
+  // firstInstance counting from the data bound by setInstanceData. The
+  // commands are copied into this frame's instance buffers and drawn by
+  // as few indirect draws as the device allows. Devices lacking indirect
+  // first instance draw them one by one instead.
+  void drawIndexedIndirect(VkBuffer vbuf, VkBuffer ibuf, VkIndexType indexType,
+                           VkDrawIndexedIndirectCommand const* commands,
+                           uint32_t count);
+
+  // Draws count commands read from a buffer at offset, e.g. written by
+  // dispatches, with as few indirect draws as the device allows. Needs
+  // indirect first instance, unless every command starts at the first.
+  void drawIndexedIndirect(VkBuffer vbuf, VkBuffer ibuf, VkIndexType indexType,
+                           VkBuffer commands, VkDeviceSize offset,
+                           uint32_t count);
+
+  // Whether indirect draws may start past the first instance, which
+  // draws compacted by dispatches rely on.
+  inline bool supportsIndirectFirstInstance() const noexcept {
+    return m_enabledFeatures.drawIndirectFirstInstance;
+  }
+
+  // Compute pipelines run as part of a frame's uploads, see dispatch.
+  // Needs the primary pipeline to exist.
+  VulkanComputePipelineHandle addComputePipeline(
+      VulkanComputePipelineSettings const& settings);
+
+  // Dispatches groupCount workgroups of a compute pipeline, with the
+  // buffers bound in order, among this frame's uploads, which run ahead
+  // of its draws. Dispatches run after the draws of earlier frames, and
+  // their writes are visible to dispatches and draws recorded after
+  // them, including indirect draws.
+  void dispatch(VulkanComputePipelineHandle pipeline,
+                std::initializer_list<VkBuffer> buffers,
+                void const* pushConstants, uint32_t groupCount);
   void onFrameEnd();
 
+  // Allocations from this arena are valid until the next onFrameBegin.
+  inline FrameArena& frameArena() noexcept { return m_frameArena; }
+
+  // Number of draws recorded since the current frame began.
+  GETTER(drawCallCount, m_drawCallCount)
+
+  // Pipelines, textures and mesh buffers bound since the current frame
+  // began, and binds skipped since the state was bound already.
+  GETTER(pipelineBindCount, m_pipelineBindCount)
+  GETTER(textureBindCount, m_textureBindCount)
+  GETTER(bufferBindCount, m_bufferBindCount)
+  GETTER(redundantBindCount, m_redundantBindCount)
+
+  // Hands out small ids telling meshes and textures apart in the keys
+  // draws are sorted by. Ids wrap around after 65536 of them, which
+  // merely costs state changes between resources sharing an id.
+  inline uint16_t allocateSortId() noexcept {
+    return static_cast<uint16_t>(m_nextSortId++);
+  }
+
   // Wait for all frames in flight to be delivered.
   inline void flush() { vkDeviceWaitIdle(m_device); }
 
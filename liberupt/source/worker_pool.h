@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "common.h"
+
+// Fixed set of threads for data-parallel loops. The calling thread
+// takes part in the work as well, and parallelFor returns only once
+// every index has been processed.
+//
+// A pool runs one loop at a time: parallelFor must neither be called
+// from several threads at once, nor from inside a loop body. The pool
+// returned by sharedWorkerPool is used by the BVH build, field of view,
+// pathfinding, tile query and voxel meshing batches, so those must not
+// be started from one another's callbacks or from concurrent threads.
+class WorkerPool {
+ private:
+  std::vector<std::thread> m_threads;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wakeWorkers;
+  std::condition_variable m_workersDone;
+
+  // Describe the current loop, and are only written while no worker
+  // is busy, so that workers may copy them under the lock and then run
+  // without it. A worker waking up late may copy those of a loop that
+  // has returned already, but finds no indices left to claim then.
+  std::function<void(size_t, size_t)> const* m_pTask;
+  size_t m_count;
+  size_t m_grain;
+  std::atomic<size_t> m_next;
+
+  size_t m_numBusy;
+  uint64_t m_generation;
+  bool m_isRunning;
+  bool m_stop;
+
+  // First exception thrown by the task on a worker, if any, which
+  // parallelFor rethrows.
+  std::exception_ptr m_workerException;
+
+  // Claims ranges of grain indices until none are left.
+  inline void work(std::function<void(size_t, size_t)> const* pTask,
+                   size_t count, size_t grain) {
+    while (true) {
+      auto begin = m_next.fetch_add(grain, std::memory_order_relaxed);
+      if (begin >= count) return;
+      (*pTask)(begin, std::min(begin + grain, count));
+    }
+  }
+
+  inline void runWorker() {
+    auto lock = std::unique_lock(m_mutex);
+    auto seenGeneration = m_generation;
+
+    while (true) {
+      m_wakeWorkers.wait(
+          lock, [&] { return m_stop || m_generation != seenGeneration; });
+      if (m_stop) return;
+
+      seenGeneration = m_generation;
+      auto pTask = m_pTask;
+      auto count = m_count;
+      auto grain = m_grain;
+      ++m_numBusy;
+      lock.unlock();
+      try {
+        work(pTask, count, grain);
+        lock.lock();
+      } catch (...) {
+        lock.lock();
+        if (!m_workerException) m_workerException = std::current_exception();
+      }
+      if (--m_numBusy == 0) m_workersDone.notify_all();
+    }
+  }
+
+  // Waits for the workers to leave the current loop, returning the
+  // exception thrown on any of them.
+  inline std::exception_ptr finishLoop() {
+    auto lock = std::unique_lock(m_mutex);
+    m_workersDone.wait(lock, [this] { return m_numBusy == 0; });
+    m_isRunning = false;
+    return std::exchange(m_workerException, nullptr);
+  }
+
+ public:
+  inline WorkerPool(size_t numThreads = std::max(
+                        1u, std::thread::hardware_concurrency()) - 1)
+      : m_pTask(nullptr),
+        m_count(0),
+        m_grain(1),
+        m_next(0),
+        m_numBusy(0),
+        m_generation(0),
+        m_isRunning(false),
+        m_stop(false) {
+    for (size_t i = 0; i < numThreads; ++i) {
+      m_threads.emplace_back([this] { runWorker(); });
+    }
+  }
+
+  inline ~WorkerPool() {
+    {
+      auto lock = std::lock_guard(m_mutex);
+      m_stop = true;
+    }
+    m_wakeWorkers.notify_all();
+    for (auto& thread : m_threads) thread.join();
+  }
+
+  WorkerPool(WorkerPool const&) = delete;
+  WorkerPool& operator=(WorkerPool const&) = delete;
+
+  // Invokes fn(begin, end) for consecutive ranges of up to grain
+  // indices, covering [0, count). Calls may run concurrently, so fn
+  // must only write to data owned by its range. Exceptions thrown by fn
+  // are rethrown once all threads have left the loop. Not reentrant,
+  // see above; calls overlapping another loop of the pool throw.
+  template <typename Fn>
+  void parallelFor(size_t count, size_t grain, Fn&& fn) {
+    if (count == 0) return;
+    if (m_threads.empty() || count <= grain) {
+      fn(size_t{0}, count);
+      return;
+    }
+
+    grain = std::max<size_t>(grain, 1);
+    auto task = std::function<void(size_t, size_t)>(std::forward<Fn>(fn));
+    {
+      auto lock = std::unique_lock(m_mutex);
+      crashIf(m_isRunning);
+      m_isRunning = true;
+
+      // Workers that woke up late for the previous loop may still be
+      // looking at its fields.
+      m_workersDone.wait(lock, [this] { return m_numBusy == 0; });
+      m_pTask = &task;
+      m_count = count;
+      m_grain = grain;
+      m_next.store(0, std::memory_order_relaxed);
+      ++m_generation;
+    }
+    m_wakeWorkers.notify_all();
+
+    // The task must outlive the workers running it, even if it throws.
+    try {
+      work(&task, count, grain);
+    } catch (...) {
+      finishLoop();
+      throw;
+    }
+    if (auto exception = finishLoop()) std::rethrow_exception(exception);
+  }
+
+  inline size_t threadCount() const noexcept { return m_threads.size() + 1; }
+};
+
+// Pool shared by the engine's parallel algorithms, created on first use.
+inline WorkerPool& sharedWorkerPool() {
+  static WorkerPool pool;
+  return pool;
+}
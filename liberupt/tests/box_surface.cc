@@ -0,0 +1,156 @@
+#include <liberupt/source/mesh_util.h>
+
+// Samples points on every face of random boxes, and checks that those
+// lying against or inside an occluder are exactly the ones left out by
+// boxSurfaceVertices, and that the visible area it reports matches a
+// Monte Carlo estimate.
+
+constexpr float tolerance = 1e-3f;
+constexpr float samplesPerUnitArea = 400;
+
+struct FaceRect {
+  int axis;
+  float plane;
+  Aabb bounds;
+};
+
+// Rectangles emitted for a box, as two triangles each.
+std::vector<FaceRect> emittedRects(
+    std::vector<VPositionColorTexcoord> const& vertices) {
+  auto rects = std::vector<FaceRect>();
+  for (size_t i = 0; i < vertices.size(); i += 6) {
+    auto a = vertices[i].position;
+    auto b = vertices[i + 2].position;
+    auto axis = a.x == b.x ? 0 : a.y == b.y ? 1 : 2;
+    rects.push_back({axis, a[axis], {glm::min(a, b), glm::max(a, b)}});
+  }
+  return rects;
+}
+
+// Whether an occluder fills the space right in front of a point on a
+// face, as boxSurfaceVertices decides.
+bool isCovered(std::vector<Aabb> const& occluders, glm::vec3 const& point,
+               int axis, bool isPositive) {
+  auto front = point;
+  front[axis] += isPositive ? tolerance : -tolerance;
+  for (auto const& occluder : occluders) {
+    if (glm::all(glm::lessThan(occluder.min, front)) &&
+        glm::all(glm::lessThan(front, occluder.max))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool isEmitted(std::vector<FaceRect> const& rects, glm::vec3 const& point,
+               int axis) {
+  for (auto const& rect : rects) {
+    if (rect.axis == axis && rect.plane == point[axis] &&
+        glm::all(glm::lessThanEqual(rect.bounds.min, point)) &&
+        glm::all(glm::lessThanEqual(point, rect.bounds.max))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void checkBoxes(std::vector<SolidBox> const& boxes,
+                std::vector<Aabb> const& occluders) {
+  auto vertices = std::vector<VPositionColorTexcoord>();
+  auto report = boxSurfaceVertices(boxes, occluders, vertices);
+  crashIf(vertices.size() != 3 * report.numTrianglesAfter);
+
+  auto numSamples = size_t{0};
+  auto numMismatches = size_t{0};
+  auto estimatedArea = 0.0;
+  auto emittedArea = 0.0;
+
+  for (auto const& [box, color] : boxes) {
+    auto boxVertices = std::vector<VPositionColorTexcoord>();
+    boxSurfaceVertices({{box, color}}, occluders, boxVertices);
+    auto rects = emittedRects(boxVertices);
+    for (auto const& rect : rects) {
+      auto size = rect.bounds.extent();
+      size[rect.axis] = 1;
+      emittedArea += size.x * size.y * size.z;
+    }
+
+    for (int axis = 0; axis < 3; ++axis) {
+      for (auto isPositive : {false, true}) {
+        auto size = box.extent();
+        auto area = size[(axis + 1) % 3] * size[(axis + 2) % 3];
+        auto count = static_cast<size_t>(std::ceil(area * samplesPerUnitArea));
+
+        auto numVisible = size_t{0};
+        for (size_t i = 0; i < count; ++i) {
+          auto point = glm::vec3{frand(box.min.x, box.max.x),
+                                 frand(box.min.y, box.max.y),
+                                 frand(box.min.z, box.max.z)};
+          point[axis] = isPositive ? box.max[axis] : box.min[axis];
+
+          auto isVisible = !isCovered(occluders, point, axis, isPositive);
+          numVisible += isVisible;
+          numMismatches += isVisible != isEmitted(rects, point, axis);
+        }
+        numSamples += count;
+        estimatedArea += area * numVisible / count;
+      }
+    }
+  }
+
+  // Points within the tolerance of the edges of holes may go either
+  // way, which only a sliver of the samples do.
+  crashIf(numMismatches > numSamples / 500);
+  crashIf(std::abs(emittedArea - report.areaAfter) >
+          1e-3 * report.areaBefore);
+  crashIf(std::abs(estimatedArea - report.areaAfter) >
+          0.01 * report.areaBefore);
+}
+
+// Floor, ceiling and four walls overlapping at the corners, like the
+// slabs of the demo's rooms, for rooms side by side sharing walls.
+void checkRooms() {
+  constexpr float wall = 0.5f;
+  auto boxes = std::vector<SolidBox>();
+  for (int room = 0; room < 6; ++room) {
+    auto origin = glm::vec3{8.0f * (room % 3), 0, 8.0f * (room / 3)};
+    auto size = glm::vec3{8, 4 + room % 2, 8};
+    auto add = [&](glm::vec3 const& min, glm::vec3 const& max) {
+      boxes.push_back({{origin + min, origin + max}});
+    };
+    add({0, 0, 0}, {size.x, wall, size.z});
+    add({0, size.y - wall, 0}, {size.x, size.y, size.z});
+    add({0, 0, 0}, {wall, size.y, size.z});
+    add({size.x - wall, 0, 0}, {size.x, size.y, size.z});
+    add({0, 0, 0}, {size.x, size.y, wall});
+    add({0, 0, size.z - wall}, {size.x, size.y, size.z});
+  }
+
+  auto occluders = std::vector<Aabb>();
+  for (auto const& slab : boxes) occluders.push_back(slab.box);
+  checkBoxes(boxes, occluders);
+}
+
+// Boxes on a coarse grid, so that many touch or overlap, occluded by
+// themselves and by a few more.
+void checkRandomBoxes() {
+  for (size_t round = 0; round < 20; ++round) {
+    auto boxes = std::vector<SolidBox>();
+    auto occluders = std::vector<Aabb>();
+    for (size_t i = 0; i < 30; ++i) {
+      auto min = glm::vec3{rand() % 8, rand() % 8, rand() % 8} * 0.5f;
+      auto size = glm::vec3{1 + rand() % 6, 1 + rand() % 6, 1 + rand() % 6};
+      auto box = Aabb{min, min + size * 0.5f};
+      if (i < 20) boxes.push_back({box});
+      occluders.push_back(box);
+    }
+    checkBoxes(boxes, occluders);
+  }
+}
+
+int main() {
+  srand(1);
+  checkRooms();
+  checkRandomBoxes();
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include <liberupt/source/bvh.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// Checks the frustum and ray queries of trees against testing every
+// item, on random boxes, both right after building and after the boxes
+// were moved and the tree refitted.
+
+constexpr size_t numItems = 5000;
+constexpr size_t numQueries = 500;
+constexpr float infinity = std::numeric_limits<float>::infinity();
+
+Aabb randomBox(glm::vec3 const& center) {
+  auto halfSize = glm::vec3{frand(0.1f, 4), frand(0.1f, 4), frand(0.1f, 4)};
+  return {center - halfSize, center + halfSize};
+}
+
+glm::vec3 randomPoint(float extent) {
+  return {frand(-extent, extent), frand(-extent, extent),
+          frand(-extent, extent)};
+}
+
+// Same slab test as the tree, so that distances compare exactly.
+float rayBoxDistance(glm::vec3 const& origin, glm::vec3 const& invDirection,
+                     float maxDistance, Aabb const& box) {
+  auto t0 = (box.min - origin) * invDirection;
+  auto t1 = (box.max - origin) * invDirection;
+  auto tMin = glm::min(t0, t1);
+  auto tMax = glm::max(t0, t1);
+
+  auto enter = std::max({tMin.x, tMin.y, tMin.z, 0.0f});
+  auto exit = std::min({tMax.x, tMax.y, tMax.z, maxDistance});
+  return enter <= exit ? enter : infinity;
+}
+
+void checkFrustums(Bvh const& bvh) {
+  auto visits = std::vector<uint32_t>(numItems);
+  for (size_t query = 0; query < numQueries; ++query) {
+    auto eye = randomPoint(150);
+    auto view = glm::lookAtLH(eye, randomPoint(50), {0, 1, 0});
+    auto projection = glm::perspectiveLH(glm::radians(frand(20, 90)),
+                                         frand(0.5f, 2), 0.1f, frand(20, 300));
+    auto planes = extractFrustumPlanes(projection * view);
+
+    std::fill(visits.begin(), visits.end(), 0);
+    bvh.forEachInFrustum(planes, [&](uint32_t item) { ++visits[item]; });
+
+    // Visited items may lie outside the frustum, as long as they share
+    // a leaf with one that does not, but those inside must be visited.
+    for (uint32_t item = 0; item < numItems; ++item) {
+      crashIf(visits[item] > 1);
+      auto isInside = isBoxInFrustum(planes, bvh.itemBounds()[item]);
+      crashIf(isInside && visits[item] == 0);
+    }
+  }
+}
+
+void checkRaycasts(Bvh const& bvh) {
+  for (size_t query = 0; query < numQueries; ++query) {
+    auto origin = randomPoint(150);
+    auto direction = glm::normalize(randomPoint(1));
+    auto invDirection = 1.0f / direction;
+    auto maxDistance = query % 2 ? infinity : frand(0, 200);
+
+    auto expected = BvhRayHit{};
+    expected.distance = infinity;
+    for (uint32_t item = 0; item < numItems; ++item) {
+      auto distance = rayBoxDistance(origin, invDirection, maxDistance,
+                                     bvh.itemBounds()[item]);
+      if (distance < expected.distance) expected = {true, item, distance};
+    }
+
+    // Ties between items may be broken either way.
+    auto hit = bvh.raycast(origin, direction, maxDistance);
+    crashIf(hit.hit != expected.hit);
+    if (!hit.hit) continue;
+    crashIf(hit.distance != expected.distance);
+    crashIf(rayBoxDistance(origin, invDirection, maxDistance,
+                           bvh.itemBounds()[hit.item]) != hit.distance);
+
+    // Items whose geometry is missed report infinity, which is no hit
+    // even with an unlimited distance.
+    auto miss = bvh.raycast(origin, direction, infinity,
+                            [](uint32_t) { return infinity; });
+    crashIf(miss.hit);
+  }
+}
+
+int main() {
+  srand(1);
+  auto centers = std::vector<glm::vec3>(numItems);
+  auto bounds = std::vector<Aabb>(numItems);
+  for (size_t i = 0; i < numItems; ++i) {
+    centers[i] = randomPoint(100);
+    bounds[i] = randomBox(centers[i]);
+  }
+
+  auto bvh = Bvh();
+  bvh.build(bounds);
+  checkFrustums(bvh);
+  checkRaycasts(bvh);
+
+  // Moved far enough for the refitted nodes to overlap heavily.
+  for (uint32_t i = 0; i < numItems; ++i) {
+    bvh.setItemBounds(i, randomBox(centers[i] + randomPoint(30)));
+  }
+  bvh.refit();
+  checkFrustums(bvh);
+  checkRaycasts(bvh);
+
+  // Exactly at the maximum distance still counts as a hit.
+  auto box = Aabb{{10, -1, -1}, {12, 1, 1}};
+  bvh.build({box});
+  crashIf(!bvh.raycast({0, 0, 0}, {1, 0, 0}, 10).hit);
+  crashIf(bvh.raycast({0, 0, 0}, {1, 0, 0}, 9.5f).hit);
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include <liberupt/source/mesh_util.h>
+#include <liberupt/source/renderer.h>
+
+// Renders frames of sprites and of instanced models, and checks that
+// frames make no heap allocations once the frame arena and the per-frame
+// buffers have grown to fit them. Only allocations through operator new
+// are counted, not those the driver makes internally.
+
+constexpr size_t numWarmupFrames = 10;
+constexpr size_t numCheckedFrames = 50;
+
+template <typename AnyRenderer, typename QueueDraws>
+void checkSteadyFrames(AnyRenderer& renderer, QueueDraws&& queueDraws) {
+  for (size_t frame = 0; frame < numWarmupFrames + numCheckedFrames;
+       ++frame) {
+    renderer.handleWindowEvents();
+    crashIf(!renderer.tryBeginFrame());
+    queueDraws();
+    renderer.endFrame();
+
+    auto const& stats = renderer.frameStats();
+    if (frame >= numWarmupFrames && stats.heapAllocations != 0) {
+      std::cerr << "Frame " << frame << " made " << stats.heapAllocations
+                << " heap allocations." << lf;
+    }
+    crashIf(frame >= numWarmupFrames && stats.heapAllocations != 0);
+  }
+}
+
+void checkSprites() {
+  auto renderer = Renderer2d({"Frame allocations", {320, 240}, false});
+  renderer.materialize();
+
+  auto& white = renderer.createTexture("white");
+  white.updatePixels(1, 1, {0xffffffff});
+  auto& gray = renderer.createTexture("gray");
+  gray.updatePixels(1, 1, {0xff808080});
+
+  auto sprites = std::vector<Sprite>();
+  for (size_t i = 0; i < 2000; ++i) {
+    auto& sprite = sprites.emplace_back(i % 3 ? white : gray);
+    sprite.setPosition({static_cast<float>(i % 40 * 8),
+                        static_cast<float>(i / 40 * 5)});
+    sprite.setSize({8, 8});
+    sprite.setDepth(static_cast<float>(i % 7) / 7);
+    sprite.setTranslucent(i % 5 == 0);
+  }
+
+  checkSteadyFrames(renderer, [&] {
+    for (auto const& sprite : sprites) renderer.renderSprite(sprite);
+  });
+}
+
+void checkModels() {
+  auto renderer = Renderer3d({"Frame allocations", {320, 240}, false});
+  renderer.materialize();
+  renderer.camera3d().setPosition({0, 0, -40});
+
+  auto& texture = renderer.createTexture("white");
+  texture.updatePixels(1, 1, {0xffffffff});
+  auto& cube = renderer.createMesh("cube");
+  cube.setVertices(cubeVertices());
+
+  // Spread around the camera, so that some are culled.
+  auto models = std::vector<Model>();
+  for (size_t i = 0; i < 4000; ++i) {
+    auto& model = models.emplace_back(cube, texture);
+    model.setPosition({static_cast<float>(i % 20) * 3 - 30,
+                       static_cast<float>(i / 20 % 20) * 3 - 30,
+                       static_cast<float>(i / 400) * 3 - 30});
+  }
+
+  checkSteadyFrames(renderer, [&] {
+    for (auto const& model : models) renderer.renderModel(model);
+  });
+}
+
+int main() {
+  checkSprites();
+  checkModels();
+  return 0;
+}
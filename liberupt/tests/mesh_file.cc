@@ -0,0 +1,105 @@
+#include <liberupt/source/mesh_file.h>
+
+#include <filesystem>
+
+// Saves meshes to files and maps them again, checking that vertices are
+// stored packed whenever they can be, and read back within the
+// precision packing keeps, along with the indices and levels of detail.
+
+// Triangles of a unit sphere, colored and textured by latitude and
+// longitude.
+std::vector<VPositionColorTexcoord> sphereTriangles(uint32_t numRings,
+                                                    uint32_t numSegments) {
+  auto point = [&](uint32_t ring, uint32_t segment) {
+    auto u = static_cast<float>(segment) / numSegments;
+    auto v = static_cast<float>(ring) / numRings;
+    auto theta = 3.14159265f * v;
+    auto phi = 2 * 3.14159265f * u;
+    return VPositionColorTexcoord{
+        {std::sin(theta) * std::cos(phi), std::cos(theta),
+         std::sin(theta) * std::sin(phi)},
+        {u, v, 1 - u},
+        {u, v}};
+  };
+
+  auto vertices = std::vector<VPositionColorTexcoord>{};
+  for (uint32_t ring = 0; ring < numRings; ++ring) {
+    for (uint32_t segment = 0; segment < numSegments; ++segment) {
+      auto a = point(ring, segment);
+      auto b = point(ring, segment + 1);
+      auto c = point(ring + 1, segment + 1);
+      auto d = point(ring + 1, segment);
+      vertices.insert(vertices.end(), {a, b, c, c, d, a});
+    }
+  }
+  return vertices;
+}
+
+void checkRoundTrip(std::vector<VPositionColorTexcoord> vertices,
+                    VertexLayout expectedLayout) {
+  auto indices = std::vector<uint32_t>{};
+  optimizeMesh(vertices, indices);
+  auto lods = buildLodChain(vertices, indices, 3, 0.5f, 0.1f);
+
+  auto box = Aabb{};
+  for (auto const& vertex : vertices) box.extend(vertex.position);
+  auto sphere = BoundingSphere{box.center(), 1};
+
+  auto path =
+      (std::filesystem::temp_directory_path() / "erupt_mesh.mesh").string();
+  saveMeshFile(path, vertices, indices, lods, box, sphere);
+  crashIf(!MeshFile::isCurrent(path));
+
+  {
+    auto file = MeshFile(path);
+    auto const& header = file.header();
+    crashIf(file.vertexLayout() != expectedLayout);
+    crashIf(header.vertexCount != vertices.size() ||
+            header.vertexBytes !=
+                (expectedLayout == VertexLayout::Packed
+                     ? sizeof(VPackedPositionColorTexcoord)
+                     : sizeof(VPositionColorTexcoord)));
+
+    auto fileLods = file.lods();
+    crashIf(fileLods.size() != lods.size());
+    for (size_t i = 0; i < lods.size(); ++i) {
+      crashIf(fileLods[i].firstIndex != lods[i].firstIndex ||
+              fileLods[i].indexCount != lods[i].indexCount ||
+              fileLods[i].error != lods[i].error);
+    }
+    crashIf(file.indices() != indices);
+
+    // A step of the quantization grid, and half a step of the colors.
+    auto positionError = box.extent() * (0.5f / 32767) + 1e-6f;
+    auto colorError = 0.5f / 255 + 1e-6f;
+    auto read = file.vertices();
+    crashIf(read.size() != vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+      auto const& expected = vertices[i];
+      auto const& actual = read[i];
+      if (expectedLayout == VertexLayout::Float) {
+        crashIf(std::memcmp(&actual, &expected, sizeof(actual)) != 0);
+        continue;
+      }
+      crashIf(glm::any(glm::greaterThan(
+          glm::abs(actual.position - expected.position), positionError)));
+      crashIf(glm::any(glm::greaterThan(
+          glm::abs(actual.m_color - expected.m_color), glm::vec3(colorError))));
+      crashIf(glm::any(
+          glm::greaterThan(glm::abs(actual.texcoord - expected.texcoord),
+                           glm::vec2(maxTexcoordError))));
+    }
+  }
+
+  std::filesystem::remove(path);
+}
+
+int main() {
+  checkRoundTrip(sphereTriangles(16, 32), VertexLayout::Packed);
+
+  // Colors out of the range of normalized bytes keep vertices as floats.
+  auto bright = sphereTriangles(8, 8);
+  for (auto& vertex : bright) vertex.m_color *= 2.0f;
+  checkRoundTrip(bright, VertexLayout::Float);
+  return 0;
+}
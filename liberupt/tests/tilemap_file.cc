@@ -0,0 +1,167 @@
+#include <liberupt/source/tilemap_file.h>
+
+#include <filesystem>
+
+// Encodes tiles as runs and decodes them again, and saves sparse tile
+// storage to a file, checking that every tile reads back the same
+// through the memory-mapped view of it.
+
+using Storage = TileStorage<uint16_t, 32>;
+
+template <typename TileType>
+constexpr size_t runBytes = sizeof(uint16_t) + sizeof(TileType);
+
+// Returns the number of runs the tiles were encoded as.
+template <typename TileType>
+size_t checkRunsRoundTrip(std::vector<TileType> const& tiles) {
+  // Runs are appended to whatever the output holds already.
+  auto encoded = std::vector<std::byte>{std::byte{0xee}};
+  encodeTileRuns(tiles.data(), tiles.size(), encoded);
+  crashIf(encoded.front() != std::byte{0xee});
+  crashIf((encoded.size() - 1) % runBytes<TileType> != 0);
+
+  auto decoded = std::vector<TileType>(tiles.size());
+  decodeTileRuns(encoded.data() + 1, encoded.size() - 1, decoded.data(),
+                 decoded.size());
+  crashIf(decoded != tiles);
+  return (encoded.size() - 1) / runBytes<TileType>;
+}
+
+template <typename TileType>
+void checkRuns() {
+  auto max = std::numeric_limits<TileType>::max();
+  crashIf(checkRunsRoundTrip(std::vector<TileType>{}) != 0);
+  crashIf(checkRunsRoundTrip(std::vector<TileType>{max}) != 1);
+  crashIf(checkRunsRoundTrip(std::vector<TileType>{1, 2, 1, 2}) != 4);
+  crashIf(checkRunsRoundTrip(std::vector<TileType>{3, 3, 3, 0, 0}) != 2);
+
+  // Runs longer than a run length can hold are split.
+  auto uniform = std::vector<TileType>(3 * size_t{UINT16_MAX} + 2, 7);
+  crashIf(checkRunsRoundTrip(uniform) != 4);
+  uniform.resize(2 * size_t{UINT16_MAX});
+  crashIf(checkRunsRoundTrip(uniform) != 2);
+
+  auto tiles = std::vector<TileType>(Storage::chunkArea);
+  for (auto& tile : tiles) tile = static_cast<TileType>(rand() % 3 ? 0 : max);
+  checkRunsRoundTrip(tiles);
+}
+
+bool failsToDecode(std::vector<std::byte> const& encoded, size_t count) {
+  auto tiles = std::vector<uint16_t>(count);
+  try {
+    decodeTileRuns(encoded.data(), encoded.size(), tiles.data(), count);
+  } catch (std::runtime_error const&) {
+    return true;
+  }
+  return false;
+}
+
+void checkMalformedRuns() {
+  auto run = [](uint16_t length, uint16_t value) {
+    auto bytes = std::vector<std::byte>(runBytes<uint16_t>);
+    std::memcpy(&bytes[0], &length, sizeof(length));
+    std::memcpy(&bytes[sizeof(length)], &value, sizeof(value));
+    return bytes;
+  };
+
+  auto valid = run(10, 1);
+  crashIf(failsToDecode(valid, 10));
+
+  // Too few tiles, a truncated run, and runs of nothing or too many.
+  crashIf(!failsToDecode(valid, 11));
+  crashIf(!failsToDecode({valid.begin(), valid.end() - 1}, 10));
+  crashIf(!failsToDecode(run(0, 1), 10));
+  crashIf(!failsToDecode(run(11, 1), 10));
+}
+
+// Tiles of a chunk as read from the file, background ones included.
+std::vector<uint16_t> readChunk(TilemapFile const& file,
+                                Storage::ChunkKey key) {
+  auto tiles = std::vector<uint16_t>(Storage::chunkArea);
+  if (!file.hasChunk(key)) {
+    auto [pData, bytes] = file.chunkData(key);
+    crashIf(pData || bytes);
+
+    auto bits = file.layerBackground(Storage::chunkLayer(key));
+    auto background = uint16_t{};
+    std::memcpy(&background, &bits, sizeof(background));
+    std::fill(tiles.begin(), tiles.end(), background);
+    return tiles;
+  }
+
+  auto [pData, bytes] = file.chunkData(key);
+  decodeTileRuns(pData, bytes, tiles.data(), tiles.size());
+  return tiles;
+}
+
+void checkFileRoundTrip() {
+  // Chunks along the right and bottom edges stick out of the map.
+  auto size = glm::u64vec3{100, 70, 3};
+  auto tiles = Storage(size);
+
+  // Scattered tiles on layer 0, a uniform chunk on layer 1, whose
+  // background differs, and an edited chunk reverted on layer 2.
+  for (int i = 0; i < 500; ++i) {
+    tiles.set({rand() % size.x, rand() % size.y, 0},
+              static_cast<uint16_t>(1 + rand() % 1000));
+  }
+  tiles.fill(1, 5);
+  tiles.fillRect(1, {32, 32}, {64, 64}, 9);
+  tiles.set({40, 10, 1}, UINT16_MAX);
+  tiles.set({99, 69, 2}, 3);
+  tiles.resetChunk(Storage::chunkKeyAt({99, 69, 2}));
+
+  auto path = (std::filesystem::temp_directory_path() / "erupt_tilemap.ertm")
+                  .string();
+  saveTiles(tiles, path);
+
+  {
+    auto file = TilemapFile(path);
+    auto const& header = file.header();
+    crashIf(header.tileBytes != sizeof(uint16_t) ||
+            header.chunkSize != Storage::chunkSize);
+    crashIf(file.size() != size || header.chunkCount != tiles.chunkCount());
+
+    for (size_t z = 0; z < size.z; ++z) {
+      auto bits = file.layerBackground(z);
+      crashIf(std::memcmp(&bits, &tiles.layerBackground(z),
+                          sizeof(uint16_t)) != 0);
+    }
+
+    auto numChunks = glm::u64vec2{(size.x - 1) / Storage::chunkSize + 1,
+                                  (size.y - 1) / Storage::chunkSize + 1};
+    size_t numStored = 0;
+    for (size_t z = 0; z < size.z; ++z) {
+      for (size_t cy = 0; cy < numChunks.y; ++cy) {
+        for (size_t cx = 0; cx < numChunks.x; ++cx) {
+          auto key = Storage::chunkKey(cx, cy, z);
+          crashIf(file.hasChunk(key) != tiles.hasChunk(key));
+          numStored += file.hasChunk(key);
+
+          auto chunk = readChunk(file, key);
+          for (size_t y = 0; y < Storage::chunkSize; ++y) {
+            for (size_t x = 0; x < Storage::chunkSize; ++x) {
+              auto pos = glm::u64vec3{cx * Storage::chunkSize + x,
+                                      cy * Storage::chunkSize + y, z};
+              if (pos.x >= size.x || pos.y >= size.y) continue;
+              crashIf(chunk[y * Storage::chunkSize + x] != tiles.at(pos));
+            }
+          }
+        }
+      }
+    }
+    crashIf(numStored != header.chunkCount);
+  }
+
+  std::filesystem::remove(path);
+}
+
+int main() {
+  srand(1);
+  checkRuns<uint8_t>();
+  checkRuns<uint16_t>();
+  checkRuns<uint64_t>();
+  checkMalformedRuns();
+  checkFileRoundTrip();
+  return 0;
+}
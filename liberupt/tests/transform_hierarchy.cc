@@ -0,0 +1,143 @@
+#include <liberupt/source/transform_hierarchy.h>
+
+#include <glm/gtx/euler_angles.hpp>
+#include <glm/gtx/transform.hpp>
+#include <unordered_map>
+
+// Builds a random hierarchy, then repeatedly reparents, destroys,
+// creates and moves transforms, checking after every update that each
+// world matrix is the product of the local matrices of its ancestors,
+// computed with glm the way Model does. Parents placed after their
+// children and destroyed transforms make the updates reorder the slots.
+
+using Handle = TransformHierarchy::Handle;
+
+constexpr size_t numInitial = 500;
+constexpr size_t numRounds = 50;
+
+// Parent of every live transform, as the test expects it.
+using Parents = std::unordered_map<Handle, Handle>;
+
+glm::vec3 randomVector(float min, float max) {
+  return {frand(min, max), frand(min, max), frand(min, max)};
+}
+
+void randomizeLocal(TransformHierarchy& transforms, Handle handle) {
+  transforms.setPosition(handle, randomVector(-10, 10));
+  transforms.setScale(handle, randomVector(0.8f, 1.25f));
+  transforms.setEuler(handle, randomVector(-3.14159265f, 3.14159265f));
+}
+
+glm::mat4 localMatrix(TransformHierarchy const& transforms, Handle handle) {
+  auto const& euler = transforms.euler(handle);
+  return glm::translate(transforms.position(handle)) *
+         glm::scale(transforms.scale(handle)) *
+         glm::eulerAngleYXZ(euler.y, euler.x, euler.z);
+}
+
+Handle randomHandle(Parents const& parents) {
+  auto it = parents.begin();
+  std::advance(it, rand() % parents.size());
+  return it->first;
+}
+
+bool isAncestor(Parents const& parents, Handle ancestor, Handle handle) {
+  for (; handle != TransformHierarchy::none; handle = parents.at(handle)) {
+    if (handle == ancestor) return true;
+  }
+  return false;
+}
+
+void check(TransformHierarchy& transforms, Parents const& parents) {
+  transforms.update();
+  crashIf(transforms.size() != parents.size());
+
+  for (auto [handle, parent] : parents) {
+    crashIf(transforms.parent(handle) != parent);
+
+    auto expected = localMatrix(transforms, handle);
+    for (auto ancestor = parent; ancestor != TransformHierarchy::none;
+         ancestor = parents.at(ancestor)) {
+      expected = localMatrix(transforms, ancestor) * expected;
+    }
+
+    auto const& world = transforms.worldMatrix(handle);
+    for (int col = 0; col < 4; ++col) {
+      for (int row = 0; row < 4; ++row) {
+        auto difference = std::abs(world[col][row] - expected[col][row]);
+        crashIf(difference > 1e-4f * (1 + std::abs(expected[col][row])));
+      }
+    }
+  }
+
+  // Nothing changed since, so nothing is recomputed.
+  transforms.update();
+  crashIf(!transforms.changed().empty());
+}
+
+int main() {
+  srand(1);
+  auto transforms = TransformHierarchy();
+  auto parents = Parents{};
+
+  auto create = [&](Handle parent) {
+    auto handle = transforms.create(parent);
+    crashIf(parents.contains(handle));
+    parents[handle] = parent;
+    randomizeLocal(transforms, handle);
+  };
+
+  create(TransformHierarchy::none);
+  for (size_t i = 1; i < numInitial; ++i) {
+    create(rand() % 4 ? randomHandle(parents) : TransformHierarchy::none);
+  }
+  check(transforms, parents);
+
+  for (size_t round = 0; round < numRounds; ++round) {
+    // Reparenting under transforms created later leaves parents after
+    // their children until the update reorders them.
+    for (int i = 0; i < 20; ++i) {
+      auto handle = randomHandle(parents);
+      auto parent =
+          rand() % 5 ? randomHandle(parents) : TransformHierarchy::none;
+      if (parent != TransformHierarchy::none &&
+          isAncestor(parents, handle, parent)) {
+        continue;
+      }
+      transforms.setParent(handle, parent);
+      parents[handle] = parent;
+    }
+
+    // Children of destroyed transforms become roots.
+    for (int i = 0; i < 10 && parents.size() > 1; ++i) {
+      auto handle = randomHandle(parents);
+      transforms.destroy(handle);
+      parents.erase(handle);
+      for (auto& [child, parent] : parents) {
+        if (parent == handle) parent = TransformHierarchy::none;
+      }
+    }
+
+    // New transforms reuse the handles of destroyed ones.
+    for (int i = 0; i < 10; ++i) {
+      create(rand() % 4 ? randomHandle(parents) : TransformHierarchy::none);
+    }
+
+    for (int i = 0; i < 30; ++i) {
+      randomizeLocal(transforms, randomHandle(parents));
+    }
+    check(transforms, parents);
+  }
+
+  // Setting a parent to a descendant would make a cycle.
+  auto root = transforms.create();
+  auto child = transforms.create(root);
+  auto failed = false;
+  try {
+    transforms.setParent(root, child);
+  } catch (std::runtime_error const&) {
+    failed = true;
+  }
+  crashIf(!failed);
+  return 0;
+}
@@ -0,0 +1,181 @@
+#include <liberupt/source/voxel_world.h>
+
+// Edits chunks and worlds at random alongside a dense copy of their
+// blocks, and checks that every block reads back the same through each
+// change of palette size, repacking and compaction.
+
+using Blocks = std::vector<BlockId>;
+
+void checkChunk(VoxelChunk const& chunk, Blocks const& expected) {
+  for (size_t i = 0; i < VoxelChunk::volume; ++i) {
+    crashIf(chunk.at(i) != expected[i]);
+  }
+  auto box = Blocks(VoxelChunk::volume);
+  chunk.readBox({0, 0, 0}, glm::ivec3(voxelChunkSize), box.data(),
+                voxelChunkSize, voxelChunkSize * voxelChunkSize);
+  crashIf(box != expected);
+}
+
+// Sets random blocks out of numDistinct kinds, starting at firstBlock.
+void setRandomBlocks(VoxelChunk& chunk, Blocks& expected, size_t count,
+                     BlockId firstBlock, size_t numDistinct) {
+  for (size_t n = 0; n < count; ++n) {
+    auto i = rand() % VoxelChunk::volume;
+    auto block = static_cast<BlockId>(firstBlock + rand() % numDistinct);
+    chunk.set(i, block);
+    expected[i] = block;
+  }
+}
+
+// Grows the palette through every width of index up to direct storage,
+// then shrinks it back, with compaction in between.
+void checkPaletteRoundTrip() {
+  auto chunk = VoxelChunk(7);
+  auto expected = Blocks(VoxelChunk::volume, 7);
+  crashIf(!chunk.isUniform() || chunk.uniform() != 7);
+
+  // Along with the block the chunk was filled with, the blocks set
+  // fill the palette of each width exactly.
+  auto expectedBits = {1u, 2u, 4u, 8u, VoxelChunk::directBits};
+  for (auto bits : expectedBits) {
+    auto numDistinct =
+        bits == VoxelChunk::directBits ? 1000 : (size_t{1} << bits) - 1;
+    setRandomBlocks(chunk, expected, 40000, 100, numDistinct);
+    checkChunk(chunk, expected);
+    crashIf(chunk.bits() != bits);
+  }
+
+  // Only a few kinds left, which compaction packs tightly again.
+  for (size_t i = 0; i < VoxelChunk::volume; ++i) {
+    auto block = static_cast<BlockId>(i % 3);
+    chunk.set(i, block);
+    expected[i] = block;
+  }
+  checkChunk(chunk, expected);
+  crashIf(chunk.bits() != VoxelChunk::directBits);
+  chunk.compact();
+  checkChunk(chunk, expected);
+  crashIf(chunk.bits() != 2);
+
+  // Entries freed by edits are reused, rather than growing the palette.
+  for (size_t round = 0; round < 50; ++round) {
+    for (size_t i = 0; i < VoxelChunk::volume; ++i) {
+      if (expected[i] == 2) {
+        chunk.set(i, static_cast<BlockId>(3 + round));
+        expected[i] = static_cast<BlockId>(3 + round);
+      } else if (expected[i] == 2 + round) {
+        chunk.set(i, 2);
+        expected[i] = 2;
+      }
+    }
+    checkChunk(chunk, expected);
+    crashIf(chunk.bits() != 2);
+  }
+
+  // Filling the whole chunk block by block makes it uniform.
+  for (size_t i = 0; i < VoxelChunk::volume; ++i) chunk.set(i, 9);
+  crashIf(!chunk.isUniform() || chunk.uniform() != 9);
+  crashIf(chunk.heapBytes() != 0);
+
+  auto blocks = Blocks(VoxelChunk::volume);
+  for (auto& block : blocks) block = static_cast<BlockId>(rand() % 5);
+  chunk.assign(blocks.data());
+  checkChunk(chunk, blocks);
+  crashIf(chunk.bits() != 4);
+}
+
+// Edits a world spanning chunks on both sides of the origin, and checks
+// reads, neighborhoods and the chunks marked dirty.
+void checkWorld() {
+  constexpr int extent = 2 * voxelChunkSize;
+  constexpr int side = 2 * extent;
+  auto world = VoxelWorld();
+  auto expected = Blocks(side * side * side, airBlock);
+  auto indexOf = [](glm::ivec3 const& pos) {
+    return static_cast<size_t>(pos.x + extent) +
+           side * (static_cast<size_t>(pos.y + extent) +
+                   side * static_cast<size_t>(pos.z + extent));
+  };
+  auto expectedAt = [&](glm::ivec3 const& pos) {
+    auto inside = glm::all(glm::greaterThanEqual(pos, glm::ivec3(-extent))) &&
+                  glm::all(glm::lessThan(pos, glm::ivec3(extent)));
+    return inside ? expected[indexOf(pos)] : airBlock;
+  };
+
+  for (size_t n = 0; n < 200000; ++n) {
+    auto pos = glm::ivec3{rand() % side - extent, rand() % side - extent,
+                          rand() % side - extent};
+    auto block = static_cast<BlockId>(rand() % 4 ? rand() % 300 : airBlock);
+    world.set(pos, block);
+    expected[indexOf(pos)] = block;
+  }
+
+  // Every edited chunk is dirty, as are neighbors whose border was
+  // edited, but none further away.
+  auto dirty = world.takeDirtyChunks();
+  for (int cz = -2; cz < 2; ++cz) {
+    for (int cy = -2; cy < 2; ++cy) {
+      for (int cx = -2; cx < 2; ++cx) {
+        crashIf(!contains(dirty, glm::ivec3{cx, cy, cz}));
+      }
+    }
+  }
+  for (auto const& chunk : dirty) {
+    crashIf(glm::any(glm::lessThan(chunk, glm::ivec3(-3))) ||
+            glm::any(glm::greaterThan(chunk, glm::ivec3(2))));
+  }
+  crashIf(!world.takeDirtyChunks().empty());
+
+  auto checkReads = [&] {
+    auto read = VoxelWorld::Reader(world);
+    for (int z = -extent; z < extent; ++z) {
+      for (int y = -extent; y < extent; ++y) {
+        for (int x = -extent; x < extent; ++x) {
+          crashIf(world.at({x, y, z}) != expected[indexOf({x, y, z})]);
+          crashIf(read({x, y, z}) != expected[indexOf({x, y, z})]);
+        }
+      }
+    }
+
+    auto neighborhood = std::make_unique<VoxelNeighborhood>();
+    for (int cz = -3; cz < 3; ++cz) {
+      for (int cy = -3; cy < 3; ++cy) {
+        for (int cx = -3; cx < 3; ++cx) {
+          world.fillNeighborhood({cx, cy, cz}, *neighborhood);
+          auto corner = glm::ivec3{cx, cy, cz} * voxelChunkSize;
+          for (int z = -1; z <= voxelChunkSize; ++z) {
+            for (int y = -1; y <= voxelChunkSize; ++y) {
+              for (int x = -1; x <= voxelChunkSize; ++x) {
+                crashIf(neighborhood->at(x, y, z) !=
+                        expectedAt(corner + glm::ivec3{x, y, z}));
+              }
+            }
+          }
+        }
+      }
+    }
+  };
+  checkReads();
+
+  // Clearing a chunk to air lets compaction drop it.
+  for (int z = 0; z < voxelChunkSize; ++z) {
+    for (int y = 0; y < voxelChunkSize; ++y) {
+      for (int x = 0; x < voxelChunkSize; ++x) {
+        world.set({x, y, z}, airBlock);
+        expected[indexOf({x, y, z})] = airBlock;
+      }
+    }
+  }
+  auto numChunks = world.report().numChunks;
+  world.compact();
+  crashIf(world.hasChunk({0, 0, 0}));
+  crashIf(world.report().numChunks != numChunks - 1);
+  checkReads();
+}
+
+int main() {
+  srand(1);
+  checkPaletteRoundTrip();
+  checkWorld();
+  return 0;
+}
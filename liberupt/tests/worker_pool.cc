@@ -0,0 +1,54 @@
+#include <liberupt/source/worker_pool.h>
+
+// Runs many short loops back to back, which is when workers waking up
+// late for one loop overlap the start of the next, and checks that each
+// index is processed exactly once. Best run under ThreadSanitizer.
+
+void checkLoops(WorkerPool& pool) {
+  auto counts = std::vector<std::atomic<uint32_t>>(4096);
+  for (size_t loop = 0; loop < 5000; ++loop) {
+    auto count = 1 + loop * 7919 % counts.size();
+    auto grain = 1 + loop % 5;
+    pool.parallelFor(count, grain, [&](size_t begin, size_t end) {
+      crashIf(begin >= end || end > count || end - begin > grain);
+      for (auto i = begin; i < end; ++i) {
+        counts[i].fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+
+    for (size_t i = 0; i < counts.size(); ++i) {
+      crashIf(counts[i].exchange(0) != (i < count ? 1 : 0));
+    }
+  }
+}
+
+// Loops started from inside a loop body throw, rather than deadlock,
+// and leave the pool usable.
+void checkNestedLoopThrows(WorkerPool& pool) {
+  auto threw = false;
+  try {
+    pool.parallelFor(64, 1, [&](size_t begin, size_t) {
+      if (begin == 0) pool.parallelFor(64, 1, [](size_t, size_t) {});
+    });
+  } catch (std::runtime_error const&) {
+    threw = true;
+  }
+  crashIf(!threw);
+
+  auto sum = std::atomic<size_t>(0);
+  pool.parallelFor(100, 3, [&](size_t begin, size_t end) {
+    for (auto i = begin; i < end; ++i) sum += i;
+  });
+  crashIf(sum != 4950);
+}
+
+int main() {
+  for (size_t numThreads : {1, 3, 8}) {
+    auto pool = WorkerPool(numThreads);
+    checkLoops(pool);
+  }
+
+  auto pool = WorkerPool(4);
+  checkNestedLoopThrows(pool);
+  return 0;
+}